@@ -0,0 +1,619 @@
+#include <QtTest/QtTest>
+
+#include <QRandomGenerator>
+
+#include <atomic>
+#include <numeric>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "analytics/CampaignAnalytics.h"
+#include "daemon/CommandProcessor.h"
+#include "models/AreaEffect.h"
+#include "models/InitiativeModel.h"
+#include "models/TurnManager.h"
+#include "stores/BestiaryImport.h"
+#include "stores/CombatLog.h"
+#include "stores/EncounterStore.h"
+#include "stores/RosterStore.h"
+#include "undo/UndoCommands.h"
+#include "utils/Arena.h"
+
+namespace {
+std::atomic<quint64> g_mallocCalls{0};
+} // namespace
+
+#if defined(__GLIBC__)
+// Counts every malloc in the process, Qt's own included, by interposing on
+// glibc's. Only the benchmark binary does this.
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *malloc(size_t size) noexcept {
+    g_mallocCalls.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+#endif
+
+namespace {
+
+// Sizes above DND_BENCH_MAX_COUNT are skipped, so a quick local run can stop
+// at 100k while CI measures the full range.
+int maxBenchCount() {
+    return qEnvironmentVariableIsSet("DND_BENCH_MAX_COUNT") ? qEnvironmentVariableIntValue("DND_BENCH_MAX_COUNT") : 1000000;
+}
+
+void addSizeRows() {
+    QTest::addColumn<int>("count");
+    const int maxCount = maxBenchCount();
+    const struct {
+        const char *label;
+        int count;
+    } sizes[] = {{"10", 10}, {"1k", 1000}, {"100k", 100000}, {"1M", 1000000}};
+    for (const auto &size : sizes) {
+        if (size.count <= maxCount) {
+            QTest::newRow(size.label) << size.count;
+        }
+    }
+}
+
+QVector<Combatant> makeCombatants(int count, double unconsciousShare = 0.0) {
+    QRandomGenerator rng(1234);
+    QVector<Combatant> list;
+    list.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        Combatant combatant{i + 1, QStringLiteral("Creature %1").arg(i + 1), rng.bounded(1, 31), rng.bounded(-2, 6), i % 7 == 0};
+        combatant.hp = rng.bounded(1, 120);
+        combatant.ac = rng.bounded(10, 22);
+        combatant.conscious = rng.generateDouble() >= unconsciousShare;
+        if (i % 3 == 0) {
+            combatant.conditions.append({QStringLiteral("Poisoned"), 1000000});
+        }
+        list.push_back(combatant);
+    }
+    return list;
+}
+
+QVector<RosterCharacter> makeCharacters(int count) {
+    static const QString kTags[] = {QStringLiteral("undead"), QStringLiteral("beast"), QStringLiteral("boss"), QStringLiteral("minion")};
+    QVector<RosterCharacter> characters;
+    characters.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        RosterCharacter character;
+        character.name = QStringLiteral("Monster %1").arg(i + 1);
+        character.dexMod = i % 5;
+        character.tags = {kTags[i % 4], kTags[(i / 4) % 4]};
+        character.defaultHP = 10 + i % 50;
+        characters.push_back(character);
+    }
+    return characters;
+}
+
+// Heap bytes in use, or 0 where the allocator cannot report it.
+qint64 heapInUse() {
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    return static_cast<qint64>(mallinfo2().uordblks);
+#else
+    return 0;
+#endif
+}
+
+// Per-combatant layout before names and conditions were interned.
+struct LegacyCondition {
+    QString name;
+    int remainingRounds = 0;
+};
+
+struct LegacyCombatant {
+    int id = 0;
+    QString name;
+    int initiative = 0;
+    int dexMod = 0;
+    bool isPC = false;
+    bool conscious = true;
+    int hp = 0;
+    int ac = 10;
+    DeathSaves deathSaves;
+    QVector<LegacyCondition> conditions;
+    QString notes;
+};
+
+// The comparator TurnManager hard-coded before tie-breaks became rule policies.
+bool referenceLess(const Combatant &lhs, const Combatant &rhs) {
+    if (lhs.initiative != rhs.initiative) {
+        return lhs.initiative > rhs.initiative;
+    }
+    if (lhs.dexMod != rhs.dexMod) {
+        return lhs.dexMod > rhs.dexMod;
+    }
+    if (lhs.isPC != rhs.isPC) {
+        return lhs.isPC && !rhs.isPC;
+    }
+    return lhs.name.lessCaseFolded(rhs.name);
+}
+
+} // namespace
+
+class BenchmarkSuite : public QObject {
+    Q_OBJECT
+private slots:
+    void sortCombatants_data() { addSizeRows(); }
+    void sortCombatants();
+    void advanceTurnMostlyUnconscious_data() { addSizeRows(); }
+    void advanceTurnMostlyUnconscious();
+    void decrementConditions_data() { addSizeRows(); }
+    void decrementConditions();
+    void serialize_data() { addSizeRows(); }
+    void serialize();
+    void deserialize_data() { addSizeRows(); }
+    void deserialize();
+    void filterCharacters_data() { addSizeRows(); }
+    void filterCharacters();
+    void massAdd_data() { addSizeRows(); }
+    void massAdd();
+    void massAddGroup_data() { addSizeRows(); }
+    void massAddGroup();
+    void modelDataSweep_data() { addSizeRows(); }
+    void modelDataSweep();
+    void combatantFootprint_data();
+    void sortByRules_data();
+    void sortByRules();
+    void rerollRound_data() { addSizeRows(); }
+    void rerollRound();
+    void cohortResort_data() { addSizeRows(); }
+    void cohortResort();
+    void allocationCounts_data();
+    void allocationCounts();
+    void advanceTurnLogged_data();
+    void advanceTurnLogged();
+    void campaignSummary_data();
+    void campaignSummary();
+    void rosterSaveEdit_data();
+    void rosterSaveEdit();
+    void bestiaryImport_data();
+    void bestiaryImport();
+    void daemonThroughput();
+    void combatantFootprint();
+};
+
+void BenchmarkSuite::sortCombatants() {
+    QFETCH(int, count);
+    TurnManager manager;
+    manager.setCombatants(makeCombatants(count));
+    QBENCHMARK {
+        // Perturb the initiatives so every iteration sorts an unsorted list.
+        manager.forEachCombatant([](Combatant &combatant) { combatant.initiative = (combatant.initiative * 7 + 3) % 31; });
+        manager.sortCombatants();
+    }
+}
+
+void BenchmarkSuite::advanceTurnMostlyUnconscious() {
+    QFETCH(int, count);
+    TurnManager manager;
+    manager.setCombatants(makeCombatants(count, 0.95));
+    QBENCHMARK {
+        manager.advanceTurn();
+    }
+}
+
+void BenchmarkSuite::decrementConditions() {
+    QFETCH(int, count);
+    TurnManager manager;
+    manager.setCombatants(makeCombatants(count));
+    QBENCHMARK {
+        manager.decrementConditionsForCurrent();
+    }
+}
+
+void BenchmarkSuite::serialize() {
+    QFETCH(int, count);
+    TurnManager manager;
+    manager.setCombatants(makeCombatants(count));
+    QByteArray data;
+    QBENCHMARK {
+        data = EncounterStore::serialize(manager, manager.round(), manager.turnIndex());
+    }
+    QVERIFY(!data.isEmpty());
+}
+
+void BenchmarkSuite::deserialize() {
+    QFETCH(int, count);
+    TurnManager source;
+    source.setCombatants(makeCombatants(count));
+    const auto data = EncounterStore::serialize(source, source.round(), source.turnIndex());
+    TurnManager manager;
+    int round = 0;
+    int turnIndex = 0;
+    QBENCHMARK {
+        QVERIFY(EncounterStore::deserialize(data, manager, round, turnIndex));
+    }
+    QCOMPARE(manager.combatants().size(), count);
+}
+
+void BenchmarkSuite::filterCharacters() {
+    QFETCH(int, count);
+    RosterStore store;
+    store.setCharacters(makeCharacters(count));
+    const QSet<QString> tags{QStringLiteral("undead")};
+    QVector<RosterCharacter> results;
+    QBENCHMARK {
+        results = store.filterCharacters(QStringLiteral("monster 1"), tags);
+    }
+    QVERIFY(!results.isEmpty());
+}
+
+void BenchmarkSuite::massAdd() {
+    QFETCH(int, count);
+    RosterStore store;
+    store.setCharacters(makeCharacters(1));
+    const auto name = store.characters().first().name;
+    QVector<Combatant> added;
+    QBENCHMARK {
+        added = store.massAdd(name, count, store.defaultNaming());
+    }
+    QCOMPARE(added.size(), count);
+}
+
+void BenchmarkSuite::massAddGroup() {
+    QFETCH(int, count);
+    RosterStore store;
+    store.setCharacters(makeCharacters(10));
+    RosterGroup group;
+    group.name = QStringLiteral("Horde");
+    for (const auto &character : store.characters()) {
+        group.entries.push_back({character.name, std::max(1, count / 10)});
+    }
+    store.setGroups({group});
+    QVector<Combatant> added;
+    QBENCHMARK {
+        added = store.massAddGroup(group.name, store.defaultNaming());
+    }
+    QVERIFY(!added.isEmpty());
+}
+
+void BenchmarkSuite::modelDataSweep() {
+    QFETCH(int, count);
+    TurnManager manager;
+    manager.setCombatants(makeCombatants(count));
+    InitiativeModel model(&manager);
+    const int rows = model.rowCount();
+    const int columns = model.columnCount();
+    qint64 checksum = 0;
+    QBENCHMARK {
+        for (int row = 0; row < rows; ++row) {
+            for (int column = 0; column < columns; ++column) {
+                checksum += model.data(model.index(row, column), Qt::DisplayRole).isValid();
+            }
+        }
+    }
+    QVERIFY(checksum > 0);
+}
+
+void BenchmarkSuite::combatantFootprint_data() {
+    QTest::addColumn<int>("count");
+    QTest::addColumn<bool>("legacy");
+    const int maxCount = maxBenchCount();
+    for (const int count : {10000, 100000}) {
+        if (count <= maxCount) {
+            const auto label = QByteArray::number(count / 1000) + "k";
+            QTest::newRow((label + " interned").constData()) << count << false;
+            QTest::newRow((label + " legacy").constData()) << count << true;
+        }
+    }
+}
+
+// Heap growth for a mass-spawned encounter where everyone is poisoned, as
+// decoded from JSON. Reported as BytesAllocated; 0 off glibc.
+void BenchmarkSuite::combatantFootprint() {
+    QFETCH(int, count);
+    QFETCH(bool, legacy);
+    const SpawnStyle style{QStringLiteral("Goblin"), QStringLiteral("%name #%index"), false, 2};
+    const qint64 before = heapInUse();
+    qint64 bytes = 0;
+    if (legacy) {
+        QVector<LegacyCombatant> list;
+        list.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            LegacyCombatant combatant;
+            combatant.id = i + 1;
+            combatant.name = CombatantName::format(style, i + 1);
+            combatant.conditions.append({QString::fromLatin1("Poisoned"), 10});
+            list.push_back(std::move(combatant));
+        }
+        bytes = heapInUse() - before;
+    } else {
+        QVector<Combatant> list;
+        list.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            Combatant combatant;
+            combatant.id = i + 1;
+            combatant.name = CombatantName::spawned(style, i + 1);
+            combatant.conditions.append({QString::fromLatin1("Poisoned"), 10});
+            list.push_back(std::move(combatant));
+        }
+        bytes = heapInUse() - before;
+    }
+    QTest::setBenchmarkResult(static_cast<qreal>(bytes), QTest::BytesAllocated);
+}
+
+void BenchmarkSuite::sortByRules_data() {
+    QTest::addColumn<int>("count");
+    QTest::addColumn<int>("rules");
+    const int maxCount = maxBenchCount();
+    const struct {
+        const char *label;
+        int rules;
+    } variants[] = {{"reference", -1}, {"standard", 0}, {"npcs-win-ties", 1}, {"dex-score", 2}, {"random-tiebreak", 3}, {"side", 4}};
+    for (const int count : {1000, 100000}) {
+        if (count > maxCount) {
+            continue;
+        }
+        for (const auto &variant : variants) {
+            const auto label = QByteArray::number(count) + " " + variant.label;
+            QTest::newRow(label.constData()) << count << variant.rules;
+        }
+    }
+}
+
+// rules -1 is the old hard-coded comparator; the others run the specialized
+// sort TurnManager picks for that InitiativeRules value.
+void BenchmarkSuite::sortByRules() {
+    QFETCH(int, count);
+    QFETCH(int, rules);
+    auto list = makeCombatants(count);
+    QRandomGenerator rng(99);
+    for (auto &combatant : list) {
+        combatant.tiebreak = rng.bounded(1, 1 << 20);
+        combatant.side = rng.bounded(0, 3);
+    }
+    QBENCHMARK {
+        auto sorted = list;
+        if (rules < 0) {
+            std::stable_sort(sorted.begin(), sorted.end(), referenceLess);
+        } else {
+            visitInitiativeOrder(static_cast<InitiativeRules>(rules), [&sorted](auto order) {
+                using Order = decltype(order);
+                std::stable_sort(sorted.begin(), sorted.end(), [](const Combatant &lhs, const Combatant &rhs) { return Order::less(lhs, rhs); });
+            });
+        }
+    }
+}
+
+// A re-roll-every-round table: batched rolls plus one sort, which takes the
+// radix path from TurnManager::kRadixSortThreshold up.
+void BenchmarkSuite::rerollRound() {
+    QFETCH(int, count);
+    TurnManager manager;
+    manager.setCombatants(makeCombatants(count));
+    DiceRoller roller;
+    roller.setSeed(5);
+    QBENCHMARK {
+        manager.rerollInitiative(roller, RollMode::Normal);
+    }
+}
+
+void BenchmarkSuite::cohortResort() {
+    QFETCH(int, count);
+    // Six monster groups share the table with a handful of solo PCs.
+    auto list = makeCombatants(count);
+    QVector<Cohort> cohorts;
+    for (int id = 1; id <= 6; ++id) {
+        cohorts.push_back({id, QStringLiteral("Group %1").arg(id), 10 + id, id % 3});
+    }
+    for (int i = 0; i < list.size(); ++i) {
+        list[i].cohort = i % 50 < 4 ? 0 : 1 + i % 6;
+    }
+    TurnManager manager;
+    manager.setCombatants(list, cohorts);
+    int round = 0;
+    QBENCHMARK {
+        const int id = 1 + round++ % 6;
+        manager.setCohortInitiative(id, (manager.cohortById(id)->initiative * 7 + 3) % 31);
+    }
+}
+
+void BenchmarkSuite::allocationCounts_data() {
+    QTest::addColumn<int>("operation");
+    QTest::addColumn<bool>("arena");
+    const char *operations[] = {"load", "sort", "reroll", "area-effect"};
+    for (int operation = 0; operation < 4; ++operation) {
+        QTest::newRow(qPrintable(QStringLiteral("%1/heap").arg(operations[operation]))) << operation << false;
+        QTest::newRow(qPrintable(QStringLiteral("%1/arena").arg(operations[operation]))) << operation << true;
+    }
+}
+
+// malloc calls made by one operation on 10k combatants, with the scratch
+// arenas and node pool on and off. Reported as events; 0 without glibc.
+void BenchmarkSuite::allocationCounts() {
+    QFETCH(int, operation);
+    QFETCH(bool, arena);
+    constexpr int kCount = 10000;
+    arena::setEnabled(arena);
+    TurnManager manager;
+    manager.setCombatants(makeCombatants(kCount));
+    const auto data = EncounterStore::serialize(manager, manager.round(), manager.turnIndex());
+    DiceRoller roller;
+    roller.setSeed(9);
+    QVector<int> rows(kCount);
+    std::iota(rows.begin(), rows.end(), 0);
+    AreaEffectSpec spec;
+    spec.damage = DiceExpression::parse(QStringLiteral("8d6")).value_or(DiceExpression());
+
+    const quint64 before = g_mallocCalls.load(std::memory_order_relaxed);
+    switch (operation) {
+    case 0: {
+        int round = 0;
+        int turnIndex = 0;
+        QVERIFY(EncounterStore::deserialize(data, manager, round, turnIndex));
+        break;
+    }
+    case 1:
+        manager.forEachCombatant([](Combatant &combatant) { combatant.initiative = (combatant.initiative * 7 + 3) % 31; });
+        manager.sortCombatants();
+        break;
+    case 2:
+        manager.rerollInitiative(roller, RollMode::Normal);
+        break;
+    default: {
+        QVector<Combatant> beforeEdit;
+        QVector<Combatant> afterEdit;
+        resolveAreaEffect(manager, rows, spec, roller).collectEdits(manager, beforeEdit, afterEdit);
+        ApplyToManyCommand(&manager, beforeEdit, afterEdit).redo();
+        break;
+    }
+    }
+    const quint64 calls = g_mallocCalls.load(std::memory_order_relaxed) - before;
+    arena::setEnabled(true);
+    QTest::setBenchmarkResult(static_cast<qreal>(calls), QTest::Events);
+}
+
+void BenchmarkSuite::advanceTurnLogged_data() {
+    QTest::addColumn<int>("count");
+    QTest::addColumn<bool>("logged");
+    for (const int count : {1000, 100000}) {
+        QTest::newRow(qPrintable(QStringLiteral("%1/plain").arg(count))) << count << false;
+        QTest::newRow(qPrintable(QStringLiteral("%1/logged").arg(count))) << count << true;
+    }
+}
+
+// advanceTurn with and without a CombatLog attached; the two should match.
+void BenchmarkSuite::advanceTurnLogged() {
+    QFETCH(int, count);
+    QFETCH(bool, logged);
+    const auto directory = QDir::temp().filePath(QStringLiteral("dnd-bench-log-%1").arg(QCoreApplication::applicationPid()));
+    QDir(directory).removeRecursively();
+    CombatLog log(directory);
+    log.setMaxSegments(4);
+    QVERIFY(log.open());
+    TurnManager manager;
+    manager.setCombatants(makeCombatants(count));
+    manager.setEventLog(logged ? &log : nullptr);
+    QBENCHMARK {
+        manager.advanceTurn();
+    }
+    manager.setEventLog(nullptr);
+    log.close();
+    QDir(directory).removeRecursively();
+}
+
+void BenchmarkSuite::campaignSummary_data() {
+    QTest::addColumn<int>("fights");
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("10k") << 10000;
+}
+
+// The full campaign summary over fights of four PCs and eight monsters.
+void BenchmarkSuite::campaignSummary() {
+    QFETCH(int, fights);
+    QRandomGenerator rng(77);
+    const QStringList party = {QStringLiteral("Vaelen"), QStringLiteral("Brom"), QStringLiteral("Isla"), QStringLiteral("Tamsin")};
+    CampaignAnalytics analytics;
+    for (int fight = 0; fight < fights; ++fight) {
+        EncounterData encounter;
+        encounter.round = rng.bounded(1, 12);
+        for (int i = 0; i < 12; ++i) {
+            const bool isPC = i < party.size();
+            const auto name = isPC ? party.at(i) : QStringLiteral("Monster %1").arg(rng.bounded(40));
+            encounter.combatants.push_back(Combatant{i + 1, name, rng.bounded(1, 26), rng.bounded(-1, 5), isPC});
+        }
+        analytics.addEncounter(encounter);
+    }
+    QBENCHMARK {
+        const auto lines = analytics.summary();
+        QVERIFY(!lines.isEmpty());
+    }
+}
+
+void BenchmarkSuite::rosterSaveEdit_data() {
+    QTest::addColumn<int>("count");
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("100k") << 100000;
+}
+
+// One tag edit followed by a save; only the edited shard is rewritten.
+void BenchmarkSuite::rosterSaveEdit() {
+    QFETCH(int, count);
+    const auto basePath = QDir::temp().filePath(QStringLiteral("dnd-bench-roster-%1").arg(QCoreApplication::applicationPid()));
+    QDir(basePath).removeRecursively();
+    RosterStore store;
+    store.setBasePath(basePath);
+    store.setCharacters(makeCharacters(count));
+    QVERIFY(store.save());
+    auto character = store.characters().at(count / 2);
+    int edit = 0;
+    QBENCHMARK {
+        character.tags = {QStringLiteral("edit %1").arg(++edit)};
+        store.updateCharacter(character);
+        QVERIFY(store.save());
+    }
+    QDir(basePath).removeRecursively();
+}
+
+void BenchmarkSuite::bestiaryImport_data() {
+    QTest::addColumn<int>("rows");
+    QTest::newRow("10k") << 10000;
+    QTest::newRow("100k") << 100000;
+}
+
+// A spreadsheet export with quoted notes, parsed from memory.
+void BenchmarkSuite::bestiaryImport() {
+    QFETCH(int, rows);
+    QByteArray csv = "Name,DEX,HP,AC,Tags,Notes\n";
+    for (int i = 0; i < rows; ++i) {
+        csv += QStringLiteral("Monster %1,%2,%3d8+%4,%5,beast;minion,\"Bites, then \"\"retreats\"\"\"\n")
+                   .arg(i + 1)
+                   .arg(i % 5)
+                   .arg(1 + i % 12)
+                   .arg(i % 7)
+                   .arg(10 + i % 9)
+                   .toUtf8();
+    }
+    BestiaryResult result;
+    QBENCHMARK {
+        result = BestiaryImport::parse(csv.constData(), csv.size());
+    }
+    QCOMPARE(result.data.characters.size(), rows);
+    QVERIFY(result.errors.isEmpty());
+}
+
+// 100k mixed daemon commands against 100 combatants. The daemon's target is
+// at least 50k commands/s, i.e. under two seconds per iteration.
+void BenchmarkSuite::daemonThroughput() {
+    TurnManager manager;
+    DiceRoller roller;
+    roller.setSeed(36);
+    CommandProcessor processor(manager, roller);
+    QByteArray setup;
+    for (int i = 1; i <= 100; ++i) {
+        setup += QStringLiteral("{\"cmd\":\"add\",\"name\":\"C%1\",\"initiative\":%2,\"hp\":20}\n").arg(i).arg(i % 25).toUtf8();
+    }
+    QByteArray out;
+    QCOMPARE(processor.processBuffer(setup, out), 100);
+
+    constexpr int kCommands = 100000;
+    QRandomGenerator rng(36);
+    QByteArray commands;
+    for (int i = 0; i < kCommands; ++i) {
+        const int id = 1 + rng.bounded(100);
+        switch (rng.bounded(4)) {
+        case 0:
+            commands += "{\"cmd\":\"advance\"}\n";
+            break;
+        case 1:
+            commands += QStringLiteral("{\"cmd\":\"roll\",\"id\":%1}\n").arg(id).toUtf8();
+            break;
+        default:
+            commands += QStringLiteral("{\"cmd\":\"set-hp\",\"id\":%1,\"hp\":%2}\n").arg(id).arg(rng.bounded(30)).toUtf8();
+            break;
+        }
+    }
+    QBENCHMARK {
+        QByteArray input = commands;
+        out.clear();
+        QCOMPARE(processor.processBuffer(input, out), kCommands);
+    }
+    QVERIFY(!out.contains("\"error\""));
+}
+
+QTEST_MAIN(BenchmarkSuite)
+#include "BenchmarkSuite.moc"
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""Compare two QtTest XML benchmark reports and flag regressions.
+
+Usage:
+    compare_benchmarks.py BASELINE.xml CURRENT.xml [--threshold 0.10]
+
+Exits with status 1 when any benchmark is slower than the baseline by more
+than the threshold (a fraction; 0.10 means 10%).
+"""
+
+import argparse
+import sys
+import xml.etree.ElementTree as ET
+
+
+def load(path):
+    results = {}
+    root = ET.parse(path).getroot()
+    for function in root.iter("TestFunction"):
+        name = function.get("name")
+        for result in function.iter("BenchmarkResult"):
+            iterations = int(result.get("iterations", "1")) or 1
+            key = (name, result.get("tag", ""), result.get("metric", ""))
+            results[key] = float(result.get("value")) / iterations
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.10)
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+    regressions = 0
+    for key in sorted(current):
+        name, tag, metric = key
+        label = f"{name}[{tag}] ({metric})"
+        if key not in baseline:
+            print(f"NEW        {label}: {current[key]:.6g}")
+            continue
+        before = baseline[key]
+        after = current[key]
+        change = (after - before) / before if before > 0 else 0.0
+        status = "ok"
+        if change > args.threshold:
+            status = "REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            status = "improved"
+        print(f"{status:<10} {label}: {before:.6g} -> {after:.6g} ({change:+.1%})")
+    for key in sorted(set(baseline) - set(current)):
+        print(f"MISSING    {key[0]}[{key[1]}] ({key[2]})")
+
+    if regressions:
+        print(f"{regressions} benchmark(s) regressed by more than {args.threshold:.0%}")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
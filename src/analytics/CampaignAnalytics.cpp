@@ -0,0 +1,482 @@
+#include "CampaignAnalytics.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "stores/CombatLog.h"
+#include "stores/EncounterStore.h"
+#include "utils/Arena.h"
+#include "utils/Trace.h"
+
+namespace {
+
+constexpr quint32 kSnapshotMagic = 0x444e4441; // "DNDA"
+constexpr quint32 kSnapshotVersion = 1;
+constexpr int kBlockRows = 1024;
+// Wider group-by ranges fall back to a hash from key to accumulator.
+constexpr qint64 kMaxDenseGroups = 1 << 20;
+
+std::size_t index(AnalyticsField field) {
+    return std::size_t(field);
+}
+
+qint32 floorDiv(qint32 value, qint32 divisor) {
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+// Keeps the rows of selection whose value passes compare, in place and
+// without a branch per row.
+template <typename Compare>
+int compact(const qint32 *values, qint32 operand, int *selection, int selected, Compare compare) {
+    int kept = 0;
+    for (int i = 0; i < selected; ++i) {
+        const int row = selection[i];
+        selection[kept] = row;
+        kept += compare(values[row], operand) ? 1 : 0;
+    }
+    return kept;
+}
+
+int applyFilter(const qint32 *values, const AnalyticsFilter &filter, int *selection, int selected) {
+    switch (filter.op) {
+    case AnalyticsOp::Equal:
+        return compact(values, filter.value, selection, selected, std::equal_to<>());
+    case AnalyticsOp::NotEqual:
+        return compact(values, filter.value, selection, selected, std::not_equal_to<>());
+    case AnalyticsOp::Less:
+        return compact(values, filter.value, selection, selected, std::less<>());
+    case AnalyticsOp::LessEqual:
+        return compact(values, filter.value, selection, selected, std::less_equal<>());
+    case AnalyticsOp::Greater:
+        return compact(values, filter.value, selection, selected, std::greater<>());
+    case AnalyticsOp::GreaterEqual:
+        return compact(values, filter.value, selection, selected, std::greater_equal<>());
+    }
+    return selected;
+}
+
+const struct {
+    AnalyticsField field;
+    const char *name;
+} kFieldNames[] = {
+    {AnalyticsField::Fight, "fight"},
+    {AnalyticsField::Name, "name"},
+    {AnalyticsField::IsPC, "pc"},
+    {AnalyticsField::Initiative, "initiative"},
+    {AnalyticsField::DamageTaken, "damage"},
+    {AnalyticsField::ConditionRounds, "conditions"},
+    {AnalyticsField::Rounds, "rounds"},
+};
+
+} // namespace
+
+bool CampaignAnalytics::addEncounterFile(const QString &path) {
+    TRACE_SCOPE("CampaignAnalytics::addEncounterFile");
+    const QFileInfo info(path);
+    const auto source = QStringLiteral("%1@%2").arg(info.absoluteFilePath()).arg(info.lastModified().toMSecsSinceEpoch());
+    if (m_sources.contains(source)) {
+        return false;
+    }
+    const auto encounter = EncounterStore::readFile(path);
+    if (!encounter) {
+        return false;
+    }
+    addEncounter(*encounter);
+    m_sources.insert(source);
+    return true;
+}
+
+void CampaignAnalytics::addEncounter(const EncounterData &encounter) {
+    const int firstRow = rowCount();
+    const qint32 fight = fightCount();
+    for (const auto &combatant : encounter.combatants) {
+        appendRow({fight, intern(combatant.name.toString()), combatant.isPC, combatant.initiative, 0, 0, 0});
+    }
+    endFight(firstRow, encounter.round);
+}
+
+int CampaignAnalytics::addCombatLog(const CombatLog &log) {
+    TRACE_SCOPE("CampaignAnalytics::addCombatLog");
+    const auto directory = log.directory();
+    quint64 sequence = std::max(m_logResume.value(directory, 0), log.firstSequence());
+    int added = 0;
+    bool inFight = false;
+    int firstRound = 0;
+    int lastRound = 0;
+    std::vector<std::array<qint32, kFieldCount>> rows;
+    QHash<int, int> rowById;
+    QHash<QPair<int, quint32>, int> conditionSince;
+
+    const auto rowFor = [&](int id) -> std::array<qint32, kFieldCount> & {
+        auto it = rowById.constFind(id);
+        if (it == rowById.constEnd()) {
+            it = rowById.insert(id, int(rows.size()));
+            rows.push_back({fightCount(), intern(QStringLiteral("#%1").arg(id)), 0, 0, 0, 0, 0});
+        }
+        return rows[std::size_t(it.value())];
+    };
+    const auto finishFight = [&]() {
+        // Conditions still running when the next fight began lasted to its end.
+        for (auto it = conditionSince.cbegin(); it != conditionSince.cend(); ++it) {
+            rowFor(it.key().first)[index(AnalyticsField::ConditionRounds)] += lastRound - it.value() + 1;
+        }
+        const int firstRow = rowCount();
+        for (const auto &row : rows) {
+            appendRow(row);
+        }
+        endFight(firstRow, lastRound - firstRound + 1);
+        rows.clear();
+        rowById.clear();
+        conditionSince.clear();
+        ++added;
+    };
+
+    for (const quint64 end = log.endSequence(); sequence < end; ++sequence) {
+        const auto event = log.at(sequence);
+        const int round = int(event.round);
+        if (event.type == CombatEventType::EncounterStarted) {
+            if (inFight) {
+                finishFight();
+            }
+            // The fight starting here is only complete once the next one starts.
+            m_logResume.insert(directory, sequence);
+            inFight = true;
+            firstRound = round;
+            lastRound = round;
+            continue;
+        }
+        if (!inFight) {
+            continue;
+        }
+        lastRound = std::max(lastRound, round);
+        switch (event.type) {
+        case CombatEventType::Added: {
+            auto &row = rowFor(event.combatantId);
+            row[index(AnalyticsField::Name)] = intern(log.text(event.text));
+            row[index(AnalyticsField::Initiative)] = event.before;
+            row[index(AnalyticsField::IsPC)] = event.after;
+            break;
+        }
+        case CombatEventType::InitiativeChanged:
+            rowFor(event.combatantId)[index(AnalyticsField::Initiative)] = event.after;
+            break;
+        case CombatEventType::HpChanged:
+            rowFor(event.combatantId)[index(AnalyticsField::DamageTaken)] += std::max(0, event.before - event.after);
+            break;
+        case CombatEventType::ConditionAdded:
+            conditionSince.insert({event.combatantId, event.text}, round);
+            break;
+        case CombatEventType::ConditionEnded: {
+            const auto it = conditionSince.find({event.combatantId, event.text});
+            if (it != conditionSince.end()) {
+                // Rounds touched, counting the ones it began and ended in.
+                rowFor(event.combatantId)[index(AnalyticsField::ConditionRounds)] += round - it.value() + 1;
+                conditionSince.erase(it);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return added;
+}
+
+void CampaignAnalytics::clear() {
+    for (auto &column : m_columns) {
+        column.clear();
+    }
+    m_min.fill(0);
+    m_max.fill(0);
+    m_fightRounds.clear();
+    m_names.clear();
+    m_nameCodes.clear();
+    m_sources.clear();
+    m_logResume.clear();
+}
+
+bool CampaignAnalytics::save(const QString &path) const {
+    TRACE_SCOPE("CampaignAnalytics::save");
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << kSnapshotMagic << kSnapshotVersion << m_names << m_sources << m_logResume;
+    stream << quint32(rowCount()) << quint32(fightCount());
+    // Columns are written in native byte order: the snapshot is a cache of
+    // the encounter files, not an interchange format.
+    for (const auto &column : m_columns) {
+        stream.writeRawData(reinterpret_cast<const char *>(column.data()), int(column.size() * sizeof(qint32)));
+    }
+    stream.writeRawData(reinterpret_cast<const char *>(m_fightRounds.data()), int(m_fightRounds.size() * sizeof(qint32)));
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        return false;
+    }
+    return file.commit();
+}
+
+bool CampaignAnalytics::load(const QString &path) {
+    TRACE_SCOPE("CampaignAnalytics::load");
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != kSnapshotMagic || version != kSnapshotVersion) {
+        return false;
+    }
+    CampaignAnalytics loaded;
+    quint32 rows = 0;
+    quint32 fights = 0;
+    stream >> loaded.m_names >> loaded.m_sources >> loaded.m_logResume >> rows >> fights;
+    if (stream.status() != QDataStream::Ok || qint64(rows) * kFieldCount * 4 > file.size()) {
+        return false;
+    }
+    const auto readColumn = [&stream](std::vector<qint32> &column, quint32 size) {
+        column.resize(size);
+        const int bytes = int(size * sizeof(qint32));
+        return stream.readRawData(reinterpret_cast<char *>(column.data()), bytes) == bytes;
+    };
+    for (auto &column : loaded.m_columns) {
+        if (!readColumn(column, rows)) {
+            return false;
+        }
+    }
+    if (!readColumn(loaded.m_fightRounds, fights)) {
+        return false;
+    }
+    for (int i = 0; i < loaded.m_names.size(); ++i) {
+        loaded.m_nameCodes.insert(loaded.m_names.at(i), i);
+    }
+    for (int field = 0; field < kFieldCount; ++field) {
+        const auto &column = loaded.m_columns[std::size_t(field)];
+        if (!column.empty()) {
+            const auto [low, high] = std::minmax_element(column.cbegin(), column.cend());
+            loaded.m_min[std::size_t(field)] = *low;
+            loaded.m_max[std::size_t(field)] = *high;
+        }
+    }
+    *this = std::move(loaded);
+    return true;
+}
+
+std::optional<qint32> CampaignAnalytics::nameCode(const QString &name) const {
+    const auto it = m_nameCodes.constFind(name);
+    return it == m_nameCodes.constEnd() ? std::nullopt : std::optional<qint32>(it.value());
+}
+
+QString CampaignAnalytics::label(AnalyticsField field, qint32 key) const {
+    switch (field) {
+    case AnalyticsField::Name:
+        return name(key);
+    case AnalyticsField::IsPC:
+        return key ? QStringLiteral("PC") : QStringLiteral("NPC");
+    default:
+        return QString::number(key);
+    }
+}
+
+QVector<AnalyticsGroup> CampaignAnalytics::run(const AnalyticsQuery &query) const {
+    return aggregate(query.filters, query.groupBy, 1, query.aggregate, query.measure);
+}
+
+QVector<AnalyticsGroup> CampaignAnalytics::histogram(AnalyticsField field, qint32 bucketWidth, const QVector<AnalyticsFilter> &filters) const {
+    return aggregate(filters, field, std::max(1, bucketWidth), AnalyticsAggregate::Count, field);
+}
+
+double CampaignAnalytics::averageRoundsPerFight() const {
+    if (m_fightRounds.empty()) {
+        return 0.0;
+    }
+    qint64 total = 0;
+    for (const qint32 rounds : m_fightRounds) {
+        total += rounds;
+    }
+    return double(total) / double(m_fightRounds.size());
+}
+
+QStringList CampaignAnalytics::summary() const {
+    QStringList lines;
+    lines << QStringLiteral("%1 fights, %2 combatant rows").arg(fightCount()).arg(rowCount());
+    lines << QStringLiteral("Average rounds per fight: %1").arg(averageRoundsPerFight(), 0, 'f', 1);
+
+    const QVector<AnalyticsFilter> pcs = {{AnalyticsField::IsPC, AnalyticsOp::Equal, 1}};
+    const auto perPc = [&](const QString &title, AnalyticsField measure) {
+        lines << title;
+        for (const auto &group : run({pcs, AnalyticsField::Name, AnalyticsAggregate::Sum, measure})) {
+            lines << QStringLiteral("  %1: %2 (%3 per fight)").arg(name(group.key)).arg(qint64(group.value)).arg(group.value / double(group.count), 0, 'f', 1);
+        }
+    };
+    perPc(QStringLiteral("Damage taken per PC:"), AnalyticsField::DamageTaken);
+    perPc(QStringLiteral("Rounds under a condition per PC:"), AnalyticsField::ConditionRounds);
+
+    lines << QStringLiteral("Initiative per PC (min / average / max):");
+    const auto lows = run({pcs, AnalyticsField::Name, AnalyticsAggregate::Min, AnalyticsField::Initiative});
+    const auto averages = run({pcs, AnalyticsField::Name, AnalyticsAggregate::Average, AnalyticsField::Initiative});
+    const auto highs = run({pcs, AnalyticsField::Name, AnalyticsAggregate::Max, AnalyticsField::Initiative});
+    for (int i = 0; i < averages.size(); ++i) {
+        lines << QStringLiteral("  %1: %2 / %3 / %4").arg(name(averages.at(i).key)).arg(qint64(lows.at(i).value)).arg(averages.at(i).value, 0, 'f', 1).arg(qint64(highs.at(i).value));
+    }
+
+    lines << QStringLiteral("Initiative distribution:");
+    constexpr qint32 kBucket = 5;
+    for (const auto &bucket : histogram(AnalyticsField::Initiative, kBucket)) {
+        lines << QStringLiteral("  %1-%2: %3").arg(bucket.key).arg(bucket.key + kBucket - 1).arg(bucket.count);
+    }
+    return lines;
+}
+
+QString CampaignAnalytics::fieldName(AnalyticsField field) {
+    for (const auto &entry : kFieldNames) {
+        if (entry.field == field) {
+            return QString::fromLatin1(entry.name);
+        }
+    }
+    return QString();
+}
+
+std::optional<AnalyticsField> CampaignAnalytics::fieldFromName(const QString &name) {
+    for (const auto &entry : kFieldNames) {
+        if (name.compare(QLatin1String(entry.name), Qt::CaseInsensitive) == 0) {
+            return entry.field;
+        }
+    }
+    return std::nullopt;
+}
+
+QVector<AnalyticsGroup> CampaignAnalytics::aggregate(const QVector<AnalyticsFilter> &filters, std::optional<AnalyticsField> groupBy, qint32 bucketWidth,
+                                                     AnalyticsAggregate aggregate, AnalyticsField measure) const {
+    TRACE_SCOPE("CampaignAnalytics::aggregate");
+    const int rows = rowCount();
+    const qint32 *keys = groupBy ? column(*groupBy).data() : nullptr;
+    const qint32 *values = column(measure).data();
+    qint32 firstKey = 0;
+    qint64 groupCount = 1;
+    if (groupBy && rows > 0) {
+        firstKey = floorDiv(m_min[index(*groupBy)], bucketWidth);
+        groupCount = qint64(floorDiv(m_max[index(*groupBy)], bucketWidth)) - firstKey + 1;
+    }
+    const bool dense = groupCount <= kMaxDenseGroups;
+
+    ScratchArena scratch;
+    auto counts = scratch.vector<qint64>(dense ? std::size_t(groupCount) : 0);
+    auto sums = scratch.vector<qint64>(counts.size());
+    auto lows = scratch.vector<qint32>(counts.size(), std::numeric_limits<qint32>::max());
+    auto highs = scratch.vector<qint32>(counts.size(), std::numeric_limits<qint32>::min());
+    auto groupKeys = scratch.vector<qint32>();
+    QHash<qint32, int> sparseGroups;
+    const auto groupOf = [&](qint32 key) {
+        if (dense) {
+            return int(key - firstKey);
+        }
+        auto it = sparseGroups.constFind(key);
+        if (it == sparseGroups.constEnd()) {
+            it = sparseGroups.insert(key, int(counts.size()));
+            counts.push_back(0);
+            sums.push_back(0);
+            lows.push_back(std::numeric_limits<qint32>::max());
+            highs.push_back(std::numeric_limits<qint32>::min());
+            groupKeys.push_back(key);
+        }
+        return it.value();
+    };
+
+    int selection[kBlockRows];
+    for (int start = 0; start < rows; start += kBlockRows) {
+        const int length = std::min(kBlockRows, rows - start);
+        for (int i = 0; i < length; ++i) {
+            selection[i] = start + i;
+        }
+        int selected = length;
+        for (const auto &filter : filters) {
+            selected = applyFilter(column(filter.field).data(), filter, selection, selected);
+        }
+        for (int i = 0; i < selected; ++i) {
+            const int row = selection[i];
+            const int group = keys ? groupOf(floorDiv(keys[row], bucketWidth)) : 0;
+            const qint32 value = values[row];
+            ++counts[std::size_t(group)];
+            sums[std::size_t(group)] += value;
+            lows[std::size_t(group)] = std::min(lows[std::size_t(group)], value);
+            highs[std::size_t(group)] = std::max(highs[std::size_t(group)], value);
+        }
+    }
+
+    QVector<AnalyticsGroup> result;
+    const auto addGroup = [&](qint32 key, std::size_t group) {
+        const qint64 count = counts[group];
+        double value = 0.0;
+        switch (aggregate) {
+        case AnalyticsAggregate::Count:
+            value = double(count);
+            break;
+        case AnalyticsAggregate::Sum:
+            value = double(sums[group]);
+            break;
+        case AnalyticsAggregate::Average:
+            value = count > 0 ? double(sums[group]) / double(count) : 0.0;
+            break;
+        case AnalyticsAggregate::Min:
+            value = count > 0 ? lows[group] : 0;
+            break;
+        case AnalyticsAggregate::Max:
+            value = count > 0 ? highs[group] : 0;
+            break;
+        }
+        result.push_back({key, count, value});
+    };
+    if (!keys) {
+        addGroup(0, 0);
+    } else {
+        for (std::size_t group = 0; group < counts.size(); ++group) {
+            if (counts[group] > 0) {
+                addGroup((dense ? firstKey + qint32(group) : groupKeys[group]) * bucketWidth, group);
+            }
+        }
+    }
+    if (!dense) {
+        std::sort(result.begin(), result.end(), [](const AnalyticsGroup &lhs, const AnalyticsGroup &rhs) { return lhs.key < rhs.key; });
+    }
+    return result;
+}
+
+qint32 CampaignAnalytics::intern(const QString &name) {
+    const auto it = m_nameCodes.constFind(name);
+    if (it != m_nameCodes.constEnd()) {
+        return it.value();
+    }
+    const auto code = qint32(m_names.size());
+    m_names.push_back(name);
+    m_nameCodes.insert(name, code);
+    return code;
+}
+
+void CampaignAnalytics::appendRow(const std::array<qint32, kFieldCount> &row) {
+    const bool first = rowCount() == 0;
+    for (std::size_t field = 0; field < row.size(); ++field) {
+        m_columns[field].push_back(row[field]);
+        m_min[field] = first ? row[field] : std::min(m_min[field], row[field]);
+        m_max[field] = first ? row[field] : std::max(m_max[field], row[field]);
+    }
+}
+
+void CampaignAnalytics::endFight(int firstRow, int rounds) {
+    m_fightRounds.push_back(rounds);
+    auto &column = m_columns[index(AnalyticsField::Rounds)];
+    std::fill(column.begin() + firstRow, column.end(), rounds);
+    // appendRow saw a placeholder 0; the bounds only need to cover the values.
+    m_min[index(AnalyticsField::Rounds)] = std::min(m_min[index(AnalyticsField::Rounds)], rounds);
+    m_max[index(AnalyticsField::Rounds)] = std::max(m_max[index(AnalyticsField::Rounds)], rounds);
+}
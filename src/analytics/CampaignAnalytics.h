@@ -0,0 +1,113 @@
+#pragma once
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <array>
+#include <optional>
+#include <vector>
+
+struct EncounterData;
+class CombatLog;
+
+// Columns of the participant table: one row per combatant per fight.
+enum class AnalyticsField {
+    Fight,
+    Name,            // dictionary code, see CampaignAnalytics::name()
+    IsPC,
+    Initiative,      // last initiative in the fight
+    DamageTaken,     // HP lost over the fight; combat logs only
+    ConditionRounds, // rounds spent under conditions; combat logs only
+    Rounds           // length of the row's fight
+};
+
+enum class AnalyticsOp { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual };
+
+enum class AnalyticsAggregate { Count, Sum, Average, Min, Max };
+
+struct AnalyticsFilter {
+    AnalyticsField field;
+    AnalyticsOp op;
+    qint32 value;
+};
+
+// Filters are ANDed. Without groupBy the result is a single group, key 0.
+struct AnalyticsQuery {
+    QVector<AnalyticsFilter> filters;
+    std::optional<AnalyticsField> groupBy;
+    AnalyticsAggregate aggregate = AnalyticsAggregate::Count;
+    AnalyticsField measure = AnalyticsField::DamageTaken;
+};
+
+struct AnalyticsGroup {
+    qint32 key = 0;
+    qint64 count = 0;
+    double value = 0.0;
+};
+
+// Campaign statistics kept column by column, one qint32 array per field
+// with names dictionary-encoded. Queries filter and aggregate a block of
+// rows at a time through a selection vector, so the inner loops are flat
+// passes over one array each. Fed from saved encounters, which contribute
+// rosters, initiative and fight length, and from combat logs, which also
+// contribute damage and condition uptime. Not thread-safe.
+class CampaignAnalytics {
+public:
+    static constexpr int kFieldCount = 7;
+
+    // Returns false if the file cannot be read or was already added.
+    bool addEncounterFile(const QString &path);
+    void addEncounter(const EncounterData &encounter);
+    // Adds the fights the log completed since the last call for its
+    // directory; the fight still in progress waits for the next one.
+    // Returns the number of fights added.
+    int addCombatLog(const CombatLog &log);
+    void clear();
+
+    // Binary snapshot of the columns and the dictionary, so a campaign need
+    // not be re-read from its encounter files.
+    bool save(const QString &path) const;
+    bool load(const QString &path);
+
+    int fightCount() const noexcept { return int(m_fightRounds.size()); }
+    int rowCount() const noexcept { return int(column(AnalyticsField::Fight).size()); }
+    const std::vector<qint32> &column(AnalyticsField field) const { return m_columns[std::size_t(field)]; }
+    QString name(qint32 code) const { return code >= 0 && code < m_names.size() ? m_names.at(code) : QString(); }
+    std::optional<qint32> nameCode(const QString &name) const;
+    // A group key as text: names decoded, PCs as yes/no.
+    QString label(AnalyticsField field, qint32 key) const;
+
+    // Groups in key order.
+    QVector<AnalyticsGroup> run(const AnalyticsQuery &query) const;
+    // Row counts per bucket of bucketWidth values; a bucket's key is its
+    // lower bound.
+    QVector<AnalyticsGroup> histogram(AnalyticsField field, qint32 bucketWidth, const QVector<AnalyticsFilter> &filters = {}) const;
+    double averageRoundsPerFight() const;
+
+    // The campaign summary printed by dnd_analytics and the in-app dialog.
+    QStringList summary() const;
+
+    static QString fieldName(AnalyticsField field);
+    static std::optional<AnalyticsField> fieldFromName(const QString &name);
+
+private:
+    QVector<AnalyticsGroup> aggregate(const QVector<AnalyticsFilter> &filters, std::optional<AnalyticsField> groupBy, qint32 bucketWidth,
+                                      AnalyticsAggregate aggregate, AnalyticsField measure) const;
+    qint32 intern(const QString &name);
+    void appendRow(const std::array<qint32, kFieldCount> &row);
+    void endFight(int firstRow, int rounds);
+
+    std::array<std::vector<qint32>, kFieldCount> m_columns;
+    std::array<qint32, kFieldCount> m_min{};
+    std::array<qint32, kFieldCount> m_max{};
+    std::vector<qint32> m_fightRounds;
+    QVector<QString> m_names;
+    QHash<QString, qint32> m_nameCodes;
+    // Encounter files already added, and per log directory the first
+    // sequence not yet added.
+    QSet<QString> m_sources;
+    QHash<QString, quint64> m_logResume;
+};
@@ -0,0 +1,121 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+
+#include <cstdio>
+
+#include "CampaignAnalytics.h"
+#include "stores/CombatLog.h"
+
+namespace {
+
+// Adds a file, or every *.json directly inside a directory.
+int addEncounters(CampaignAnalytics &analytics, const QString &path) {
+    if (!QFileInfo(path).isDir()) {
+        return analytics.addEncounterFile(path) ? 1 : 0;
+    }
+    int added = 0;
+    const QDir dir(path);
+    for (const auto &name : dir.entryList({QStringLiteral("*.json")}, QDir::Files, QDir::Name)) {
+        added += analytics.addEncounterFile(dir.filePath(name)) ? 1 : 0;
+    }
+    return added;
+}
+
+std::optional<AnalyticsAggregate> aggregateFromName(const QString &name) {
+    const struct {
+        const char *name;
+        AnalyticsAggregate aggregate;
+    } aggregates[] = {
+        {"count", AnalyticsAggregate::Count}, {"sum", AnalyticsAggregate::Sum}, {"avg", AnalyticsAggregate::Average},
+        {"min", AnalyticsAggregate::Min},     {"max", AnalyticsAggregate::Max},
+    };
+    for (const auto &entry : aggregates) {
+        if (name.compare(QLatin1String(entry.name), Qt::CaseInsensitive) == 0) {
+            return entry.aggregate;
+        }
+    }
+    return std::nullopt;
+}
+
+void printLine(const QString &line) {
+    std::printf("%s\n", qPrintable(line));
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("dnd_analytics"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Campaign statistics over saved encounters and combat logs."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("encounters"), QStringLiteral("Encounter files, or directories of them, to add."), QStringLiteral("[paths...]"));
+    const QCommandLineOption storeOption(QStringLiteral("store"), QStringLiteral("Load the analytics snapshot <file> first and save it afterwards."), QStringLiteral("file"));
+    const QCommandLineOption logOption(QStringLiteral("log"), QStringLiteral("Add the completed fights of the combat log in <dir>."), QStringLiteral("dir"));
+    const QCommandLineOption groupOption(QStringLiteral("group-by"), QStringLiteral("Run a query grouped by <field> instead of the summary."), QStringLiteral("field"));
+    const QCommandLineOption measureOption(QStringLiteral("measure"), QStringLiteral("Field the query aggregates (default: damage)."), QStringLiteral("field"));
+    const QCommandLineOption aggregateOption(QStringLiteral("aggregate"), QStringLiteral("count, sum, avg, min or max (default: sum)."), QStringLiteral("name"));
+    const QCommandLineOption pcsOption(QStringLiteral("pcs"), QStringLiteral("Only count player characters."));
+    parser.addOption(storeOption);
+    parser.addOption(logOption);
+    parser.addOption(groupOption);
+    parser.addOption(measureOption);
+    parser.addOption(aggregateOption);
+    parser.addOption(pcsOption);
+    parser.process(app);
+
+    CampaignAnalytics analytics;
+    const auto storePath = parser.value(storeOption);
+    if (!storePath.isEmpty() && QFileInfo::exists(storePath) && !analytics.load(storePath)) {
+        std::fprintf(stderr, "could not read %s\n", qPrintable(storePath));
+        return 1;
+    }
+    int added = 0;
+    for (const auto &path : parser.positionalArguments()) {
+        added += addEncounters(analytics, path);
+    }
+    for (const auto &directory : parser.values(logOption)) {
+        CombatLog log(directory);
+        if (!log.open()) {
+            std::fprintf(stderr, "could not open the combat log in %s\n", qPrintable(directory));
+            return 1;
+        }
+        added += analytics.addCombatLog(log);
+    }
+    if (!storePath.isEmpty() && added > 0 && !analytics.save(storePath)) {
+        std::fprintf(stderr, "could not write %s\n", qPrintable(storePath));
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    if (!parser.isSet(groupOption)) {
+        for (const auto &line : analytics.summary()) {
+            printLine(line);
+        }
+    } else {
+        AnalyticsQuery query;
+        const auto groupBy = CampaignAnalytics::fieldFromName(parser.value(groupOption));
+        const auto measure = CampaignAnalytics::fieldFromName(parser.isSet(measureOption) ? parser.value(measureOption) : QStringLiteral("damage"));
+        const auto aggregate = aggregateFromName(parser.isSet(aggregateOption) ? parser.value(aggregateOption) : QStringLiteral("sum"));
+        if (!groupBy || !measure || !aggregate) {
+            std::fprintf(stderr, "fields: fight, name, pc, initiative, damage, conditions, rounds\n");
+            return 1;
+        }
+        query.groupBy = groupBy;
+        query.measure = *measure;
+        query.aggregate = *aggregate;
+        if (parser.isSet(pcsOption)) {
+            query.filters.push_back({AnalyticsField::IsPC, AnalyticsOp::Equal, 1});
+        }
+        for (const auto &group : analytics.run(query)) {
+            printLine(QStringLiteral("%1\t%2\t%3").arg(analytics.label(*groupBy, group.key)).arg(group.count).arg(group.value, 0, 'g', 10));
+        }
+    }
+    std::fprintf(stderr, "%d fights, queried in %.2f ms\n", analytics.fightCount(), double(timer.nsecsElapsed()) / 1e6);
+    return 0;
+}
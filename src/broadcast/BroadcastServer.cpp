@@ -0,0 +1,75 @@
+#include "BroadcastServer.h"
+
+#include <QTcpSocket>
+
+#include "utils/Trace.h"
+
+BroadcastServer::BroadcastServer(QObject *parent)
+    : QObject(parent) {
+    connect(&m_server, &QTcpServer::newConnection, this, &BroadcastServer::acceptConnections);
+}
+
+bool BroadcastServer::listen(quint16 port, const QHostAddress &address) {
+    return m_server.listen(address, port);
+}
+
+void BroadcastServer::close() {
+    m_server.close();
+    for (auto it = m_clients.begin(); it != m_clients.end(); ++it) {
+        it.key()->disconnectFromHost();
+    }
+}
+
+void BroadcastServer::publish(const TurnManager &manager) {
+    TRACE_SCOPE("BroadcastServer::publish");
+    const auto frames = m_encoder.update(manager);
+    if (frames.isEmpty()) {
+        return;
+    }
+    m_snapshotStale = true;
+    for (auto it = m_clients.begin(); it != m_clients.end(); ++it) {
+        send(it.key(), it.value(), frames);
+    }
+}
+
+void BroadcastServer::acceptConnections() {
+    while (auto *socket = m_server.nextPendingConnection()) {
+        m_clients.insert(socket, Client());
+        connect(socket, &QTcpSocket::bytesWritten, this, [this, socket]() { onBytesWritten(socket); });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_clients.remove(socket);
+            socket->deleteLater();
+        });
+        socket->write(currentSnapshot());
+    }
+}
+
+void BroadcastServer::send(QTcpSocket *socket, Client &client, const QByteArray &frames) {
+    if (client.needsSnapshot) {
+        return;
+    }
+    if (socket->bytesToWrite() + frames.size() > kMaxBacklogBytes) {
+        // Deltas only make sense on top of everything before them, so a
+        // lagging client skips ahead to a snapshot instead of queueing more.
+        client.needsSnapshot = true;
+        return;
+    }
+    socket->write(frames);
+}
+
+void BroadcastServer::onBytesWritten(QTcpSocket *socket) {
+    auto it = m_clients.find(socket);
+    if (it == m_clients.end() || !it->needsSnapshot || socket->bytesToWrite() > 0) {
+        return;
+    }
+    it->needsSnapshot = false;
+    socket->write(currentSnapshot());
+}
+
+const QByteArray &BroadcastServer::currentSnapshot() {
+    if (m_snapshotStale) {
+        m_snapshot = m_encoder.snapshot();
+        m_snapshotStale = false;
+    }
+    return m_snapshot;
+}
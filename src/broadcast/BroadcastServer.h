@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QHash>
+#include <QHostAddress>
+#include <QObject>
+#include <QTcpServer>
+
+#include "PlayerView.h"
+
+class QTcpSocket;
+
+// Pushes the player view of an encounter to display clients on the loopback
+// interface. New clients get a Snapshot frame, then the deltas produced by
+// each publish(). Writes never block: a client whose unsent backlog exceeds
+// kMaxBacklogBytes stops receiving deltas and, once its socket has drained,
+// is resynchronised with a fresh snapshot.
+class BroadcastServer : public QObject {
+    Q_OBJECT
+public:
+    static constexpr qint64 kMaxBacklogBytes = 256 * 1024;
+
+    explicit BroadcastServer(QObject *parent = nullptr);
+
+    // port 0 picks a free port; see serverPort().
+    bool listen(quint16 port, const QHostAddress &address = QHostAddress::LocalHost);
+    void close();
+    bool isListening() const { return m_server.isListening(); }
+    quint16 serverPort() const { return m_server.serverPort(); }
+    QString errorString() const { return m_server.errorString(); }
+
+    // Cheap when nothing changed since the last call.
+    void publish(const TurnManager &manager);
+    // Takes effect on the next publish(), which resends a full snapshot.
+    void setStreamerMode(bool enabled) { m_encoder.setStreamerMode(enabled); }
+
+    int clientCount() const { return m_clients.size(); }
+
+private:
+    struct Client {
+        bool needsSnapshot = false;
+    };
+
+    void acceptConnections();
+    void onBytesWritten(QTcpSocket *socket);
+    void send(QTcpSocket *socket, Client &client, const QByteArray &frames);
+    const QByteArray &currentSnapshot();
+
+    QTcpServer m_server;
+    PlayerViewEncoder m_encoder;
+    QByteArray m_snapshot;
+    bool m_snapshotStale = true;
+    QHash<QTcpSocket *, Client> m_clients;
+};
@@ -0,0 +1,349 @@
+#include "PlayerView.h"
+
+#include <QDataStream>
+#include <QtEndian>
+
+#include <algorithm>
+
+#include "utils/Trace.h"
+
+namespace {
+
+constexpr quint32 kMaxFrameBytes = 64 * 1024 * 1024;
+
+enum EntryFlag : quint8 {
+    FlagPC = 1,
+    FlagConscious = 2,
+    FlagExactHp = 4
+};
+
+template <typename Write>
+void appendFrame(QByteArray &out, PlayerMessage type, Write &&write) {
+    QByteArray payload;
+    {
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_6_0);
+        stream << static_cast<quint8>(type);
+        write(stream);
+    }
+    char length[4];
+    qToBigEndian<quint32>(static_cast<quint32>(payload.size()), length);
+    out.append(length, 4);
+    out += payload;
+}
+
+void writeEntry(QDataStream &stream, const PlayerEntry &entry) {
+    quint8 flags = 0;
+    flags |= entry.isPC ? FlagPC : 0;
+    flags |= entry.conscious ? FlagConscious : 0;
+    flags |= entry.exactHp ? FlagExactHp : 0;
+    stream << qint32(entry.id) << entry.name << flags << qint32(entry.hp) << quint16(entry.conditions.size());
+    for (const auto &condition : entry.conditions) {
+        stream << condition;
+    }
+    stream << entry.notes;
+}
+
+PlayerEntry readEntry(QDataStream &stream) {
+    PlayerEntry entry;
+    qint32 id = 0;
+    quint8 flags = 0;
+    qint32 hp = 0;
+    quint16 conditionCount = 0;
+    stream >> id >> entry.name >> flags >> hp >> conditionCount;
+    entry.id = id;
+    entry.isPC = flags & FlagPC;
+    entry.conscious = flags & FlagConscious;
+    entry.exactHp = flags & FlagExactHp;
+    entry.hp = hp;
+    for (quint16 i = 0; i < conditionCount && stream.status() == QDataStream::Ok; ++i) {
+        QString condition;
+        stream >> condition;
+        entry.conditions.push_back(condition);
+    }
+    stream >> entry.notes;
+    return entry;
+}
+
+bool sameShape(const PlayerEntry &lhs, const PlayerEntry &rhs) {
+    return lhs.name == rhs.name && lhs.isPC == rhs.isPC && lhs.conscious == rhs.conscious && lhs.exactHp == rhs.exactHp
+        && lhs.notes == rhs.notes;
+}
+
+} // namespace
+
+bool operator==(const PlayerEntry &lhs, const PlayerEntry &rhs) noexcept {
+    return lhs.id == rhs.id && lhs.hp == rhs.hp && lhs.conditions == rhs.conditions && sameShape(lhs, rhs);
+}
+
+void PlayerViewEncoder::setStreamerMode(bool enabled) {
+    if (enabled != m_streamerMode) {
+        m_streamerMode = enabled;
+        m_initialized = false;
+    }
+}
+
+PlayerHpBucket PlayerViewEncoder::bucketFor(int hp, int maxHp) noexcept {
+    if (hp <= 0) {
+        return PlayerHpBucket::Down;
+    }
+    if (hp * 2 <= maxHp) {
+        return PlayerHpBucket::Bloodied;
+    }
+    return hp < maxHp ? PlayerHpBucket::Hurt : PlayerHpBucket::Healthy;
+}
+
+PlayerEntry PlayerViewEncoder::viewOf(const Combatant &combatant) {
+    auto &maxHp = m_maxHp[combatant.id];
+    maxHp = std::max(maxHp, combatant.hp);
+    PlayerEntry entry;
+    entry.id = combatant.id;
+    entry.name = combatant.name.toString();
+    entry.isPC = combatant.isPC;
+    entry.conscious = combatant.conscious;
+    entry.exactHp = !m_streamerMode || combatant.isPC;
+    entry.hp = entry.exactHp ? combatant.hp : static_cast<int>(bucketFor(combatant.hp, maxHp));
+    for (const auto &condition : combatant.conditions) {
+        if (!condition.isExpired()) {
+            entry.conditions.push_back(condition.name.toString());
+        }
+    }
+    if (!m_streamerMode) {
+        entry.notes = combatant.notes;
+    }
+    return entry;
+}
+
+void PlayerViewEncoder::rebuild(const TurnManager &manager) {
+    m_order.clear();
+    m_entries.clear();
+    for (const auto &combatant : manager.combatants()) {
+        m_order.push_back(combatant.id);
+        m_entries.insert(combatant.id, viewOf(combatant));
+    }
+    m_round = manager.round();
+    m_turnIndex = manager.turnIndex();
+    m_generation = manager.generation();
+    m_initialized = true;
+}
+
+QByteArray PlayerViewEncoder::update(const TurnManager &manager) {
+    TRACE_SCOPE("PlayerViewEncoder::update");
+    if (!m_initialized) {
+        rebuild(manager);
+        return snapshot();
+    }
+    const auto changes = manager.changesSince(m_generation);
+    if (changes.reset) {
+        m_maxHp.clear();
+        rebuild(manager);
+        return snapshot();
+    }
+    m_generation = manager.generation();
+    QByteArray out;
+    bool membershipChanged = false;
+    for (const int id : changes.removedIds) {
+        if (m_entries.remove(id) > 0) {
+            m_maxHp.remove(id);
+            appendFrame(out, PlayerMessage::Remove, [id](QDataStream &stream) { stream << qint32(id); });
+            membershipChanged = true;
+        }
+    }
+    for (const int id : changes.changedIds) {
+        const int row = manager.indexOf(id);
+        if (row < 0) {
+            continue;
+        }
+        auto next = viewOf(manager.combatants().at(row));
+        auto it = m_entries.find(id);
+        if (it == m_entries.end()) {
+            appendFrame(out, PlayerMessage::Upsert, [&next](QDataStream &stream) { writeEntry(stream, next); });
+            m_entries.insert(id, std::move(next));
+            membershipChanged = true;
+            continue;
+        }
+        auto &previous = it.value();
+        if (previous == next) {
+            continue;
+        }
+        if (!sameShape(previous, next)) {
+            appendFrame(out, PlayerMessage::Upsert, [&next](QDataStream &stream) { writeEntry(stream, next); });
+        } else {
+            if (previous.hp != next.hp) {
+                appendFrame(out, PlayerMessage::Hp, [&next](QDataStream &stream) {
+                    stream << qint32(next.id) << quint8(next.exactHp) << qint32(next.hp);
+                });
+            }
+            for (const auto &name : next.conditions) {
+                if (!previous.conditions.contains(name)) {
+                    appendFrame(out, PlayerMessage::ConditionAdded, [id, &name](QDataStream &stream) { stream << qint32(id) << name; });
+                }
+            }
+            for (const auto &name : previous.conditions) {
+                if (!next.conditions.contains(name)) {
+                    appendFrame(out, PlayerMessage::ConditionExpired, [id, &name](QDataStream &stream) { stream << qint32(id) << name; });
+                }
+            }
+        }
+        previous = std::move(next);
+    }
+    if (membershipChanged || changes.orderChanged) {
+        QVector<int> order;
+        order.reserve(manager.combatants().size());
+        for (const auto &combatant : manager.combatants()) {
+            order.push_back(combatant.id);
+        }
+        if (order != m_order) {
+            m_order = std::move(order);
+            appendFrame(out, PlayerMessage::Reorder, [this](QDataStream &stream) {
+                stream << quint32(m_order.size());
+                for (const int id : m_order) {
+                    stream << qint32(id);
+                }
+            });
+        }
+    }
+    if (manager.round() != m_round || manager.turnIndex() != m_turnIndex) {
+        m_round = manager.round();
+        m_turnIndex = manager.turnIndex();
+        appendFrame(out, PlayerMessage::Turn, [this](QDataStream &stream) { stream << qint32(m_round) << qint32(m_turnIndex); });
+    }
+    return out;
+}
+
+QByteArray PlayerViewEncoder::snapshot() const {
+    QByteArray out;
+    appendFrame(out, PlayerMessage::Snapshot, [this](QDataStream &stream) {
+        stream << qint32(m_round) << qint32(m_turnIndex) << quint8(m_streamerMode) << quint32(m_order.size());
+        for (const int id : m_order) {
+            writeEntry(stream, m_entries.value(id));
+        }
+    });
+    return out;
+}
+
+int PlayerViewState::rowOf(int id) const {
+    for (int row = 0; row < entries.size(); ++row) {
+        if (entries.at(row).id == id) {
+            return row;
+        }
+    }
+    return -1;
+}
+
+int PlayerViewState::apply(QByteArray &buffer) {
+    int applied = 0;
+    qsizetype offset = 0;
+    while (buffer.size() - offset >= 4) {
+        const auto length = qFromBigEndian<quint32>(buffer.constData() + offset);
+        if (length == 0 || length > kMaxFrameBytes) {
+            return -1;
+        }
+        if (buffer.size() - offset - 4 < static_cast<qsizetype>(length)) {
+            break;
+        }
+        QDataStream stream(buffer.mid(offset + 4, length));
+        stream.setVersion(QDataStream::Qt_6_0);
+        offset += 4 + length;
+        quint8 type = 0;
+        stream >> type;
+        switch (static_cast<PlayerMessage>(type)) {
+        case PlayerMessage::Snapshot: {
+            qint32 newRound = 0;
+            qint32 newTurn = 0;
+            quint8 streamer = 0;
+            quint32 count = 0;
+            stream >> newRound >> newTurn >> streamer >> count;
+            round = newRound;
+            turnIndex = newTurn;
+            streamerMode = streamer != 0;
+            entries.clear();
+            for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+                entries.push_back(readEntry(stream));
+            }
+            break;
+        }
+        case PlayerMessage::Turn: {
+            qint32 newRound = 0;
+            qint32 newTurn = 0;
+            stream >> newRound >> newTurn;
+            round = newRound;
+            turnIndex = newTurn;
+            break;
+        }
+        case PlayerMessage::Hp: {
+            qint32 id = 0;
+            quint8 exact = 0;
+            qint32 hp = 0;
+            stream >> id >> exact >> hp;
+            const int row = rowOf(id);
+            if (row < 0) {
+                return -1;
+            }
+            entries[row].exactHp = exact != 0;
+            entries[row].hp = hp;
+            break;
+        }
+        case PlayerMessage::ConditionAdded:
+        case PlayerMessage::ConditionExpired: {
+            qint32 id = 0;
+            QString name;
+            stream >> id >> name;
+            const int row = rowOf(id);
+            if (row < 0) {
+                return -1;
+            }
+            if (static_cast<PlayerMessage>(type) == PlayerMessage::ConditionAdded) {
+                entries[row].conditions.push_back(name);
+            } else {
+                entries[row].conditions.removeAll(name);
+            }
+            break;
+        }
+        case PlayerMessage::Reorder: {
+            quint32 count = 0;
+            stream >> count;
+            QVector<PlayerEntry> reordered;
+            reordered.reserve(static_cast<int>(std::min<quint32>(count, static_cast<quint32>(entries.size()))));
+            for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+                qint32 id = 0;
+                stream >> id;
+                const int row = rowOf(id);
+                if (row < 0) {
+                    return -1;
+                }
+                reordered.push_back(entries.at(row));
+            }
+            entries = std::move(reordered);
+            break;
+        }
+        case PlayerMessage::Upsert: {
+            auto entry = readEntry(stream);
+            const int row = rowOf(entry.id);
+            if (row < 0) {
+                entries.push_back(std::move(entry));
+            } else {
+                entries[row] = std::move(entry);
+            }
+            break;
+        }
+        case PlayerMessage::Remove: {
+            qint32 id = 0;
+            stream >> id;
+            const int row = rowOf(id);
+            if (row >= 0) {
+                entries.remove(row);
+            }
+            break;
+        }
+        default:
+            return -1;
+        }
+        if (stream.status() != QDataStream::Ok) {
+            return -1;
+        }
+        ++applied;
+    }
+    buffer.remove(0, offset);
+    return applied;
+}
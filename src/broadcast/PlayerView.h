@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "models/TurnManager.h"
+
+// What a player screen may see of one combatant. In streamer mode NPC hit
+// points are reduced to a PlayerHpBucket and notes are dropped.
+struct PlayerEntry {
+    int id = 0;
+    QString name;
+    bool isPC = false;
+    bool conscious = true;
+    bool exactHp = true;
+    int hp = 0;
+    QStringList conditions;
+    QString notes;
+};
+
+bool operator==(const PlayerEntry &lhs, const PlayerEntry &rhs) noexcept;
+
+// Relative to the highest HP seen for that combatant.
+enum class PlayerHpBucket : quint8 {
+    Down,
+    Bloodied,
+    Hurt,
+    Healthy
+};
+
+// Wire format: frames of [quint32 length][quint8 type][payload], big-endian,
+// where length counts the type byte and the payload.
+enum class PlayerMessage : quint8 {
+    Snapshot = 1,
+    Turn,
+    Hp,
+    ConditionAdded,
+    ConditionExpired,
+    Reorder,
+    Upsert,
+    Remove
+};
+
+// Turns TurnManager changes into player-view frames. The first update, and
+// any update after reset() or a pruned change log, yields a Snapshot frame;
+// later ones yield only the deltas since the previous call.
+class PlayerViewEncoder {
+public:
+    void setStreamerMode(bool enabled);
+    bool streamerMode() const noexcept { return m_streamerMode; }
+
+    QByteArray update(const TurnManager &manager);
+    QByteArray snapshot() const;
+    void reset() noexcept { m_initialized = false; }
+
+    static PlayerHpBucket bucketFor(int hp, int maxHp) noexcept;
+
+private:
+    PlayerEntry viewOf(const Combatant &combatant);
+    void rebuild(const TurnManager &manager);
+
+    bool m_streamerMode = false;
+    bool m_initialized = false;
+    quint64 m_generation = 0;
+    int m_round = 1;
+    int m_turnIndex = 0;
+    QVector<int> m_order;
+    QHash<int, PlayerEntry> m_entries;
+    QHash<int, int> m_maxHp;
+};
+
+// Client-side state rebuilt from frames, as a player display would keep it.
+struct PlayerViewState {
+    int round = 1;
+    int turnIndex = 0;
+    bool streamerMode = false;
+    QVector<PlayerEntry> entries;
+
+    // Applies every complete frame at the front of buffer and leaves a partial
+    // one in place. Returns the number applied, or -1 on a malformed frame.
+    int apply(QByteArray &buffer);
+
+private:
+    int rowOf(int id) const;
+};
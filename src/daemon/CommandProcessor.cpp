@@ -0,0 +1,231 @@
+#include "CommandProcessor.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonParseError>
+
+#include <algorithm>
+#include <vector>
+
+#include "stores/EncounterStore.h"
+#include "utils/Trace.h"
+
+namespace {
+
+RollMode rollModeOf(const QJsonObject &command) {
+    const auto modeName = command.value("mode").toString();
+    if (modeName == QLatin1String("advantage")) {
+        return RollMode::Advantage;
+    }
+    return modeName == QLatin1String("disadvantage") ? RollMode::Disadvantage : RollMode::Normal;
+}
+
+} // namespace
+
+CommandProcessor::CommandProcessor(TurnManager &manager, DiceRoller &roller)
+    : m_manager(manager)
+    , m_roller(roller) {
+    for (const auto &combatant : m_manager.combatants()) {
+        m_nextId = std::max(m_nextId, combatant.id + 1);
+    }
+}
+
+void CommandProcessor::processLine(const QByteArray &line, QByteArray &out) {
+    TRACE_SCOPE("CommandProcessor::processLine");
+    QJsonParseError parseError;
+    const auto document = QJsonDocument::fromJson(line, &parseError);
+    QJsonObject event;
+    if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+        event = error(QStringLiteral("invalid JSON: %1").arg(parseError.errorString()));
+    } else {
+        const auto command = document.object();
+        event = execute(command);
+        const auto seq = command.value("seq");
+        if (!seq.isUndefined()) {
+            event["seq"] = seq;
+        }
+    }
+    out += QJsonDocument(event).toJson(QJsonDocument::Compact);
+    out += '\n';
+}
+
+int CommandProcessor::processBuffer(QByteArray &input, QByteArray &out) {
+    int processed = 0;
+    qsizetype start = 0;
+    for (;;) {
+        const auto end = input.indexOf('\n', start);
+        if (end < 0) {
+            break;
+        }
+        const auto line = input.mid(start, end - start).trimmed();
+        start = end + 1;
+        if (line.isEmpty()) {
+            continue;
+        }
+        processLine(line, out);
+        ++processed;
+    }
+    input.remove(0, start);
+    return processed;
+}
+
+int CommandProcessor::runStdio(std::FILE *in, std::FILE *out) {
+    constexpr std::size_t kChunk = 64 * 1024;
+    QByteArray input;
+    QByteArray events;
+    events.reserve(kChunk);
+    std::vector<char> buffer(kChunk);
+    for (;;) {
+        const std::size_t read = std::fread(buffer.data(), 1, kChunk, in);
+        if (read == 0) {
+            break;
+        }
+        input.append(buffer.data(), static_cast<qsizetype>(read));
+        processBuffer(input, events);
+        if (!events.isEmpty()) {
+            std::fwrite(events.constData(), 1, static_cast<std::size_t>(events.size()), out);
+            std::fflush(out);
+            events.clear();
+        }
+    }
+    if (!input.trimmed().isEmpty()) {
+        input += '\n';
+        processBuffer(input, events);
+        std::fwrite(events.constData(), 1, static_cast<std::size_t>(events.size()), out);
+        std::fflush(out);
+    }
+    return 0;
+}
+
+QJsonObject CommandProcessor::execute(const QJsonObject &command) {
+    const auto name = command.value("cmd").toString();
+    if (name == QLatin1String("advance")) {
+        return turn(true);
+    }
+    if (name == QLatin1String("rewind")) {
+        return turn(false);
+    }
+    if (name == QLatin1String("set-hp")) {
+        return setHp(command);
+    }
+    if (name == QLatin1String("roll")) {
+        return roll(command);
+    }
+    if (name == QLatin1String("reroll")) {
+        return reroll(command);
+    }
+    if (name == QLatin1String("add")) {
+        return add(command);
+    }
+    if (name == QLatin1String("remove")) {
+        return remove(command);
+    }
+    if (name == QLatin1String("snapshot")) {
+        return snapshot();
+    }
+    return error(QStringLiteral("unknown command '%1'").arg(name));
+}
+
+QJsonObject CommandProcessor::add(const QJsonObject &command) {
+    // Jobs may add combatants behind the processor's back, so skip taken ids.
+    while (m_manager.indexOf(m_nextId) >= 0) {
+        ++m_nextId;
+    }
+    Combatant combatant;
+    combatant.id = command.value("id").toInt(m_nextId);
+    if (m_manager.indexOf(combatant.id) >= 0) {
+        return error(QStringLiteral("id %1 already exists").arg(combatant.id));
+    }
+    combatant.name = command.value("name").toString();
+    combatant.initiative = command.value("initiative").toInt();
+    combatant.dexMod = command.value("dexMod").toInt();
+    combatant.isPC = command.value("isPC").toBool();
+    combatant.hp = command.value("hp").toInt();
+    combatant.ac = command.value("ac").toInt(combatant.ac);
+    m_nextId = std::max(m_nextId, combatant.id + 1);
+    m_manager.addCombatant(combatant);
+    return QJsonObject{{"event", "added"}, {"id", combatant.id}, {"index", m_manager.indexOf(combatant.id)}};
+}
+
+QJsonObject CommandProcessor::remove(const QJsonObject &command) {
+    const int id = command.value("id").toInt(-1);
+    const auto removed = m_manager.combatantById(id);
+    if (!removed || !m_manager.removeCombatant(id)) {
+        return error(QStringLiteral("unknown id %1").arg(id));
+    }
+    // The last member leaving takes its cohort with it.
+    if (removed->cohort > 0) {
+        const auto &rest = m_manager.combatants();
+        if (std::none_of(rest.cbegin(), rest.cend(), [&removed](const Combatant &combatant) { return combatant.cohort == removed->cohort; })) {
+            m_manager.removeCohort(removed->cohort);
+        }
+    }
+    return QJsonObject{{"event", "removed"}, {"id", id}};
+}
+
+QJsonObject CommandProcessor::turn(bool advance) {
+    const bool moved = advance ? m_manager.advanceTurn() : m_manager.rewindTurn();
+    if (!moved) {
+        return error(QStringLiteral("no combatants"));
+    }
+    return turnEvent("turn");
+}
+
+QJsonObject CommandProcessor::roll(const QJsonObject &command) {
+    const int id = command.value("id").toInt(-1);
+    const RollMode mode = rollModeOf(command);
+    int initiative = 0;
+    const bool found = m_manager.updateCombatant(id, [this, mode, &initiative](Combatant &combatant) {
+        combatant.initiative = m_roller.rollD20(mode, combatant.dexMod);
+        combatant.tiebreak = m_roller.rollTiebreak();
+        initiative = combatant.initiative;
+    });
+    if (!found) {
+        return error(QStringLiteral("unknown id %1").arg(id));
+    }
+    return QJsonObject{{"event", "rolled"}, {"id", id}, {"initiative", initiative}, {"index", m_manager.indexOf(id)}};
+}
+
+QJsonObject CommandProcessor::reroll(const QJsonObject &command) {
+    if (m_manager.combatants().isEmpty()) {
+        return error(QStringLiteral("no combatants"));
+    }
+    m_manager.rerollInitiative(m_roller, rollModeOf(command));
+    return turnEvent("rerolled");
+}
+
+QJsonObject CommandProcessor::setHp(const QJsonObject &command) {
+    const int id = command.value("id").toInt(-1);
+    const auto hpValue = command.value("hp");
+    if (!hpValue.isDouble()) {
+        return error(QStringLiteral("set-hp needs a numeric hp"));
+    }
+    const int hp = hpValue.toInt();
+    if (!m_manager.updateCombatant(id, [hp](Combatant &combatant) { combatant.hp = hp; })) {
+        return error(QStringLiteral("unknown id %1").arg(id));
+    }
+    return QJsonObject{{"event", "hp"}, {"id", id}, {"hp", hp}};
+}
+
+QJsonObject CommandProcessor::snapshot() const {
+    QJsonArray combatants;
+    for (const auto &combatant : m_manager.combatants()) {
+        combatants.push_back(EncounterStore::toJsonObject(combatant));
+    }
+    auto event = turnEvent("snapshot");
+    event["generation"] = static_cast<qint64>(m_manager.generation());
+    event["combatants"] = combatants;
+    return event;
+}
+
+QJsonObject CommandProcessor::turnEvent(const char *name) const {
+    QJsonObject event{{"event", QLatin1String(name)}, {"round", m_manager.round()}, {"turnIndex", m_manager.turnIndex()}};
+    if (!m_manager.combatants().isEmpty()) {
+        event["currentId"] = m_manager.combatants().at(m_manager.turnIndex()).id;
+    }
+    return event;
+}
+
+QJsonObject CommandProcessor::error(const QString &message) {
+    return QJsonObject{{"event", "error"}, {"message", message}};
+}
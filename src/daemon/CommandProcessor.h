@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+
+#include <cstdio>
+
+#include "models/TurnManager.h"
+#include "utils/DiceRoller.h"
+
+// Executes newline-delimited JSON commands against a TurnManager and appends
+// one JSON event line per command to an output buffer. Commands:
+//   {"cmd":"add","name":..,"initiative":..,"dexMod":..,"isPC":..,"hp":..,"ac":..}
+//   {"cmd":"remove","id":..}   {"cmd":"advance"}   {"cmd":"rewind"}
+//   {"cmd":"roll","id":..,"mode":"normal"|"advantage"|"disadvantage"}
+//   {"cmd":"reroll","mode":..}   re-rolls everyone's initiative
+//   {"cmd":"set-hp","id":..,"hp":..}   {"cmd":"snapshot"}
+// A "seq" member on a command is echoed on its event.
+class CommandProcessor {
+public:
+    CommandProcessor(TurnManager &manager, DiceRoller &roller);
+
+    void processLine(const QByteArray &line, QByteArray &out);
+
+    // Consumes every complete line at the front of input and leaves a trailing
+    // partial line in place. Returns the number of commands processed.
+    int processBuffer(QByteArray &input, QByteArray &out);
+
+    // Blocking loop for the daemon's stdio mode: reads large chunks from in,
+    // answers every complete line in a chunk, then writes and flushes the
+    // events in one go. A final line without a newline is answered at EOF.
+    int runStdio(std::FILE *in = stdin, std::FILE *out = stdout);
+
+private:
+    QJsonObject execute(const QJsonObject &command);
+    QJsonObject add(const QJsonObject &command);
+    QJsonObject remove(const QJsonObject &command);
+    QJsonObject turn(bool advance);
+    QJsonObject roll(const QJsonObject &command);
+    QJsonObject reroll(const QJsonObject &command);
+    QJsonObject setHp(const QJsonObject &command);
+    QJsonObject snapshot() const;
+    QJsonObject turnEvent(const char *name) const;
+    static QJsonObject error(const QString &message);
+
+    TurnManager &m_manager;
+    DiceRoller &m_roller;
+    int m_nextId = 1;
+};
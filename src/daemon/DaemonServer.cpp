@@ -0,0 +1,136 @@
+#include "DaemonServer.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+
+#include "host/EncounterHost.h"
+
+namespace {
+
+const QString kDefaultEncounter = QStringLiteral("default");
+
+// Cheap pre-filter; only lines that mention attach are parsed here.
+bool isAttach(const QByteArray &line) {
+    if (!line.contains("\"attach\"")) {
+        return false;
+    }
+    return QJsonDocument::fromJson(line).object().value("cmd").toString() == QLatin1String("attach");
+}
+
+} // namespace
+
+DaemonServer::DaemonServer(EncounterHost &host, QObject *parent)
+    : QObject(parent)
+    , m_host(host) {
+    connect(&m_server, &QLocalServer::newConnection, this, &DaemonServer::acceptConnections);
+}
+
+DaemonServer::~DaemonServer() {
+    // Replies still in flight post back to this object, so let them land
+    // before it goes away; Qt drops the undelivered events with it.
+    m_host.waitForIdle();
+}
+
+bool DaemonServer::listen(const QString &name) {
+    // A stale socket file from a crashed run would otherwise block listen().
+    QLocalServer::removeServer(name);
+    return m_server.listen(name);
+}
+
+void DaemonServer::acceptConnections() {
+    while (auto *socket = m_server.nextPendingConnection()) {
+        const quint64 clientId = m_nextClientId++;
+        auto &client = m_clients[clientId];
+        client.socket = socket;
+        client.actor = m_host.open(kDefaultEncounter);
+        connect(socket, &QLocalSocket::readyRead, this, [this, clientId]() { readClient(clientId); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, clientId, socket]() {
+            m_clients.remove(clientId);
+            socket->deleteLater();
+        });
+    }
+}
+
+void DaemonServer::readClient(quint64 clientId) {
+    auto it = m_clients.find(clientId);
+    if (it == m_clients.end()) {
+        return;
+    }
+    auto &client = it.value();
+    client.input += client.socket->readAll();
+    const auto end = client.input.lastIndexOf('\n');
+    if (end < 0) {
+        return;
+    }
+    QByteArray lines = client.input.left(end + 1);
+    client.input.remove(0, end + 1);
+    if (!lines.contains("\"attach\"")) {
+        forward(clientId, client, lines);
+        return;
+    }
+    // Split around attach commands so each batch reaches the right encounter.
+    QByteArray batch;
+    qsizetype start = 0;
+    while (start < lines.size()) {
+        const auto lineEnd = lines.indexOf('\n', start);
+        const auto line = lines.mid(start, lineEnd - start + 1);
+        start = lineEnd + 1;
+        if (isAttach(line)) {
+            forward(clientId, client, batch);
+            attach(clientId, client, line);
+        } else {
+            batch += line;
+        }
+    }
+    forward(clientId, client, batch);
+}
+
+void DaemonServer::forward(quint64 clientId, Client &client, QByteArray &batch) {
+    if (batch.trimmed().isEmpty()) {
+        batch.clear();
+        return;
+    }
+    const quint64 batchId = client.nextBatch++;
+    client.actor->post(std::move(batch), [this, clientId, batchId](const QByteArray &events) {
+        // Runs on a pool thread; hop back to the socket's thread.
+        QMetaObject::invokeMethod(
+            this, [this, clientId, batchId, events]() { deliver(clientId, batchId, events); }, Qt::QueuedConnection);
+    });
+    batch = QByteArray();
+}
+
+void DaemonServer::attach(quint64 clientId, Client &client, const QByteArray &line) {
+    const auto command = QJsonDocument::fromJson(line).object();
+    const auto id = command.value("encounter").toString();
+    QJsonObject event;
+    if (auto actor = m_host.open(id)) {
+        client.actor = std::move(actor);
+        event = QJsonObject{{"event", "attached"}, {"encounter", id}};
+    } else {
+        event = QJsonObject{{"event", "error"}, {"message", QStringLiteral("invalid encounter id '%1'").arg(id)}};
+    }
+    const auto seq = command.value("seq");
+    if (!seq.isUndefined()) {
+        event["seq"] = seq;
+    }
+    deliver(clientId, client.nextBatch++, QJsonDocument(event).toJson(QJsonDocument::Compact) + '\n');
+}
+
+void DaemonServer::deliver(quint64 clientId, quint64 batch, const QByteArray &events) {
+    auto it = m_clients.find(clientId);
+    if (it == m_clients.end()) {
+        return;
+    }
+    auto &client = it.value();
+    client.ready.insert(batch, events);
+    QByteArray out;
+    for (auto next = client.ready.begin(); next != client.ready.end() && next.key() == client.nextWrite;) {
+        out += next.value();
+        next = client.ready.erase(next);
+        ++client.nextWrite;
+    }
+    if (!out.isEmpty()) {
+        client.socket->write(out);
+    }
+}
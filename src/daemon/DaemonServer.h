@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QLocalServer>
+#include <QMap>
+
+#include <memory>
+
+class EncounterActor;
+class EncounterHost;
+class QLocalSocket;
+
+// Serves the JSON-lines protocol on a local (Unix domain) socket. Each client
+// starts on the "default" encounter and may switch with
+// {"cmd":"attach","encounter":"<id>"}, which opens the encounter on demand.
+// Commands are forwarded to the encounter's actor one batch per read burst;
+// replies come back from the pool and are written in the order sent.
+class DaemonServer : public QObject {
+    Q_OBJECT
+public:
+    explicit DaemonServer(EncounterHost &host, QObject *parent = nullptr);
+    ~DaemonServer() override;
+
+    bool listen(const QString &name);
+    QString errorString() const { return m_server.errorString(); }
+
+private:
+    struct Client {
+        QLocalSocket *socket = nullptr;
+        QByteArray input;
+        std::shared_ptr<EncounterActor> actor;
+        quint64 nextBatch = 0;
+        quint64 nextWrite = 0;
+        QMap<quint64, QByteArray> ready;
+    };
+
+    void acceptConnections();
+    void readClient(quint64 clientId);
+    void forward(quint64 clientId, Client &client, QByteArray &batch);
+    void attach(quint64 clientId, Client &client, const QByteArray &line);
+    void deliver(quint64 clientId, quint64 batch, const QByteArray &events);
+
+    EncounterHost &m_host;
+    QLocalServer m_server;
+    QHash<quint64, Client> m_clients;
+    quint64 m_nextClientId = 1;
+};
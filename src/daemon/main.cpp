@@ -0,0 +1,73 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+#include <cstdio>
+#include <optional>
+
+#include "CommandProcessor.h"
+#include "DaemonServer.h"
+#include "host/EncounterHost.h"
+#include "stores/EncounterStore.h"
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("dnd_initiatived"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Headless initiative tracker speaking JSON lines on stdin or a local socket."));
+    parser.addHelpOption();
+    const QCommandLineOption socketOption(QStringLiteral("socket"), QStringLiteral("Listen on the local socket <name> instead of stdin."), QStringLiteral("name"));
+    const QCommandLineOption loadOption(QStringLiteral("load"), QStringLiteral("Load the encounter in <file> first."), QStringLiteral("file"));
+    const QCommandLineOption seedOption(QStringLiteral("seed"), QStringLiteral("Seed the dice roller for reproducible runs."), QStringLiteral("seed"));
+    parser.addOption(socketOption);
+    parser.addOption(loadOption);
+    const QCommandLineOption threadsOption(QStringLiteral("threads"), QStringLiteral("Worker threads for socket mode (default: one per core)."), QStringLiteral("count"));
+    const QCommandLineOption autosaveOption(QStringLiteral("autosave-dir"), QStringLiteral("Autosave each encounter to <dir>/<id>.json in socket mode."), QStringLiteral("dir"));
+    parser.addOption(seedOption);
+    parser.addOption(threadsOption);
+    parser.addOption(autosaveOption);
+    parser.process(app);
+
+    std::optional<EncounterData> encounter;
+    if (parser.isSet(loadOption)) {
+        encounter = EncounterStore::readFile(parser.value(loadOption));
+        if (!encounter) {
+            std::fprintf(stderr, "could not load %s\n", qPrintable(parser.value(loadOption)));
+            return 1;
+        }
+    }
+
+    if (!parser.isSet(socketOption)) {
+        TurnManager manager;
+        DiceRoller roller;
+        if (parser.isSet(seedOption)) {
+            roller.setSeed(parser.value(seedOption).toUInt());
+        }
+        if (encounter) {
+            manager.setCombatants(std::move(encounter->combatants), std::move(encounter->cohorts));
+            manager.setTurnState(encounter->round, encounter->turnIndex);
+        }
+        CommandProcessor processor(manager, roller);
+        return processor.runStdio();
+    }
+
+    EncounterHost host(parser.value(threadsOption).toInt());
+    if (parser.isSet(seedOption)) {
+        host.setSeed(parser.value(seedOption).toUInt());
+    }
+    if (parser.isSet(autosaveOption)) {
+        host.setAutosaveDirectory(parser.value(autosaveOption));
+    }
+    if (encounter) {
+        host.open(QStringLiteral("default"))->post([loaded = std::move(*encounter)](TurnManager &manager, DiceRoller &) mutable {
+            manager.setCombatants(std::move(loaded.combatants), std::move(loaded.cohorts));
+            manager.setTurnState(loaded.round, loaded.turnIndex);
+        });
+    }
+    DaemonServer server(host);
+    if (!server.listen(parser.value(socketOption))) {
+        std::fprintf(stderr, "could not listen: %s\n", qPrintable(server.errorString()));
+        return 1;
+    }
+    return app.exec();
+}
@@ -0,0 +1,104 @@
+#include "EncounterActor.h"
+
+#include "stores/EncounterStore.h"
+#include "stores/StoreIo.h"
+#include "utils/Trace.h"
+#include "utils/WorkStealingPool.h"
+
+EncounterActor::EncounterActor(QString id, WorkStealingPool &pool)
+    : m_id(std::move(id))
+    , m_pool(pool)
+    , m_processor(m_manager, m_roller) {
+    m_sinceSave.start();
+}
+
+void EncounterActor::post(QByteArray commands, Reply reply) {
+    enqueue([this, commands = std::move(commands), reply = std::move(reply)]() mutable {
+        if (!commands.endsWith('\n')) {
+            commands += '\n';
+        }
+        QByteArray out;
+        m_processor.processBuffer(commands, out);
+        if (reply) {
+            reply(out);
+        }
+    });
+}
+
+void EncounterActor::post(Job job) {
+    enqueue([this, job = std::move(job)]() { job(m_manager, m_roller); });
+}
+
+void EncounterActor::setSeed(quint32 seed) {
+    enqueue([this, seed]() { m_roller.setSeed(seed); });
+}
+
+void EncounterActor::setAutosavePath(QString path) {
+    enqueue([this, path = std::move(path)]() mutable {
+        m_autosavePath = std::move(path);
+        m_savedGeneration = 0;
+    });
+}
+
+void EncounterActor::enqueue(std::function<void()> task) {
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mailboxMutex);
+        m_mailbox.push_back(std::move(task));
+        schedule = !m_scheduled;
+        m_scheduled = true;
+    }
+    if (schedule) {
+        m_pool.submit([self = shared_from_this()]() { self->drain(); });
+    }
+}
+
+// Runs at most kDrainBatch tasks, then yields the worker so one busy
+// encounter cannot starve the others. m_scheduled stays set until the mailbox
+// is seen empty, which keeps a second drain from starting in parallel.
+void EncounterActor::drain() {
+    TRACE_SCOPE("EncounterActor::drain");
+    std::function<void()> task;
+    for (int i = 0; i < kDrainBatch; ++i) {
+        {
+            std::lock_guard<std::mutex> lock(m_mailboxMutex);
+            if (m_mailbox.empty()) {
+                break;
+            }
+            task = std::move(m_mailbox.front());
+            m_mailbox.pop_front();
+        }
+        task();
+    }
+    bool idle = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mailboxMutex);
+        idle = m_mailbox.empty();
+    }
+    autosave(idle);
+    {
+        std::lock_guard<std::mutex> lock(m_mailboxMutex);
+        if (m_mailbox.empty()) {
+            m_scheduled = false;
+            return;
+        }
+    }
+    m_pool.submit([self = shared_from_this()]() { self->drain(); });
+}
+
+// Saves at the end of every burst, and at most every kAutosaveIntervalMs
+// while commands keep arriving.
+void EncounterActor::autosave(bool idle) {
+    if (m_autosavePath.isEmpty() || m_manager.generation() == m_savedGeneration) {
+        return;
+    }
+    if (!idle && m_sinceSave.elapsed() < kAutosaveIntervalMs) {
+        return;
+    }
+    TRACE_SCOPE("EncounterActor::autosave");
+    const auto data = EncounterStore::serialize(m_manager.currentVersion(), m_manager.round(), m_manager.turnIndex());
+    if (StoreWriteSequencer::write(m_autosavePath, StoreWriteSequencer::reserve(m_autosavePath), data)) {
+        m_savedGeneration = m_manager.generation();
+    }
+    m_sinceSave.restart();
+}
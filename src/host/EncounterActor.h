@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "daemon/CommandProcessor.h"
+#include "models/TurnManager.h"
+#include "utils/DiceRoller.h"
+
+class WorkStealingPool;
+
+// One encounter with a single-threaded mailbox. Posted work runs on the pool,
+// but never on two threads at once and always in posting order, so the
+// TurnManager, dice stream and autosave file need no locking of their own.
+// Replies and jobs run on a pool thread; Qt clients must hop back to their
+// own thread before touching widgets or sockets.
+class EncounterActor : public std::enable_shared_from_this<EncounterActor> {
+public:
+    using Reply = std::function<void(const QByteArray &events)>;
+    using Job = std::function<void(TurnManager &manager, DiceRoller &roller)>;
+
+    static constexpr int kDrainBatch = 64;
+    static constexpr int kAutosaveIntervalMs = 2000;
+
+    EncounterActor(QString id, WorkStealingPool &pool);
+
+    const QString &id() const noexcept { return m_id; }
+
+    // Runs newline-delimited JSON commands and hands their events to reply.
+    void post(QByteArray commands, Reply reply);
+    void post(Job job);
+
+    // Both take effect in mailbox order, like any other job.
+    void setSeed(quint32 seed);
+    void setAutosavePath(QString path);
+
+private:
+    void enqueue(std::function<void()> task);
+    void drain();
+    void autosave(bool idle);
+
+    const QString m_id;
+    WorkStealingPool &m_pool;
+
+    std::mutex m_mailboxMutex;
+    std::deque<std::function<void()>> m_mailbox;
+    bool m_scheduled = false;
+
+    // Only touched by the thread currently draining the mailbox.
+    TurnManager m_manager;
+    DiceRoller m_roller;
+    CommandProcessor m_processor;
+    QString m_autosavePath;
+    quint64 m_savedGeneration = 0;
+    QElapsedTimer m_sinceSave;
+};
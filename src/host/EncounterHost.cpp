@@ -0,0 +1,63 @@
+#include "EncounterHost.h"
+
+#include <QDir>
+#include <QRegularExpression>
+
+EncounterHost::EncounterHost(int threadCount)
+    : m_pool(threadCount) {
+}
+
+EncounterHost::~EncounterHost() {
+    m_pool.waitForIdle();
+}
+
+void EncounterHost::setAutosaveDirectory(QString directory) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_autosaveDirectory = std::move(directory);
+}
+
+void EncounterHost::setSeed(quint32 seed) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_seeds.emplace(seed);
+}
+
+bool EncounterHost::isValidId(const QString &id) {
+    // Ids double as autosave file names.
+    static const QRegularExpression pattern(QStringLiteral("^[A-Za-z0-9_-]{1,64}$"));
+    return pattern.match(id).hasMatch();
+}
+
+std::shared_ptr<EncounterActor> EncounterHost::open(const QString &id) {
+    if (!isValidId(id)) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &actor = m_encounters[id];
+    if (actor) {
+        return actor;
+    }
+    actor = std::make_shared<EncounterActor>(id, m_pool);
+    if (m_seeds) {
+        actor->setSeed(m_seeds->generate());
+    }
+    if (!m_autosaveDirectory.isEmpty()) {
+        QDir().mkpath(m_autosaveDirectory);
+        actor->setAutosavePath(QDir(m_autosaveDirectory).filePath(id + QStringLiteral(".json")));
+    }
+    return actor;
+}
+
+std::shared_ptr<EncounterActor> EncounterHost::attach(const QString &id) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_encounters.value(id);
+}
+
+bool EncounterHost::close(const QString &id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_encounters.remove(id) > 0;
+}
+
+QStringList EncounterHost::encounterIds() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_encounters.keys();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QHash>
+#include <QRandomGenerator>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include "EncounterActor.h"
+#include "utils/WorkStealingPool.h"
+
+// Owns many independent encounters and schedules their actors over one
+// work-stealing pool. Clients look encounters up by id; every method is
+// thread-safe.
+class EncounterHost {
+public:
+    // threadCount <= 0 uses one worker per hardware core.
+    explicit EncounterHost(int threadCount = 0);
+    // Lets every encounter finish its queued work, including the final autosave.
+    ~EncounterHost();
+
+    // New encounters save to <directory>/<id>.json when set.
+    void setAutosaveDirectory(QString directory);
+    // Derives each new encounter's dice seed from this one, for reproducible
+    // sessions. Without it every encounter seeds itself securely.
+    void setSeed(quint32 seed);
+
+    // Ids are 1-64 characters of [A-Za-z0-9_-].
+    static bool isValidId(const QString &id);
+
+    // Returns the existing encounter or creates it; null for an invalid id.
+    std::shared_ptr<EncounterActor> open(const QString &id);
+    // Returns null for an unknown id.
+    std::shared_ptr<EncounterActor> attach(const QString &id) const;
+    // Clients still holding the actor can keep posting until they drop it.
+    bool close(const QString &id);
+
+    QStringList encounterIds() const;
+    void waitForIdle() { m_pool.waitForIdle(); }
+    int threadCount() const noexcept { return m_pool.threadCount(); }
+
+private:
+    // Declared first so it outlives every actor it runs.
+    WorkStealingPool m_pool;
+
+    mutable std::mutex m_mutex;
+    QHash<QString, std::shared_ptr<EncounterActor>> m_encounters;
+    QString m_autosaveDirectory;
+    std::optional<QRandomGenerator> m_seeds;
+};
@@ -1,11 +1,34 @@
 #include <QApplication>
 
+#include <cstring>
+
 #include "ui/MainWindow.h"
+#include "utils/Settings.h"
+#include "utils/StartupTimer.h"
+#include "utils/Trace.h"
 
 int main(int argc, char *argv[]) {
+    // Checked before QApplication exists so its construction is measured too.
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--startup-trace") == 0) {
+            StartupTimer::start();
+        }
+    }
+
     QApplication app(argc, argv);
-    MainWindow window;
-    window.show();
-    return app.exec();
+    StartupTimer::mark(QStringLiteral("application created"));
+    const auto tracePath = Settings().tracePath();
+    Trace::setEnabled(!tracePath.isEmpty());
+    int result = 0;
+    {
+        MainWindow window;
+        StartupTimer::reportOnFirstPaint(&window);
+        window.show();
+        StartupTimer::mark(QStringLiteral("window shown"));
+        result = app.exec();
+    }
+    if (Trace::isEnabled()) {
+        Trace::writeJson(tracePath);
+    }
+    return result;
 }
-
@@ -0,0 +1,114 @@
+#include "AreaEffect.h"
+
+#include <algorithm>
+
+#include "utils/Arena.h"
+
+AreaEffectResult resolveAreaEffect(const TurnManager &manager, const QVector<int> &rows, const AreaEffectSpec &spec, DiceRoller &roller) {
+    AreaEffectResult result;
+    const auto &combatants = manager.combatants();
+    ScratchArena scratch;
+    auto modifiers = scratch.vector<int>();
+    modifiers.reserve(rows.size());
+    result.ids.reserve(rows.size());
+    result.hpBefore.reserve(rows.size());
+    result.deathSavesAfter.reserve(rows.size());
+    for (const int row : rows) {
+        if (row < 0 || row >= combatants.size()) {
+            continue;
+        }
+        const auto &combatant = combatants.at(row);
+        result.ids.push_back(combatant.id);
+        result.hpBefore.push_back(combatant.hp);
+        result.consciousAfter.push_back(combatant.conscious ? 1 : 0);
+        result.deathSavesAfter.push_back(combatant.deathSaves);
+        switch (spec.modifierSource) {
+        case SaveModifierSource::None:
+            modifiers.push_back(0);
+            break;
+        case SaveModifierSource::DexMod:
+            modifiers.push_back(combatant.dexMod);
+            break;
+        case SaveModifierSource::Fixed:
+            modifiers.push_back(spec.fixedModifier);
+            break;
+        }
+    }
+
+    const int count = result.ids.size();
+    result.saveTotals.resize(count);
+    result.saved.resize(count);
+    result.damage.resize(count);
+    result.hpAfter.resize(count);
+
+    roller.rollD20Many(spec.saveMode, modifiers.data(), result.saveTotals.data(), count);
+    if (spec.rollDamageOnce) {
+        std::fill(result.damage.begin(), result.damage.end(), std::max(0, roller.roll(spec.damage)));
+    } else {
+        roller.rollMany(spec.damage, result.damage.data(), count);
+    }
+
+    const int dc = spec.saveDC;
+    // Branch-free save handling: halving is a shift by one, and shifting a
+    // non-negative int by 31 zeroes it for saves that negate the damage.
+    const int savedShift = spec.halfOnSave ? 1 : 31;
+    const int *totals = result.saveTotals.constData();
+    const int *hpBefore = result.hpBefore.constData();
+    quint8 *saved = result.saved.data();
+    int *damage = result.damage.data();
+    int *hpAfter = result.hpAfter.data();
+    quint8 *conscious = result.consciousAfter.data();
+    // A target at 0 HP that is still conscious has no HP tracked and keeps
+    // its state; one at 0 HP and unconscious is down. conscious holds the
+    // current value until damage actually lands.
+    for (int i = 0; i < count; ++i) {
+        const int rolled = std::max(0, damage[i]);
+        saved[i] = totals[i] >= dc ? 1 : 0;
+        damage[i] = saved[i] ? (rolled >> savedShift) : rolled;
+        const bool tracked = hpBefore[i] > 0 || conscious[i] == 0;
+        hpAfter[i] = tracked ? std::max(0, hpBefore[i] - damage[i]) : hpBefore[i];
+        conscious[i] = tracked && damage[i] > 0 ? (hpAfter[i] > 0 ? 1 : 0) : conscious[i];
+    }
+
+    // Death saves only change for the few targets that were already down or
+    // just dropped, so this pass stays scalar.
+    for (int i = 0; i < count; ++i) {
+        if (damage[i] <= 0 || (hpBefore[i] <= 0 && conscious[i] != 0)) {
+            continue;
+        }
+        auto &deathSaves = result.deathSavesAfter[i];
+        if (hpBefore[i] <= 0) {
+            deathSaves.stable = false;
+            deathSaves.recordFailure();
+        } else if (hpAfter[i] == 0) {
+            deathSaves.reset();
+        }
+    }
+    return result;
+}
+
+void AreaEffectResult::collectEdits(const TurnManager &manager, QVector<Combatant> &before, QVector<Combatant> &after) const {
+    before.clear();
+    after.clear();
+    before.reserve(size());
+    after.reserve(size());
+    for (int i = 0; i < size(); ++i) {
+        const auto current = manager.combatantById(ids.at(i));
+        if (!current) {
+            continue;
+        }
+        before.push_back(*current);
+        Combatant edited = *current;
+        if (edited.isMob()) {
+            // The whole mob is in the area, so every standing member is hit.
+            edited.mob.applyDamage(damage.at(i), MobDamage::Each);
+            edited.syncMobSummary();
+            after.push_back(edited);
+            continue;
+        }
+        edited.hp = hpAfter.at(i);
+        edited.conscious = consciousAfter.at(i) != 0;
+        edited.deathSaves = deathSavesAfter.at(i);
+        after.push_back(edited);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "TurnManager.h"
+#include "utils/DiceRoller.h"
+
+#include <QVector>
+
+enum class SaveModifierSource {
+    None,
+    DexMod,
+    Fixed
+};
+
+struct AreaEffectSpec {
+    int saveDC = 15;
+    SaveModifierSource modifierSource = SaveModifierSource::DexMod;
+    int fixedModifier = 0;
+    RollMode saveMode = RollMode::Normal;
+    DiceExpression damage;
+    bool halfOnSave = true;
+    // 5e rolls area damage once and applies it to every target.
+    bool rollDamageOnce = true;
+};
+
+// Outcome of an area effect, one column per field so the resolution runs over
+// contiguous arrays. Nothing is applied until the caller commits it.
+struct AreaEffectResult {
+    QVector<int> ids;
+    QVector<int> saveTotals;
+    QVector<quint8> saved;
+    QVector<int> damage;
+    QVector<int> hpBefore;
+    QVector<int> hpAfter;
+    QVector<quint8> consciousAfter;
+    QVector<DeathSaves> deathSavesAfter;
+
+    int size() const noexcept { return ids.size(); }
+
+    // Before/after copies of the affected combatants, ready for ApplyToManyCommand.
+    void collectEdits(const TurnManager &manager, QVector<Combatant> &before, QVector<Combatant> &after) const;
+};
+
+AreaEffectResult resolveAreaEffect(const TurnManager &manager, const QVector<int> &rows, const AreaEffectSpec &spec, DiceRoller &roller);
@@ -32,6 +32,10 @@ void DeathSaves::recordFailure() noexcept {
     }
 }
 
+bool operator==(const Cohort &lhs, const Cohort &rhs) noexcept {
+    return lhs.id == rhs.id && lhs.name == rhs.name && lhs.initiative == rhs.initiative && lhs.dexMod == rhs.dexMod;
+}
+
 bool operator==(const Condition &lhs, const Condition &rhs) noexcept {
     return lhs.name == rhs.name && lhs.remainingRounds == rhs.remainingRounds;
 }
@@ -41,6 +45,31 @@ bool operator==(const DeathSaves &lhs, const DeathSaves &rhs) noexcept {
 }
 
 bool operator==(const Combatant &lhs, const Combatant &rhs) noexcept {
-    return lhs.id == rhs.id && lhs.name == rhs.name && lhs.initiative == rhs.initiative && lhs.dexMod == rhs.dexMod && lhs.isPC == rhs.isPC && lhs.conscious == rhs.conscious && lhs.hp == rhs.hp && lhs.ac == rhs.ac && lhs.deathSaves == rhs.deathSaves && lhs.conditions == rhs.conditions && lhs.notes == rhs.notes;
+    return lhs.id == rhs.id && lhs.name == rhs.name && lhs.initiative == rhs.initiative && lhs.dexMod == rhs.dexMod && lhs.isPC == rhs.isPC && lhs.conscious == rhs.conscious && lhs.hp == rhs.hp && lhs.ac == rhs.ac && lhs.deathSaves == rhs.deathSaves && lhs.conditions == rhs.conditions && lhs.notes == rhs.notes
+        && lhs.dexScore == rhs.dexScore && lhs.tiebreak == rhs.tiebreak && lhs.side == rhs.side && lhs.cohort == rhs.cohort && lhs.mob == rhs.mob;
 }
 
+
+QVector<Combatant> splitMob(const Combatant &mob, int firstId) {
+    QVector<Combatant> members;
+    if (!mob.isMob()) {
+        return members;
+    }
+    const SpawnStyle style{mob.name.toString(), QStringLiteral("%name %index"), false, 2};
+    members.reserve(mob.mob.size());
+    for (int member = 0; member < mob.mob.size(); ++member) {
+        Combatant combatant = mob;
+        combatant.mob = MobMembers();
+        combatant.id = firstId + member;
+        combatant.name = CombatantName::spawned(style, member + 1);
+        combatant.hp = mob.mob.hp(member);
+        combatant.conscious = mob.mob.isStanding(member);
+        if (const auto *own = mob.mob.conditions(member)) {
+            for (const auto &condition : *own) {
+                combatant.conditions.push_back(condition);
+            }
+        }
+        members.push_back(std::move(combatant));
+    }
+    return members;
+}
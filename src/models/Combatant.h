@@ -3,12 +3,9 @@
 #include <QString>
 #include <QVector>
 
-struct Condition {
-    QString name;
-    int remainingRounds = 0;
-
-    bool isExpired() const noexcept { return remainingRounds <= 0; }
-};
+#include "CombatantName.h"
+#include "ConditionList.h"
+#include "MobMembers.h"
 
 struct DeathSaves {
     int successes = 0;
@@ -23,7 +20,7 @@ struct DeathSaves {
 
 struct Combatant {
     int id = 0;
-    QString name;
+    CombatantName name;
     int initiative = 0;
     int dexMod = 0;
     bool isPC = false;
@@ -31,10 +28,42 @@ struct Combatant {
     int hp = 0;
     int ac = 10;
     DeathSaves deathSaves;
-    QVector<Condition> conditions;
+    ConditionList conditions;
     QString notes;
+    // Read only by some InitiativeRules. A dexScore of 0 is derived from dexMod.
+    int dexScore = 0;
+    int tiebreak = 0;
+    int side = 0;
+    // Id of the Cohort this combatant acts with; 0 when it acts alone.
+    int cohort = 0;
+    // Non-empty for a mob row. hp and conscious then summarise the members;
+    // call syncMobSummary() after changing them.
+    MobMembers mob;
+
+    int effectiveDexScore() const noexcept { return dexScore > 0 ? dexScore : 10 + 2 * dexMod; }
+    bool isMob() const noexcept { return !mob.isEmpty(); }
+    void syncMobSummary() noexcept {
+        if (isMob()) {
+            hp = mob.totalHp();
+            conscious = mob.standing() > 0;
+        }
+    }
+};
+
+// One Combatant per mob member, named "<mob> <n>" and numbered from firstId.
+// Members keep the mob's roll, stats and row conditions plus their own.
+QVector<Combatant> splitMob(const Combatant &mob, int firstId);
+
+// A group that rolls initiative once, e.g. a pack of wolves. Members stay
+// contiguous in the turn order and are sorted as a single entry.
+struct Cohort {
+    int id = 0;
+    QString name;
+    int initiative = 0;
+    int dexMod = 0;
 };
 
+bool operator==(const Cohort &lhs, const Cohort &rhs) noexcept;
 bool operator==(const Condition &lhs, const Condition &rhs) noexcept;
 bool operator==(const DeathSaves &lhs, const DeathSaves &rhs) noexcept;
 bool operator==(const Combatant &lhs, const Combatant &rhs) noexcept;
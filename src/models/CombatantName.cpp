@@ -0,0 +1,123 @@
+#include "CombatantName.h"
+
+#include <QHash>
+
+#include <algorithm>
+
+#include "InternTable.h"
+
+namespace {
+
+InternTable<SpawnStyle> &spawnStyles() {
+    static InternTable<SpawnStyle> table;
+    return table;
+}
+
+InternTable<QString> &conditionNames() {
+    static InternTable<QString> table;
+    return table;
+}
+
+// Length of the formatted index, or -1 when it may not sort numerically.
+int indexDigits(const SpawnStyle &style, int index) {
+    if (index < 0) {
+        return -1;
+    }
+    int digits = 1;
+    for (int rest = index; rest >= 10; rest /= 10) {
+        ++digits;
+    }
+    return style.zeroPad ? std::max(digits, style.width) : digits;
+}
+
+} // namespace
+
+bool operator==(const SpawnStyle &lhs, const SpawnStyle &rhs) noexcept {
+    return lhs.baseName == rhs.baseName && lhs.pattern == rhs.pattern && lhs.zeroPad == rhs.zeroPad && lhs.width == rhs.width;
+}
+
+size_t qHash(const SpawnStyle &style, size_t seed) noexcept {
+    return qHashMulti(seed, style.baseName, style.pattern, style.zeroPad, style.width);
+}
+
+CombatantName CombatantName::spawned(const SpawnStyle &style, int index) {
+    CombatantName name;
+    SpawnStyle key = style;
+    if (!key.zeroPad) {
+        key.width = 0;
+    }
+    name.m_style = spawnStyles().intern(key);
+    name.m_index = index;
+    if (name.m_style == 0) {
+        name.m_text = format(style, index);
+    }
+    return name;
+}
+
+QString CombatantName::format(const SpawnStyle &style, int index) {
+    QString formatted = style.pattern;
+    QString indexStr = QString::number(index);
+    if (style.zeroPad) {
+        indexStr = QString("%1").arg(index, style.width, 10, QLatin1Char('0'));
+    }
+    formatted.replace("%name", style.baseName);
+    formatted.replace("%index", indexStr);
+    return formatted;
+}
+
+const SpawnStyle &CombatantName::style() const {
+    return spawnStyles().at(m_style);
+}
+
+QString CombatantName::toString() const {
+    return isSpawned() ? format(style(), m_index) : m_text;
+}
+
+bool CombatantName::isEmpty() const {
+    return isSpawned() ? toString().isEmpty() : m_text.isEmpty();
+}
+
+bool CombatantName::lessCaseFolded(const CombatantName &other) const {
+    if (isSpawned() && m_style == other.m_style) {
+        // Same prefix and suffix; equal-width indices then order like the text.
+        const auto &shared = style();
+        const int digits = indexDigits(shared, m_index);
+        if (digits >= 0 && digits == indexDigits(shared, other.m_index) && shared.pattern.contains(QLatin1String("%index"))) {
+            return m_index < other.m_index;
+        }
+    }
+    return toString().toCaseFolded() < other.toString().toCaseFolded();
+}
+
+bool operator==(const CombatantName &lhs, const CombatantName &rhs) {
+    if (lhs.m_style == rhs.m_style) {
+        if (!lhs.isSpawned()) {
+            return lhs.m_text == rhs.m_text;
+        }
+        if (lhs.m_index == rhs.m_index) {
+            return true;
+        }
+    }
+    return lhs.toString() == rhs.toString();
+}
+
+ConditionName::ConditionName(const QString &text) {
+    if (text.isEmpty()) {
+        return;
+    }
+    // Most lookups repeat a handful of names; skip the shared lock for those.
+    thread_local QHash<QString, quint32> recent;
+    const auto it = recent.constFind(text);
+    if (it != recent.constEnd()) {
+        m_id = it.value();
+        return;
+    }
+    m_id = conditionNames().intern(text);
+    if (recent.size() < 256) {
+        recent.insert(text, m_id);
+    }
+}
+
+const QString &ConditionName::toString() const {
+    return conditionNames().at(m_id);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+// How a mass-spawned name is built: pattern with %name and %index
+// placeholders, the base name, and how the index is padded.
+struct SpawnStyle {
+    QString baseName;
+    QString pattern;
+    bool zeroPad = false;
+    int width = 2;
+};
+
+bool operator==(const SpawnStyle &lhs, const SpawnStyle &rhs) noexcept;
+size_t qHash(const SpawnStyle &style, size_t seed = 0) noexcept;
+
+// A combatant's name. Either free text, or for mass-spawned creatures an
+// interned SpawnStyle plus an index that is formatted on demand, so
+// "Goblin #1" through "Goblin #500" own no string storage at all.
+// Comparisons follow the formatted text.
+class CombatantName {
+public:
+    CombatantName() = default;
+    CombatantName(QString text)
+        : m_text(std::move(text)) {}
+    CombatantName(const char *text)
+        : m_text(QString::fromUtf8(text)) {}
+
+    static CombatantName spawned(const SpawnStyle &style, int index);
+    static QString format(const SpawnStyle &style, int index);
+
+    bool isSpawned() const noexcept { return m_style != 0; }
+    // Only meaningful when isSpawned().
+    const SpawnStyle &style() const;
+    int index() const noexcept { return m_index; }
+
+    QString toString() const;
+    bool isEmpty() const;
+
+    // Same result as toString().toCaseFolded() <, but siblings of one style
+    // compare by index without formatting either name.
+    bool lessCaseFolded(const CombatantName &other) const;
+
+    // Heap bytes owned by this name alone; shared style strings are not counted.
+    qsizetype ownedBytes() const noexcept { return m_text.size() * static_cast<qsizetype>(sizeof(QChar)); }
+
+    friend bool operator==(const CombatantName &lhs, const CombatantName &rhs);
+    friend bool operator!=(const CombatantName &lhs, const CombatantName &rhs) { return !(lhs == rhs); }
+
+private:
+    QString m_text;
+    quint32 m_style = 0;
+    int m_index = 0;
+};
+
+// Interned condition name: one shared string per distinct name, four bytes
+// per use.
+class ConditionName {
+public:
+    ConditionName() = default;
+    ConditionName(const QString &text);
+    ConditionName(const char *text)
+        : ConditionName(QString::fromUtf8(text)) {}
+
+    quint32 id() const noexcept { return m_id; }
+    const QString &toString() const;
+    bool isEmpty() const noexcept { return m_id == 0; }
+
+    friend bool operator==(ConditionName lhs, ConditionName rhs) noexcept { return lhs.m_id == rhs.m_id; }
+    friend bool operator!=(ConditionName lhs, ConditionName rhs) noexcept { return lhs.m_id != rhs.m_id; }
+
+private:
+    quint32 m_id = 0;
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <initializer_list>
+#include <type_traits>
+
+#include "CombatantName.h"
+
+struct Condition {
+    ConditionName name;
+    int remainingRounds = 0;
+
+    bool isExpired() const noexcept { return remainingRounds <= 0; }
+};
+
+static_assert(std::is_trivially_copyable_v<Condition>, "ConditionList copies conditions bytewise");
+
+// Condition storage for one combatant. Nearly every combatant carries zero to
+// two conditions, so those live inline and only a third one moves the list to
+// the heap.
+class ConditionList {
+public:
+    static constexpr int kInlineCapacity = 2;
+
+    using value_type = Condition;
+    using iterator = Condition *;
+    using const_iterator = const Condition *;
+
+    ConditionList() noexcept = default;
+    ConditionList(std::initializer_list<Condition> conditions) {
+        reserve(static_cast<int>(conditions.size()));
+        for (const auto &condition : conditions) {
+            push_back(condition);
+        }
+    }
+    ConditionList(const ConditionList &other) { copyFrom(other); }
+    ConditionList(ConditionList &&other) noexcept { takeFrom(other); }
+    ~ConditionList() { release(); }
+
+    ConditionList &operator=(const ConditionList &other) {
+        if (this != &other) {
+            release();
+            copyFrom(other);
+        }
+        return *this;
+    }
+    ConditionList &operator=(ConditionList &&other) noexcept {
+        if (this != &other) {
+            release();
+            takeFrom(other);
+        }
+        return *this;
+    }
+
+    int size() const noexcept { return static_cast<int>(m_size); }
+    bool isEmpty() const noexcept { return m_size == 0; }
+    bool isInline() const noexcept { return m_capacity <= kInlineCapacity; }
+    // Zero while the conditions fit inline.
+    qsizetype heapBytes() const noexcept { return isInline() ? 0 : static_cast<qsizetype>(m_capacity * sizeof(Condition)); }
+
+    iterator begin() noexcept { return data(); }
+    iterator end() noexcept { return data() + m_size; }
+    const_iterator begin() const noexcept { return data(); }
+    const_iterator end() const noexcept { return data() + m_size; }
+
+    const Condition &at(int index) const {
+        Q_ASSERT(index >= 0 && index < size());
+        return data()[index];
+    }
+    Condition &operator[](int index) {
+        Q_ASSERT(index >= 0 && index < size());
+        return data()[index];
+    }
+    const Condition &operator[](int index) const { return at(index); }
+
+    void reserve(int capacity) {
+        if (capacity > static_cast<int>(m_capacity)) {
+            grow(capacity);
+        }
+    }
+    void push_back(const Condition &condition) {
+        const Condition copy = condition;
+        if (m_size == m_capacity) {
+            grow(m_capacity * 2);
+        }
+        data()[m_size++] = copy;
+    }
+    void append(const Condition &condition) { push_back(condition); }
+    iterator erase(iterator first, iterator last) {
+        const auto tail = std::copy(last, end(), first);
+        m_size = static_cast<quint16>(tail - begin());
+        return first;
+    }
+    void clear() noexcept { m_size = 0; }
+
+    friend bool operator==(const ConditionList &lhs, const ConditionList &rhs) noexcept {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Condition &a, const Condition &b) {
+            return a.name == b.name && a.remainingRounds == b.remainingRounds;
+        });
+    }
+    friend bool operator!=(const ConditionList &lhs, const ConditionList &rhs) noexcept { return !(lhs == rhs); }
+
+private:
+    union Storage {
+        Storage() noexcept
+            : items{} {}
+        Condition items[kInlineCapacity];
+        Condition *heap;
+    };
+
+    Condition *data() noexcept { return isInline() ? m_storage.items : m_storage.heap; }
+    const Condition *data() const noexcept { return isInline() ? m_storage.items : m_storage.heap; }
+
+    void grow(int capacity) {
+        Q_ASSERT(capacity <= 0xffff);
+        auto *heap = new Condition[capacity];
+        std::copy(begin(), end(), heap);
+        release();
+        m_storage.heap = heap;
+        m_capacity = static_cast<quint16>(capacity);
+    }
+    void release() noexcept {
+        if (!isInline()) {
+            delete[] m_storage.heap;
+            m_storage = Storage();
+            m_capacity = kInlineCapacity;
+        }
+    }
+    void copyFrom(const ConditionList &other) {
+        m_size = 0;
+        reserve(other.size());
+        std::copy(other.begin(), other.end(), begin());
+        m_size = other.m_size;
+    }
+    void takeFrom(ConditionList &other) noexcept {
+        m_storage = other.m_storage;
+        m_size = other.m_size;
+        m_capacity = other.m_capacity;
+        other.m_storage = Storage();
+        other.m_size = 0;
+        other.m_capacity = kInlineCapacity;
+    }
+
+    Storage m_storage;
+    quint16 m_size = 0;
+    quint16 m_capacity = kInlineCapacity;
+};
@@ -0,0 +1,68 @@
+#include "EncounterTimeline.h"
+
+#include <algorithm>
+
+QVector<Combatant> EncounterVersion::toList() const {
+    QVector<Combatant> list;
+    list.reserve(order.size());
+    order.forEach([&](int slot) { list.push_back(*storage.at(slot)); });
+    return list;
+}
+
+void EncounterTimeline::append(const EncounterVersion &version) {
+    m_versions.push_back(version);
+    m_latestSerialByTurn.insert(turnKey(version.round, version.turnIndex), version.serial);
+    while (m_capacity > 0 && count() > m_capacity) {
+        evictOldest();
+    }
+}
+
+void EncounterTimeline::clear() {
+    m_versions.clear();
+    m_latestSerialByTurn.clear();
+}
+
+const EncounterVersion *EncounterTimeline::bySerial(quint64 serial) const {
+    if (m_versions.empty() || serial < m_versions.front().serial || serial > m_versions.back().serial) {
+        return nullptr;
+    }
+    // Serials are strictly increasing, so a binary search finds the slot even
+    // after restores skipped numbers.
+    const auto it = std::lower_bound(m_versions.begin(), m_versions.end(), serial, [](const EncounterVersion &version, quint64 value) {
+        return version.serial < value;
+    });
+    if (it == m_versions.end() || it->serial != serial) {
+        return nullptr;
+    }
+    return &(*it);
+}
+
+const EncounterVersion *EncounterTimeline::find(int round, int turnIndex) const {
+    const auto it = m_latestSerialByTurn.constFind(turnKey(round, turnIndex));
+    if (it == m_latestSerialByTurn.constEnd()) {
+        return nullptr;
+    }
+    return bySerial(it.value());
+}
+
+void EncounterTimeline::setCapacity(int capacity) {
+    m_capacity = std::max(0, capacity);
+    while (m_capacity > 0 && count() > m_capacity) {
+        evictOldest();
+    }
+}
+
+void EncounterTimeline::evictOldest() {
+    const auto &oldest = m_versions.front();
+    const auto key = turnKey(oldest.round, oldest.turnIndex);
+    // A later version of the same turn keeps its entry.
+    const auto it = m_latestSerialByTurn.find(key);
+    if (it != m_latestSerialByTurn.end() && it.value() == oldest.serial) {
+        m_latestSerialByTurn.erase(it);
+    }
+    m_versions.pop_front();
+}
+
+quint64 EncounterTimeline::turnKey(int round, int turnIndex) {
+    return (static_cast<quint64>(static_cast<quint32>(round)) << 32) | static_cast<quint32>(turnIndex);
+}
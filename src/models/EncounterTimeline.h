@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Combatant.h"
+#include "PersistentVector.h"
+
+#include <QHash>
+#include <QVector>
+
+#include <deque>
+#include <memory>
+
+// Immutable view of the encounter at one point in time. Combatants live in
+// stable storage slots; the turn order is a separate vector of slot indices,
+// so an HP edit shares every node except one leaf path with its predecessor.
+struct EncounterVersion {
+    PersistentVector<std::shared_ptr<const Combatant>> storage;
+    PersistentVector<int> order;
+    QVector<Cohort> cohorts;
+    int round = 1;
+    int turnIndex = 0;
+    quint64 serial = 0;
+
+    int size() const noexcept { return order.size(); }
+    const Combatant &at(int position) const { return *storage.at(order.at(position)); }
+    QVector<Combatant> toList() const;
+};
+
+// Bounded log of recorded versions, addressable by serial or by round/turn.
+class EncounterTimeline {
+public:
+    static constexpr int kDefaultCapacity = 4096;
+
+    void append(const EncounterVersion &version);
+    void clear();
+
+    int count() const noexcept { return static_cast<int>(m_versions.size()); }
+    const EncounterVersion &at(int index) const { return m_versions.at(index); }
+    const EncounterVersion *bySerial(quint64 serial) const;
+    const EncounterVersion *find(int round, int turnIndex) const;
+
+    void setCapacity(int capacity);
+    int capacity() const noexcept { return m_capacity; }
+
+private:
+    static quint64 turnKey(int round, int turnIndex);
+    void evictOldest();
+
+    std::deque<EncounterVersion> m_versions;
+    QHash<quint64, quint64> m_latestSerialByTurn;
+    int m_capacity = kDefaultCapacity;
+};
@@ -2,9 +2,16 @@
 
 #include <QBrush>
 
+#include <algorithm>
+#include <memory>
+
+#include "undo/UndoHistory.h"
+#include "utils/Trace.h"
+
 InitiativeModel::InitiativeModel(TurnManager *manager, QObject *parent)
     : QAbstractTableModel(parent)
-    , m_manager(manager) {}
+    , m_manager(manager)
+    , m_syncedGeneration(manager ? manager->generation() : 0) {}
 
 int InitiativeModel::rowCount(const QModelIndex &parent) const {
     if (parent.isValid() || !m_manager) {
@@ -21,6 +28,7 @@ int InitiativeModel::columnCount(const QModelIndex &parent) const {
 }
 
 QVariant InitiativeModel::data(const QModelIndex &index, int role) const {
+    TRACE_SCOPE("InitiativeModel::data");
     if (!m_manager || !index.isValid()) {
         return QVariant();
     }
@@ -34,7 +42,7 @@ QVariant InitiativeModel::data(const QModelIndex &index, int role) const {
         case ColumnIndex:
             return index.row() + 1;
         case ColumnName:
-            return combatant.name;
+            return combatant.name.toString();
         case ColumnInitiative:
             return combatant.initiative;
         case ColumnDex:
@@ -42,6 +50,9 @@ QVariant InitiativeModel::data(const QModelIndex &index, int role) const {
         case ColumnType:
             return combatant.isPC ? tr("PC") : tr("NPC");
         case ColumnStatus:
+            if (combatant.isMob()) {
+                return tr("%1/%2 standing").arg(combatant.mob.standing()).arg(combatant.mob.size());
+            }
             return combatant.conscious ? tr("OK") : tr("Down");
         case ColumnHP:
             return combatant.hp;
@@ -50,21 +61,49 @@ QVariant InitiativeModel::data(const QModelIndex &index, int role) const {
         case ColumnConditions: {
             QStringList names;
             for (const auto &condition : combatant.conditions) {
-                names << QStringLiteral("%1 (%2)").arg(condition.name).arg(condition.remainingRounds);
+                names << QStringLiteral("%1 (%2)").arg(condition.name.toString()).arg(condition.remainingRounds);
+            }
+            if (combatant.mob.membersWithConditions() > 0) {
+                names << tr("%n member(s) with own conditions", nullptr, combatant.mob.membersWithConditions());
             }
             return names.join(", ");
         }
         case ColumnNotes:
             return combatant.notes;
+        case ColumnGroup: {
+            const auto cohort = m_manager->cohortById(combatant.cohort);
+            return cohort ? cohort->name : QString();
+        }
         default:
             break;
         }
     }
 
+    if (role == CohortIdRole) {
+        return combatant.cohort;
+    }
+    if (role == CohortStartRole) {
+        return combatant.cohort > 0 && (index.row() == 0 || combatants.at(index.row() - 1).cohort != combatant.cohort);
+    }
+
     if (role == Qt::ToolTipRole && index.column() == ColumnNotes) {
         return combatant.notes;
     }
 
+    if (role == Qt::ToolTipRole && combatant.isMob() && (index.column() == ColumnStatus || index.column() == ColumnHP)) {
+        // The mob's members, one per line; Split Mob turns them into rows.
+        constexpr int kShownMembers = 40;
+        const int shown = std::min(combatant.mob.size(), kShownMembers);
+        QStringList lines;
+        for (int member = 0; member < shown; ++member) {
+            lines << tr("#%1: %2 HP").arg(member + 1).arg(combatant.mob.hp(member));
+        }
+        if (shown < combatant.mob.size()) {
+            lines << tr("and %n more", nullptr, combatant.mob.size() - shown);
+        }
+        return lines.join(QStringLiteral("\n"));
+    }
+
     if (role == Qt::ForegroundRole && !combatant.conscious) {
         return QBrush(Qt::gray);
     }
@@ -94,6 +133,8 @@ QVariant InitiativeModel::headerData(int section, Qt::Orientation orientation, i
             return tr("Conditions");
         case ColumnNotes:
             return tr("Notes");
+        case ColumnGroup:
+            return tr("Group");
         default:
             break;
         }
@@ -106,11 +147,17 @@ Qt::ItemFlags InitiativeModel::flags(const QModelIndex &index) const {
         return Qt::NoItemFlags;
     }
     Qt::ItemFlags itemFlags = Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+    const bool mob = m_manager && index.row() < m_manager->combatants().size() && m_manager->combatants().at(index.row()).isMob();
     switch (index.column()) {
+    case ColumnHP:
+        // A mob's HP is the sum over its members; damage goes through Damage Mob.
+        if (!mob) {
+            itemFlags |= Qt::ItemIsEditable;
+        }
+        break;
     case ColumnName:
     case ColumnInitiative:
     case ColumnDex:
-    case ColumnHP:
     case ColumnAC:
     case ColumnNotes:
         itemFlags |= Qt::ItemIsEditable;
@@ -122,40 +169,94 @@ Qt::ItemFlags InitiativeModel::flags(const QModelIndex &index) const {
 }
 
 bool InitiativeModel::setData(const QModelIndex &index, const QVariant &value, int role) {
+    TRACE_SCOPE("InitiativeModel::setData");
     if (!m_manager || role != Qt::EditRole || !index.isValid()) {
         return false;
     }
-    auto &combatant = m_manager->combatants()[index.row()];
+    const auto &before = m_manager->combatants().at(index.row());
+    // A cohort member's initiative is the cohort's; edit that instead.
+    if (index.column() == ColumnInitiative && before.cohort > 0) {
+        if (const auto cohort = m_manager->cohortById(before.cohort)) {
+            Cohort edited = *cohort;
+            edited.initiative = value.toInt();
+            if (edited == *cohort) {
+                return true;
+            }
+            auto command = std::make_unique<EditCohortCommand>(m_manager, cohort, edited);
+            if (m_undoHistory) {
+                m_undoHistory->push(command.release());
+            } else {
+                command->redo();
+            }
+            refresh();
+            return true;
+        }
+    }
+    Combatant after = before;
     switch (index.column()) {
     case ColumnName:
-        combatant.name = value.toString();
+        after.name = value.toString();
         break;
     case ColumnInitiative:
-        combatant.initiative = value.toInt();
-        m_manager->sortCombatants();
+        after.initiative = value.toInt();
         break;
     case ColumnDex:
-        combatant.dexMod = value.toInt();
-        m_manager->sortCombatants();
+        after.dexMod = value.toInt();
         break;
     case ColumnHP:
-        combatant.hp = value.toInt();
+        after.hp = value.toInt();
         break;
     case ColumnAC:
-        combatant.ac = value.toInt();
+        after.ac = value.toInt();
         break;
     case ColumnNotes:
-        combatant.notes = value.toString();
+        after.notes = value.toString();
         break;
     default:
         return false;
     }
+    auto command = std::make_unique<EditCombatantCommand>(m_manager, after.id, before, after);
+    if (command->isEmpty()) {
+        return true;
+    }
+    if (m_undoHistory) {
+        m_undoHistory->push(command.release());
+    } else {
+        command->redo();
+    }
     emit dataChanged(index, index);
     return true;
 }
 
 void InitiativeModel::refresh() {
-    beginResetModel();
-    endResetModel();
+    TRACE_SCOPE("InitiativeModel::refresh");
+    if (!m_manager) {
+        return;
+    }
+    const auto changes = m_manager->changesSince(m_syncedGeneration);
+    m_syncedGeneration = changes.generation;
+    if (changes.isEmpty()) {
+        return;
+    }
+    if (changes.reset || changes.orderChanged || changes.cohortsChanged || !changes.removedIds.isEmpty()) {
+        beginResetModel();
+        endResetModel();
+        return;
+    }
+    const int rows = rowCount();
+    if (rows == 0) {
+        return;
+    }
+    if (changes.turnChanged) {
+        // The current-turn highlight moved; repaint without dropping selection.
+        emit dataChanged(index(0, 0), index(rows - 1, ColumnCount - 1));
+        return;
+    }
+    for (const int id : changes.changedIds) {
+        const int row = m_manager->indexOf(id);
+        if (row >= 0) {
+            emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+        }
+    }
 }
 
@@ -4,6 +4,8 @@
 
 #include "TurnManager.h"
 
+class UndoHistory;
+
 class InitiativeModel : public QAbstractTableModel {
     Q_OBJECT
 public:
@@ -18,9 +20,17 @@ public:
         ColumnAC,
         ColumnConditions,
         ColumnNotes,
+        ColumnGroup,
         ColumnCount
     };
 
+    enum Roles {
+        // Cohort id of the row, 0 for solo combatants.
+        CohortIdRole = Qt::UserRole + 1,
+        // True on the first row of a cohort, so views can draw group breaks.
+        CohortStartRole
+    };
+
     explicit InitiativeModel(TurnManager *manager, QObject *parent = nullptr);
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -30,9 +40,15 @@ public:
     Qt::ItemFlags flags(const QModelIndex &index) const override;
     bool setData(const QModelIndex &index, const QVariant &value, int role) override;
 
+    // Emits row-level dataChanged for what changed since the last refresh and
+    // falls back to a reset when rows were added, removed or reordered.
     void refresh();
 
+    void setUndoHistory(UndoHistory *history) noexcept { m_undoHistory = history; }
+
 private:
     TurnManager *m_manager;
+    UndoHistory *m_undoHistory = nullptr;
+    quint64 m_syncedGeneration = 0;
 };
 
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include "Combatant.h"
+
+// House rules for breaking initiative ties. Each names a fixed chain of rule
+// policies below; the chain is chosen once per sort, so the comparator the
+// sort runs is fully inlined for that variant.
+enum class InitiativeRules {
+    Standard,       // dex mod, then PCs first
+    NpcsWinTies,    // dex mod, then NPCs first
+    DexScore,       // dex score instead of mod, then PCs first
+    RandomTiebreak, // dex mod, then the rolled tiebreak value
+    SideInitiative  // one roll per side; sides stay together
+};
+
+namespace initiative {
+
+constexpr int bitsFor(quint64 range) noexcept {
+    int bits = 0;
+    for (; range != 0; range >>= 1) {
+        ++bits;
+    }
+    return bits;
+}
+
+// A rule is a stateless policy with compare() returning <0 when lhs acts
+// first, 0 when the rule cannot tell them apart and >0 otherwise, plus the
+// equivalent less() for when it is the last rule in a chain. pack() appends
+// kBits to a radix key that sorts ascending in acting order, or returns false
+// when the value is outside the packable range.
+template <typename Key>
+struct HighestFirst {
+    static constexpr int kBits = bitsFor(quint64(Key::kMax - Key::kMin));
+
+    static int compare(const Combatant &lhs, const Combatant &rhs) noexcept {
+        const int a = Key::of(lhs);
+        const int b = Key::of(rhs);
+        return a == b ? 0 : (a > b ? -1 : 1);
+    }
+    static bool less(const Combatant &lhs, const Combatant &rhs) noexcept { return Key::of(lhs) > Key::of(rhs); }
+    static bool pack(const Combatant &combatant, quint32, quint64 &key) noexcept {
+        const int value = Key::of(combatant);
+        if (value < Key::kMin || value > Key::kMax) {
+            return false;
+        }
+        key = (key << kBits) | quint64(Key::kMax - value);
+        return true;
+    }
+};
+
+template <typename Key>
+struct LowestFirst {
+    static constexpr int kBits = HighestFirst<Key>::kBits;
+
+    static int compare(const Combatant &lhs, const Combatant &rhs) noexcept { return -HighestFirst<Key>::compare(lhs, rhs); }
+    static bool less(const Combatant &lhs, const Combatant &rhs) noexcept { return Key::of(lhs) < Key::of(rhs); }
+    static bool pack(const Combatant &combatant, quint32, quint64 &key) noexcept {
+        const int value = Key::of(combatant);
+        if (value < Key::kMin || value > Key::kMax) {
+            return false;
+        }
+        key = (key << kBits) | quint64(value - Key::kMin);
+        return true;
+    }
+};
+
+// Ranges are what the radix path packs; anything outside them falls back to
+// the comparison sort.
+struct InitiativeKey {
+    static constexpr int kMin = -512;
+    static constexpr int kMax = 511;
+    static int of(const Combatant &combatant) noexcept { return combatant.initiative; }
+};
+struct DexModKey {
+    static constexpr int kMin = -32;
+    static constexpr int kMax = 31;
+    static int of(const Combatant &combatant) noexcept { return combatant.dexMod; }
+};
+struct DexScoreKey {
+    static constexpr int kMin = 0;
+    static constexpr int kMax = 127;
+    static int of(const Combatant &combatant) noexcept { return combatant.effectiveDexScore(); }
+};
+struct PCKey {
+    static constexpr int kMin = 0;
+    static constexpr int kMax = 1;
+    static int of(const Combatant &combatant) noexcept { return combatant.isPC ? 1 : 0; }
+};
+struct TiebreakKey {
+    static constexpr int kMin = 0;
+    static constexpr int kMax = 1 << 20;
+    static int of(const Combatant &combatant) noexcept { return combatant.tiebreak; }
+};
+struct SideKey {
+    static constexpr int kMin = -128;
+    static constexpr int kMax = 127;
+    static int of(const Combatant &combatant) noexcept { return combatant.side; }
+};
+
+using Initiative = HighestFirst<InitiativeKey>;
+using DexMod = HighestFirst<DexModKey>;
+using DexScore = HighestFirst<DexScoreKey>;
+using PCsFirst = HighestFirst<PCKey>;
+using NpcsFirst = LowestFirst<PCKey>;
+using Tiebreak = HighestFirst<TiebreakKey>;
+using Side = LowestFirst<SideKey>;
+
+// Packs the caller-supplied rank of the name in case-folded order.
+struct Name {
+    static constexpr int kBits = 24;
+
+    static int compare(const Combatant &lhs, const Combatant &rhs) {
+        if (lhs.name.lessCaseFolded(rhs.name)) {
+            return -1;
+        }
+        return rhs.name.lessCaseFolded(lhs.name) ? 1 : 0;
+    }
+    static bool less(const Combatant &lhs, const Combatant &rhs) { return lhs.name.lessCaseFolded(rhs.name); }
+    static bool pack(const Combatant &, quint32 nameRank, quint64 &key) noexcept {
+        if (nameRank >= (1u << kBits)) {
+            return false;
+        }
+        key = (key << kBits) | nameRank;
+        return true;
+    }
+};
+
+// Applies Rules in order until one of them decides.
+template <typename Rule, typename... Rest>
+struct Chain {
+    static constexpr int kKeyBits = (Rule::kBits + ... + Rest::kBits);
+    static_assert(kKeyBits <= 64, "radix key does not fit in 64 bits");
+
+    // Key whose ascending order matches less(); false if a value is out of range.
+    static bool packKey(const Combatant &combatant, quint32 nameRank, quint64 &key) noexcept {
+        key = 0;
+        return Rule::pack(combatant, nameRank, key) && (Rest::pack(combatant, nameRank, key) && ...);
+    }
+
+    static bool less(const Combatant &lhs, const Combatant &rhs) {
+        if constexpr (sizeof...(Rest) == 0) {
+            return Rule::less(lhs, rhs);
+        } else {
+            const int order = Rule::compare(lhs, rhs);
+            return order != 0 ? order < 0 : Chain<Rest...>::less(lhs, rhs);
+        }
+    }
+};
+
+using StandardOrder = Chain<Initiative, DexMod, PCsFirst, Name>;
+using NpcsWinTiesOrder = Chain<Initiative, DexMod, NpcsFirst, Name>;
+using DexScoreOrder = Chain<Initiative, DexScore, PCsFirst, Name>;
+using RandomTiebreakOrder = Chain<Initiative, DexMod, Tiebreak, Name>;
+// Everyone on a side shares its roll, so sides tie on initiative; keep each
+// side together and order within it as usual.
+using SideInitiativeOrder = Chain<Initiative, Side, DexMod, PCsFirst, Name>;
+
+} // namespace initiative
+
+// Calls visit with a default-constructed ordering type (one with a static
+// less()) for rules. Branches once; everything inside visit is specialized.
+template <typename Visitor>
+decltype(auto) visitInitiativeOrder(InitiativeRules rules, Visitor &&visit) {
+    switch (rules) {
+    case InitiativeRules::NpcsWinTies:
+        return visit(initiative::NpcsWinTiesOrder{});
+    case InitiativeRules::DexScore:
+        return visit(initiative::DexScoreOrder{});
+    case InitiativeRules::RandomTiebreak:
+        return visit(initiative::RandomTiebreakOrder{});
+    case InitiativeRules::SideInitiative:
+        return visit(initiative::SideInitiativeOrder{});
+    case InitiativeRules::Standard:
+        break;
+    }
+    return visit(initiative::StandardOrder{});
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QHash>
+#include <QtGlobal>
+
+#include <array>
+#include <atomic>
+#include <mutex>
+
+// Append-only, process-wide table that hands out one small id per distinct
+// value. Entries are never moved or freed, so at() is a lock-free read whose
+// reference stays valid for the life of the table; intern() takes a mutex.
+// Id 0 always holds a default-constructed T.
+template <typename T>
+class InternTable {
+public:
+    static constexpr quint32 kChunkBits = 10;
+    static constexpr quint32 kChunkSize = 1u << kChunkBits;
+    static constexpr quint32 kMaxChunks = 4096;
+
+    InternTable() { intern(T()); }
+
+    ~InternTable() {
+        for (auto &chunk : m_chunks) {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    InternTable(const InternTable &) = delete;
+    InternTable &operator=(const InternTable &) = delete;
+
+    // Returns 0 once the table is full, so callers degrade to the default value.
+    quint32 intern(const T &value) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it = m_ids.constFind(value);
+        if (it != m_ids.constEnd()) {
+            return it.value();
+        }
+        const quint32 id = m_size.load(std::memory_order_relaxed);
+        if (id >= kChunkSize * kMaxChunks) {
+            return 0;
+        }
+        auto &chunk = m_chunks[id >> kChunkBits];
+        T *entries = chunk.load(std::memory_order_relaxed);
+        if (!entries) {
+            entries = new T[kChunkSize];
+            chunk.store(entries, std::memory_order_release);
+        }
+        entries[id & (kChunkSize - 1)] = value;
+        m_ids.insert(value, id);
+        m_size.store(id + 1, std::memory_order_release);
+        return id;
+    }
+
+    // id must have come from intern() on this table.
+    const T &at(quint32 id) const {
+        Q_ASSERT(id < m_size.load(std::memory_order_acquire));
+        return m_chunks[id >> kChunkBits].load(std::memory_order_acquire)[id & (kChunkSize - 1)];
+    }
+
+    int size() const noexcept { return static_cast<int>(m_size.load(std::memory_order_acquire)); }
+
+private:
+    std::mutex m_mutex;
+    QHash<T, quint32> m_ids;
+    std::array<std::atomic<T *>, kMaxChunks> m_chunks{};
+    std::atomic<quint32> m_size{0};
+};
@@ -0,0 +1,117 @@
+#include "MobMembers.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+qint16 clampHp(int hp) {
+    return static_cast<qint16>(std::clamp(hp, 0, int(std::numeric_limits<qint16>::max())));
+}
+
+} // namespace
+
+MobMembers MobMembers::uniform(int count, int hp) {
+    MobMembers mob;
+    if (count <= 0) {
+        return mob;
+    }
+    mob.m_hp.fill(clampHp(hp), count);
+    mob.m_standing = hp > 0 ? count : 0;
+    return mob;
+}
+
+int MobMembers::totalHp() const noexcept {
+    int total = 0;
+    for (const qint16 hp : m_hp) {
+        total += hp;
+    }
+    return total;
+}
+
+void MobMembers::setHp(int member, int hp) {
+    Q_ASSERT(member >= 0 && member < size());
+    const qint16 clamped = clampHp(hp);
+    m_standing += (clamped > 0 ? 1 : 0) - (m_hp.at(member) > 0 ? 1 : 0);
+    m_hp[member] = clamped;
+}
+
+int MobMembers::applyDamage(int amount, MobDamage spread) {
+    if (amount <= 0 || m_standing == 0) {
+        return 0;
+    }
+    const int before = m_standing;
+    qint16 *hp = m_hp.data();
+    const int count = size();
+    switch (spread) {
+    case MobDamage::Focus:
+        for (int member = 0; member < count; ++member) {
+            if (hp[member] > 0) {
+                hp[member] = clampHp(hp[member] - amount);
+                m_standing -= hp[member] == 0 ? 1 : 0;
+                break;
+            }
+        }
+        break;
+    case MobDamage::Overflow:
+        for (int member = 0; member < count && amount > 0; ++member) {
+            if (hp[member] > 0) {
+                const int dealt = std::min<int>(amount, hp[member]);
+                hp[member] = static_cast<qint16>(hp[member] - dealt);
+                amount -= dealt;
+                m_standing -= hp[member] == 0 ? 1 : 0;
+            }
+        }
+        break;
+    case MobDamage::Each:
+        for (int member = 0; member < count; ++member) {
+            hp[member] = clampHp(hp[member] - amount);
+        }
+        m_standing = static_cast<int>(std::count_if(m_hp.cbegin(), m_hp.cend(), [](qint16 value) { return value > 0; }));
+        break;
+    }
+    return before - m_standing;
+}
+
+const ConditionList *MobMembers::conditions(int member) const {
+    const auto it = m_conditions.constFind(member);
+    return it == m_conditions.constEnd() ? nullptr : &it.value();
+}
+
+void MobMembers::addCondition(int member, const Condition &condition) {
+    Q_ASSERT(member >= 0 && member < size());
+    m_conditions[member].push_back(condition);
+}
+
+bool MobMembers::expireConditions() {
+    if (m_conditions.isEmpty()) {
+        return false;
+    }
+    for (auto it = m_conditions.begin(); it != m_conditions.end();) {
+        auto &list = it.value();
+        for (auto &condition : list) {
+            if (condition.remainingRounds > 0) {
+                --condition.remainingRounds;
+            }
+        }
+        list.erase(std::remove_if(list.begin(), list.end(), [](const Condition &c) { return c.isExpired(); }), list.end());
+        if (list.isEmpty()) {
+            it = m_conditions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return true;
+}
+
+qsizetype MobMembers::heapBytes() const noexcept {
+    qsizetype bytes = m_hp.size() * static_cast<qsizetype>(sizeof(qint16));
+    for (auto it = m_conditions.cbegin(); it != m_conditions.cend(); ++it) {
+        bytes += static_cast<qsizetype>(sizeof(int) + sizeof(ConditionList)) + it.value().heapBytes();
+    }
+    return bytes;
+}
+
+bool operator==(const MobMembers &lhs, const MobMembers &rhs) {
+    return lhs.m_hp == rhs.m_hp && lhs.m_conditions == rhs.m_conditions;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QHash>
+#include <QVector>
+#include <QtGlobal>
+
+#include "ConditionList.h"
+
+// How damage dealt to a mob is shared among its standing members.
+enum class MobDamage {
+    Focus,    // the first standing member takes it all; excess is lost
+    Overflow, // excess carries on to the next standing member
+    Each      // every standing member takes the full amount, e.g. an area effect
+};
+
+// Per-member state behind a single mob row: many identical minions sharing
+// one Combatant. HP is two bytes per member and a member stands while its HP
+// is above zero. Individual conditions are rare, so only members that carry
+// one get a list. Copies share storage until written.
+class MobMembers {
+public:
+    MobMembers() = default;
+    static MobMembers uniform(int count, int hp);
+
+    bool isEmpty() const noexcept { return m_hp.isEmpty(); }
+    int size() const noexcept { return m_hp.size(); }
+    int standing() const noexcept { return m_standing; }
+    int totalHp() const noexcept;
+
+    int hp(int member) const { return m_hp.at(member); }
+    bool isStanding(int member) const { return m_hp.at(member) > 0; }
+    void setHp(int member, int hp);
+
+    // Returns the number of members it dropped.
+    int applyDamage(int amount, MobDamage spread);
+
+    // nullptr when the member has no conditions of its own.
+    const ConditionList *conditions(int member) const;
+    void addCondition(int member, const Condition &condition);
+    int membersWithConditions() const noexcept { return m_conditions.size(); }
+    // Ticks every member's conditions down by a round; false if none had any.
+    bool expireConditions();
+
+    qsizetype heapBytes() const noexcept;
+
+    friend bool operator==(const MobMembers &lhs, const MobMembers &rhs);
+    friend bool operator!=(const MobMembers &lhs, const MobMembers &rhs) { return !(lhs == rhs); }
+
+private:
+    QVector<qint16> m_hp;
+    QHash<int, ConditionList> m_conditions;
+    int m_standing = 0;
+};
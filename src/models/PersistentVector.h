@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "utils/Arena.h"
+
+// Immutable 32-way trie. Every update returns a new vector that shares all
+// untouched nodes with the original, so a version costs O(log32 n) nodes and
+// any element of any version is reachable in O(log32 n). Nodes come from the
+// shared arena pool.
+template <typename T>
+class PersistentVector {
+public:
+    PersistentVector() = default;
+
+    // Bulk construction in O(n), for when most entries are new anyway.
+    template <typename Iterator>
+    static PersistentVector build(Iterator first, Iterator last) {
+        PersistentVector result;
+        std::vector<NodePtr> level;
+        while (first != last) {
+            auto leaf = arena::makePooled<Node>();
+            leaf->values.reserve(kWidth);
+            for (int i = 0; i < kWidth && first != last; ++i, ++first) {
+                leaf->values.push_back(*first);
+            }
+            result.m_size += static_cast<int>(leaf->values.size());
+            level.push_back(std::move(leaf));
+        }
+        while (level.size() > 1) {
+            std::vector<NodePtr> parents;
+            for (std::size_t i = 0; i < level.size(); i += kWidth) {
+                auto parent = arena::makePooled<Node>();
+                const auto end = std::min(level.size(), i + kWidth);
+                parent->children.assign(level.begin() + i, level.begin() + end);
+                parents.push_back(std::move(parent));
+            }
+            level = std::move(parents);
+            result.m_shift += kBits;
+        }
+        if (!level.empty()) {
+            result.m_root = std::move(level.front());
+        }
+        return result;
+    }
+
+    int size() const noexcept { return m_size; }
+    bool isEmpty() const noexcept { return m_size == 0; }
+
+    const T &at(int index) const {
+        assert(index >= 0 && index < m_size);
+        const Node *node = m_root.get();
+        for (int level = m_shift; level > 0; level -= kBits) {
+            node = node->children[(index >> level) & kMask].get();
+        }
+        return node->values[index & kMask];
+    }
+
+    PersistentVector set(int index, T value) const {
+        assert(index >= 0 && index < m_size);
+        PersistentVector result = *this;
+        result.m_root = assign(m_root.get(), m_shift, index, std::move(value));
+        return result;
+    }
+
+    PersistentVector pushBack(T value) const {
+        PersistentVector result = *this;
+        if (!m_root) {
+            result.m_root = makePath(0, std::move(value));
+        } else if (m_size == (1 << (m_shift + kBits))) {
+            auto root = arena::makePooled<Node>();
+            root->children.push_back(m_root);
+            root->children.push_back(makePath(m_shift, std::move(value)));
+            result.m_root = std::move(root);
+            result.m_shift = m_shift + kBits;
+        } else {
+            result.m_root = append(m_root.get(), m_shift, m_size, std::move(value));
+        }
+        ++result.m_size;
+        return result;
+    }
+
+    PersistentVector popBack() const {
+        assert(m_size > 0);
+        PersistentVector result;
+        if (m_size == 1) {
+            return result;
+        }
+        result.m_root = removeLast(m_root.get(), m_shift, m_size - 1);
+        result.m_shift = m_shift;
+        result.m_size = m_size - 1;
+        while (result.m_shift > 0 && result.m_root->children.size() == 1) {
+            result.m_root = result.m_root->children.front();
+            result.m_shift -= kBits;
+        }
+        return result;
+    }
+
+    template <typename Visitor>
+    void forEach(Visitor &&visitor) const {
+        if (m_root) {
+            visit(m_root.get(), m_shift, visitor);
+        }
+    }
+
+    // True when both vectors are the same version (O(1)).
+    bool isSameVersion(const PersistentVector &other) const noexcept {
+        return m_root == other.m_root && m_size == other.m_size;
+    }
+
+private:
+    static constexpr int kBits = 5;
+    static constexpr int kWidth = 1 << kBits;
+    static constexpr int kMask = kWidth - 1;
+
+    struct Node {
+        std::vector<std::shared_ptr<const Node>> children;
+        std::vector<T> values;
+    };
+    using NodePtr = std::shared_ptr<const Node>;
+
+    static NodePtr makePath(int level, T value) {
+        auto node = arena::makePooled<Node>();
+        if (level == 0) {
+            node->values.reserve(kWidth);
+            node->values.push_back(std::move(value));
+        } else {
+            node->children.reserve(kWidth);
+            node->children.push_back(makePath(level - kBits, std::move(value)));
+        }
+        return node;
+    }
+
+    static NodePtr assign(const Node *node, int level, int index, T value) {
+        auto copy = arena::makePooled<Node>(*node);
+        if (level == 0) {
+            copy->values[index & kMask] = std::move(value);
+        } else {
+            const int slot = (index >> level) & kMask;
+            copy->children[slot] = assign(node->children[slot].get(), level - kBits, index, std::move(value));
+        }
+        return copy;
+    }
+
+    static NodePtr append(const Node *node, int level, int index, T value) {
+        auto copy = arena::makePooled<Node>(*node);
+        if (level == 0) {
+            copy->values.push_back(std::move(value));
+            return copy;
+        }
+        const int slot = (index >> level) & kMask;
+        if (slot < static_cast<int>(node->children.size())) {
+            copy->children[slot] = append(node->children[slot].get(), level - kBits, index, std::move(value));
+        } else {
+            copy->children.push_back(makePath(level - kBits, std::move(value)));
+        }
+        return copy;
+    }
+
+    static NodePtr removeLast(const Node *node, int level, int index) {
+        if (level == 0) {
+            if (node->values.size() == 1) {
+                return nullptr;
+            }
+            auto copy = arena::makePooled<Node>(*node);
+            copy->values.pop_back();
+            return copy;
+        }
+        const int slot = (index >> level) & kMask;
+        auto child = removeLast(node->children[slot].get(), level - kBits, index);
+        if (!child && slot == 0) {
+            return nullptr;
+        }
+        auto copy = arena::makePooled<Node>(*node);
+        if (child) {
+            copy->children[slot] = std::move(child);
+        } else {
+            copy->children.pop_back();
+        }
+        return copy;
+    }
+
+    template <typename Visitor>
+    static void visit(const Node *node, int level, Visitor &visitor) {
+        if (level == 0) {
+            for (const auto &value : node->values) {
+                visitor(value);
+            }
+            return;
+        }
+        for (const auto &child : node->children) {
+            visit(child.get(), level - kBits, visitor);
+        }
+    }
+
+    NodePtr m_root;
+    int m_size = 0;
+    int m_shift = 0;
+};
@@ -1,141 +1,909 @@
 #include "TurnManager.h"
 
 #include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
 
-TurnManager::CombatantList &TurnManager::combatants() {
-    return m_combatants;
-}
+#include "stores/CombatLog.h"
+#include "utils/Arena.h"
+#include "utils/Trace.h"
 
 const TurnManager::CombatantList &TurnManager::combatants() const {
     return m_combatants;
 }
 
-void TurnManager::setCombatants(CombatantList list) {
+void TurnManager::setCombatants(CombatantList list, QVector<Cohort> cohorts) {
+    TRACE_SCOPE("TurnManager::setCombatants");
     m_combatants = std::move(list);
-    sortCombatants();
+    if (!cohorts.isEmpty()) {
+        // A cohort nobody belongs to would only force the block sort.
+        QSet<int> occupied;
+        for (const auto &combatant : m_combatants) {
+            if (combatant.cohort > 0) {
+                occupied.insert(combatant.cohort);
+            }
+        }
+        cohorts.erase(std::remove_if(cohorts.begin(), cohorts.end(), [&occupied](const Cohort &cohort) { return !occupied.contains(cohort.id); }),
+                      cohorts.end());
+    }
+    if (cohorts != m_version.cohorts) {
+        m_version.cohorts = std::move(cohorts);
+        m_cohortsDirty = true;
+    }
+    ScratchArena scratch;
+    auto stored = scratch.vector<std::shared_ptr<const Combatant>>();
+    stored.reserve(m_combatants.size());
+    for (const auto &combatant : m_combatants) {
+        stored.push_back(arena::makePooled<const Combatant>(combatant));
+    }
+    m_version.storage = PersistentVector<std::shared_ptr<const Combatant>>::build(stored.begin(), stored.end());
+    m_version.order = PersistentVector<int>();
+    m_rowSlots.resize(m_combatants.size());
+    std::iota(m_rowSlots.begin(), m_rowSlots.end(), 0);
+    m_freeSlots.clear();
+    m_dirtySlots.clear();
+    m_allDirty = false;
+    m_orderDirty = true;
+    m_versionChanged = true;
+    m_pendingRemovals.clear();
+    m_changeLog.clear();
+    m_generationById.clear();
+    m_changeFloor = m_serial + 1;
+    if (m_eventLog) {
+        m_eventLog->append(CombatEventType::EncounterStarted, m_round, m_turnIndex, 0);
+        for (const auto &combatant : std::as_const(m_combatants)) {
+            logChanges(nullptr, combatant);
+        }
+    }
+    sortInPlace();
     normalizeTurnIndex();
+    commitVersion();
 }
 
 void TurnManager::addCombatant(const Combatant &combatant) {
-    m_combatants.push_back(combatant);
-    sortCombatants();
-    normalizeTurnIndex();
+    addCombatants({combatant});
 }
 
 bool TurnManager::removeCombatant(int id) {
-    const auto it = std::remove_if(m_combatants.begin(), m_combatants.end(), [id](const Combatant &c) { return c.id == id; });
-    if (it == m_combatants.end()) {
-        return false;
+    return removeCombatants({id}) > 0;
+}
+
+void TurnManager::addCombatants(const CombatantList &list) {
+    TRACE_SCOPE("TurnManager::addCombatants");
+    if (list.isEmpty()) {
+        return;
+    }
+    m_combatants.reserve(m_combatants.size() + list.size());
+    m_rowSlots.reserve(m_combatants.capacity());
+    for (const auto &combatant : list) {
+        m_combatants.push_back(combatant);
+        m_rowSlots.push_back(acquireSlot());
+        markDirty(m_combatants.size() - 1);
     }
-    const int removedIndex = std::distance(m_combatants.begin(), it);
-    m_combatants.erase(it, m_combatants.end());
+    m_orderDirty = true;
+    sortInPlace();
+    normalizeTurnIndex();
+    commitVersion();
+}
+
+int TurnManager::removeCombatants(const QVector<int> &ids) {
+    TRACE_SCOPE("TurnManager::removeCombatants");
+    const QSet<int> doomed(ids.cbegin(), ids.cend());
+    const int size = m_combatants.size();
+    int kept = 0;
+    for (int row = 0; row < size; ++row) {
+        if (doomed.contains(m_combatants[row].id)) {
+            m_pendingRemovals.push_back(m_combatants[row].id);
+            releaseSlot(m_rowSlots[row]);
+            continue;
+        }
+        if (kept != row) {
+            m_combatants[kept] = std::move(m_combatants[row]);
+            m_rowSlots[kept] = m_rowSlots[row];
+        }
+        ++kept;
+    }
+    if (kept == size) {
+        return 0;
+    }
+    const int removedIndex = kept;
+    m_combatants.erase(m_combatants.begin() + kept, m_combatants.end());
+    m_rowSlots.resize(kept);
+    m_orderDirty = true;
     if (m_turnIndex >= static_cast<int>(m_combatants.size())) {
         m_turnIndex = std::max(0, static_cast<int>(m_combatants.size()) - 1);
     }
     if (removedIndex <= m_turnIndex) {
         normalizeTurnIndex();
     }
-    return true;
+    commitVersion();
+    return size - kept;
 }
 
 std::optional<Combatant> TurnManager::combatantById(int id) const {
-    const auto it = std::find_if(m_combatants.begin(), m_combatants.end(), [id](const Combatant &c) { return c.id == id; });
-    if (it == m_combatants.end()) {
+    const int row = indexOf(id);
+    if (row < 0) {
         return std::nullopt;
     }
-    return *it;
+    return m_combatants.at(row);
+}
+
+int TurnManager::indexOf(int id) const {
+    return m_rowById.value(id, -1);
 }
 
-static bool combatantLess(const Combatant &lhs, const Combatant &rhs) {
-    if (lhs.initiative != rhs.initiative) {
-        return lhs.initiative > rhs.initiative;
+namespace {
+struct OrderFields {
+    int initiative;
+    int dexMod;
+    bool isPC;
+    CombatantName name;
+    int dexScore;
+    int tiebreak;
+    int side;
+
+    explicit OrderFields(const Combatant &combatant)
+        : initiative(combatant.initiative)
+        , dexMod(combatant.dexMod)
+        , isPC(combatant.isPC)
+        , name(combatant.name)
+        , dexScore(combatant.dexScore)
+        , tiebreak(combatant.tiebreak)
+        , side(combatant.side) {}
+
+    bool matches(const Combatant &combatant) const {
+        return combatant.initiative == initiative && combatant.dexMod == dexMod && combatant.isPC == isPC && combatant.name == name
+            && combatant.dexScore == dexScore && combatant.tiebreak == tiebreak && combatant.side == side;
     }
-    if (lhs.dexMod != rhs.dexMod) {
-        return lhs.dexMod > rhs.dexMod;
+};
+}
+
+bool TurnManager::updateCombatant(int id, const std::function<void(Combatant &)> &mutator) {
+    return updateCombatants({id}, [&mutator](int, Combatant &combatant) { mutator(combatant); }) > 0;
+}
+
+int TurnManager::updateCombatants(const QVector<int> &ids, const std::function<void(int position, Combatant &)> &mutator) {
+    TRACE_SCOPE("TurnManager::updateCombatants");
+    int updated = 0;
+    bool reorder = false;
+    for (int position = 0; position < ids.size(); ++position) {
+        const int row = indexOf(ids.at(position));
+        if (row < 0) {
+            continue;
+        }
+        Combatant &combatant = m_combatants[row];
+        const OrderFields before(combatant);
+        mutator(position, combatant);
+        markDirty(row);
+        reorder = reorder || !before.matches(combatant);
+        ++updated;
     }
-    if (lhs.isPC != rhs.isPC) {
-        return lhs.isPC && !rhs.isPC;
+    if (updated == 0) {
+        return 0;
     }
-    const auto lhsName = lhs.name.toCaseFolded();
-    const auto rhsName = rhs.name.toCaseFolded();
-    return lhsName < rhsName;
+    if (reorder) {
+        sortInPlace();
+    }
+    commitVersion();
+    return updated;
 }
 
 void TurnManager::sortCombatants() {
-    std::stable_sort(m_combatants.begin(), m_combatants.end(), combatantLess);
+    TRACE_SCOPE("TurnManager::sortCombatants");
+    sortInPlace();
+    commitVersion();
+}
+
+void TurnManager::setInitiativeRules(InitiativeRules rules) {
+    if (rules == m_rules) {
+        return;
+    }
+    m_rules = rules;
+    sortCombatants();
+}
+
+std::optional<Cohort> TurnManager::cohortById(int id) const {
+    for (const auto &cohort : m_version.cohorts) {
+        if (cohort.id == id) {
+            return cohort;
+        }
+    }
+    return std::nullopt;
+}
+
+int TurnManager::nextCohortId() const {
+    int maxId = 0;
+    for (const auto &cohort : m_version.cohorts) {
+        maxId = std::max(maxId, cohort.id);
+    }
+    return maxId + 1;
+}
+
+void TurnManager::setCohort(const Cohort &cohort) {
+    TRACE_SCOPE("TurnManager::setCohort");
+    if (cohort.id <= 0) {
+        return;
+    }
+    auto &cohorts = m_version.cohorts;
+    const auto it = std::find_if(cohorts.begin(), cohorts.end(), [&cohort](const Cohort &existing) { return existing.id == cohort.id; });
+    if (it == cohorts.end()) {
+        cohorts.push_back(cohort);
+    } else if (*it == cohort) {
+        return;
+    } else {
+        *it = cohort;
+    }
+    m_cohortsDirty = true;
+    sortInPlace();
+    commitVersion();
+}
+
+bool TurnManager::setCohortInitiative(int id, int initiative) {
+    auto cohort = cohortById(id);
+    if (!cohort) {
+        return false;
+    }
+    cohort->initiative = initiative;
+    setCohort(*cohort);
+    return true;
+}
+
+bool TurnManager::removeCohort(int id) {
+    TRACE_SCOPE("TurnManager::removeCohort");
+    auto &cohorts = m_version.cohorts;
+    const auto it = std::find_if(cohorts.begin(), cohorts.end(), [id](const Cohort &cohort) { return cohort.id == id; });
+    if (it == cohorts.end()) {
+        return false;
+    }
+    cohorts.erase(it);
+    for (int row = 0; row < m_combatants.size(); ++row) {
+        if (m_combatants.at(row).cohort == id) {
+            m_combatants[row].cohort = 0;
+            markDirty(row);
+        }
+    }
+    m_cohortsDirty = true;
+    sortInPlace();
+    commitVersion();
+    return true;
+}
+
+bool TurnManager::syncCohortMembers() {
+    bool grouped = false;
+    QHash<int, int> initiativeOf;
+    for (const auto &cohort : std::as_const(m_version.cohorts)) {
+        initiativeOf.insert(cohort.id, cohort.initiative);
+    }
+    for (int row = 0; row < m_combatants.size(); ++row) {
+        const auto &combatant = m_combatants.at(row);
+        if (combatant.cohort <= 0) {
+            continue;
+        }
+        const auto it = initiativeOf.constFind(combatant.cohort);
+        if (it == initiativeOf.constEnd()) {
+            continue;
+        }
+        grouped = true;
+        if (combatant.initiative != it.value()) {
+            m_combatants[row].initiative = it.value();
+            markDirty(row);
+        }
+    }
+    return grouped;
+}
+
+bool TurnManager::sharesTurn(int row, int previous) const {
+    if (m_advanceMode != AdvanceMode::PerCohort || previous < 0) {
+        return false;
+    }
+    const int cohort = m_combatants.at(row).cohort;
+    return cohort > 0 && cohort == m_combatants.at(previous).cohort;
+}
+
+int TurnManager::turnStart(int row) const {
+    while (row > 0 && sharesTurn(row, row - 1)) {
+        --row;
+    }
+    return row;
+}
+
+bool TurnManager::turnIsConscious(int row) const {
+    for (int member = row; member < m_combatants.size(); ++member) {
+        if (member > row && !sharesTurn(member, member - 1)) {
+            break;
+        }
+        if (m_combatants.at(member).conscious) {
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+// Stable LSD radix sort of rows by keys, one byte per pass. Passes over bytes
+// that every key shares are skipped, so small initiative ranges cost few passes.
+void radixSortRows(ScratchVector<quint64> &keys, ScratchVector<int> &rows) {
+    const size_t size = keys.size();
+    ScratchVector<quint64> keyScratch(size, keys.get_allocator());
+    ScratchVector<int> rowScratch(size, rows.get_allocator());
+    quint64 differing = 0;
+    for (const quint64 key : keys) {
+        differing |= key ^ keys.front();
+    }
+    for (int shift = 0; shift < 64 && (differing >> shift) != 0; shift += 8) {
+        if (((differing >> shift) & 0xff) == 0) {
+            continue;
+        }
+        size_t offsets[256] = {};
+        for (const quint64 key : keys) {
+            ++offsets[(key >> shift) & 0xff];
+        }
+        size_t total = 0;
+        for (auto &offset : offsets) {
+            const size_t count = offset;
+            offset = total;
+            total += count;
+        }
+        for (size_t i = 0; i < size; ++i) {
+            const size_t target = offsets[(keys[i] >> shift) & 0xff]++;
+            keyScratch[target] = keys[i];
+            rowScratch[target] = rows[i];
+        }
+        keys.swap(keyScratch);
+        rows.swap(rowScratch);
+    }
+}
+
+// Fills permutation in acting order with a radix pass over Order's packed
+// key. False, with permutation untouched, when some value does not pack.
+template <typename Order>
+bool radixSortPermutation(const TurnManager::CombatantList &combatants, const QVector<int> &rowSlots,
+                          const std::vector<quint32> &nameRanks, ScratchVector<int> &permutation) {
+    const int size = combatants.size();
+    ScratchVector<quint64> keys(size, permutation.get_allocator());
+    for (int row = 0; row < size; ++row) {
+        if (!Order::packKey(combatants.at(row), nameRanks[rowSlots.at(row)], keys[row])) {
+            return false;
+        }
+    }
+    radixSortRows(keys, permutation);
+    return true;
+}
+
+// Sorts blocks instead of rows. A cohort is one block keyed by a stand-in
+// carrying its initiative, dex and name; everyone else is a block of one.
+// Rows are then laid out block by block in their current relative order.
+template <typename Order>
+void sortByCohort(const TurnManager::CombatantList &combatants, const QVector<Cohort> &cohorts, ScratchArena &scratch, ScratchVector<int> &permutation) {
+    const int size = combatants.size();
+    std::vector<Combatant> standIns;
+    standIns.reserve(cohorts.size());
+    QHash<int, int> blockOfCohort;
+    auto blockKeys = scratch.vector<const Combatant *>();
+    auto blockOfRow = scratch.vector<int>(size);
+    for (int row = 0; row < size; ++row) {
+        const auto &combatant = combatants.at(row);
+        if (combatant.cohort > 0) {
+            const auto found = blockOfCohort.constFind(combatant.cohort);
+            if (found != blockOfCohort.constEnd()) {
+                blockOfRow[row] = found.value();
+                continue;
+            }
+            const auto cohort = std::find_if(cohorts.cbegin(), cohorts.cend(), [&combatant](const Cohort &candidate) {
+                return candidate.id == combatant.cohort;
+            });
+            if (cohort != cohorts.cend()) {
+                Combatant standIn = combatant;
+                standIn.name = cohort->name;
+                standIn.initiative = cohort->initiative;
+                standIn.dexMod = cohort->dexMod;
+                standIn.dexScore = 0;
+                standIns.push_back(std::move(standIn));
+                blockOfCohort.insert(combatant.cohort, static_cast<int>(blockKeys.size()));
+                blockOfRow[row] = static_cast<int>(blockKeys.size());
+                blockKeys.push_back(&standIns.back());
+                continue;
+            }
+        }
+        blockOfRow[row] = static_cast<int>(blockKeys.size());
+        blockKeys.push_back(&combatant);
+    }
+    const int blocks = static_cast<int>(blockKeys.size());
+    auto blockOrder = scratch.vector<int>(blocks);
+    std::iota(blockOrder.begin(), blockOrder.end(), 0);
+    std::stable_sort(blockOrder.begin(), blockOrder.end(), [&blockKeys](int lhs, int rhs) {
+        return Order::less(*blockKeys[lhs], *blockKeys[rhs]);
+    });
+    auto offsets = scratch.vector<int>(blocks + 1, 0);
+    for (int row = 0; row < size; ++row) {
+        ++offsets[blockOfRow[row] + 1];
+    }
+    auto start = scratch.vector<int>(blocks, 0);
+    int next = 0;
+    for (const int block : blockOrder) {
+        start[block] = next;
+        next += offsets[block + 1];
+    }
+    for (int row = 0; row < size; ++row) {
+        permutation[start[blockOfRow[row]]++] = row;
+    }
+}
+
+} // namespace
+
+const std::vector<quint32> &TurnManager::nameRanksBySlot() {
+    const int size = m_combatants.size();
+    bool current = true;
+    for (int row = 0; row < size && current; ++row) {
+        const auto slot = static_cast<size_t>(m_rowSlots.at(row));
+        current = slot < m_rankedNames.size() && m_rankedNames[slot] == m_combatants.at(row).name;
+    }
+    if (current) {
+        return m_nameRanks;
+    }
+    TRACE_SCOPE("TurnManager::rankNames");
+    std::vector<int> byName(size);
+    std::iota(byName.begin(), byName.end(), 0);
+    std::stable_sort(byName.begin(), byName.end(), [this](int lhs, int rhs) {
+        return m_combatants.at(lhs).name.lessCaseFolded(m_combatants.at(rhs).name);
+    });
+    const auto slotCount = static_cast<size_t>(m_version.storage.size());
+    m_rankedNames.assign(slotCount, CombatantName());
+    m_nameRanks.assign(slotCount, 0);
+    quint32 rank = 0;
+    for (int i = 0; i < size; ++i) {
+        const int row = byName[i];
+        if (i > 0 && m_combatants.at(byName[i - 1]).name.lessCaseFolded(m_combatants.at(row).name)) {
+            ++rank;
+        }
+        const auto slot = static_cast<size_t>(m_rowSlots.at(row));
+        m_rankedNames[slot] = m_combatants.at(row).name;
+        m_nameRanks[slot] = rank;
+    }
+    return m_nameRanks;
+}
+
+void TurnManager::sortInPlace() {
+    const int size = m_combatants.size();
+    ScratchArena scratch;
+    auto permutation = scratch.vector<int>(size);
+    std::iota(permutation.begin(), permutation.end(), 0);
+    // Cohorts without members, e.g. while an undo re-adds a group, sort like
+    // no cohorts at all.
+    const bool grouped = !m_version.cohorts.isEmpty() && syncCohortMembers();
+    visitInitiativeOrder(m_rules, [this, size, grouped, &scratch, &permutation](auto order) {
+        using Order = decltype(order);
+        if (grouped) {
+            sortByCohort<Order>(m_combatants, m_version.cohorts, scratch, permutation);
+            return;
+        }
+        if (size >= kRadixSortThreshold && radixSortPermutation<Order>(m_combatants, m_rowSlots, nameRanksBySlot(), permutation)) {
+            return;
+        }
+        std::stable_sort(permutation.begin(), permutation.end(), [this](int lhs, int rhs) {
+            return Order::less(m_combatants.at(lhs), m_combatants.at(rhs));
+        });
+    });
+    bool identity = true;
+    for (int row = 0; row < size && identity; ++row) {
+        identity = permutation[row] == row;
+    }
+    if (identity) {
+        return;
+    }
+    CombatantList sorted;
+    sorted.reserve(size);
+    QVector<int> rowSlots;
+    rowSlots.reserve(size);
+    for (const int row : permutation) {
+        sorted.push_back(std::move(m_combatants[row]));
+        rowSlots.push_back(m_rowSlots.at(row));
+    }
+    m_combatants = std::move(sorted);
+    m_rowSlots = std::move(rowSlots);
+    m_orderDirty = true;
 }
 
 bool TurnManager::advanceTurn() {
+    TRACE_SCOPE("TurnManager::advanceTurn");
     if (m_combatants.isEmpty()) {
         return false;
     }
 
-    decrementConditionsForCurrent();
-
     const int size = m_combatants.size();
+    // A shared cohort turn ends for every member at once.
+    m_turnIndex = turnStart(m_turnIndex);
+    int turnEnd = m_turnIndex + 1;
+    while (turnEnd < size && sharesTurn(turnEnd, turnEnd - 1)) {
+        ++turnEnd;
+    }
+    for (int row = m_turnIndex; row < turnEnd; ++row) {
+        if (expireConditions(m_combatants[row])) {
+            markDirty(row);
+        }
+    }
+
     int attempts = 0;
+    bool rerolled = false;
     do {
         ++m_turnIndex;
+        while (m_turnIndex < size && sharesTurn(m_turnIndex, m_turnIndex - 1)) {
+            ++m_turnIndex;
+        }
         if (m_turnIndex >= size) {
             m_turnIndex = 0;
             ++m_round;
+            if (m_rerollRoller && !rerolled) {
+                rollAll(*m_rerollRoller, m_rerollMode);
+                rerolled = true;
+            }
         }
         ++attempts;
         if (!m_skipUnconscious) {
             break;
         }
-    } while (attempts <= size && !m_combatants[m_turnIndex].conscious);
+    } while (attempts <= size && !turnIsConscious(m_turnIndex));
 
+    commitVersion();
     return true;
 }
 
 bool TurnManager::rewindTurn() {
+    TRACE_SCOPE("TurnManager::rewindTurn");
     if (m_combatants.isEmpty()) {
         return false;
     }
 
     const int size = m_combatants.size();
     int attempts = 0;
+    m_turnIndex = turnStart(m_turnIndex);
     do {
         --m_turnIndex;
         if (m_turnIndex < 0) {
             m_turnIndex = size - 1;
             m_round = std::max(1, m_round - 1);
         }
+        m_turnIndex = turnStart(m_turnIndex);
         ++attempts;
         if (!m_skipUnconscious) {
             break;
         }
-    } while (attempts <= size && !m_combatants[m_turnIndex].conscious);
+    } while (attempts <= size && !turnIsConscious(m_turnIndex));
 
+    commitVersion();
     return true;
 }
 
 void TurnManager::forEachCombatant(const std::function<void(Combatant &)> &visitor) {
+    TRACE_SCOPE("TurnManager::forEachCombatant");
     for (auto &combatant : m_combatants) {
         visitor(combatant);
     }
+    m_allDirty = true;
+    commitVersion();
+}
+
+void TurnManager::rerollInitiative(DiceRoller &roller, RollMode mode) {
+    TRACE_SCOPE("TurnManager::rerollInitiative");
+    if (m_combatants.isEmpty()) {
+        return;
+    }
+    rollAll(roller, mode);
+    normalizeTurnIndex();
+    commitVersion();
+}
+
+void TurnManager::rollAll(DiceRoller &roller, RollMode mode) {
+    const int size = m_combatants.size();
+    ScratchArena scratch;
+    auto modifiers = scratch.vector<int>(size);
+    auto totals = scratch.vector<int>(size);
+    auto tiebreaks = scratch.vector<int>(size);
+    for (int row = 0; row < size; ++row) {
+        modifiers[row] = m_combatants.at(row).dexMod;
+    }
+    roller.rollD20Many(mode, modifiers.data(), totals.data(), size);
+    roller.rollTiebreakMany(tiebreaks.data(), size);
+    for (int row = 0; row < size; ++row) {
+        m_combatants[row].initiative = totals[row];
+        m_combatants[row].tiebreak = tiebreaks[row];
+    }
+    // One roll per cohort; sortInPlace() hands it to the members.
+    for (auto &cohort : m_version.cohorts) {
+        cohort.initiative = roller.rollD20(mode, cohort.dexMod);
+        m_cohortsDirty = true;
+    }
+    m_allDirty = true;
+    sortInPlace();
+}
+
+void TurnManager::setTurnState(int round, int turnIndex) {
+    TRACE_SCOPE("TurnManager::setTurnState");
+    m_round = round;
+    m_turnIndex = turnIndex;
+    normalizeTurnIndex();
+    commitVersion();
 }
 
 void TurnManager::resetInitiativeOrder() {
+    TRACE_SCOPE("TurnManager::resetInitiativeOrder");
     m_round = 1;
     m_turnIndex = 0;
-    sortCombatants();
+    sortInPlace();
+    commitVersion();
 }
 
 void TurnManager::decrementConditionsForCurrent() {
+    TRACE_SCOPE("TurnManager::decrementConditionsForCurrent");
     if (m_combatants.isEmpty()) {
         return;
     }
-    Combatant &current = m_combatants[m_turnIndex];
-    for (auto &condition : current.conditions) {
+    if (expireConditions(m_combatants[m_turnIndex])) {
+        markDirty(m_turnIndex);
+        commitVersion();
+    }
+}
+
+bool TurnManager::expireConditions(Combatant &combatant) {
+    const bool mobChanged = combatant.mob.expireConditions();
+    if (combatant.conditions.isEmpty()) {
+        return mobChanged;
+    }
+    for (auto &condition : combatant.conditions) {
         if (condition.remainingRounds > 0) {
             --condition.remainingRounds;
         }
     }
-    current.conditions.erase(std::remove_if(current.conditions.begin(), current.conditions.end(), [](const Condition &c) {
+    combatant.conditions.erase(std::remove_if(combatant.conditions.begin(), combatant.conditions.end(), [](const Condition &c) {
         return c.isExpired();
-    }), current.conditions.end());
+    }), combatant.conditions.end());
+    return true;
+}
+
+void TurnManager::restoreVersion(const EncounterVersion &version) {
+    TRACE_SCOPE("TurnManager::restoreVersion");
+    m_version = version;
+    m_combatants = version.toList();
+    m_rowSlots.clear();
+    m_rowSlots.reserve(version.size());
+    version.order.forEach([this](int slot) { m_rowSlots.push_back(slot); });
+    m_freeSlots.clear();
+    for (int slot = version.storage.size() - 1; slot >= 0; --slot) {
+        if (!version.storage.at(slot)) {
+            m_freeSlots.push_back(slot);
+        }
+    }
+    m_round = version.round;
+    m_turnIndex = version.turnIndex;
+    m_dirtySlots.clear();
+    m_allDirty = false;
+    m_orderDirty = true;
+    m_versionChanged = true;
+    m_cohortsDirty = true;
+    // A restore can swap any slot, so it resets change tracking like setCombatants.
+    m_pendingRemovals.clear();
+    m_changeLog.clear();
+    m_generationById.clear();
+    m_changeFloor = m_serial + 1;
+    commitVersion();
+}
+
+void TurnManager::markDirty(int row) {
+    m_dirtySlots.insert(m_rowSlots.at(row));
+}
+
+int TurnManager::acquireSlot() {
+    if (!m_freeSlots.isEmpty()) {
+        return m_freeSlots.takeLast();
+    }
+    m_version.storage = m_version.storage.pushBack(nullptr);
+    return m_version.storage.size() - 1;
+}
+
+void TurnManager::releaseSlot(int slot) {
+    m_version.storage = m_version.storage.set(slot, nullptr);
+    m_freeSlots.push_back(slot);
+    m_dirtySlots.remove(slot);
+    m_versionChanged = true;
+}
+
+void TurnManager::commitVersion() {
+    TRACE_SCOPE("TurnManager::commitVersion");
+    bool changed = m_versionChanged;
+    const int size = m_combatants.size();
+    const quint64 next = m_serial + 1;
+    const auto changesBefore = m_changeLog.size();
+    for (const int id : std::as_const(m_pendingRemovals)) {
+        recordChange(id, true);
+        if (m_eventLog) {
+            m_eventLog->append(CombatEventType::Removed, m_round, m_turnIndex, id);
+        }
+    }
+    m_pendingRemovals.clear();
+
+    if (m_orderDirty) {
+        int differing = std::abs(m_version.order.size() - size);
+        for (int row = 0; row < std::min(size, m_version.order.size()); ++row) {
+            if (m_version.order.at(row) != m_rowSlots.at(row)) {
+                ++differing;
+            }
+        }
+        if (differing * 8 > size) {
+            // A large reshuffle shares little anyway; rebuilding is cheaper than path-copying.
+            m_version.order = PersistentVector<int>::build(m_rowSlots.cbegin(), m_rowSlots.cend());
+        } else if (differing > 0) {
+            for (int row = 0; row < size; ++row) {
+                if (row >= m_version.order.size()) {
+                    m_version.order = m_version.order.pushBack(m_rowSlots.at(row));
+                } else if (m_version.order.at(row) != m_rowSlots.at(row)) {
+                    m_version.order = m_version.order.set(row, m_rowSlots.at(row));
+                }
+            }
+            while (m_version.order.size() > size) {
+                m_version.order = m_version.order.popBack();
+            }
+        }
+        if (differing > 0) {
+            m_orderGeneration = next;
+            changed = true;
+        }
+
+        m_rowBySlot.fill(-1, m_version.storage.size());
+        m_rowById.clear();
+        m_rowById.reserve(size);
+        for (int row = size - 1; row >= 0; --row) {
+            m_rowBySlot[m_rowSlots.at(row)] = row;
+            m_rowById.insert(m_combatants.at(row).id, row);
+        }
+        m_orderDirty = false;
+    }
+
+    if (m_allDirty) {
+        for (int row = 0; row < size; ++row) {
+            const int slot = m_rowSlots.at(row);
+            const auto &stored = m_version.storage.at(slot);
+            if (!stored || !(*stored == m_combatants.at(row))) {
+                if (m_eventLog) {
+                    logChanges(stored.get(), m_combatants.at(row));
+                }
+                m_version.storage = m_version.storage.set(slot, arena::makePooled<const Combatant>(m_combatants.at(row)));
+                recordChange(m_combatants.at(row).id, false);
+                changed = true;
+            }
+        }
+    } else {
+        for (const int slot : std::as_const(m_dirtySlots)) {
+            const int row = m_rowBySlot.value(slot, -1);
+            if (row >= 0) {
+                if (m_eventLog) {
+                    logChanges(m_version.storage.at(slot).get(), m_combatants.at(row));
+                }
+                m_version.storage = m_version.storage.set(slot, arena::makePooled<const Combatant>(m_combatants.at(row)));
+                recordChange(m_combatants.at(row).id, false);
+                changed = true;
+            }
+        }
+    }
+    m_dirtySlots.clear();
+    m_allDirty = false;
+    m_versionChanged = false;
+    if (m_cohortsDirty) {
+        m_cohortGeneration = next;
+        m_cohortsDirty = false;
+        changed = true;
+    }
+
+    if (m_version.round != m_round || m_version.turnIndex != m_turnIndex) {
+        if (m_eventLog && m_turnIndex >= 0 && m_turnIndex < size) {
+            m_eventLog->append(CombatEventType::TurnStarted, m_round, m_turnIndex, m_combatants.at(m_turnIndex).id, m_version.round, m_round);
+        }
+        m_version.round = m_round;
+        m_version.turnIndex = m_turnIndex;
+        m_turnGeneration = next;
+        changed = true;
+    }
+    if (!changed) {
+        m_changeLog.resize(changesBefore);
+        return;
+    }
+    m_version.serial = ++m_serial;
+    m_timeline.append(m_version);
+    m_snapshots.publish(arena::makePooled<const EncounterVersion>(m_version));
+
+    // Keep the log proportional to the encounter; older queries get a reset.
+    const std::size_t limit = std::max<std::size_t>(1024, 4 * static_cast<std::size_t>(size));
+    if (m_changeLog.size() > limit) {
+        const auto drop = m_changeLog.size() - limit / 2;
+        m_changeFloor = std::max(m_changeFloor, m_changeLog[drop - 1].generation);
+        m_changeLog.erase(m_changeLog.begin(), m_changeLog.begin() + static_cast<std::ptrdiff_t>(drop));
+    }
+}
+
+void TurnManager::recordChange(int id, bool removed) {
+    const quint64 generation = m_serial + 1;
+    m_changeLog.push_back({generation, id, removed});
+    if (removed) {
+        m_generationById.remove(id);
+    } else {
+        m_generationById.insert(id, generation);
+    }
+}
+
+void TurnManager::logChanges(const Combatant *before, const Combatant &after) const {
+    const auto log = [&](CombatEventType type, int from, int to, const QString &text = QString()) {
+        m_eventLog->append(type, m_round, m_turnIndex, after.id, from, to, text);
+    };
+    // A storage slot may be reused by a new combatant within one commit.
+    if (!before || before->id != after.id) {
+        log(CombatEventType::Added, after.initiative, after.isPC, after.name.toString());
+        return;
+    }
+    if (before->initiative != after.initiative) {
+        log(CombatEventType::InitiativeChanged, before->initiative, after.initiative);
+    }
+    if (before->hp != after.hp) {
+        log(CombatEventType::HpChanged, before->hp, after.hp);
+    }
+    if (before->conscious != after.conscious) {
+        log(CombatEventType::ConsciousChanged, before->conscious, after.conscious);
+    }
+    const auto packSaves = [](const DeathSaves &saves) {
+        return (saves.successes & 0xff) | (saves.failures & 0xff) << 8 | int(saves.dead) << 16 | int(saves.stable) << 17;
+    };
+    if (packSaves(before->deathSaves) != packSaves(after.deathSaves)) {
+        log(CombatEventType::DeathSavesChanged, packSaves(before->deathSaves), packSaves(after.deathSaves));
+    }
+    const auto hasCondition = [](const ConditionList &list, ConditionName name) {
+        return std::any_of(list.begin(), list.end(), [name](const Condition &condition) { return condition.name == name; });
+    };
+    for (const auto &condition : before->conditions) {
+        if (!hasCondition(after.conditions, condition.name)) {
+            log(CombatEventType::ConditionEnded, condition.remainingRounds, 0, condition.name.toString());
+        }
+    }
+    for (const auto &condition : after.conditions) {
+        if (!hasCondition(before->conditions, condition.name)) {
+            log(CombatEventType::ConditionAdded, 0, condition.remainingRounds, condition.name.toString());
+        }
+    }
+}
+
+EncounterChanges TurnManager::changesSince(quint64 generation) const {
+    EncounterChanges changes;
+    changes.generation = m_serial;
+    if (generation >= m_serial) {
+        return changes;
+    }
+    if (generation < m_changeFloor) {
+        changes.reset = true;
+        return changes;
+    }
+    changes.orderChanged = m_orderGeneration > generation;
+    changes.turnChanged = m_turnGeneration > generation;
+    changes.cohortsChanged = m_cohortGeneration > generation;
+    auto it = std::upper_bound(m_changeLog.cbegin(), m_changeLog.cend(), generation, [](quint64 value, const ChangeRecord &record) {
+        return value < record.generation;
+    });
+    // Only the last record per id matters: a combatant added and then removed
+    // is reported as removed, one removed and re-added as changed.
+    QHash<int, bool> latest;
+    QVector<int> seen;
+    for (; it != m_changeLog.cend(); ++it) {
+        if (!latest.contains(it->id)) {
+            seen.push_back(it->id);
+        }
+        latest.insert(it->id, it->removed);
+    }
+    for (const int id : std::as_const(seen)) {
+        if (latest.value(id)) {
+            changes.removedIds.push_back(id);
+        } else {
+            changes.changedIds.push_back(id);
+        }
+    }
+    return changes;
 }
 
 void TurnManager::normalizeTurnIndex() {
@@ -154,4 +922,3 @@ void TurnManager::normalizeTurnIndex() {
         m_round = 1;
     }
 }
-
@@ -1,28 +1,106 @@
 #pragma once
 
 #include "Combatant.h"
+#include "EncounterTimeline.h"
+#include "InitiativeRules.h"
+#include "utils/DiceRoller.h"
+#include "utils/SnapshotPublisher.h"
 
+#include <QHash>
+#include <QSet>
 #include <QVector>
 #include <functional>
 #include <optional>
+#include <vector>
+
+class CombatLog;
+
+// What changed after a given generation. When the history needed to answer
+// has been pruned, reset is set and callers must treat everything as changed.
+struct EncounterChanges {
+    quint64 generation = 0;
+    bool reset = false;
+    bool orderChanged = false;
+    bool turnChanged = false;
+    bool cohortsChanged = false;
+    QVector<int> changedIds;
+    QVector<int> removedIds;
+
+    bool isEmpty() const noexcept {
+        return !reset && !orderChanged && !turnChanged && !cohortsChanged && changedIds.isEmpty() && removedIds.isEmpty();
+    }
+};
+
+enum class AdvanceMode {
+    PerMember, // every combatant takes its own turn
+    PerCohort  // a cohort's members share one turn
+};
 
 class TurnManager {
 public:
     using CombatantList = QVector<Combatant>;
 
-    CombatantList &combatants();
+    // Read-only; all writes go through the mutators below so that every change
+    // is recorded as a new EncounterVersion.
     const CombatantList &combatants() const;
 
-    void setCombatants(CombatantList list);
+    // Replaces the roster, cohorts included.
+    void setCombatants(CombatantList list, QVector<Cohort> cohorts = {});
 
     void addCombatant(const Combatant &combatant);
     bool removeCombatant(int id);
+
+    // Batch variants: one sort and one recorded version per call.
+    void addCombatants(const CombatantList &list);
+    int removeCombatants(const QVector<int> &ids);
+    int updateCombatants(const QVector<int> &ids, const std::function<void(int position, Combatant &)> &mutator);
+
     std::optional<Combatant> combatantById(int id) const;
+    int indexOf(int id) const;
+
+    // Applies mutator to the combatant with the given id and re-sorts when an
+    // ordering field changed. Returns false if the id is unknown.
+    bool updateCombatant(int id, const std::function<void(Combatant &)> &mutator);
 
     void sortCombatants();
 
+    // Cohorts sort as one entry keyed by their own initiative, dex and name;
+    // members take the cohort's initiative and keep their relative order, so
+    // re-sorting costs one comparison sort over cohorts and solo combatants.
+    const QVector<Cohort> &cohorts() const noexcept { return m_version.cohorts; }
+    std::optional<Cohort> cohortById(int id) const;
+    // Inserts or replaces by id; ids must be positive.
+    void setCohort(const Cohort &cohort);
+    bool setCohortInitiative(int id, int initiative);
+    int nextCohortId() const;
+    // Members become individual combatants again.
+    bool removeCohort(int id);
+
+    void setAdvanceMode(AdvanceMode mode) noexcept { m_advanceMode = mode; }
+    AdvanceMode advanceMode() const noexcept { return m_advanceMode; }
+
+    // Tie-break house rules. Changing them re-sorts and records a version.
+    void setInitiativeRules(InitiativeRules rules);
+    InitiativeRules initiativeRules() const noexcept { return m_rules; }
+
+    // Rolls initiative and tiebreak for everyone in one batch and re-sorts
+    // once. Lists of kRadixSortThreshold or more sort with a radix pass.
+    void rerollInitiative(DiceRoller &roller, RollMode mode);
+    // When set, every advanceTurn() into a new round re-rolls first. The
+    // roller must outlive the manager or be cleared with nullptr.
+    void setRoundStartReroll(DiceRoller *roller, RollMode mode = RollMode::Normal) noexcept {
+        m_rerollRoller = roller;
+        m_rerollMode = mode;
+    }
+    bool roundStartReroll() const noexcept { return m_rerollRoller != nullptr; }
+
+    static constexpr int kRadixSortThreshold = 1024;
+
     int round() const noexcept { return m_round; }
     int turnIndex() const noexcept { return m_turnIndex; }
+    // Moves the turn marker, e.g. to a saved position, and records a version.
+    // Out-of-range values are clamped like after a removal.
+    void setTurnState(int round, int turnIndex);
 
     bool advanceTurn();
     bool rewindTurn();
@@ -36,12 +114,91 @@ public:
     void setSkipUnconscious(bool skip) noexcept { m_skipUnconscious = skip; }
     bool skipUnconscious() const noexcept { return m_skipUnconscious; }
 
+    // Committed changes and turn starts are appended to log, which must
+    // outlive this manager or be unset first. setCombatants() logs the start
+    // of a new encounter.
+    void setEventLog(CombatLog *log) noexcept { m_eventLog = log; }
+    CombatLog *eventLog() const noexcept { return m_eventLog; }
+
+    const EncounterVersion &currentVersion() const noexcept { return m_version; }
+    const EncounterTimeline &timeline() const noexcept { return m_timeline; }
+    EncounterTimeline &timeline() noexcept { return m_timeline; }
+    void restoreVersion(const EncounterVersion &version);
+
+    // The latest committed version, published after every mutator. This is
+    // the one member that is safe to call from any thread; readers get an
+    // immutable version that stays valid for as long as they hold it.
+    std::shared_ptr<const EncounterVersion> snapshot() const { return m_snapshots.acquire(); }
+
+    // Monotonic counters bumped by every mutator that changes something. The
+    // encounter generation equals the serial of the current version.
+    quint64 generation() const noexcept { return m_serial; }
+    quint64 generationOf(int id) const { return m_generationById.value(id, 0); }
+    EncounterChanges changesSince(quint64 generation) const;
+
 private:
+    struct ChangeRecord {
+        quint64 generation;
+        int id;
+        bool removed;
+    };
+
     void normalizeTurnIndex();
+    void sortInPlace();
+    // Returns whether any combatant belongs to an existing cohort.
+    bool syncCohortMembers();
+    bool sharesTurn(int row, int previous) const;
+    bool turnIsConscious(int row) const;
+    int turnStart(int row) const;
+    const std::vector<quint32> &nameRanksBySlot();
+    void rollAll(DiceRoller &roller, RollMode mode);
+    bool expireConditions(Combatant &combatant);
+    void markDirty(int row);
+    int acquireSlot();
+    void releaseSlot(int slot);
+    void commitVersion();
+    void recordChange(int id, bool removed);
+    void logChanges(const Combatant *before, const Combatant &after) const;
 
     CombatantList m_combatants;
     int m_round = 1;
     int m_turnIndex = 0;
     bool m_skipUnconscious = true;
+    InitiativeRules m_rules = InitiativeRules::Standard;
+    AdvanceMode m_advanceMode = AdvanceMode::PerMember;
+    DiceRoller *m_rerollRoller = nullptr;
+    RollMode m_rerollMode = RollMode::Normal;
+    CombatLog *m_eventLog = nullptr;
+
+    // Case-folded name order per storage slot for the radix sort. Rebuilt when
+    // a row's name differs from the one its slot was ranked under.
+    std::vector<CombatantName> m_rankedNames;
+    std::vector<quint32> m_nameRanks;
+
+    // Versioning state. m_rowSlots runs parallel to m_combatants and names the
+    // storage slot of each row in m_version.
+    EncounterVersion m_version;
+    EncounterTimeline m_timeline;
+    quint64 m_serial = 0;
+    QVector<int> m_rowSlots;
+    QVector<int> m_rowBySlot;
+    QVector<int> m_freeSlots;
+    QHash<int, int> m_rowById;
+    QSet<int> m_dirtySlots;
+    bool m_allDirty = false;
+    bool m_orderDirty = false;
+    bool m_versionChanged = false;
+    bool m_cohortsDirty = false;
+
+    // Change tracking, in generation order. Entries at or below m_changeFloor
+    // have been pruned.
+    std::vector<ChangeRecord> m_changeLog;
+    QVector<int> m_pendingRemovals;
+    QHash<int, quint64> m_generationById;
+    quint64 m_changeFloor = 0;
+    quint64 m_orderGeneration = 0;
+    quint64 m_turnGeneration = 0;
+    quint64 m_cohortGeneration = 0;
+
+    SnapshotPublisher<EncounterVersion> m_snapshots;
 };
-
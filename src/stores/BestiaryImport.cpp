@@ -0,0 +1,445 @@
+#include "BestiaryImport.h"
+
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QThreadPool>
+#include <QtAlgorithms>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <optional>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DND_BESTIARY_SSE2 1
+#endif
+
+#include "utils/DiceRoller.h"
+#include "utils/Trace.h"
+
+namespace {
+
+constexpr qint64 kScanChunk = qint64(1) << 20;
+constexpr int kRowBatch = 4096;
+
+// The newlines of one chunk of the file, each stored as offset * 2 plus the
+// parity of the quotes before it within the chunk, and the chunk's own quote
+// parity. Chunks are scanned independently; the parities are chained after.
+struct ScanChunk {
+    qint64 begin = 0;
+    qint64 end = 0;
+    QVector<qint64> newlines;
+    bool quoteParity = false;
+};
+
+void scanChunk(const char *data, ScanChunk &chunk) {
+    bool inQuotes = false;
+    qint64 i = chunk.begin;
+#ifdef DND_BESTIARY_SSE2
+    // Sixteen bytes per step; blocks with neither byte are skipped outright.
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i quote = _mm_set1_epi8('"');
+    for (; i + 16 <= chunk.end; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const quint32 quotes = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quote)));
+        quint32 hits = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline))) | quotes;
+        while (hits != 0) {
+            const quint32 bit = qCountTrailingZeroBits(hits);
+            if (quotes & (1u << bit)) {
+                inQuotes = !inQuotes;
+            } else {
+                chunk.newlines.push_back((i + bit) * 2 + (inQuotes ? 1 : 0));
+            }
+            hits &= hits - 1;
+        }
+    }
+#endif
+    for (; i < chunk.end; ++i) {
+        if (data[i] == '"') {
+            inQuotes = !inQuotes;
+        } else if (data[i] == '\n') {
+            chunk.newlines.push_back(i * 2 + (inQuotes ? 1 : 0));
+        }
+    }
+    chunk.quoteParity = inQuotes;
+}
+
+// Start offset of every record, followed by the end of the data. A newline
+// inside a quoted field does not end a record.
+QVector<qint64> findRecords(const char *data, qint64 begin, qint64 size) {
+    QVector<ScanChunk> chunks;
+    for (qint64 start = begin; start < size; start += kScanChunk) {
+        chunks.push_back({start, std::min(size, start + kScanChunk), {}, false});
+    }
+    QtConcurrent::blockingMap(chunks, [data](ScanChunk &chunk) { scanChunk(data, chunk); });
+    QVector<qint64> records{begin};
+    bool parity = false;
+    for (const auto &chunk : std::as_const(chunks)) {
+        for (const qint64 entry : chunk.newlines) {
+            if (bool(entry & 1) == parity) {
+                records.push_back((entry >> 1) + 1);
+            }
+        }
+        parity = parity != chunk.quoteParity;
+    }
+    if (records.last() < size) {
+        records.push_back(size);
+    }
+    return records;
+}
+
+struct Field {
+    const char *data = nullptr;
+    int size = 0;
+    bool escaped = false;
+};
+
+// Splits one record, without its line ending, at delimiter. Quoted fields
+// keep their doubled quotes until fieldText().
+void splitRecord(const char *begin, const char *end, char delimiter, QVector<Field> &fields) {
+    fields.clear();
+    const char *p = begin;
+    while (true) {
+        if (p < end && *p == '"') {
+            const char *start = ++p;
+            bool escaped = false;
+            while (p < end) {
+                if (*p == '"') {
+                    if (p + 1 < end && p[1] == '"') {
+                        escaped = true;
+                        p += 2;
+                        continue;
+                    }
+                    break;
+                }
+                ++p;
+            }
+            fields.push_back({start, int(p - start), escaped});
+            // Anything between the closing quote and the delimiter is dropped.
+            while (p < end && *p != delimiter) {
+                ++p;
+            }
+        } else {
+            const char *start = p;
+            const void *hit = std::memchr(p, delimiter, std::size_t(end - p));
+            p = hit ? static_cast<const char *>(hit) : end;
+            fields.push_back({start, int(p - start), false});
+        }
+        if (p >= end) {
+            break;
+        }
+        ++p;
+    }
+}
+
+QString fieldText(const Field &field) {
+    if (!field.escaped) {
+        return QString::fromUtf8(field.data, field.size).trimmed();
+    }
+    return QString::fromUtf8(QByteArray(field.data, field.size).replace("\"\"", "\"")).trimmed();
+}
+
+bool isBlank(const Field &field) {
+    return std::all_of(field.data, field.data + field.size, [](char ch) { return ch == ' ' || ch == '\t'; });
+}
+
+// Leading integer with an optional sign; trailing text such as
+// "15 (natural armor)" is ignored.
+bool parseLeadingInt(const Field &field, int &value) {
+    const char *p = field.data;
+    const char *end = field.data + field.size;
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    bool negative = false;
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = *p == '-';
+        ++p;
+    }
+    const char *digits = p;
+    qint64 result = 0;
+    while (p < end && *p >= '0' && *p <= '9' && result < (qint64(1) << 31)) {
+        result = result * 10 + (*p - '0');
+        ++p;
+    }
+    if (p == digits || result >= (qint64(1) << 31)) {
+        return false;
+    }
+    value = int(negative ? -result : result);
+    return true;
+}
+
+std::optional<int> hitPoints(const QString &text) {
+    if (const auto expression = DiceExpression::parse(text)) {
+        return expression->count * (expression->sides + 1) / 2 + expression->bonus;
+    }
+    const int paren = text.indexOf(QLatin1Char('('));
+    if (paren > 0) {
+        bool ok = false;
+        const int value = text.left(paren).trimmed().toInt(&ok);
+        if (ok) {
+            return value;
+        }
+    }
+    return std::nullopt;
+}
+
+bool isTruthy(const QString &text) {
+    static const QSet<QString> kTrue{QStringLiteral("1"), QStringLiteral("true"), QStringLiteral("yes"), QStringLiteral("y"), QStringLiteral("pc"),
+                                     QStringLiteral("x")};
+    return kTrue.contains(text.toCaseFolded());
+}
+
+struct ColumnIndexes {
+    int name = -1;
+    int dex = -1;
+    int hp = -1;
+    int ac = -1;
+    int tags = -1;
+    int notes = -1;
+    int isPC = -1;
+    int group = -1;
+    int count = -1;
+};
+
+int resolveColumn(const QString &setting, const QStringList &header) {
+    if (setting.isEmpty()) {
+        return -1;
+    }
+    bool isNumber = false;
+    const int number = setting.toInt(&isNumber);
+    if (isNumber) {
+        return number >= 1 ? number - 1 : -1;
+    }
+    for (int i = 0; i < header.size(); ++i) {
+        if (header.at(i).compare(setting, Qt::CaseInsensitive) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+struct RowBatch {
+    int first = 0;
+    int last = 0;
+    int rows = 0;
+    QVector<RosterCharacter> characters;
+    QVector<std::pair<QString, RosterGroupEntry>> groupEntries;
+    QVector<BestiaryRowError> errors;
+};
+
+// Fills character, and group and count when the row names a group. Returns
+// why the row was skipped, or an empty string.
+QString parseRecord(const QVector<Field> &fields, const ColumnIndexes &columns, const BestiaryColumns &options, RosterCharacter &character,
+                    QString &group, int &count) {
+    const auto field = [&fields](int column) -> const Field * {
+        return column >= 0 && column < fields.size() && !isBlank(fields.at(column)) ? &fields.at(column) : nullptr;
+    };
+    character = RosterCharacter();
+    if (const auto *name = field(columns.name)) {
+        character.name = fieldText(*name);
+    }
+    if (character.name.isEmpty()) {
+        return QStringLiteral("missing name");
+    }
+    int value = 0;
+    if (const auto *dex = field(columns.dex)) {
+        if (!parseLeadingInt(*dex, value)) {
+            return QStringLiteral("bad dex \"%1\"").arg(fieldText(*dex));
+        }
+        character.dexMod = options.dexIsScore ? int(std::floor((value - 10) / 2.0)) : value;
+    }
+    if (const auto *hp = field(columns.hp)) {
+        // Plain numbers, the common case, skip the formula parser.
+        const bool plain = std::all_of(hp->data, hp->data + hp->size, [](char ch) { return (ch >= '0' && ch <= '9') || ch == ' '; });
+        if (plain && parseLeadingInt(*hp, value)) {
+            character.defaultHP = value;
+        } else {
+            const auto text = fieldText(*hp);
+            const auto parsed = hitPoints(text);
+            if (!parsed) {
+                return QStringLiteral("bad HP \"%1\"").arg(text);
+            }
+            character.defaultHP = *parsed;
+        }
+    }
+    if (const auto *ac = field(columns.ac)) {
+        if (!parseLeadingInt(*ac, value)) {
+            return QStringLiteral("bad AC \"%1\"").arg(fieldText(*ac));
+        }
+        character.defaultAC = value;
+    }
+    if (const auto *tags = field(columns.tags)) {
+        for (const auto &tag : fieldText(*tags).split(options.tagSeparator)) {
+            const auto trimmed = tag.trimmed();
+            if (!trimmed.isEmpty()) {
+                character.tags.insert(trimmed);
+            }
+        }
+    }
+    if (const auto *notes = field(columns.notes)) {
+        character.defaultNotes = fieldText(*notes);
+    }
+    if (const auto *isPC = field(columns.isPC)) {
+        character.isPC = isTruthy(fieldText(*isPC));
+    }
+    group.clear();
+    count = 1;
+    if (const auto *groupField = field(columns.group)) {
+        group = fieldText(*groupField);
+        if (const auto *countField = field(columns.count)) {
+            if (!parseLeadingInt(*countField, count) || count < 1) {
+                return QStringLiteral("bad count \"%1\"").arg(fieldText(*countField));
+            }
+        }
+    }
+    return QString();
+}
+
+void parseBatch(const char *data, const QVector<qint64> &records, const ColumnIndexes &columns, const BestiaryColumns &options, char delimiter,
+                int rowOffset, RowBatch &batch) {
+    QVector<Field> fields;
+    RosterCharacter character;
+    QString group;
+    int count = 1;
+    for (int record = batch.first; record < batch.last; ++record) {
+        const char *begin = data + records.at(record);
+        const char *end = data + records.at(record + 1);
+        while (end > begin && (end[-1] == '\n' || end[-1] == '\r')) {
+            --end;
+        }
+        if (begin == end) {
+            continue;
+        }
+        splitRecord(begin, end, delimiter, fields);
+        ++batch.rows;
+        const auto error = parseRecord(fields, columns, options, character, group, count);
+        if (!error.isEmpty()) {
+            batch.errors.push_back({record + rowOffset, error});
+            continue;
+        }
+        if (!group.isEmpty()) {
+            batch.groupEntries.push_back({group, RosterGroupEntry{character.name, count}});
+        }
+        batch.characters.push_back(std::move(character));
+    }
+}
+
+} // namespace
+
+BestiaryResult BestiaryImport::readFile(const QString &path, const BestiaryColumns &columns, const StoreProgress &progress) {
+    TRACE_SCOPE("BestiaryImport::readFile");
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        BestiaryResult result;
+        result.error = QStringLiteral("cannot open %1").arg(path);
+        return result;
+    }
+    const qint64 size = file.size();
+    if (size == 0) {
+        return parse(nullptr, 0, columns, progress);
+    }
+    // Mapping fails on some file systems and devices; read it whole then.
+    if (uchar *mapped = file.map(0, size)) {
+        auto result = parse(reinterpret_cast<const char *>(mapped), size, columns, progress);
+        file.unmap(mapped);
+        return result;
+    }
+    const auto bytes = file.readAll();
+    return parse(bytes.constData(), bytes.size(), columns, progress);
+}
+
+BestiaryResult BestiaryImport::parse(const char *data, qint64 size, const BestiaryColumns &columns, const StoreProgress &progress) {
+    TRACE_SCOPE("BestiaryImport::parse");
+    BestiaryResult result;
+    qint64 begin = 0;
+    if (size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        begin = 3;
+    }
+    const auto records = findRecords(data, begin, size);
+    if (records.size() < 2) {
+        result.error = QStringLiteral("no rows");
+        return result;
+    }
+
+    const char *firstBegin = data + records.at(0);
+    const char *firstEnd = data + records.at(1);
+    while (firstEnd > firstBegin && (firstEnd[-1] == '\n' || firstEnd[-1] == '\r')) {
+        --firstEnd;
+    }
+    char delimiter = columns.delimiter;
+    if (delimiter == 0) {
+        const auto tabs = std::count(firstBegin, firstEnd, '\t');
+        const auto commas = std::count(firstBegin, firstEnd, ',');
+        delimiter = tabs > commas ? '\t' : ',';
+    }
+    QStringList header;
+    if (columns.hasHeader) {
+        QVector<Field> fields;
+        splitRecord(firstBegin, firstEnd, delimiter, fields);
+        for (const auto &field : std::as_const(fields)) {
+            header.append(fieldText(field));
+        }
+    }
+    ColumnIndexes indexes;
+    indexes.name = resolveColumn(columns.name, header);
+    indexes.dex = resolveColumn(columns.dex, header);
+    indexes.hp = resolveColumn(columns.hp, header);
+    indexes.ac = resolveColumn(columns.ac, header);
+    indexes.tags = resolveColumn(columns.tags, header);
+    indexes.notes = resolveColumn(columns.notes, header);
+    indexes.isPC = resolveColumn(columns.isPC, header);
+    indexes.group = resolveColumn(columns.group, header);
+    indexes.count = resolveColumn(columns.count, header);
+    if (indexes.name < 0) {
+        result.error = QStringLiteral("no \"%1\" column").arg(columns.name);
+        return result;
+    }
+
+    // Records are parsed in batches on the pool, a wave at a time so progress
+    // and cancellation are checked on the calling thread in between.
+    const int firstRecord = columns.hasHeader ? 1 : 0;
+    const int recordCount = static_cast<int>(records.size()) - 1;
+    QVector<RowBatch> batches;
+    for (int first = firstRecord; first < recordCount; first += kRowBatch) {
+        RowBatch batch;
+        batch.first = first;
+        batch.last = std::min(recordCount, first + kRowBatch);
+        batches.push_back(std::move(batch));
+    }
+    const int total = recordCount - firstRecord;
+    const int wave = std::max(1, QThreadPool::globalInstance()->maxThreadCount()) * 2;
+    for (int start = 0; start < batches.size(); start += wave) {
+        if (progress && !progress(batches.at(start).first - firstRecord, total)) {
+            return BestiaryResult();
+        }
+        QtConcurrent::blockingMap(batches.begin() + start, batches.begin() + std::min<int>(batches.size(), start + wave),
+                                  [&](RowBatch &batch) { parseBatch(data, records, indexes, columns, delimiter, 1, batch); });
+    }
+    if (progress && !progress(total, total)) {
+        return BestiaryResult();
+    }
+
+    result.data.hasCharacters = true;
+    QHash<QString, int> groupPositions;
+    for (auto &batch : batches) {
+        result.rows += batch.rows;
+        result.data.characters += std::move(batch.characters);
+        result.errors += std::move(batch.errors);
+        for (auto &[group, entry] : batch.groupEntries) {
+            const auto key = group.toCaseFolded();
+            auto it = groupPositions.find(key);
+            if (it == groupPositions.end()) {
+                it = groupPositions.insert(key, result.data.groups.size());
+                result.data.groups.push_back(RosterGroup{group, {}});
+            }
+            result.data.groups[it.value()].entries.push_back(std::move(entry));
+        }
+    }
+    result.data.hasGroups = !result.data.groups.isEmpty();
+    return result;
+}
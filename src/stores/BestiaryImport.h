@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include "RosterStore.h"
+#include "StoreIo.h"
+
+// Which column feeds each roster field. An entry is a header name, matched
+// case-insensitively, or a 1-based column number. An empty entry, or a header
+// the file does not have, leaves the field at its default; only name is
+// required.
+struct BestiaryColumns {
+    QString name = QStringLiteral("name");
+    QString dex = QStringLiteral("dex");
+    // A flat value, "52 (8d10+8)", or a dice formula, which is averaged.
+    QString hp = QStringLiteral("hp");
+    QString ac = QStringLiteral("ac");
+    QString tags = QStringLiteral("tags");
+    QString notes = QStringLiteral("notes");
+    QString isPC = QStringLiteral("pc");
+    // A row naming a group puts count copies of its character in that group.
+    // Merging into a roster that already has the group keeps its other
+    // entries.
+    QString group = QStringLiteral("group");
+    QString count = QStringLiteral("count");
+
+    bool hasHeader = true;
+    // The dex column holds ability scores (14) rather than modifiers (+2).
+    bool dexIsScore = false;
+    // ',' or '\t'; 0 picks whichever the first line has more of.
+    char delimiter = 0;
+    QChar tagSeparator = QLatin1Char(';');
+};
+
+struct BestiaryRowError {
+    // 1-based record number in the file, the header included.
+    int row = 0;
+    QString message;
+};
+
+struct BestiaryResult {
+    RosterData data;
+    int rows = 0;
+    QVector<BestiaryRowError> errors;
+    // Set when nothing could be imported, e.g. the name column is missing.
+    QString error;
+};
+
+// Bulk CSV/TSV import into roster entries. The file is memory-mapped, record
+// boundaries come from a vectorized newline and quote scan, and records are
+// parsed in batches on the global pool. A bad row is reported and skipped.
+// Apply the result with RosterStore::merge().
+class BestiaryImport {
+public:
+    static BestiaryResult readFile(const QString &path, const BestiaryColumns &columns = {}, const StoreProgress &progress = {});
+    static BestiaryResult parse(const char *data, qint64 size, const BestiaryColumns &columns = {}, const StoreProgress &progress = {});
+};
@@ -0,0 +1,275 @@
+#include "CombatLog.h"
+
+#include <QDir>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr char kMagic[8] = {'D', 'N', 'D', 'C', 'L', 'O', 'G', '1'};
+
+struct SegmentHeader {
+    char magic[8];
+    quint32 recordSize;
+    quint32 count;
+    quint64 number;
+    quint64 reserved;
+};
+
+static_assert(sizeof(SegmentHeader) == 32, "records start 32 bytes into a segment");
+
+constexpr qint64 kSegmentBytes = qint64(sizeof(SegmentHeader)) + qint64(CombatLog::kRecordsPerSegment) * qint64(sizeof(CombatEvent));
+
+SegmentHeader *headerOf(uchar *data) {
+    return reinterpret_cast<SegmentHeader *>(data);
+}
+
+} // namespace
+
+CombatLog::CombatLog(QString directory)
+    : m_directory(std::move(directory)) {}
+
+CombatLog::~CombatLog() {
+    close();
+}
+
+bool CombatLog::open() {
+    close();
+    if (m_directory.isEmpty() || !QDir().mkpath(m_directory)) {
+        return false;
+    }
+    const QDir dir(m_directory);
+
+    // String table: length-prefixed UTF-8, id 0 is the empty string.
+    m_strings = {QString()};
+    m_stringIds.clear();
+    m_stringFile.setFileName(dir.filePath(QStringLiteral("strings.dat")));
+    if (m_stringFile.open(QIODevice::ReadOnly)) {
+        const QByteArray table = m_stringFile.readAll();
+        m_stringFile.close();
+        qsizetype offset = 0;
+        while (offset + qsizetype(sizeof(quint32)) <= table.size()) {
+            quint32 length = 0;
+            std::memcpy(&length, table.constData() + offset, sizeof(length));
+            offset += sizeof(length);
+            if (offset + qsizetype(length) > table.size()) {
+                break;
+            }
+            const auto text = QString::fromUtf8(table.constData() + offset, qsizetype(length));
+            m_stringIds.insert(text, quint32(m_strings.size()));
+            m_strings.push_back(text);
+            offset += length;
+        }
+    }
+    if (!m_stringFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return false;
+    }
+
+    QVector<quint64> numbers;
+    for (const auto &name : dir.entryList({QStringLiteral("segment-*.log")}, QDir::Files, QDir::Name)) {
+        bool ok = false;
+        const quint64 number = name.mid(8, name.size() - 12).toULongLong(&ok);
+        if (ok) {
+            numbers.push_back(number);
+        }
+    }
+    // Only the newest contiguous run of segments is usable.
+    int firstUsable = 0;
+    for (int i = 1; i < numbers.size(); ++i) {
+        if (numbers.at(i) != numbers.at(i - 1) + 1) {
+            firstUsable = i;
+        }
+    }
+    for (int i = firstUsable; i < numbers.size(); ++i) {
+        if (!mapSegment(numbers.at(i), false)) {
+            m_segments.clear();
+            break;
+        }
+    }
+    if (m_segments.empty() && !mapSegment(numbers.isEmpty() ? 0 : numbers.last() + 1, true)) {
+        return false;
+    }
+    const auto &last = m_segments.back();
+    m_end = last.number * kRecordsPerSegment + headerOf(last.data)->count;
+    m_open = true;
+    for (quint64 sequence = firstSequence(); sequence < m_end; ++sequence) {
+        index(*slot(sequence), sequence);
+    }
+    return true;
+}
+
+void CombatLog::close() {
+    for (auto &segment : m_segments) {
+        segment.file->unmap(segment.data);
+    }
+    m_segments.clear();
+    m_stringFile.close();
+    m_byCombatant.clear();
+    m_rounds.clear();
+    m_end = 0;
+    m_encounterStart = 0;
+    m_open = false;
+}
+
+void CombatLog::setMaxSegments(int segments) {
+    m_maxSegments = std::max(0, segments);
+    while (m_maxSegments > 0 && int(m_segments.size()) > m_maxSegments) {
+        dropOldestSegment();
+    }
+}
+
+void CombatLog::append(CombatEventType type, int round, int turnIndex, int combatantId, int before, int after, const QString &text) {
+    if (!m_open) {
+        return;
+    }
+    if (m_end == (m_segments.back().number + 1) * kRecordsPerSegment) {
+        if (!mapSegment(m_segments.back().number + 1, true)) {
+            return;
+        }
+        setMaxSegments(m_maxSegments);
+    }
+    CombatEvent event;
+    event.round = quint32(std::max(0, round));
+    event.type = type;
+    event.turnIndex = quint16(std::clamp(turnIndex, 0, 0xffff));
+    event.combatantId = combatantId;
+    event.before = before;
+    event.after = after;
+    event.text = text.isEmpty() ? 0 : intern(text);
+    std::memcpy(slot(m_end), &event, sizeof(event));
+    // The count is written after the record, so a reader never sees a torn one.
+    headerOf(m_segments.back().data)->count = quint32(m_end % kRecordsPerSegment) + 1;
+    index(event, m_end);
+    ++m_end;
+}
+
+quint64 CombatLog::firstSequence() const noexcept {
+    return m_segments.empty() ? m_end : m_segments.front().number * kRecordsPerSegment;
+}
+
+CombatEvent CombatLog::at(quint64 sequence) const {
+    Q_ASSERT(sequence >= firstSequence() && sequence < m_end);
+    CombatEvent event;
+    std::memcpy(&event, slot(sequence), sizeof(event));
+    return event;
+}
+
+QVector<CombatEvent> CombatLog::eventsFor(int combatantId, int firstRound, int lastRound, quint64 fromSequence) const {
+    QVector<CombatEvent> events;
+    const auto it = m_byCombatant.constFind(combatantId);
+    if (it == m_byCombatant.constEnd()) {
+        return events;
+    }
+    const auto &sequences = it.value();
+    const quint64 first = std::max(firstSequence(), fromSequence);
+    for (auto sequence = std::lower_bound(sequences.begin(), sequences.end(), first); sequence != sequences.end(); ++sequence) {
+        const auto event = at(*sequence);
+        if (int(event.round) >= firstRound && int(event.round) <= lastRound) {
+            events.push_back(event);
+        }
+    }
+    return events;
+}
+
+QVector<CombatEvent> CombatLog::eventsInRounds(int firstRound, int lastRound) const {
+    QVector<CombatEvent> events;
+    const quint64 first = firstSequence();
+    for (const auto &run : m_rounds) {
+        if (int(run.round) < firstRound || int(run.round) > lastRound || run.end <= first) {
+            continue;
+        }
+        for (quint64 sequence = std::max(run.first, first); sequence < run.end; ++sequence) {
+            events.push_back(at(sequence));
+        }
+    }
+    return events;
+}
+
+bool CombatLog::mapSegment(quint64 number, bool create) {
+    Segment segment;
+    segment.number = number;
+    segment.file = std::make_unique<QFile>(segmentPath(number));
+    if (!segment.file->open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    if (segment.file->size() != kSegmentBytes && (!create || !segment.file->resize(kSegmentBytes))) {
+        return false;
+    }
+    segment.data = segment.file->map(0, kSegmentBytes);
+    if (!segment.data) {
+        return false;
+    }
+    auto *header = headerOf(segment.data);
+    if (create) {
+        std::memcpy(header->magic, kMagic, sizeof(kMagic));
+        header->recordSize = sizeof(CombatEvent);
+        header->count = 0;
+        header->number = number;
+        header->reserved = 0;
+    } else if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->recordSize != sizeof(CombatEvent) || header->number != number
+               || header->count > kRecordsPerSegment) {
+        segment.file->unmap(segment.data);
+        return false;
+    }
+    m_segments.push_back(std::move(segment));
+    return true;
+}
+
+void CombatLog::dropOldestSegment() {
+    auto &oldest = m_segments.front();
+    oldest.file->unmap(oldest.data);
+    oldest.file->remove();
+    m_segments.pop_front();
+    // Trim the index once per dropped segment rather than on every query.
+    const quint64 first = firstSequence();
+    for (auto it = m_byCombatant.begin(); it != m_byCombatant.end();) {
+        auto &sequences = it.value();
+        sequences.erase(sequences.begin(), std::lower_bound(sequences.begin(), sequences.end(), first));
+        if (sequences.empty()) {
+            it = m_byCombatant.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_rounds.erase(m_rounds.begin(), std::find_if(m_rounds.begin(), m_rounds.end(), [first](const RoundRun &run) { return run.end > first; }));
+}
+
+quint32 CombatLog::intern(const QString &text) {
+    const auto it = m_stringIds.constFind(text);
+    if (it != m_stringIds.constEnd()) {
+        return it.value();
+    }
+    const QByteArray utf8 = text.toUtf8();
+    const quint32 length = quint32(utf8.size());
+    m_stringFile.write(reinterpret_cast<const char *>(&length), sizeof(length));
+    m_stringFile.write(utf8);
+    m_stringFile.flush();
+    const auto id = quint32(m_strings.size());
+    m_strings.push_back(text);
+    m_stringIds.insert(text, id);
+    return id;
+}
+
+void CombatLog::index(const CombatEvent &event, quint64 sequence) {
+    if (event.type == CombatEventType::EncounterStarted) {
+        m_encounterStart = sequence;
+    }
+    if (event.combatantId != 0) {
+        m_byCombatant[event.combatantId].push_back(sequence);
+    }
+    if (!m_rounds.empty() && m_rounds.back().round == event.round && m_rounds.back().end == sequence) {
+        m_rounds.back().end = sequence + 1;
+    } else {
+        m_rounds.push_back({event.round, sequence, sequence + 1});
+    }
+}
+
+CombatEvent *CombatLog::slot(quint64 sequence) const {
+    const auto &segment = m_segments[std::size_t(sequence / kRecordsPerSegment - m_segments.front().number)];
+    return reinterpret_cast<CombatEvent *>(segment.data + sizeof(SegmentHeader)) + sequence % kRecordsPerSegment;
+}
+
+QString CombatLog::segmentPath(quint64 number) const {
+    return QDir(m_directory).filePath(QStringLiteral("segment-%1.log").arg(number, 8, 10, QLatin1Char('0')));
+}
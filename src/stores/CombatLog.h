@@ -0,0 +1,118 @@
+#pragma once
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+enum class CombatEventType : quint16 {
+    TurnStarted,       // before: previous round, after: round
+    Roll,              // before: raw die, after: total, text: roll mode
+    InitiativeChanged, // before/after: initiative
+    HpChanged,         // before/after: hp
+    ConsciousChanged,  // before/after: 0 or 1
+    DeathSavesChanged, // before/after: successes | failures << 8 | dead << 16 | stable << 17
+    ConditionAdded,    // after: rounds, text: condition
+    ConditionEnded,    // before: rounds left, text: condition
+    Added,             // before: initiative, after: 1 for a PC, text: name
+    Removed,
+    EncounterStarted   // a roster was loaded; Added events for it follow
+};
+
+// One fixed-layout log record. Text lives in the log's string table.
+struct CombatEvent {
+    quint32 round = 0;
+    CombatEventType type = CombatEventType::TurnStarted;
+    quint16 turnIndex = 0;
+    qint32 combatantId = 0;
+    qint32 before = 0;
+    qint32 after = 0;
+    quint32 text = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<CombatEvent> && sizeof(CombatEvent) == 24, "CombatEvent is written to disk as is");
+
+// Append-only record of what happened in a fight, kept in a directory of
+// memory-mapped segment files of kRecordsPerSegment records each. Appending
+// copies 24 bytes into the mapped segment and updates the in-memory index;
+// only starting a new segment or interning a new string touches the file
+// system. An index by combatant id and by round answers history queries
+// without scanning the log. With setMaxSegments() the log becomes a ring
+// that deletes its oldest segment. Not thread-safe.
+class CombatLog {
+public:
+    static constexpr quint32 kRecordsPerSegment = 16384;
+
+    explicit CombatLog(QString directory);
+    ~CombatLog();
+
+    CombatLog(const CombatLog &) = delete;
+    CombatLog &operator=(const CombatLog &) = delete;
+
+    // Maps the existing segments and rebuilds the index from them.
+    bool open();
+    void close();
+    bool isOpen() const noexcept { return m_open; }
+    QString directory() const { return m_directory; }
+
+    // 0 keeps every segment.
+    void setMaxSegments(int segments);
+
+    void append(CombatEventType type, int round, int turnIndex, int combatantId, int before = 0, int after = 0, const QString &text = QString());
+
+    // Sequence numbers run from firstSequence() up to, excluding, endSequence().
+    quint64 firstSequence() const noexcept;
+    quint64 endSequence() const noexcept { return m_end; }
+    CombatEvent at(quint64 sequence) const;
+    QString text(quint32 id) const { return id < quint32(m_strings.size()) ? m_strings.at(id) : QString(); }
+
+    // Where the current fight begins: the latest EncounterStarted still in
+    // the log, else firstSequence(). Ids and rounds restart with each fight,
+    // so per-combatant history should not reach back past it.
+    quint64 encounterStart() const noexcept { return std::max(m_encounterStart, firstSequence()); }
+
+    // Events in sequence order, rounds inclusive, from fromSequence on.
+    QVector<CombatEvent> eventsFor(int combatantId, int firstRound, int lastRound, quint64 fromSequence = 0) const;
+    QVector<CombatEvent> eventsInRounds(int firstRound, int lastRound) const;
+
+private:
+    struct Segment {
+        quint64 number = 0;
+        std::unique_ptr<QFile> file;
+        uchar *data = nullptr;
+    };
+    // Consecutive records of one round.
+    struct RoundRun {
+        quint32 round;
+        quint64 first;
+        quint64 end;
+    };
+
+    bool mapSegment(quint64 number, bool create);
+    void dropOldestSegment();
+    quint32 intern(const QString &text);
+    void index(const CombatEvent &event, quint64 sequence);
+    CombatEvent *slot(quint64 sequence) const;
+    QString segmentPath(quint64 number) const;
+
+    QString m_directory;
+    bool m_open = false;
+    int m_maxSegments = 0;
+    std::deque<Segment> m_segments;
+    quint64 m_end = 0;
+    quint64 m_encounterStart = 0;
+
+    QFile m_stringFile;
+    QVector<QString> m_strings;
+    QHash<QString, quint32> m_stringIds;
+
+    QHash<int, std::vector<quint64>> m_byCombatant;
+    std::vector<RoundRun> m_rounds;
+};
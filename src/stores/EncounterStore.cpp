@@ -4,6 +4,11 @@
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QtConcurrent>
+
+#include <optional>
+
+#include "utils/Trace.h"
 
 namespace {
 constexpr int kSchemaVersion = 2;
@@ -11,7 +16,11 @@ constexpr int kSchemaVersion = 2;
 QJsonObject toJson(const Combatant &combatant) {
     QJsonObject obj;
     obj["id"] = combatant.id;
-    obj["name"] = combatant.name;
+    obj["name"] = combatant.name.toString();
+    if (combatant.name.isSpawned()) {
+        const auto &style = combatant.name.style();
+        obj["spawn"] = QJsonArray{style.baseName, combatant.name.index(), style.pattern, style.zeroPad ? style.width : 0};
+    }
     obj["initiative"] = combatant.initiative;
     obj["dexMod"] = combatant.dexMod;
     obj["isPC"] = combatant.isPC;
@@ -27,40 +36,302 @@ QJsonObject toJson(const Combatant &combatant) {
     QJsonArray conditions;
     for (const auto &condition : combatant.conditions) {
         QJsonObject conditionObj;
-        conditionObj["name"] = condition.name;
+        conditionObj["name"] = condition.name.toString();
         conditionObj["remainingRounds"] = condition.remainingRounds;
         conditions.push_back(conditionObj);
     }
     obj["conditions"] = conditions;
     obj["notes"] = combatant.notes;
+    obj["dexScore"] = combatant.dexScore;
+    obj["tiebreak"] = combatant.tiebreak;
+    obj["side"] = combatant.side;
+    if (combatant.cohort > 0) {
+        obj["cohort"] = combatant.cohort;
+    }
+    if (combatant.isMob()) {
+        // hp and conscious above stay as the mob's summary for older readers.
+        QJsonArray hp;
+        QJsonArray memberConditions;
+        for (int member = 0; member < combatant.mob.size(); ++member) {
+            hp.push_back(combatant.mob.hp(member));
+            if (const auto *own = combatant.mob.conditions(member)) {
+                for (const auto &condition : *own) {
+                    memberConditions.push_back(QJsonObject{{"member", member}, {"name", condition.name.toString()}, {"remainingRounds", condition.remainingRounds}});
+                }
+            }
+        }
+        QJsonObject mob;
+        mob["hp"] = hp;
+        if (!memberConditions.isEmpty()) {
+            mob["conditions"] = memberConditions;
+        }
+        obj["mob"] = mob;
+    }
     return obj;
 }
 
+QJsonArray cohortsToJson(const QVector<Cohort> &cohorts) {
+    QJsonArray array;
+    for (const auto &cohort : cohorts) {
+        QJsonObject obj;
+        obj["id"] = cohort.id;
+        obj["name"] = cohort.name;
+        obj["initiative"] = cohort.initiative;
+        obj["dexMod"] = cohort.dexMod;
+        array.push_back(obj);
+    }
+    return array;
+}
+
+QVector<Cohort> cohortsFromJson(const QJsonArray &array) {
+    QVector<Cohort> cohorts;
+    cohorts.reserve(array.size());
+    for (const auto &value : array) {
+        const auto obj = value.toObject();
+        Cohort cohort;
+        cohort.id = obj.value("id").toInt();
+        cohort.name = obj.value("name").toString();
+        cohort.initiative = obj.value("initiative").toInt();
+        cohort.dexMod = obj.value("dexMod").toInt();
+        if (cohort.id > 0) {
+            cohorts.push_back(std::move(cohort));
+        }
+    }
+    return cohorts;
+}
+
+// Keys are told apart by length first, so most keys cost one integer switch
+// and one comparison. This replaces a binary search per QJsonObject::value().
+enum class CombatantKey {
+    Unknown,
+    Id,
+    Name,
+    Initiative,
+    DexMod,
+    IsPC,
+    Conscious,
+    HP,
+    AC,
+    DeathSaves,
+    Conditions,
+    Notes,
+    Spawn,
+    DexScore,
+    Tiebreak,
+    Side,
+    Cohort,
+    Mob
+};
+
+CombatantKey combatantKey(const QString &key) {
+    switch (key.size()) {
+    case 2:
+        if (key == QLatin1String("id")) {
+            return CombatantKey::Id;
+        }
+        if (key == QLatin1String("hp")) {
+            return CombatantKey::HP;
+        }
+        return key == QLatin1String("ac") ? CombatantKey::AC : CombatantKey::Unknown;
+    case 3:
+        return key == QLatin1String("mob") ? CombatantKey::Mob : CombatantKey::Unknown;
+    case 4:
+        if (key == QLatin1String("name")) {
+            return CombatantKey::Name;
+        }
+        if (key == QLatin1String("side")) {
+            return CombatantKey::Side;
+        }
+        return key == QLatin1String("isPC") ? CombatantKey::IsPC : CombatantKey::Unknown;
+    case 5:
+        if (key == QLatin1String("notes")) {
+            return CombatantKey::Notes;
+        }
+        return key == QLatin1String("spawn") ? CombatantKey::Spawn : CombatantKey::Unknown;
+    case 6:
+        if (key == QLatin1String("dexMod")) {
+            return CombatantKey::DexMod;
+        }
+        return key == QLatin1String("cohort") ? CombatantKey::Cohort : CombatantKey::Unknown;
+    case 8:
+        if (key == QLatin1String("dexScore")) {
+            return CombatantKey::DexScore;
+        }
+        return key == QLatin1String("tiebreak") ? CombatantKey::Tiebreak : CombatantKey::Unknown;
+    case 9:
+        return key == QLatin1String("conscious") ? CombatantKey::Conscious : CombatantKey::Unknown;
+    case 10:
+        if (key == QLatin1String("initiative")) {
+            return CombatantKey::Initiative;
+        }
+        if (key == QLatin1String("deathSaves")) {
+            return CombatantKey::DeathSaves;
+        }
+        return key == QLatin1String("conditions") ? CombatantKey::Conditions : CombatantKey::Unknown;
+    default:
+        return CombatantKey::Unknown;
+    }
+}
+
+DeathSaves deathSavesFromJson(const QJsonObject &obj) {
+    DeathSaves saves;
+    for (auto it = obj.constBegin(); it != obj.constEnd(); ++it) {
+        const auto &key = it.key();
+        if (key == QLatin1String("successes")) {
+            saves.successes = it.value().toInt();
+        } else if (key == QLatin1String("failures")) {
+            saves.failures = it.value().toInt();
+        } else if (key == QLatin1String("dead")) {
+            saves.dead = it.value().toBool();
+        } else if (key == QLatin1String("stable")) {
+            saves.stable = it.value().toBool();
+        }
+    }
+    return saves;
+}
+
+Condition conditionFromJson(const QJsonObject &obj) {
+    Condition condition;
+    for (auto it = obj.constBegin(); it != obj.constEnd(); ++it) {
+        if (it.key() == QLatin1String("name")) {
+            condition.name = it.value().toString();
+        } else if (it.key() == QLatin1String("remainingRounds")) {
+            condition.remainingRounds = it.value().toInt();
+        }
+    }
+    return condition;
+}
+
+MobMembers mobFromJson(const QJsonObject &obj) {
+    const auto hp = obj.value("hp").toArray();
+    auto mob = MobMembers::uniform(static_cast<int>(hp.size()), 0);
+    for (int member = 0; member < mob.size(); ++member) {
+        mob.setHp(member, hp.at(member).toInt());
+    }
+    for (const auto &value : obj.value("conditions").toArray()) {
+        const auto conditionObj = value.toObject();
+        const int member = conditionObj.value("member").toInt(-1);
+        if (member >= 0 && member < mob.size()) {
+            mob.addCondition(member, conditionFromJson(conditionObj));
+        }
+    }
+    return mob;
+}
+
+// [baseName, index, pattern, width]; width 0 means no zero padding.
+std::optional<CombatantName> spawnFromJson(const QJsonArray &spawn) {
+    if (spawn.size() != 4) {
+        return std::nullopt;
+    }
+    SpawnStyle style;
+    style.baseName = spawn.at(0).toString();
+    style.pattern = spawn.at(2).toString();
+    style.width = spawn.at(3).toInt();
+    style.zeroPad = style.width > 0;
+    return CombatantName::spawned(style, spawn.at(1).toInt());
+}
+
+// Single pass over the object's own entries. Missing keys keep the loader's
+// historical defaults; those differ from Combatant's for ac.
 Combatant combatantFromJson(const QJsonObject &obj) {
     Combatant combatant;
-    combatant.id = obj.value("id").toInt();
-    combatant.name = obj.value("name").toString();
-    combatant.initiative = obj.value("initiative").toInt();
-    combatant.dexMod = obj.value("dexMod").toInt();
-    combatant.isPC = obj.value("isPC").toBool();
-    combatant.conscious = obj.value("conscious").toBool(true);
-    combatant.hp = obj.value("hp").toInt();
-    combatant.ac = obj.value("ac").toInt();
-    const auto ds = obj.value("deathSaves").toObject();
-    combatant.deathSaves.successes = ds.value("successes").toInt();
-    combatant.deathSaves.failures = ds.value("failures").toInt();
-    combatant.deathSaves.dead = ds.value("dead").toBool();
-    combatant.deathSaves.stable = ds.value("stable").toBool();
-    for (const auto &conditionValue : obj.value("conditions").toArray()) {
-        const auto conditionObj = conditionValue.toObject();
-        Condition condition;
-        condition.name = conditionObj.value("name").toString();
-        condition.remainingRounds = conditionObj.value("remainingRounds").toInt();
-        combatant.conditions.push_back(condition);
-    }
-    combatant.notes = obj.value("notes").toString();
+    combatant.ac = 0;
+    std::optional<CombatantName> spawned;
+    bool hasName = false;
+    for (auto it = obj.constBegin(); it != obj.constEnd(); ++it) {
+        const auto value = it.value();
+        switch (combatantKey(it.key())) {
+        case CombatantKey::Id:
+            combatant.id = value.toInt();
+            break;
+        case CombatantKey::Name:
+            combatant.name = value.toString();
+            hasName = true;
+            break;
+        case CombatantKey::Initiative:
+            combatant.initiative = value.toInt();
+            break;
+        case CombatantKey::DexMod:
+            combatant.dexMod = value.toInt();
+            break;
+        case CombatantKey::IsPC:
+            combatant.isPC = value.toBool();
+            break;
+        case CombatantKey::Conscious:
+            combatant.conscious = value.toBool(true);
+            break;
+        case CombatantKey::HP:
+            combatant.hp = value.toInt();
+            break;
+        case CombatantKey::AC:
+            combatant.ac = value.toInt();
+            break;
+        case CombatantKey::DeathSaves:
+            combatant.deathSaves = deathSavesFromJson(value.toObject());
+            break;
+        case CombatantKey::Conditions: {
+            const auto conditions = value.toArray();
+            combatant.conditions.reserve(conditions.size());
+            for (const auto &conditionValue : conditions) {
+                combatant.conditions.push_back(conditionFromJson(conditionValue.toObject()));
+            }
+            break;
+        }
+        case CombatantKey::Notes:
+            combatant.notes = value.toString();
+            break;
+        case CombatantKey::Spawn:
+            spawned = spawnFromJson(value.toArray());
+            break;
+        case CombatantKey::DexScore:
+            combatant.dexScore = value.toInt();
+            break;
+        case CombatantKey::Tiebreak:
+            combatant.tiebreak = value.toInt();
+            break;
+        case CombatantKey::Side:
+            combatant.side = value.toInt();
+            break;
+        case CombatantKey::Cohort:
+            combatant.cohort = value.toInt();
+            break;
+        case CombatantKey::Mob:
+            combatant.mob = mobFromJson(value.toObject());
+            break;
+        case CombatantKey::Unknown:
+            break;
+        }
+    }
+    combatant.syncMobSummary();
+    // A hand-edited name wins over a stale spawn record.
+    if (spawned && (!hasName || *spawned == combatant.name)) {
+        combatant.name = std::move(*spawned);
+    }
     return combatant;
 }
+
+constexpr int kProgressStep = 1024;
+
+QByteArray writeDocument(int round, int turnIndex, QJsonArray combatants, const QVector<Cohort> &cohorts) {
+    QJsonObject root;
+    root["schema"] = kSchemaVersion;
+    root["round"] = round;
+    root["turnIndex"] = turnIndex;
+    if (!cohorts.isEmpty()) {
+        // Only cohorts someone still belongs to are worth saving.
+        QSet<int> occupied;
+        for (const auto &value : std::as_const(combatants)) {
+            occupied.insert(value.toObject().value("cohort").toInt());
+        }
+        QVector<Cohort> kept;
+        std::copy_if(cohorts.cbegin(), cohorts.cend(), std::back_inserter(kept), [&occupied](const Cohort &cohort) { return occupied.contains(cohort.id); });
+        if (!kept.isEmpty()) {
+            root["cohorts"] = cohortsToJson(kept);
+        }
+    }
+    root["combatants"] = std::move(combatants);
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
 }
 
 EncounterStore::EncounterStore(QObject *parent)
@@ -71,6 +342,7 @@ void EncounterStore::setFilePath(QString path) {
 }
 
 bool EncounterStore::load(TurnManager &manager, int &round, int &turnIndex) const {
+    TRACE_SCOPE("EncounterStore::load");
     if (m_filePath.isEmpty()) {
         return false;
     }
@@ -83,44 +355,109 @@ bool EncounterStore::load(TurnManager &manager, int &round, int &turnIndex) cons
 }
 
 bool EncounterStore::save(const TurnManager &manager, int round, int turnIndex) const {
+    TRACE_SCOPE("EncounterStore::save");
     if (m_filePath.isEmpty()) {
         return false;
     }
-    QFile file(m_filePath);
-    if (!file.open(QIODevice::WriteOnly)) {
-        return false;
+    const auto ticket = StoreWriteSequencer::reserve(m_filePath);
+    return StoreWriteSequencer::write(m_filePath, ticket, serialize(manager, round, turnIndex));
+}
+
+QFuture<EncounterData> EncounterStore::loadAsync() const {
+    return QtConcurrent::run([path = m_filePath](QPromise<EncounterData> &promise) {
+        TRACE_SCOPE("EncounterStore::loadAsync");
+        auto decoded = readFile(path, promiseProgress(promise));
+        if (decoded && !promise.isCanceled()) {
+            promise.addResult(std::move(*decoded));
+        }
+    });
+}
+
+QFuture<bool> EncounterStore::saveAsync(const TurnManager &manager, int round, int turnIndex) const {
+    if (m_filePath.isEmpty()) {
+        return readyFuture(false);
     }
-    file.write(serialize(manager, round, turnIndex));
-    return true;
+    // The ticket is taken now, on the caller's thread, so request order decides
+    // which save wins.
+    const auto ticket = StoreWriteSequencer::reserve(m_filePath);
+    return QtConcurrent::run([path = m_filePath, ticket, version = manager.snapshot(), round, turnIndex](QPromise<bool> &promise) {
+        TRACE_SCOPE("EncounterStore::saveAsync");
+        const auto data = serialize(*version, round, turnIndex, promiseProgress(promise));
+        if (promise.isCanceled()) {
+            return;
+        }
+        promise.addResult(StoreWriteSequencer::write(path, ticket, data));
+    });
 }
 
 QByteArray EncounterStore::serialize(const TurnManager &manager, int round, int turnIndex) {
-    QJsonObject root;
-    root["schema"] = kSchemaVersion;
-    root["round"] = round;
-    root["turnIndex"] = turnIndex;
+    TRACE_SCOPE("EncounterStore::serialize");
     QJsonArray combatants;
     for (const auto &combatant : manager.combatants()) {
         combatants.push_back(toJson(combatant));
     }
-    root["combatants"] = combatants;
-    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+    return writeDocument(round, turnIndex, std::move(combatants), manager.cohorts());
+}
+
+QByteArray EncounterStore::serialize(const EncounterVersion &version, int round, int turnIndex, const StoreProgress &progress) {
+    TRACE_SCOPE("EncounterStore::serializeVersion");
+    const int total = version.size();
+    QJsonArray combatants;
+    for (int position = 0; position < total; ++position) {
+        if (progress && position % kProgressStep == 0 && !progress(position, total)) {
+            return QByteArray();
+        }
+        combatants.push_back(toJson(version.at(position)));
+    }
+    if (progress && !progress(total, total)) {
+        return QByteArray();
+    }
+    return writeDocument(round, turnIndex, std::move(combatants), version.cohorts);
 }
 
 bool EncounterStore::deserialize(const QByteArray &data, TurnManager &manager, int &round, int &turnIndex) {
+    TRACE_SCOPE("EncounterStore::deserialize");
+    auto decoded = decode(data);
+    if (!decoded) {
+        return false;
+    }
+    round = decoded->round;
+    turnIndex = decoded->turnIndex;
+    manager.setCombatants(std::move(decoded->combatants), std::move(decoded->cohorts));
+    return true;
+}
+
+std::optional<EncounterData> EncounterStore::decode(const QByteArray &data, const StoreProgress &progress) {
+    TRACE_SCOPE("EncounterStore::decode");
     const auto doc = QJsonDocument::fromJson(data);
     const auto root = doc.object();
     if (root.value("schema").toInt() != kSchemaVersion) {
-        return false;
+        return std::nullopt;
+    }
+    EncounterData decoded;
+    decoded.round = root.value("round").toInt(1);
+    decoded.turnIndex = root.value("turnIndex").toInt(0);
+    const auto array = root.value("combatants").toArray();
+    const int total = static_cast<int>(array.size());
+    decoded.combatants.resize(total);
+    if (!convertJsonArray(array, decoded.combatants.data(), combatantFromJson, progress, 0, total)) {
+        return std::nullopt;
     }
-    round = root.value("round").toInt(1);
-    turnIndex = root.value("turnIndex").toInt(0);
+    decoded.cohorts = cohortsFromJson(root.value("cohorts").toArray());
+    if (progress && !progress(total, total)) {
+        return std::nullopt;
+    }
+    return decoded;
+}
 
-    TurnManager::CombatantList list;
-    for (const auto &value : root.value("combatants").toArray()) {
-        list.push_back(combatantFromJson(value.toObject()));
+std::optional<EncounterData> EncounterStore::readFile(const QString &path, const StoreProgress &progress) {
+    QFile file(path);
+    if (path.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
     }
-    manager.setCombatants(list);
-    return true;
+    return decode(file.readAll(), progress);
 }
 
+QJsonObject EncounterStore::toJsonObject(const Combatant &combatant) {
+    return toJson(combatant);
+}
@@ -1,10 +1,24 @@
 #pragma once
 
+#include <QFuture>
+#include <QJsonObject>
 #include <QObject>
 #include <QString>
 
+#include <optional>
+
+#include "StoreIo.h"
 #include "models/TurnManager.h"
 
+// Decoded encounter file, independent of any TurnManager so it can be parsed
+// off the GUI thread.
+struct EncounterData {
+    int round = 1;
+    int turnIndex = 0;
+    TurnManager::CombatantList combatants;
+    QVector<Cohort> cohorts;
+};
+
 class EncounterStore : public QObject {
     Q_OBJECT
 public:
@@ -16,8 +30,19 @@ public:
     bool load(TurnManager &manager, int &round, int &turnIndex) const;
     bool save(const TurnManager &manager, int round, int turnIndex) const;
 
+    // Parsing and serialization run on the global thread pool and report
+    // progress per combatant. A canceled or failed load finishes without a
+    // result; take it with QFuture::takeResult(). saveAsync snapshots the
+    // current version, so later edits do not race with the writer.
+    QFuture<EncounterData> loadAsync() const;
+    QFuture<bool> saveAsync(const TurnManager &manager, int round, int turnIndex) const;
+
     static QByteArray serialize(const TurnManager &manager, int round, int turnIndex);
+    static QByteArray serialize(const EncounterVersion &version, int round, int turnIndex, const StoreProgress &progress = {});
     static bool deserialize(const QByteArray &data, TurnManager &manager, int &round, int &turnIndex);
+    static std::optional<EncounterData> decode(const QByteArray &data, const StoreProgress &progress = {});
+    static std::optional<EncounterData> readFile(const QString &path, const StoreProgress &progress = {});
+    static QJsonObject toJsonObject(const Combatant &combatant);
 
 private:
     QString m_filePath;
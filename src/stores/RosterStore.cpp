@@ -2,12 +2,19 @@
 
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QStandardPaths>
+#include <QtConcurrent>
 
 #include <algorithm>
+#include <numeric>
+#include <utility>
+
+#include "utils/Trace.h"
 
 namespace {
 constexpr int kSchemaVersion = 2;
@@ -29,17 +36,47 @@ QJsonObject toJson(const RosterCharacter &character) {
     return obj;
 }
 
+// Single pass over the object's entries, dispatching on key length like the
+// encounter loader. Missing keys keep the historical defaults (defaultAC 0).
 RosterCharacter characterFromJson(const QJsonObject &obj) {
     RosterCharacter character;
-    character.name = obj.value("name").toString();
-    character.dexMod = obj.value("dexMod").toInt();
-    character.isPC = obj.value("isPC").toBool();
-    for (const auto &tag : obj.value("tags").toArray()) {
-        character.tags.insert(tag.toString());
-    }
-    character.defaultHP = obj.value("defaultHP").toInt();
-    character.defaultAC = obj.value("defaultAC").toInt();
-    character.defaultNotes = obj.value("defaultNotes").toString();
+    character.defaultAC = 0;
+    for (auto it = obj.constBegin(); it != obj.constEnd(); ++it) {
+        const auto &key = it.key();
+        const auto value = it.value();
+        switch (key.size()) {
+        case 4:
+            if (key == QLatin1String("name")) {
+                character.name = value.toString();
+            } else if (key == QLatin1String("isPC")) {
+                character.isPC = value.toBool();
+            } else if (key == QLatin1String("tags")) {
+                for (const auto &tag : value.toArray()) {
+                    character.tags.insert(tag.toString());
+                }
+            }
+            break;
+        case 6:
+            if (key == QLatin1String("dexMod")) {
+                character.dexMod = value.toInt();
+            }
+            break;
+        case 9:
+            if (key == QLatin1String("defaultHP")) {
+                character.defaultHP = value.toInt();
+            } else if (key == QLatin1String("defaultAC")) {
+                character.defaultAC = value.toInt();
+            }
+            break;
+        case 12:
+            if (key == QLatin1String("defaultNotes")) {
+                character.defaultNotes = value.toString();
+            }
+            break;
+        default:
+            break;
+        }
+    }
     return character;
 }
 
@@ -69,123 +106,1402 @@ RosterGroup groupFromJson(const QJsonObject &obj) {
     }
     return group;
 }
+
+constexpr int kProgressStep = 1024;
+
+// Root object of a roster file, or an empty object when the file is missing
+// or has another schema.
+QJsonObject readSchemaRoot(const QString &path) {
+    QFile file(path);
+    if (!file.exists() || !file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    const auto root = QJsonDocument::fromJson(file.readAll()).object();
+    if (root.value("schema").toInt() != kSchemaVersion) {
+        return QJsonObject();
+    }
+    return root;
+}
+
+MassAddNaming namingFromJson(const QJsonObject &obj, MassAddNaming naming) {
+    if (!obj.isEmpty()) {
+        naming.pattern = obj.value("pattern").toString(naming.pattern);
+        naming.startIndex = obj.value("startIndex").toInt(naming.startIndex);
+        naming.zeroPad = obj.value("zeroPad").toBool(naming.zeroPad);
+        naming.width = obj.value("width").toInt(naming.width);
+    }
+    return naming;
+}
+
+bool sameNaming(const MassAddNaming &lhs, const MassAddNaming &rhs) {
+    return lhs.pattern == rhs.pattern && lhs.startIndex == rhs.startIndex && lhs.zeroPad == rhs.zeroPad && lhs.width == rhs.width;
+}
+
+template <typename T>
+bool hasRepeatedNames(const QVector<T> &entries) {
+    QSet<QString> seen;
+    seen.reserve(entries.size());
+    for (const auto &entry : entries) {
+        const auto key = entry.name.toCaseFolded();
+        if (seen.contains(key)) {
+            return true;
+        }
+        seen.insert(key);
+    }
+    return false;
+}
+
+// Turns current into next by name, touching only what differs. index maps
+// case-folded names to positions in current and is patched as entries move.
+// onChange(before, after) sees each update; before is null for an insert and
+// after is null for a removal.
+template <typename T, typename OnChange>
+void patchByName(QVector<T> &current, QHash<QString, int> &index, QVector<T> next, QStringList &inserted, QStringList &updated, QStringList &removed,
+                 const OnChange &onChange) {
+    QHash<QString, int> nextIndex;
+    nextIndex.reserve(next.size());
+    for (int i = 0; i < next.size(); ++i) {
+        nextIndex.insert(next.at(i).name.toCaseFolded(), i);
+    }
+    std::vector<bool> consumed(std::size_t(next.size()), false);
+    std::vector<bool> dropped(std::size_t(current.size()), false);
+    int firstDropped = current.size();
+    for (int i = 0; i < current.size(); ++i) {
+        const auto key = current.at(i).name.toCaseFolded();
+        const auto it = nextIndex.constFind(key);
+        if (it == nextIndex.constEnd()) {
+            removed.append(current.at(i).name);
+            onChange(&current.at(i), nullptr);
+            index.remove(key);
+            dropped[std::size_t(i)] = true;
+            firstDropped = std::min(firstDropped, i);
+            continue;
+        }
+        consumed[std::size_t(it.value())] = true;
+        auto &replacement = next[it.value()];
+        if (!(current.at(i) == replacement)) {
+            updated.append(replacement.name);
+            onChange(&current.at(i), &replacement);
+            current[i] = std::move(replacement);
+        }
+    }
+    // Close up behind the first removal; positions before it are unchanged.
+    int out = firstDropped;
+    for (int i = firstDropped; i < current.size(); ++i) {
+        if (!dropped[std::size_t(i)]) {
+            index.insert(current.at(i).name.toCaseFolded(), out);
+            if (out != i) {
+                current[out] = std::move(current[i]);
+            }
+            ++out;
+        }
+    }
+    current.resize(out);
+    for (int i = 0; i < next.size(); ++i) {
+        if (!consumed[std::size_t(i)]) {
+            inserted.append(next.at(i).name);
+            onChange(nullptr, &next.at(i));
+            index.insert(next.at(i).name.toCaseFolded(), current.size());
+            current.push_back(std::move(next[i]));
+        }
+    }
+}
+
+// Removes entries[position] and shifts the positions indexed after it. Every
+// entry must be indexed, i.e. no names repeat.
+template <typename T>
+void removeIndexed(QVector<T> &entries, QHash<QString, int> &index, int position) {
+    index.remove(entries.at(position).name.toCaseFolded());
+    entries.removeAt(position);
+    for (int i = position; i < entries.size(); ++i) {
+        index.insert(entries.at(i).name.toCaseFolded(), i);
+    }
+}
+
+// Replaces the entry named like each update, or appends it. A later update
+// of the same name wins.
+template <typename T>
+void upsertByName(QVector<T> &entries, QHash<QString, int> index, QVector<T> updates) {
+    for (auto &update : updates) {
+        const auto key = update.name.toCaseFolded();
+        const auto it = index.constFind(key);
+        if (it != index.constEnd()) {
+            entries[it.value()] = std::move(update);
+        } else {
+            index.insert(key, entries.size());
+            entries.push_back(std::move(update));
+        }
+    }
+}
+
+// A group already in the roster keeps its name and its other entries; an
+// entry for a character it already has replaces that entry's count.
+void mergeGroups(QVector<RosterGroup> &groups, QHash<QString, int> index, QVector<RosterGroup> updates) {
+    for (auto &update : updates) {
+        const auto key = update.name.toCaseFolded();
+        const auto it = index.constFind(key);
+        if (it == index.constEnd()) {
+            index.insert(key, groups.size());
+            groups.push_back(std::move(update));
+            continue;
+        }
+        auto &entries = groups[it.value()].entries;
+        for (auto &entry : update.entries) {
+            const auto character = entry.characterName.toCaseFolded();
+            const auto existing = std::find_if(entries.begin(), entries.end(), [&character](const RosterGroupEntry &other) {
+                return other.characterName.toCaseFolded() == character;
+            });
+            if (existing != entries.end()) {
+                existing->count = entry.count;
+            } else {
+                entries.push_back(std::move(entry));
+            }
+        }
+    }
+}
+
+QJsonObject namingToJson(const MassAddNaming &naming) {
+    QJsonObject obj;
+    obj["pattern"] = naming.pattern;
+    obj["startIndex"] = naming.startIndex;
+    obj["zeroPad"] = naming.zeroPad;
+    obj["width"] = naming.width;
+    return obj;
+}
+
+constexpr int kShardTarget = 256;
+constexpr int kMinShards = 16;
+constexpr int kMaxShards = 4096;
+
+// Power-of-two shard count that keeps shards near kShardTarget entries.
+int shardCountFor(int entries) {
+    int count = kMinShards;
+    while (count < kMaxShards && count * kShardTarget < entries) {
+        count *= 2;
+    }
+    return count;
+}
+
+bool validShardCount(int count) {
+    return count >= 1 && count <= kMaxShards && (count & (count - 1)) == 0;
+}
+
+// FNV-1a over the case-folded name. qHash is seeded per process, and a name
+// must land in the same shard on every run.
+int shardOf(const QString &key, int count) {
+    quint32 hash = 2166136261u;
+    for (const QChar ch : key) {
+        hash = (hash ^ ch.unicode()) * 16777619u;
+    }
+    return int(hash & quint32(count - 1));
+}
+
+// The shard count is part of the name, so a save that changes the layout
+// writes new files and the old layout stays readable until the manifest
+// switches to the new count.
+QString shardFileName(bool groups, int count, int shard) {
+    return QStringLiteral("%1-%2-%3.json")
+        .arg(groups ? QStringLiteral("groups") : QStringLiteral("characters"))
+        .arg(count, 3, 16, QLatin1Char('0'))
+        .arg(shard, 3, 16, QLatin1Char('0'));
+}
+
+template <typename T>
+QVector<QString> foldedNames(const QVector<T> &entries) {
+    QVector<QString> names;
+    names.reserve(entries.size());
+    for (const auto &entry : entries) {
+        names.push_back(entry.name.toCaseFolded());
+    }
+    return names;
+}
+
+template <typename T>
+void sortByOrder(QVector<T> &entries, QVector<qint64> &order) {
+    QVector<int> permutation(entries.size());
+    std::iota(permutation.begin(), permutation.end(), 0);
+    std::stable_sort(permutation.begin(), permutation.end(), [&order](int lhs, int rhs) { return order.at(lhs) < order.at(rhs); });
+    QVector<T> sorted;
+    sorted.reserve(entries.size());
+    QVector<qint64> sortedOrder;
+    sortedOrder.reserve(entries.size());
+    for (const int i : std::as_const(permutation)) {
+        sorted.push_back(std::move(entries[i]));
+        sortedOrder.push_back(order.at(i));
+    }
+    entries = std::move(sorted);
+    order = std::move(sortedOrder);
+}
+
+// One shard file as read on a worker thread.
+struct ShardRead {
+    bool isGroups = false;
+    int count = 0;
+    int shard = 0;
+    QVector<RosterCharacter> characters;
+    QVector<RosterGroup> groups;
+    QVector<qint64> order;
+};
+
+// A missing shard file is an empty shard.
+void readShardFile(const QString &directory, ShardRead &read) {
+    const auto root = readSchemaRoot(directory + "/" + shardFileName(read.isGroups, read.count, read.shard));
+    const auto array = root.value(read.isGroups ? "groups" : "characters").toArray();
+    read.order.reserve(array.size());
+    for (const auto &value : array) {
+        const auto obj = value.toObject();
+        read.order.push_back(obj.value("order").toInteger());
+        if (read.isGroups) {
+            read.groups.push_back(groupFromJson(obj));
+        } else {
+            read.characters.push_back(characterFromJson(obj));
+        }
+    }
+}
+
+// The indexed entries of one shard, in saved order.
+template <typename T>
+void collectShard(const QVector<T> &entries, const QHash<QString, int> &index, const QHash<QString, qint64> &members, QVector<T> &out,
+                  QVector<qint64> &order) {
+    QVector<std::pair<qint64, int>> positions;
+    positions.reserve(members.size());
+    for (auto it = members.constBegin(); it != members.constEnd(); ++it) {
+        const auto position = index.constFind(it.key());
+        if (position != index.constEnd()) {
+            positions.push_back({it.value(), position.value()});
+        }
+    }
+    std::sort(positions.begin(), positions.end());
+    for (const auto &position : std::as_const(positions)) {
+        out.push_back(entries.at(position.second));
+        order.push_back(position.first);
+    }
+}
+
+// Completes a partial read with the current entries of the shards it did not
+// cover, giving the whole list in saved order.
+template <typename T>
+void mergeShards(const QVector<T> &current, const QVector<QHash<QString, qint64>> &layout, const QVector<int> &covered, QVector<T> &entries,
+                 QVector<qint64> &order) {
+    const QSet<int> replaced(covered.cbegin(), covered.cend());
+    for (const auto &entry : current) {
+        const auto key = entry.name.toCaseFolded();
+        const int shard = shardOf(key, layout.size());
+        if (!replaced.contains(shard)) {
+            entries.push_back(entry);
+            order.push_back(layout.at(shard).value(key));
+        }
+    }
+    sortByOrder(entries, order);
+}
+
+// Puts the current entries of locally edited names over a full read: an
+// edited entry replaces the file's in place, one removed locally stays
+// removed, and one added locally is appended.
+template <typename T>
+void keepEdited(const QVector<T> &current, const QHash<QString, int> &index, const QSet<QString> &edited, QVector<T> &entries,
+                QVector<qint64> &order) {
+    if (edited.isEmpty()) {
+        return;
+    }
+    const bool ordered = order.size() == entries.size();
+    qint64 nextOrder = 0;
+    for (const qint64 position : std::as_const(order)) {
+        nextOrder = std::max(nextOrder, position + 1);
+    }
+    QVector<T> kept;
+    kept.reserve(entries.size());
+    QVector<qint64> keptOrder;
+    QSet<QString> seen;
+    for (int i = 0; i < entries.size(); ++i) {
+        const auto key = entries.at(i).name.toCaseFolded();
+        if (edited.contains(key)) {
+            const auto position = index.constFind(key);
+            if (seen.contains(key) || position == index.constEnd()) {
+                continue;
+            }
+            seen.insert(key);
+            kept.push_back(current.at(position.value()));
+        } else {
+            kept.push_back(std::move(entries[i]));
+        }
+        if (ordered) {
+            keptOrder.push_back(order.at(i));
+        }
+    }
+    for (const auto &entry : current) {
+        const auto key = entry.name.toCaseFolded();
+        if (edited.contains(key) && !seen.contains(key)) {
+            seen.insert(key);
+            kept.push_back(entry);
+            if (ordered) {
+                keptOrder.push_back(nextOrder++);
+            }
+        }
+    }
+    entries = std::move(kept);
+    if (ordered) {
+        order = std::move(keptOrder);
+    }
+}
+}
+
+bool operator==(const RosterCharacter &lhs, const RosterCharacter &rhs) {
+    return lhs.name == rhs.name && lhs.dexMod == rhs.dexMod && lhs.isPC == rhs.isPC && lhs.tags == rhs.tags && lhs.defaultHP == rhs.defaultHP
+           && lhs.defaultAC == rhs.defaultAC && lhs.defaultNotes == rhs.defaultNotes;
+}
+
+bool operator==(const RosterGroup &lhs, const RosterGroup &rhs) {
+    if (lhs.name != rhs.name || lhs.entries.size() != rhs.entries.size()) {
+        return false;
+    }
+    for (int i = 0; i < lhs.entries.size(); ++i) {
+        if (lhs.entries.at(i).characterName != rhs.entries.at(i).characterName || lhs.entries.at(i).count != rhs.entries.at(i).count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+void RosterStore::ShardLayout::reset(const QVector<T> &entries) {
+    const int count = shardCountFor(entries.size());
+    shards = QVector<QHash<QString, qint64>>(count);
+    for (int i = 0; i < entries.size(); ++i) {
+        const auto key = entries.at(i).name.toCaseFolded();
+        shards[shardOf(key, count)].insert(key, i);
+    }
+    nextOrder = entries.size();
+    for (int shard = 0; shard < count; ++shard) {
+        dirty.insert(shard);
+    }
+}
+
+template <typename T>
+void RosterStore::ShardLayout::edit(const QVector<T> &entries) {
+    for (const auto &entry : entries) {
+        edited.insert(entry.name.toCaseFolded());
+    }
+}
+
+void RosterStore::ShardLayout::adopt(const QVector<QString> &names, const QVector<qint64> &order, int shardCount, const QVector<int> &covered) {
+    if (covered.isEmpty()) {
+        shards = QVector<QHash<QString, qint64>>(shardCount);
+        dirty.clear();
+        saved = shardCount;
+    }
+    for (const int shard : covered) {
+        shards[shard].clear();
+        dirty.remove(shard);
+    }
+    const QSet<int> replaced(covered.cbegin(), covered.cend());
+    for (int i = 0; i < names.size(); ++i) {
+        const int shard = shardOf(names.at(i), shards.size());
+        if (covered.isEmpty() || replaced.contains(shard)) {
+            shards[shard].insert(names.at(i), order.at(i));
+        }
+        nextOrder = std::max(nextOrder, order.at(i) + 1);
+    }
+}
+
+template <typename T>
+void RosterStore::ShardLayout::track(const T *before, const T *after) {
+    if (before && after) {
+        touch(after->name.toCaseFolded());
+    } else if (before) {
+        remove(before->name.toCaseFolded());
+    } else if (after) {
+        insert(after->name.toCaseFolded());
+    }
+}
+
+void RosterStore::ShardLayout::insert(const QString &name) {
+    const int shard = shardOf(name, shards.size());
+    shards[shard].insert(name, nextOrder++);
+    dirty.insert(shard);
+    edited.insert(name);
+}
+
+void RosterStore::ShardLayout::remove(const QString &name) {
+    const int shard = shardOf(name, shards.size());
+    shards[shard].remove(name);
+    dirty.insert(shard);
+    edited.insert(name);
+}
+
+void RosterStore::ShardLayout::touch(const QString &name) {
+    dirty.insert(shardOf(name, shards.size()));
+    edited.insert(name);
 }
 
 RosterStore::RosterStore(QObject *parent)
     : QObject(parent) {
-    QString dataLocation = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-    if (dataLocation.isEmpty()) {
-        dataLocation = QDir::homePath() + "/.dnd-initiative";
-    }
-    setBasePath(dataLocation);
+    m_characterShards.shards.resize(shardCountFor(0));
+    m_groupShards.shards.resize(shardCountFor(0));
+    // External tools and sync clients often write a file in several steps.
+    m_reloadTimer.setSingleShot(true);
+    m_reloadTimer.setInterval(300);
+    connect(&m_reloadTimer, &QTimer::timeout, this, &RosterStore::startReload);
+    connect(&m_reloadWatcher, &QFutureWatcher<RosterData>::finished, this, &RosterStore::finishReload);
 }
 
 void RosterStore::setBasePath(QString path) {
     m_basePath = std::move(path);
-    QDir().mkpath(m_basePath);
+}
+
+QString RosterStore::basePath() const {
+    if (m_basePath.isEmpty()) {
+        m_basePath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        if (m_basePath.isEmpty()) {
+            m_basePath = QDir::homePath() + "/.dnd-initiative";
+        }
+    }
+    return m_basePath;
 }
 
 void RosterStore::setCharacters(QVector<RosterCharacter> characters) {
+    m_characterShards.edit(m_characters);
     m_characters = std::move(characters);
+    rebuildIndexes();
+    m_characterShards.reset(m_characters);
+    m_characterShards.edit(m_characters);
+    m_manifestDirty = true;
     emit dataChanged();
+    RosterChanges changes;
+    changes.reset = true;
+    emit rosterChanged(changes);
 }
 
 void RosterStore::setGroups(QVector<RosterGroup> groups) {
+    m_groupShards.edit(m_groups);
     m_groups = std::move(groups);
+    rebuildIndexes();
+    m_groupShards.reset(m_groups);
+    m_groupShards.edit(m_groups);
+    m_manifestDirty = true;
     emit dataChanged();
+    RosterChanges changes;
+    changes.reset = true;
+    emit rosterChanged(changes);
 }
 
 void RosterStore::setDefaultNaming(const MassAddNaming &naming) {
     m_defaultNaming = naming;
+    m_manifestDirty = true;
     emit dataChanged();
+    RosterChanges changes;
+    changes.namingChanged = true;
+    emit rosterChanged(changes);
 }
 
 QString RosterStore::charactersPath() const {
-    return m_basePath + "/characters.json";
+    return basePath() + "/characters.json";
 }
 
 QString RosterStore::groupsPath() const {
-    return m_basePath + "/groups.json";
+    return basePath() + "/groups.json";
+}
+
+QString RosterStore::shardDirectory() const {
+    return basePath() + "/roster";
+}
+
+void RosterStore::updateCharacter(const RosterCharacter &character) {
+    RosterChanges changes;
+    const auto key = character.name.toCaseFolded();
+    const int position = findCharacter(character.name);
+    if (position >= 0) {
+        if (m_characters.at(position) == character) {
+            return;
+        }
+        unindexTags(m_characters.at(position));
+        m_characters[position] = character;
+        m_characterShards.touch(key);
+        changes.updatedCharacters.append(character.name);
+    } else {
+        m_characterIndex.insert(key, m_characters.size());
+        m_characters.push_back(character);
+        m_characterShards.insert(key);
+        changes.insertedCharacters.append(character.name);
+        growShards();
+    }
+    indexTags(character);
+    emit dataChanged();
+    emit rosterChanged(changes);
+}
+
+bool RosterStore::removeCharacter(const QString &name) {
+    const int position = findCharacter(name);
+    if (position < 0) {
+        return false;
+    }
+    RosterChanges changes;
+    changes.removedCharacters.append(m_characters.at(position).name);
+    unindexTags(m_characters.at(position));
+    m_characterShards.remove(m_characters.at(position).name.toCaseFolded());
+    if (m_characterIndex.size() == m_characters.size()) {
+        removeIndexed(m_characters, m_characterIndex, position);
+    } else {
+        m_characters.removeAt(position);
+        rebuildIndexes();
+    }
+    emit dataChanged();
+    emit rosterChanged(changes);
+    return true;
+}
+
+void RosterStore::updateGroup(const RosterGroup &group) {
+    RosterChanges changes;
+    const auto key = group.name.toCaseFolded();
+    const int position = findGroup(group.name);
+    if (position >= 0) {
+        if (m_groups.at(position) == group) {
+            return;
+        }
+        m_groups[position] = group;
+        m_groupShards.touch(key);
+        changes.updatedGroups.append(group.name);
+    } else {
+        m_groupIndex.insert(key, m_groups.size());
+        m_groups.push_back(group);
+        m_groupShards.insert(key);
+        changes.insertedGroups.append(group.name);
+        growShards();
+    }
+    emit dataChanged();
+    emit rosterChanged(changes);
+}
+
+bool RosterStore::removeGroup(const QString &name) {
+    const int position = findGroup(name);
+    if (position < 0) {
+        return false;
+    }
+    RosterChanges changes;
+    changes.removedGroups.append(m_groups.at(position).name);
+    m_groupShards.remove(m_groups.at(position).name.toCaseFolded());
+    if (m_groupIndex.size() == m_groups.size()) {
+        removeIndexed(m_groups, m_groupIndex, position);
+    } else {
+        m_groups.removeAt(position);
+        rebuildIndexes();
+    }
+    emit dataChanged();
+    emit rosterChanged(changes);
+    return true;
+}
+
+// A shard averaging twice the target splits the whole layout once, which
+// keeps inserts amortized constant.
+void RosterStore::growShards() {
+    const auto grow = [this](auto &entries, ShardLayout &layout) {
+        if (layout.shards.size() < kMaxShards && entries.size() > layout.shards.size() * kShardTarget * 2) {
+            layout.reset(entries);
+            m_manifestDirty = true;
+        }
+    };
+    grow(m_characters, m_characterShards);
+    grow(m_groups, m_groupShards);
+}
+
+bool RosterStore::hasUnsavedChanges() const noexcept {
+    return m_manifestDirty || !m_characterShards.dirty.isEmpty() || !m_groupShards.dirty.isEmpty();
 }
 
 bool RosterStore::load() {
-    QFile charactersFile(charactersPath());
-    if (charactersFile.exists() && charactersFile.open(QIODevice::ReadOnly)) {
-        const auto doc = QJsonDocument::fromJson(charactersFile.readAll());
-        const auto root = doc.object();
-        const auto schema = root.value("schema").toInt();
-        if (schema == kSchemaVersion) {
-            m_characters.clear();
-            for (const auto &value : root.value("characters").toArray()) {
-                m_characters.push_back(characterFromJson(value.toObject()));
+    TRACE_SCOPE("RosterStore::load");
+    apply(readFiles(basePath()));
+    return true;
+}
+
+RosterData RosterStore::readFiles(const QString &basePath, const StoreProgress &progress, RosterFiles files) {
+    TRACE_SCOPE("RosterStore::readFiles");
+    if (QFileInfo::exists(basePath + "/roster/manifest.json")) {
+        return readShards(basePath, files, nullptr, nullptr, progress);
+    }
+    return readSingleFiles(basePath, progress, files);
+}
+
+RosterData RosterStore::readSingleFiles(const QString &basePath, const StoreProgress &progress, RosterFiles files) {
+    RosterData data;
+    const bool readCharacters = int(files) & int(RosterFiles::Characters);
+    const bool readGroups = int(files) & int(RosterFiles::Groups);
+    const auto charactersRoot = readCharacters ? readSchemaRoot(basePath + "/characters.json") : QJsonObject();
+    const auto groupsRoot = readGroups ? readSchemaRoot(basePath + "/groups.json") : QJsonObject();
+    const auto characterArray = charactersRoot.value("characters").toArray();
+    const auto groupArray = groupsRoot.value("groups").toArray();
+    const int total = static_cast<int>(characterArray.size() + groupArray.size());
+    int done = 0;
+    const auto proceed = [&]() {
+        return !progress || done % kProgressStep != 0 || progress(done, total);
+    };
+
+    if (!charactersRoot.isEmpty()) {
+        data.hasCharacters = true;
+        data.characters.resize(characterArray.size());
+        if (!convertJsonArray(characterArray, data.characters.data(), characterFromJson, progress, 0, total)) {
+            return RosterData();
+        }
+        done = static_cast<int>(characterArray.size());
+    }
+    if (!groupsRoot.isEmpty()) {
+        data.hasGroups = true;
+        for (const auto &value : groupArray) {
+            if (!proceed()) {
+                return RosterData();
             }
+            data.groups.push_back(groupFromJson(value.toObject()));
+            ++done;
         }
+        data.naming = groupsRoot.value("naming").toObject();
     }
+    if (progress && !progress(total, total)) {
+        return RosterData();
+    }
+    return data;
+}
 
-    QFile groupsFile(groupsPath());
-    if (groupsFile.exists() && groupsFile.open(QIODevice::ReadOnly)) {
-        const auto doc = QJsonDocument::fromJson(groupsFile.readAll());
-        const auto root = doc.object();
-        const auto schema = root.value("schema").toInt();
-        if (schema == kSchemaVersion) {
-            m_groups.clear();
-            for (const auto &value : root.value("groups").toArray()) {
-                m_groups.push_back(groupFromJson(value.toObject()));
-            }
-            const auto namingObj = root.value("naming").toObject();
-            if (!namingObj.isEmpty()) {
-                m_defaultNaming.pattern = namingObj.value("pattern").toString(m_defaultNaming.pattern);
-                m_defaultNaming.startIndex = namingObj.value("startIndex").toInt(m_defaultNaming.startIndex);
-                m_defaultNaming.zeroPad = namingObj.value("zeroPad").toBool(m_defaultNaming.zeroPad);
-                m_defaultNaming.width = namingObj.value("width").toInt(m_defaultNaming.width);
+RosterData RosterStore::readShards(const QString &basePath, RosterFiles files, const QVector<int> *characterShards, const QVector<int> *groupShards,
+                                   const StoreProgress &progress) {
+    TRACE_SCOPE("RosterStore::readShards");
+    const auto directory = basePath + "/roster";
+    const auto manifest = readSchemaRoot(directory + "/manifest.json");
+    RosterData data;
+    data.characterShardCount = manifest.value("characterShards").toInt();
+    data.groupShardCount = manifest.value("groupShards").toInt();
+    if (!validShardCount(data.characterShardCount) || !validShardCount(data.groupShardCount)) {
+        return RosterData();
+    }
+    data.sharded = true;
+    data.partial = characterShards || groupShards;
+    data.hasCharacters = int(files) & int(RosterFiles::Characters);
+    data.hasGroups = int(files) & int(RosterFiles::Groups);
+    data.naming = manifest.value("naming").toObject();
+    const auto select = [](const QVector<int> *shards, int count) {
+        QVector<int> selected;
+        if (!shards) {
+            selected.resize(count);
+            std::iota(selected.begin(), selected.end(), 0);
+            return selected;
+        }
+        for (const int shard : *shards) {
+            if (shard >= 0 && shard < count) {
+                selected.push_back(shard);
             }
         }
+        return selected;
+    };
+    if (data.hasCharacters) {
+        data.characterShards = select(characterShards, data.characterShardCount);
+    }
+    if (data.hasGroups) {
+        data.groupShards = select(groupShards, data.groupShardCount);
+    }
+
+    QVector<ShardRead> reads;
+    reads.reserve(data.characterShards.size() + data.groupShards.size());
+    for (const int shard : std::as_const(data.characterShards)) {
+        reads.push_back({false, data.characterShardCount, shard, {}, {}, {}});
+    }
+    for (const int shard : std::as_const(data.groupShards)) {
+        reads.push_back({true, data.groupShardCount, shard, {}, {}, {}});
+    }
+    // Shards are parsed in parallel, a batch at a time so progress and
+    // cancellation are checked on the calling thread in between.
+    const int total = static_cast<int>(reads.size());
+    const int batch = 4 * std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+    for (int start = 0; start < total; start += batch) {
+        if (progress && !progress(start, total)) {
+            return RosterData();
+        }
+        QtConcurrent::blockingMap(reads.begin() + start, reads.begin() + std::min(total, start + batch),
+                                  [&directory](ShardRead &read) { readShardFile(directory, read); });
+    }
+    if (progress && !progress(total, total)) {
+        return RosterData();
+    }
+    for (auto &read : reads) {
+        if (read.isGroups) {
+            data.groups += std::move(read.groups);
+            data.groupOrder += std::move(read.order);
+        } else {
+            data.characters += std::move(read.characters);
+            data.characterOrder += std::move(read.order);
+        }
+    }
+    sortByOrder(data.characters, data.characterOrder);
+    sortByOrder(data.groups, data.groupOrder);
+    return data;
+}
+
+RosterData RosterStore::mergePartial(RosterData data) const {
+    if (!data.partial) {
+        // A full read, from a manifest change or the single-file layout.
+        if (data.hasCharacters) {
+            keepEdited(m_characters, m_characterIndex, m_characterShards.edited, data.characters, data.characterOrder);
+        }
+        if (data.hasGroups) {
+            keepEdited(m_groups, m_groupIndex, m_groupShards.edited, data.groups, data.groupOrder);
+        }
+        return data;
+    }
+    if (data.hasCharacters) {
+        mergeShards(m_characters, m_characterShards.shards, data.characterShards, data.characters, data.characterOrder);
+    }
+    if (data.hasGroups) {
+        mergeShards(m_groups, m_groupShards.shards, data.groupShards, data.groups, data.groupOrder);
+    }
+    return data;
+}
+
+void RosterStore::adoptShards(const RosterData &data) {
+    // A patch that grew the layout has already marked every shard dirty.
+    if (data.partial && (data.characterShardCount != m_characterShards.shards.size() || data.groupShardCount != m_groupShards.shards.size())) {
+        return;
+    }
+    if (data.hasCharacters) {
+        m_characterShards.adopt(foldedNames(data.characters), data.characterOrder, data.characterShardCount,
+                                data.partial ? data.characterShards : QVector<int>());
+    }
+    if (data.hasGroups) {
+        m_groupShards.adopt(foldedNames(data.groups), data.groupOrder, data.groupShardCount, data.partial ? data.groupShards : QVector<int>());
     }
+    if (!data.partial) {
+        m_manifestDirty = false;
+    }
+}
 
+void RosterStore::apply(RosterData data) {
+    if (data.hasCharacters) {
+        m_characters = data.characters;
+    }
+    if (data.hasGroups) {
+        m_groups = data.groups;
+        m_defaultNaming = namingFromJson(data.naming, m_defaultNaming);
+    }
+    rebuildIndexes();
+    if (data.sharded) {
+        adoptShards(data);
+    } else if (data.hasCharacters || data.hasGroups) {
+        // Read from the single-file layout; the next save migrates it.
+        if (data.hasCharacters) {
+            m_characterShards.reset(m_characters);
+            m_characterShards.saved = 0;
+        }
+        if (data.hasGroups) {
+            m_groupShards.reset(m_groups);
+            m_groupShards.saved = 0;
+        }
+        m_manifestDirty = true;
+    }
     emit dataChanged();
+    RosterChanges changes;
+    changes.reset = true;
+    emit rosterChanged(changes);
+}
+
+RosterChanges RosterStore::applyChanges(RosterData data) {
+    TRACE_SCOPE("RosterStore::applyChanges");
+    RosterChanges changes;
+    // Names are the diff key, so a roster with repeated names is replaced.
+    const bool keyed = m_characterIndex.size() == m_characters.size() && m_groupIndex.size() == m_groups.size()
+                       && !(data.hasCharacters && hasRepeatedNames(data.characters)) && !(data.hasGroups && hasRepeatedNames(data.groups));
+    if (!keyed) {
+        if (data.hasCharacters) {
+            m_characterShards.edit(m_characters);
+            m_characters = std::move(data.characters);
+        }
+        if (data.hasGroups) {
+            m_groupShards.edit(m_groups);
+            m_groups = std::move(data.groups);
+            m_defaultNaming = namingFromJson(data.naming, m_defaultNaming);
+        }
+        rebuildIndexes();
+        if (data.hasCharacters) {
+            m_characterShards.reset(m_characters);
+            m_characterShards.edit(m_characters);
+        }
+        if (data.hasGroups) {
+            m_groupShards.reset(m_groups);
+            m_groupShards.edit(m_groups);
+        }
+        m_manifestDirty = m_manifestDirty || data.hasCharacters || data.hasGroups;
+        changes.reset = data.hasCharacters || data.hasGroups;
+    } else {
+        if (data.hasCharacters) {
+            patchByName(m_characters, m_characterIndex, std::move(data.characters), changes.insertedCharacters, changes.updatedCharacters,
+                        changes.removedCharacters, [this](const RosterCharacter *before, const RosterCharacter *after) {
+                            if (before) {
+                                unindexTags(*before);
+                            }
+                            if (after) {
+                                indexTags(*after);
+                            }
+                            m_characterShards.track(before, after);
+                        });
+        }
+        if (data.hasGroups) {
+            patchByName(m_groups, m_groupIndex, std::move(data.groups), changes.insertedGroups, changes.updatedGroups, changes.removedGroups,
+                        [this](const RosterGroup *before, const RosterGroup *after) { m_groupShards.track(before, after); });
+            const auto naming = namingFromJson(data.naming, m_defaultNaming);
+            changes.namingChanged = !sameNaming(naming, m_defaultNaming);
+            m_defaultNaming = naming;
+            m_manifestDirty = m_manifestDirty || changes.namingChanged;
+        }
+        growShards();
+    }
+    if (!changes.isEmpty()) {
+        emit dataChanged();
+        emit rosterChanged(changes);
+    }
+    return changes;
+}
+
+RosterChanges RosterStore::merge(RosterData data) {
+    TRACE_SCOPE("RosterStore::merge");
+    RosterData next;
+    if (data.hasCharacters) {
+        next.hasCharacters = true;
+        next.characters = m_characters;
+        upsertByName(next.characters, m_characterIndex, std::move(data.characters));
+    }
+    if (data.hasGroups) {
+        next.hasGroups = true;
+        next.groups = m_groups;
+        mergeGroups(next.groups, m_groupIndex, std::move(data.groups));
+        next.naming = namingToJson(m_defaultNaming);
+    }
+    return applyChanges(std::move(next));
+}
+
+void RosterStore::setWatching(bool watching) {
+    if (watching == isWatching()) {
+        return;
+    }
+    if (!watching) {
+        delete m_watcher;
+        m_watcher = nullptr;
+        m_reloadTimer.stop();
+        return;
+    }
+    m_watcher = new QFileSystemWatcher(this);
+    // Saves replace the files, which drops them from the watcher; the
+    // directory notification re-adds them.
+    connect(m_watcher, &QFileSystemWatcher::fileChanged, &m_reloadTimer, qOverload<>(&QTimer::start));
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, &m_reloadTimer, qOverload<>(&QTimer::start));
+    QDir().mkpath(basePath());
+    m_stamps.clear();
+    for (const auto &path : watchedFiles()) {
+        m_stamps.insert(path, stampOf(path));
+    }
+    watchFiles();
+}
+
+void RosterStore::startReload() {
+    if (m_reloadWatcher.isRunning()) {
+        m_reloadQueued = true;
+        return;
+    }
+    if (m_watcher) {
+        watchFiles();
+    }
+    const auto manifestPath = shardDirectory() + "/manifest.json";
+    const bool sharded = QFileInfo::exists(manifestPath);
+    int files = 0;
+    bool full = false;
+    QVector<int> characterShards;
+    QVector<int> groupShards;
+    for (const auto &path : watchedFiles()) {
+        const auto stamp = stampOf(path);
+        if (stamp == m_stamps.value(path)) {
+            continue;
+        }
+        m_stamps.insert(path, stamp);
+        if (!sharded) {
+            files |= int(path == charactersPath() ? RosterFiles::Characters : RosterFiles::Groups);
+            continue;
+        }
+        if (path == manifestPath) {
+            full = true;
+            continue;
+        }
+        // characters-<count>-<shard>.json or groups-<count>-<shard>.json, in
+        // hex. Unsaved local edits win over the file; the next save
+        // overwrites it.
+        const auto name = QFileInfo(path).completeBaseName();
+        const bool isGroups = name.startsWith(QLatin1String("groups-"));
+        const auto &layout = isGroups ? m_groupShards : m_characterShards;
+        bool countOk = false;
+        bool ok = false;
+        const int count = name.section('-', 1, 1).toInt(&countOk, 16);
+        const int shard = name.section('-', 2).toInt(&ok, 16);
+        if (countOk && ok && count == layout.shards.size() && !layout.dirty.contains(shard)) {
+            (isGroups ? groupShards : characterShards).push_back(shard);
+            files |= int(isGroups ? RosterFiles::Groups : RosterFiles::Characters);
+        }
+    }
+    // The layout is keyed by name, so repeated names take a full read.
+    const bool keyed = m_characterIndex.size() == m_characters.size() && m_groupIndex.size() == m_groups.size();
+    if (sharded && (full || !keyed)) {
+        m_reloadWatcher.setFuture(QtConcurrent::run([path = basePath()]() {
+            TRACE_SCOPE("RosterStore::reload");
+            return readFiles(path);
+        }));
+        return;
+    }
+    if (files == 0) {
+        return;
+    }
+    if (!sharded) {
+        m_reloadWatcher.setFuture(QtConcurrent::run([path = basePath(), files]() {
+            TRACE_SCOPE("RosterStore::reload");
+            return readFiles(path, {}, RosterFiles(files));
+        }));
+        return;
+    }
+    const int characterCount = m_characterShards.shards.size();
+    const int groupCount = m_groupShards.shards.size();
+    m_reloadWatcher.setFuture(QtConcurrent::run([path = basePath(), files, characterShards, groupShards, characterCount, groupCount]() {
+        TRACE_SCOPE("RosterStore::reload");
+        auto data = readShards(path, RosterFiles(files), &characterShards, &groupShards, {});
+        // Shard numbers only line up while the shard counts match.
+        if (!data.sharded || data.characterShardCount != characterCount || data.groupShardCount != groupCount) {
+            data = readFiles(path);
+        }
+        return data;
+    }));
+}
+
+void RosterStore::finishReload() {
+    auto future = m_reloadWatcher.future();
+    if (future.resultCount() > 0) {
+        // Applying the files is not a local edit; the names edited before
+        // it stay edited, and their shards dirty, until the next save.
+        auto characterEdits = m_characterShards.edited;
+        auto groupEdits = m_groupShards.edited;
+        const auto data = mergePartial(future.takeResult());
+        applyChanges(data);
+        if (data.sharded) {
+            adoptShards(data);
+        }
+        m_characterShards.edited = std::move(characterEdits);
+        m_groupShards.edited = std::move(groupEdits);
+        for (auto *layout : {&m_characterShards, &m_groupShards}) {
+            for (const auto &name : std::as_const(layout->edited)) {
+                layout->dirty.insert(shardOf(name, layout->shards.size()));
+            }
+        }
+    }
+    if (m_reloadQueued) {
+        m_reloadQueued = false;
+        startReload();
+    }
+}
+
+// The files of whichever layout is on disk: the single files, or the
+// manifest and every shard of the saved layout.
+QStringList RosterStore::watchedFiles() const {
+    const auto directory = shardDirectory();
+    if (!QFileInfo::exists(directory + "/manifest.json")) {
+        return {charactersPath(), groupsPath()};
+    }
+    QStringList paths{directory + "/manifest.json"};
+    for (int shard = 0; shard < m_characterShards.saved; ++shard) {
+        paths.append(directory + "/" + shardFileName(false, m_characterShards.saved, shard));
+    }
+    for (int shard = 0; shard < m_groupShards.saved; ++shard) {
+        paths.append(directory + "/" + shardFileName(true, m_groupShards.saved, shard));
+    }
+    return paths;
+}
+
+void RosterStore::watchFiles() {
+    const auto watched = m_watcher->files() + m_watcher->directories();
+    const QSet<QString> present(watched.cbegin(), watched.cend());
+    for (const auto &path : QStringList{basePath(), shardDirectory()} + watchedFiles()) {
+        if (!present.contains(path) && QFileInfo::exists(path)) {
+            m_watcher->addPath(path);
+        }
+    }
+}
+
+RosterStore::FileStamp RosterStore::stampOf(const QString &path) {
+    const QFileInfo info(path);
+    if (!info.exists()) {
+        return FileStamp();
+    }
+    return {info.size(), info.lastModified().toMSecsSinceEpoch()};
+}
+
+void RosterStore::rebuildIndexes() {
+    m_characterIndex.clear();
+    m_characterIndex.reserve(m_characters.size());
+    m_tagIndex.clear();
+    for (int i = 0; i < m_characters.size(); ++i) {
+        const auto key = m_characters.at(i).name.toCaseFolded();
+        if (!m_characterIndex.contains(key)) {
+            m_characterIndex.insert(key, i);
+            indexTags(m_characters.at(i));
+        }
+    }
+    m_groupIndex.clear();
+    for (int i = 0; i < m_groups.size(); ++i) {
+        const auto key = m_groups.at(i).name.toCaseFolded();
+        if (!m_groupIndex.contains(key)) {
+            m_groupIndex.insert(key, i);
+        }
+    }
+}
+
+void RosterStore::indexTags(const RosterCharacter &character) {
+    const auto key = character.name.toCaseFolded();
+    for (const auto &tag : character.tags) {
+        m_tagIndex[tag].insert(key);
+    }
+}
+
+void RosterStore::unindexTags(const RosterCharacter &character) {
+    const auto key = character.name.toCaseFolded();
+    for (const auto &tag : character.tags) {
+        const auto it = m_tagIndex.find(tag);
+        if (it != m_tagIndex.end()) {
+            it.value().remove(key);
+            if (it.value().isEmpty()) {
+                m_tagIndex.erase(it);
+            }
+        }
+    }
+}
+
+std::optional<RosterCharacter> RosterStore::character(const QString &name) const {
+    const int position = findCharacter(name);
+    if (position < 0) {
+        return std::nullopt;
+    }
+    return m_characters.at(position);
+}
+
+int RosterStore::findCharacter(const QString &name) const {
+    return m_characterIndex.value(name.toCaseFolded(), -1);
+}
+
+int RosterStore::findGroup(const QString &name) const {
+    return m_groupIndex.value(name.toCaseFolded(), -1);
+}
+
+bool RosterStore::save() {
+    TRACE_SCOPE("RosterStore::save");
+    const auto pending = takeDirtyShards();
+    if (!writeShards(basePath(), pending, {})) {
+        restoreDirtyShards(pending);
+        return false;
+    }
+    finishSave(pending);
     return true;
 }
 
-bool RosterStore::save() const {
-    QJsonObject charactersRoot;
-    charactersRoot["schema"] = kSchemaVersion;
-    QJsonArray characterArray;
-    for (const auto &character : m_characters) {
-        characterArray.push_back(toJson(character));
+bool RosterStore::importFiles(const QString &directory) {
+    TRACE_SCOPE("RosterStore::importFiles");
+    auto data = readSingleFiles(directory, {}, RosterFiles::All);
+    if (!data.hasCharacters && !data.hasGroups) {
+        return false;
     }
-    charactersRoot["characters"] = characterArray;
-    QFile charactersFile(charactersPath());
-    if (!charactersFile.open(QIODevice::WriteOnly)) {
+    applyChanges(std::move(data));
+    return true;
+}
+
+bool RosterStore::exportFiles(const QString &directory) const {
+    TRACE_SCOPE("RosterStore::exportFiles");
+    const auto charactersTicket = StoreWriteSequencer::reserve(directory + "/characters.json");
+    const auto groupsTicket = StoreWriteSequencer::reserve(directory + "/groups.json");
+    return writeFiles(directory, snapshot(), charactersTicket, groupsTicket, {});
+}
+
+QFuture<RosterData> RosterStore::loadAsync() const {
+    return QtConcurrent::run([path = basePath()](QPromise<RosterData> &promise) {
+        TRACE_SCOPE("RosterStore::loadAsync");
+        auto data = readFiles(path, promiseProgress(promise));
+        if (!promise.isCanceled()) {
+            promise.addResult(std::move(data));
+        }
+    });
+}
+
+QFuture<bool> RosterStore::saveAsync() {
+    // Tickets are reserved here so the most recent request wins per file.
+    const auto pending = takeDirtyShards();
+    auto future = QtConcurrent::run([path = basePath(), pending](QPromise<bool> &promise) {
+        TRACE_SCOPE("RosterStore::saveAsync");
+        const bool ok = writeShards(path, pending, promiseProgress(promise));
+        if (!promise.isCanceled()) {
+            promise.addResult(ok);
+        }
+    });
+    auto *watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, pending]() {
+        const auto result = watcher->future();
+        watcher->deleteLater();
+        if (result.resultCount() > 0 && result.result()) {
+            finishSave(pending);
+        } else {
+            restoreDirtyShards(pending);
+        }
+    });
+    watcher->setFuture(future);
+    return future;
+}
+
+RosterData RosterStore::snapshot() const {
+    RosterData data;
+    data.hasCharacters = true;
+    data.characters = m_characters;
+    data.hasGroups = true;
+    data.groups = m_groups;
+    data.naming = namingToJson(m_defaultNaming);
+    return data;
+}
+
+RosterStore::ShardedSave RosterStore::takeDirtyShards() {
+    // The layout is keyed by name; with repeated names every shard is
+    // rewritten from a scan, each entry ordered by its position.
+    const bool charactersKeyed = m_characterIndex.size() == m_characters.size();
+    const bool groupsKeyed = m_groupIndex.size() == m_groups.size();
+    if (!charactersKeyed) {
+        m_characterShards.reset(m_characters);
+    }
+    if (!groupsKeyed) {
+        m_groupShards.reset(m_groups);
+    }
+    m_manifestDirty = m_manifestDirty || !charactersKeyed || !groupsKeyed;
+    ShardedSave save;
+    const auto directory = shardDirectory();
+    bool fresh = false;
+    const auto take = [&](bool isGroups, ShardLayout &layout) {
+        const int count = layout.shards.size();
+        QVector<int> dirty;
+        if (count != layout.saved) {
+            // A new layout is written whole, next to the saved one.
+            fresh = true;
+            dirty.resize(count);
+            std::iota(dirty.begin(), dirty.end(), 0);
+            for (int shard = 0; shard < layout.saved; ++shard) {
+                ShardWrite stale;
+                stale.isGroups = isGroups;
+                stale.count = layout.saved;
+                stale.shard = shard;
+                stale.ticket = StoreWriteSequencer::reserve(directory + "/" + shardFileName(isGroups, layout.saved, shard));
+                save.stale.push_back(std::move(stale));
+            }
+        } else {
+            dirty = QVector<int>(layout.dirty.cbegin(), layout.dirty.cend());
+            std::sort(dirty.begin(), dirty.end());
+        }
+        for (const int shard : std::as_const(dirty)) {
+            ShardWrite write;
+            write.isGroups = isGroups;
+            write.count = count;
+            write.shard = shard;
+            write.ticket = StoreWriteSequencer::reserve(directory + "/" + shardFileName(isGroups, count, shard));
+            if (shard < count) {
+                if (isGroups && groupsKeyed) {
+                    collectShard(m_groups, m_groupIndex, layout.shards.at(shard), write.groups, write.order);
+                } else if (!isGroups && charactersKeyed) {
+                    collectShard(m_characters, m_characterIndex, layout.shards.at(shard), write.characters, write.order);
+                } else if (isGroups) {
+                    for (int i = 0; i < m_groups.size(); ++i) {
+                        if (shardOf(m_groups.at(i).name.toCaseFolded(), layout.shards.size()) == shard) {
+                            write.groups.push_back(m_groups.at(i));
+                            write.order.push_back(i);
+                        }
+                    }
+                } else {
+                    for (int i = 0; i < m_characters.size(); ++i) {
+                        if (shardOf(m_characters.at(i).name.toCaseFolded(), layout.shards.size()) == shard) {
+                            write.characters.push_back(m_characters.at(i));
+                            write.order.push_back(i);
+                        }
+                    }
+                }
+            }
+            save.shards.push_back(std::move(write));
+        }
+        layout.dirty.clear();
+        (isGroups ? save.editedGroups : save.editedCharacters) = std::exchange(layout.edited, {});
+    };
+    take(false, m_characterShards);
+    take(true, m_groupShards);
+    save.manifest = m_manifestDirty || fresh || (!save.shards.isEmpty() && !QFileInfo::exists(directory + "/manifest.json"));
+    if (save.manifest) {
+        save.manifestTicket = StoreWriteSequencer::reserve(directory + "/manifest.json");
+        save.naming = namingToJson(m_defaultNaming);
+        save.characterShardCount = m_characterShards.shards.size();
+        save.groupShardCount = m_groupShards.shards.size();
+    }
+    m_manifestDirty = false;
+    return save;
+}
+
+void RosterStore::restoreDirtyShards(const ShardedSave &save) {
+    for (const auto &write : save.shards) {
+        (write.isGroups ? m_groupShards : m_characterShards).dirty.insert(write.shard);
+    }
+    m_characterShards.edited.unite(save.editedCharacters);
+    m_groupShards.edited.unite(save.editedGroups);
+    m_manifestDirty = m_manifestDirty || save.manifest;
+}
+
+// The manifest on disk now names the saved layout, and our own writes
+// should not come back through the watcher as a reload.
+void RosterStore::finishSave(const ShardedSave &save) {
+    if (save.manifest) {
+        m_characterShards.saved = save.characterShardCount;
+        m_groupShards.saved = save.groupShardCount;
+    }
+    if (!m_watcher) {
+        return;
+    }
+    const auto directory = shardDirectory();
+    for (const auto &write : save.shards) {
+        const auto path = directory + "/" + shardFileName(write.isGroups, write.count, write.shard);
+        m_stamps.insert(path, stampOf(path));
+    }
+    for (const auto &write : save.stale) {
+        m_stamps.remove(directory + "/" + shardFileName(write.isGroups, write.count, write.shard));
+    }
+    if (save.manifest) {
+        m_stamps.insert(directory + "/manifest.json", stampOf(directory + "/manifest.json"));
+    }
+    watchFiles();
+}
+
+// Shards go first and the manifest last. Each file is replaced atomically;
+// a shard left without entries is removed. A new layout only becomes the
+// one read once the manifest names it, so a save interrupted while writing
+// it leaves the previous layout intact.
+bool RosterStore::writeShards(const QString &basePath, const ShardedSave &save, const StoreProgress &progress) {
+    const auto directory = basePath + "/roster";
+    QDir().mkpath(directory);
+    const int total = static_cast<int>(save.shards.size());
+    for (int i = 0; i < total; ++i) {
+        if (progress && !progress(i, total)) {
+            return false;
+        }
+        const auto &write = save.shards.at(i);
+        const auto path = directory + "/" + shardFileName(write.isGroups, write.count, write.shard);
+        if (write.order.isEmpty()) {
+            if (!StoreWriteSequencer::remove(path, write.ticket)) {
+                return false;
+            }
+            continue;
+        }
+        QJsonArray entries;
+        for (int j = 0; j < write.order.size(); ++j) {
+            auto obj = write.isGroups ? toJson(write.groups.at(j)) : toJson(write.characters.at(j));
+            obj["order"] = write.order.at(j);
+            entries.push_back(obj);
+        }
+        QJsonObject root;
+        root["schema"] = kSchemaVersion;
+        root[write.isGroups ? "groups" : "characters"] = entries;
+        if (!StoreWriteSequencer::write(path, write.ticket, QJsonDocument(root).toJson(QJsonDocument::Indented))) {
+            return false;
+        }
+    }
+    if (progress && !progress(total, total)) {
         return false;
     }
-    charactersFile.write(QJsonDocument(charactersRoot).toJson(QJsonDocument::Indented));
+    if (!save.manifest) {
+        return true;
+    }
+    QJsonObject manifest;
+    manifest["schema"] = kSchemaVersion;
+    manifest["characterShards"] = save.characterShardCount;
+    manifest["groupShards"] = save.groupShardCount;
+    manifest["naming"] = save.naming;
+    if (!StoreWriteSequencer::write(directory + "/manifest.json", save.manifestTicket, QJsonDocument(manifest).toJson(QJsonDocument::Indented))) {
+        return false;
+    }
+    // The replaced layout is never read again; a file that cannot be
+    // removed is only clutter.
+    for (const auto &write : save.stale) {
+        StoreWriteSequencer::remove(directory + "/" + shardFileName(write.isGroups, write.count, write.shard), write.ticket);
+    }
+    return true;
+}
 
-    QJsonObject groupsRoot;
-    groupsRoot["schema"] = kSchemaVersion;
+bool RosterStore::writeFiles(const QString &basePath, const RosterData &data, quint64 charactersTicket, quint64 groupsTicket, const StoreProgress &progress) {
+    const int total = static_cast<int>(data.characters.size() + data.groups.size());
+    int done = 0;
+    const auto proceed = [&]() {
+        return !progress || done % kProgressStep != 0 || progress(done, total);
+    };
+
+    QJsonArray characterArray;
+    for (const auto &character : data.characters) {
+        if (!proceed()) {
+            return false;
+        }
+        characterArray.push_back(toJson(character));
+        ++done;
+    }
     QJsonArray groupArray;
-    for (const auto &group : m_groups) {
+    for (const auto &group : data.groups) {
+        if (!proceed()) {
+            return false;
+        }
         groupArray.push_back(toJson(group));
+        ++done;
     }
-    groupsRoot["groups"] = groupArray;
-    QJsonObject naming;
-    naming["pattern"] = m_defaultNaming.pattern;
-    naming["startIndex"] = m_defaultNaming.startIndex;
-    naming["zeroPad"] = m_defaultNaming.zeroPad;
-    naming["width"] = m_defaultNaming.width;
-    groupsRoot["naming"] = naming;
-
-    QFile groupsFile(groupsPath());
-    if (!groupsFile.open(QIODevice::WriteOnly)) {
+    if (progress && !progress(total, total)) {
         return false;
     }
-    groupsFile.write(QJsonDocument(groupsRoot).toJson(QJsonDocument::Indented));
 
-    return true;
+    QJsonObject charactersRoot;
+    charactersRoot["schema"] = kSchemaVersion;
+    charactersRoot["characters"] = characterArray;
+    QJsonObject groupsRoot;
+    groupsRoot["schema"] = kSchemaVersion;
+    groupsRoot["groups"] = groupArray;
+    groupsRoot["naming"] = data.naming;
+
+    QDir().mkpath(basePath);
+    return StoreWriteSequencer::write(basePath + "/characters.json", charactersTicket, QJsonDocument(charactersRoot).toJson(QJsonDocument::Indented))
+        && StoreWriteSequencer::write(basePath + "/groups.json", groupsTicket, QJsonDocument(groupsRoot).toJson(QJsonDocument::Indented));
 }
 
 QVector<RosterCharacter> RosterStore::filterCharacters(const QString &text, const QSet<QString> &tags) const {
+    TRACE_SCOPE("RosterStore::filterCharacters");
     QVector<RosterCharacter> results;
     const auto lower = text.toCaseFolded();
+    if (!tags.isEmpty() && m_characterIndex.size() == m_characters.size()) {
+        // Start from the rarest tag and visit only the characters carrying it.
+        const QSet<QString> *rarest = nullptr;
+        for (const auto &tag : tags) {
+            const auto it = m_tagIndex.constFind(tag);
+            if (it == m_tagIndex.constEnd()) {
+                return results;
+            }
+            if (!rarest || it.value().size() < rarest->size()) {
+                rarest = &it.value();
+            }
+        }
+        QVector<int> positions;
+        positions.reserve(rarest->size());
+        for (const auto &key : *rarest) {
+            if (!text.isEmpty() && !key.contains(lower)) {
+                continue;
+            }
+            const auto &character = m_characters.at(m_characterIndex.value(key));
+            if (std::all_of(tags.cbegin(), tags.cend(), [&character](const QString &tag) { return character.tags.contains(tag); })) {
+                positions.push_back(m_characterIndex.value(key));
+            }
+        }
+        std::sort(positions.begin(), positions.end());
+        for (const int position : std::as_const(positions)) {
+            results.push_back(m_characters.at(position));
+        }
+        return results;
+    }
     for (const auto &character : m_characters) {
         if (!text.isEmpty() && !character.name.toCaseFolded().contains(lower)) {
             continue;
@@ -207,29 +1523,19 @@ QVector<RosterCharacter> RosterStore::filterCharacters(const QString &text, cons
     return results;
 }
 
-static QString formatName(const QString &pattern, const QString &name, int index, bool zeroPad, int width) {
-    QString formatted = pattern;
-    QString indexStr = QString::number(index);
-    if (zeroPad) {
-        indexStr = QString("%1").arg(index, width, 10, QLatin1Char('0'));
-    }
-    formatted.replace("%name", name);
-    formatted.replace("%index", indexStr);
-    return formatted;
-}
-
 QVector<Combatant> RosterStore::massAdd(const QString &characterName, int count, const MassAddNaming &naming) const {
+    TRACE_SCOPE("RosterStore::massAdd");
     QVector<Combatant> added;
-    const auto it = std::find_if(m_characters.begin(), m_characters.end(), [&](const RosterCharacter &c) {
-        return c.name.compare(characterName, Qt::CaseInsensitive) == 0;
-    });
-    if (it == m_characters.end() || count <= 0) {
+    const int position = findCharacter(characterName);
+    if (position < 0 || count <= 0) {
         return added;
     }
+    const auto it = m_characters.cbegin() + position;
 
+    const SpawnStyle style{it->name, naming.pattern, naming.zeroPad, naming.width};
     for (int i = 0; i < count; ++i) {
         Combatant combatant;
-        combatant.name = formatName(naming.pattern, it->name, naming.startIndex + i, naming.zeroPad, naming.width);
+        combatant.name = CombatantName::spawned(style, naming.startIndex + i);
         combatant.dexMod = it->dexMod;
         combatant.isPC = it->isPC;
         combatant.hp = it->defaultHP;
@@ -240,14 +1546,36 @@ QVector<Combatant> RosterStore::massAdd(const QString &characterName, int count,
     return added;
 }
 
+std::optional<Combatant> RosterStore::massAddMob(const QString &characterName, int count, int memberHP) const {
+    TRACE_SCOPE("RosterStore::massAddMob");
+    const int position = findCharacter(characterName);
+    if (position < 0 || count <= 0) {
+        return std::nullopt;
+    }
+    const auto it = m_characters.cbegin() + position;
+    const int hp = memberHP > 0 ? memberHP : it->defaultHP;
+    if (hp <= 0) {
+        return std::nullopt;
+    }
+    Combatant combatant;
+    combatant.name = it->name;
+    combatant.dexMod = it->dexMod;
+    combatant.isPC = it->isPC;
+    combatant.ac = it->defaultAC;
+    combatant.notes = it->defaultNotes;
+    combatant.mob = MobMembers::uniform(count, hp);
+    combatant.syncMobSummary();
+    return combatant;
+}
+
 QVector<Combatant> RosterStore::massAddGroup(const QString &groupName, const MassAddNaming &naming) const {
+    TRACE_SCOPE("RosterStore::massAddGroup");
     QVector<Combatant> combatants;
-    const auto it = std::find_if(m_groups.begin(), m_groups.end(), [&](const RosterGroup &group) {
-        return group.name.compare(groupName, Qt::CaseInsensitive) == 0;
-    });
-    if (it == m_groups.end()) {
+    const int position = findGroup(groupName);
+    if (position < 0) {
         return combatants;
     }
+    const auto it = m_groups.cbegin() + position;
 
     int offset = 0;
     for (const auto &entry : it->entries) {
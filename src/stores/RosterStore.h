@@ -1,12 +1,24 @@
 #pragma once
 
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QJsonObject>
+#include <QMetaType>
 #include <QObject>
 #include <QSet>
 #include <QString>
+#include <QStringList>
+#include <QTimer>
 #include <QVector>
 
+#include <optional>
+
+#include "StoreIo.h"
 #include "models/Combatant.h"
 
+class QFileSystemWatcher;
+
 struct RosterCharacter {
     QString name;
     int dexMod = 0;
@@ -27,6 +39,9 @@ struct RosterGroup {
     QVector<RosterGroupEntry> entries;
 };
 
+bool operator==(const RosterCharacter &lhs, const RosterCharacter &rhs);
+bool operator==(const RosterGroup &lhs, const RosterGroup &rhs);
+
 struct MassAddNaming {
     QString pattern = "%name #%index";
     int startIndex = 1;
@@ -34,6 +49,54 @@ struct MassAddNaming {
     int width = 2;
 };
 
+// Raw result of reading the roster files. It holds no reference to the store,
+// so it can be built on a worker thread and moved into the store afterwards.
+struct RosterData {
+    bool hasCharacters = false;
+    QVector<RosterCharacter> characters;
+    bool hasGroups = false;
+    QVector<RosterGroup> groups;
+    QJsonObject naming;
+
+    // Filled when read from the sharded layout: the saved position of each
+    // entry and the shard count of each list. A partial read covers only the
+    // listed shards; entries stored in other shards are not part of it.
+    bool sharded = false;
+    QVector<qint64> characterOrder;
+    QVector<qint64> groupOrder;
+    int characterShardCount = 0;
+    int groupShardCount = 0;
+    bool partial = false;
+    QVector<int> characterShards;
+    QVector<int> groupShards;
+};
+
+enum class RosterFiles {
+    Characters = 0x1,
+    Groups = 0x2,
+    All = Characters | Groups
+};
+
+// Names touched by one roster change, as stored. reset means the roster was
+// replaced wholesale and views should rebuild.
+struct RosterChanges {
+    bool reset = false;
+    QStringList insertedCharacters;
+    QStringList updatedCharacters;
+    QStringList removedCharacters;
+    QStringList insertedGroups;
+    QStringList updatedGroups;
+    QStringList removedGroups;
+    bool namingChanged = false;
+
+    bool isEmpty() const noexcept {
+        return !reset && !namingChanged && insertedCharacters.isEmpty() && updatedCharacters.isEmpty() && removedCharacters.isEmpty()
+               && insertedGroups.isEmpty() && updatedGroups.isEmpty() && removedGroups.isEmpty();
+    }
+};
+
+Q_DECLARE_METATYPE(RosterChanges)
+
 class RosterStore : public QObject {
     Q_OBJECT
 public:
@@ -42,30 +105,178 @@ public:
     const QVector<RosterCharacter> &characters() const noexcept { return m_characters; }
     const QVector<RosterGroup> &groups() const noexcept { return m_groups; }
     const MassAddNaming &defaultNaming() const noexcept { return m_defaultNaming; }
+    // Case-insensitive, like every other name lookup in the roster.
+    std::optional<RosterCharacter> character(const QString &name) const;
 
     void setCharacters(QVector<RosterCharacter> characters);
     void setGroups(QVector<RosterGroup> groups);
     void setDefaultNaming(const MassAddNaming &naming);
 
+    // The default location is resolved on first use, not at construction.
     void setBasePath(QString path);
+    QString basePath() const;
+
+    // Inserts or replaces one entry by name, or removes it. Only the shard
+    // holding the entry is rewritten by the next save.
+    void updateCharacter(const RosterCharacter &character);
+    bool removeCharacter(const QString &name);
+    void updateGroup(const RosterGroup &group);
+    bool removeGroup(const QString &name);
 
+    // The roster is stored as a manifest plus shard files under roster/, and
+    // save() rewrites only the shards with edits since the last save. load()
+    // falls back to the single-file layout, which the next save migrates.
     bool load();
-    bool save() const;
+    bool save();
+    bool hasUnsavedChanges() const noexcept;
+
+    // The single-file layout (characters.json and groups.json) in directory.
+    // An import is applied as a patch, so only the shards it changes are dirty.
+    bool importFiles(const QString &directory);
+    bool exportFiles(const QString &directory) const;
+
+    // Asynchronous variants run on the global thread pool with progress and
+    // cancellation; a canceled load finishes without a result. Apply a loaded
+    // result with apply(future.takeResult()). The shards a failed or canceled
+    // save covered are marked dirty again.
+    QFuture<RosterData> loadAsync() const;
+    QFuture<bool> saveAsync();
+
+    static RosterData readFiles(const QString &basePath, const StoreProgress &progress = {}, RosterFiles files = RosterFiles::All);
+    void apply(RosterData data);
+    // Diffs data against the roster by name and applies only the difference:
+    // entries are updated in place, removals close up and new names are
+    // appended. Returns what changed, which is also emitted.
+    RosterChanges applyChanges(RosterData data);
+    // Inserts the entries of data, replacing characters with the same name,
+    // and keeps every other entry. A group with an existing name is merged
+    // into it entry by entry. Goes through applyChanges().
+    RosterChanges merge(RosterData data);
+
+    // Reloads the roster files after external edits. A burst of writes is
+    // coalesced into one reload, only files whose size or time changed are
+    // parsed, on the global pool, and the result goes through applyChanges().
+    // Shards with unsaved local edits are not reloaded.
+    void setWatching(bool watching);
+    bool isWatching() const noexcept { return m_watcher != nullptr; }
+    void setReloadDelay(int milliseconds) { m_reloadTimer.setInterval(milliseconds); }
 
     QVector<RosterCharacter> filterCharacters(const QString &text, const QSet<QString> &tags) const;
     QVector<Combatant> massAdd(const QString &characterName, int count, const MassAddNaming &naming) const;
     QVector<Combatant> massAddGroup(const QString &groupName, const MassAddNaming &naming) const;
+    // count copies of a character as a single mob row. Members start at
+    // memberHP, or the character's default HP when memberHP is 0; a mob whose
+    // members would start at 0 HP is refused.
+    std::optional<Combatant> massAddMob(const QString &characterName, int count, int memberHP = 0) const;
 
 signals:
     void dataChanged();
+    void rosterChanged(const RosterChanges &changes);
 
 private:
+    struct FileStamp {
+        qint64 size = -1;
+        qint64 modified = -1;
+
+        bool operator==(const FileStamp &other) const noexcept { return size == other.size && modified == other.modified; }
+    };
+
+    // Where one list's entries live on disk. Each shard maps the case-folded
+    // names hashed to it to their saved positions. saved is the shard count
+    // the manifest on disk names, 0 if none; while it differs from the
+    // layout's, the next save writes a complete new set of files. edited
+    // holds the names changed locally since the last save, which a reload
+    // keeps.
+    struct ShardLayout {
+        QVector<QHash<QString, qint64>> shards;
+        QSet<int> dirty;
+        QSet<QString> edited;
+        qint64 nextOrder = 0;
+        int saved = 0;
+
+        template <typename T>
+        void reset(const QVector<T> &entries);
+        template <typename T>
+        void edit(const QVector<T> &entries);
+        void adopt(const QVector<QString> &names, const QVector<qint64> &order, int shardCount, const QVector<int> &covered);
+        template <typename T>
+        void track(const T *before, const T *after);
+        void insert(const QString &name);
+        void remove(const QString &name);
+        void touch(const QString &name);
+    };
+
+    // One shard file to write, or to remove when it has no entries.
+    struct ShardWrite {
+        bool isGroups = false;
+        int count = 0;
+        int shard = 0;
+        quint64 ticket = 0;
+        QVector<RosterCharacter> characters;
+        QVector<RosterGroup> groups;
+        QVector<qint64> order;
+    };
+
+    // stale holds the files of a replaced layout, removed once the manifest
+    // names the new one.
+    struct ShardedSave {
+        QVector<ShardWrite> shards;
+        QVector<ShardWrite> stale;
+        bool manifest = false;
+        quint64 manifestTicket = 0;
+        QJsonObject naming;
+        int characterShardCount = 0;
+        int groupShardCount = 0;
+        QSet<QString> editedCharacters;
+        QSet<QString> editedGroups;
+    };
+
     QString charactersPath() const;
     QString groupsPath() const;
+    QString shardDirectory() const;
+    RosterData snapshot() const;
+    ShardedSave takeDirtyShards();
+    void restoreDirtyShards(const ShardedSave &save);
+    void finishSave(const ShardedSave &save);
+    static bool writeShards(const QString &basePath, const ShardedSave &save, const StoreProgress &progress);
+    void growShards();
+    static RosterData readSingleFiles(const QString &basePath, const StoreProgress &progress, RosterFiles files);
+    // Null shard lists read every shard of that list.
+    static RosterData readShards(const QString &basePath, RosterFiles files, const QVector<int> *characterShards, const QVector<int> *groupShards,
+                                 const StoreProgress &progress);
+    RosterData mergePartial(RosterData data) const;
+    void adoptShards(const RosterData &data);
+    static FileStamp stampOf(const QString &path);
+    QStringList watchedFiles() const;
+    void startReload();
+    void finishReload();
+    void watchFiles();
+    void rebuildIndexes();
+    void indexTags(const RosterCharacter &character);
+    void unindexTags(const RosterCharacter &character);
+    int findCharacter(const QString &name) const;
+    int findGroup(const QString &name) const;
+    static bool writeFiles(const QString &basePath, const RosterData &data, quint64 charactersTicket, quint64 groupsTicket, const StoreProgress &progress);
 
     QVector<RosterCharacter> m_characters;
     QVector<RosterGroup> m_groups;
     MassAddNaming m_defaultNaming;
-    QString m_basePath;
+    mutable QString m_basePath;
+
+    // Case-folded name to position (the first, if names repeat), and tag to
+    // the case-folded names carrying it. Patched by applyChanges().
+    QHash<QString, int> m_characterIndex;
+    QHash<QString, int> m_groupIndex;
+    QHash<QString, QSet<QString>> m_tagIndex;
+
+    QFileSystemWatcher *m_watcher = nullptr;
+    QTimer m_reloadTimer;
+    QFutureWatcher<RosterData> m_reloadWatcher;
+    bool m_reloadQueued = false;
+    QHash<QString, FileStamp> m_stamps;
+
+    ShardLayout m_characterShards;
+    ShardLayout m_groupShards;
+    bool m_manifestDirty = false;
 };
 
@@ -0,0 +1,69 @@
+#include "StoreIo.h"
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#include <atomic>
+#include <memory>
+
+namespace {
+
+struct PathState {
+    // Tickets are handed out without taking writeMutex so requesting a save
+    // never waits for a write in progress.
+    std::atomic<quint64> nextTicket{1};
+    QMutex writeMutex;
+    quint64 lastWritten = 0;
+};
+
+QMutex registryMutex;
+QHash<QString, std::shared_ptr<PathState>> registry;
+
+std::shared_ptr<PathState> stateFor(const QString &path) {
+    QMutexLocker locker(&registryMutex);
+    auto &state = registry[path];
+    if (!state) {
+        state = std::make_shared<PathState>();
+    }
+    return state;
+}
+
+} // namespace
+
+quint64 StoreWriteSequencer::reserve(const QString &path) {
+    return stateFor(path)->nextTicket.fetch_add(1);
+}
+
+bool StoreWriteSequencer::write(const QString &path, quint64 ticket, const QByteArray &data) {
+    const auto state = stateFor(path);
+    QMutexLocker locker(&state->writeMutex);
+    if (ticket < state->lastWritten) {
+        return true;
+    }
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(data);
+    if (!file.commit()) {
+        return false;
+    }
+    state->lastWritten = ticket;
+    return true;
+}
+
+bool StoreWriteSequencer::remove(const QString &path, quint64 ticket) {
+    const auto state = stateFor(path);
+    QMutexLocker locker(&state->writeMutex);
+    if (ticket < state->lastWritten) {
+        return true;
+    }
+    if (QFile::exists(path) && !QFile::remove(path)) {
+        return false;
+    }
+    state->lastWritten = ticket;
+    return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFuture>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QPromise>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <functional>
+
+// Progress sink for the store parsers and serializers. Returning false asks
+// the caller to stop; it then returns without a result.
+using StoreProgress = std::function<bool(int done, int total)>;
+
+// Forwards StoreProgress calls to a QPromise. The range is set on the first
+// call, and cancellation is reported back to the parser.
+template <typename T>
+StoreProgress promiseProgress(QPromise<T> &promise) {
+    return [&promise](int done, int total) {
+        if (done == 0) {
+            promise.setProgressRange(0, total);
+        }
+        promise.setProgressValue(done);
+        return !promise.isCanceled();
+    };
+}
+
+template <typename T>
+QFuture<T> readyFuture(T value) {
+    QPromise<T> promise;
+    promise.start();
+    promise.addResult(std::move(value));
+    promise.finish();
+    return promise.future();
+}
+
+// Orders writes to the same file across threads. A writer takes a ticket when
+// the save is requested and hands it back with the data. Writes to one path
+// never overlap, and a write whose ticket is older than the last completed
+// one is dropped, so the most recently requested save wins even when the
+// workers finish out of order.
+class StoreWriteSequencer {
+public:
+    static quint64 reserve(const QString &path);
+
+    // Returns false only on an I/O error; a superseded write counts as done.
+    static bool write(const QString &path, quint64 ticket, const QByteArray &data);
+    // Same ordering for deleting the file; a missing file counts as removed.
+    static bool remove(const QString &path, quint64 ticket);
+};
+
+// Converts array[i] into out[i] for every element. out must already hold
+// array.size() entries. Large arrays are split into chunks and run on the
+// global pool. Progress is reported on the calling thread between batches,
+// as offset + converted out of total. Returns false if progress cancels.
+template <typename T, typename Convert>
+bool convertJsonArray(const QJsonArray &array, T *out, const Convert &convert, const StoreProgress &progress, int offset, int total) {
+    constexpr int kChunk = 2048;
+    const int count = static_cast<int>(array.size());
+    const int batch = kChunk * std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+    QVector<int> chunkStarts;
+    for (int start = 0; start < count; start += batch) {
+        if (progress && !progress(offset + start, total)) {
+            return false;
+        }
+        const int end = std::min(count, start + batch);
+        if (end - start <= kChunk) {
+            for (int i = start; i < end; ++i) {
+                out[i] = convert(array.at(i).toObject());
+            }
+            continue;
+        }
+        chunkStarts.clear();
+        for (int chunk = start; chunk < end; chunk += kChunk) {
+            chunkStarts.push_back(chunk);
+        }
+        // The calling thread takes part in blockingMap, so this is safe from
+        // inside a pool task such as loadAsync.
+        QtConcurrent::blockingMap(chunkStarts, [&array, out, &convert, end](int chunk) {
+            const int chunkEnd = std::min(end, chunk + kChunk);
+            for (int i = chunk; i < chunkEnd; ++i) {
+                out[i] = convert(array.at(i).toObject());
+            }
+        });
+    }
+    return true;
+}
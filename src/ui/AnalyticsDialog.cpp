@@ -0,0 +1,111 @@
+#include "AnalyticsDialog.h"
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDialogButtonBox>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileDialog>
+#include <QFormLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QTextEdit>
+#include <QVBoxLayout>
+
+AnalyticsDialog::AnalyticsDialog(CampaignAnalytics &analytics, QWidget *parent)
+    : QDialog(parent)
+    , m_analytics(analytics) {
+    setWindowTitle(tr("Campaign Statistics"));
+
+    auto *layout = new QVBoxLayout(this);
+    m_summaryText = new QTextEdit(this);
+    m_summaryText->setReadOnly(true);
+    layout->addWidget(m_summaryText);
+
+    auto *form = new QFormLayout();
+    m_groupCombo = new QComboBox(this);
+    m_measureCombo = new QComboBox(this);
+    for (int field = 0; field < CampaignAnalytics::kFieldCount; ++field) {
+        const auto name = CampaignAnalytics::fieldName(static_cast<AnalyticsField>(field));
+        m_groupCombo->addItem(name, field);
+        m_measureCombo->addItem(name, field);
+    }
+    m_groupCombo->setCurrentIndex(static_cast<int>(AnalyticsField::Name));
+    m_measureCombo->setCurrentIndex(static_cast<int>(AnalyticsField::DamageTaken));
+    m_aggregateCombo = new QComboBox(this);
+    m_aggregateCombo->addItem(tr("Count"), static_cast<int>(AnalyticsAggregate::Count));
+    m_aggregateCombo->addItem(tr("Sum"), static_cast<int>(AnalyticsAggregate::Sum));
+    m_aggregateCombo->addItem(tr("Average"), static_cast<int>(AnalyticsAggregate::Average));
+    m_aggregateCombo->addItem(tr("Minimum"), static_cast<int>(AnalyticsAggregate::Min));
+    m_aggregateCombo->addItem(tr("Maximum"), static_cast<int>(AnalyticsAggregate::Max));
+    m_aggregateCombo->setCurrentIndex(1);
+    m_pcsCheck = new QCheckBox(tr("Player characters only"), this);
+    form->addRow(tr("Group by"), m_groupCombo);
+    form->addRow(tr("Measure"), m_measureCombo);
+    form->addRow(tr("Aggregate"), m_aggregateCombo);
+    form->addRow(m_pcsCheck);
+    layout->addLayout(form);
+
+    auto *runButton = new QPushButton(tr("Run Query"), this);
+    layout->addWidget(runButton);
+    m_resultsTable = new QTableWidget(0, 3, this);
+    m_resultsTable->setHorizontalHeaderLabels({tr("Group"), tr("Rows"), tr("Value")});
+    m_resultsTable->horizontalHeader()->setStretchLastSection(true);
+    layout->addWidget(m_resultsTable);
+    m_statusLabel = new QLabel(this);
+    layout->addWidget(m_statusLabel);
+
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    auto *addButton = buttons->addButton(tr("Add Encounters..."), QDialogButtonBox::ActionRole);
+    layout->addWidget(buttons);
+
+    connect(runButton, &QPushButton::clicked, this, &AnalyticsDialog::runQuery);
+    connect(addButton, &QPushButton::clicked, this, &AnalyticsDialog::addEncounters);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    resize(560, 640);
+    refreshSummary();
+}
+
+void AnalyticsDialog::addEncounters() {
+    const auto directory = QFileDialog::getExistingDirectory(this, tr("Folder of Saved Encounters"));
+    if (directory.isEmpty()) {
+        return;
+    }
+    const QDir dir(directory);
+    int added = 0;
+    for (const auto &name : dir.entryList({QStringLiteral("*.json")}, QDir::Files, QDir::Name)) {
+        added += m_analytics.addEncounterFile(dir.filePath(name)) ? 1 : 0;
+    }
+    m_statusLabel->setText(tr("Added %n encounter(s)", nullptr, added));
+    refreshSummary();
+}
+
+void AnalyticsDialog::runQuery() {
+    AnalyticsQuery query;
+    const auto groupBy = static_cast<AnalyticsField>(m_groupCombo->currentData().toInt());
+    query.groupBy = groupBy;
+    query.measure = static_cast<AnalyticsField>(m_measureCombo->currentData().toInt());
+    query.aggregate = static_cast<AnalyticsAggregate>(m_aggregateCombo->currentData().toInt());
+    if (m_pcsCheck->isChecked()) {
+        query.filters.push_back({AnalyticsField::IsPC, AnalyticsOp::Equal, 1});
+    }
+    QElapsedTimer timer;
+    timer.start();
+    const auto groups = m_analytics.run(query);
+    const double elapsedMs = double(timer.nsecsElapsed()) / 1e6;
+
+    m_resultsTable->setRowCount(static_cast<int>(groups.size()));
+    for (int row = 0; row < groups.size(); ++row) {
+        const auto &group = groups.at(row);
+        m_resultsTable->setItem(row, 0, new QTableWidgetItem(m_analytics.label(groupBy, group.key)));
+        m_resultsTable->setItem(row, 1, new QTableWidgetItem(QString::number(group.count)));
+        m_resultsTable->setItem(row, 2, new QTableWidgetItem(QString::number(group.value, 'g', 10)));
+    }
+    m_statusLabel->setText(tr("%n group(s) in %1 ms", nullptr, static_cast<int>(groups.size())).arg(elapsedMs, 0, 'f', 2));
+}
+
+void AnalyticsDialog::refreshSummary() {
+    m_summaryText->setPlainText(m_analytics.summary().join(QStringLiteral("\n")));
+}
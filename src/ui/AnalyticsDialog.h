@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QDialog>
+
+#include "analytics/CampaignAnalytics.h"
+
+class QCheckBox;
+class QComboBox;
+class QLabel;
+class QTableWidget;
+class QTextEdit;
+
+// Campaign statistics: the standard summary plus ad-hoc grouped queries over
+// the given store. Encounter files added here go into that store.
+class AnalyticsDialog : public QDialog {
+    Q_OBJECT
+public:
+    explicit AnalyticsDialog(CampaignAnalytics &analytics, QWidget *parent = nullptr);
+
+private slots:
+    void addEncounters();
+    void runQuery();
+
+private:
+    void refreshSummary();
+
+    CampaignAnalytics &m_analytics;
+
+    QTextEdit *m_summaryText = nullptr;
+    QComboBox *m_groupCombo = nullptr;
+    QComboBox *m_measureCombo = nullptr;
+    QComboBox *m_aggregateCombo = nullptr;
+    QCheckBox *m_pcsCheck = nullptr;
+    QTableWidget *m_resultsTable = nullptr;
+    QLabel *m_statusLabel = nullptr;
+};
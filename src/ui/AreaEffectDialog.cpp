@@ -0,0 +1,92 @@
+#include "AreaEffectDialog.h"
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QHeaderView>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTableWidget>
+#include <QVBoxLayout>
+
+AreaEffectDialog::AreaEffectDialog(const TurnManager &manager, QVector<int> rows, DiceRoller &roller, QWidget *parent)
+    : QDialog(parent)
+    , m_manager(manager)
+    , m_rows(std::move(rows))
+    , m_roller(roller) {
+    setWindowTitle(tr("Apply Effect to %n Target(s)", nullptr, static_cast<int>(m_rows.size())));
+
+    auto *layout = new QVBoxLayout(this);
+    auto *form = new QFormLayout();
+    m_dcSpin = new QSpinBox(this);
+    m_dcSpin->setRange(1, 40);
+    m_dcSpin->setValue(15);
+    m_sourceCombo = new QComboBox(this);
+    m_sourceCombo->addItem(tr("Dex modifier"), static_cast<int>(SaveModifierSource::DexMod));
+    m_sourceCombo->addItem(tr("Fixed"), static_cast<int>(SaveModifierSource::Fixed));
+    m_sourceCombo->addItem(tr("None"), static_cast<int>(SaveModifierSource::None));
+    m_fixedSpin = new QSpinBox(this);
+    m_fixedSpin->setRange(-10, 20);
+    m_damageEdit = new QLineEdit(QStringLiteral("8d6"), this);
+    m_halfCheck = new QCheckBox(tr("Half damage on a successful save"), this);
+    m_halfCheck->setChecked(true);
+    m_onceCheck = new QCheckBox(tr("Roll damage once for all targets"), this);
+    m_onceCheck->setChecked(true);
+    form->addRow(tr("Save DC"), m_dcSpin);
+    form->addRow(tr("Save modifier"), m_sourceCombo);
+    form->addRow(tr("Fixed modifier"), m_fixedSpin);
+    form->addRow(tr("Damage"), m_damageEdit);
+    form->addRow(m_halfCheck);
+    form->addRow(m_onceCheck);
+    layout->addLayout(form);
+
+    auto *rollButton = new QPushButton(tr("Roll"), this);
+    layout->addWidget(rollButton);
+
+    m_resultsTable = new QTableWidget(0, 5, this);
+    m_resultsTable->setHorizontalHeaderLabels({tr("Name"), tr("Save"), tr("Result"), tr("Damage"), tr("HP")});
+    m_resultsTable->horizontalHeader()->setStretchLastSection(true);
+    layout->addWidget(m_resultsTable);
+
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Apply | QDialogButtonBox::Cancel, this);
+    m_applyButton = buttons->button(QDialogButtonBox::Apply);
+    m_applyButton->setEnabled(false);
+    layout->addWidget(buttons);
+
+    connect(rollButton, &QPushButton::clicked, this, &AreaEffectDialog::rollEffect);
+    connect(m_applyButton, &QPushButton::clicked, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+}
+
+void AreaEffectDialog::rollEffect() {
+    const auto damage = DiceExpression::parse(m_damageEdit->text());
+    if (!damage) {
+        m_damageEdit->setFocus();
+        return;
+    }
+    AreaEffectSpec spec;
+    spec.saveDC = m_dcSpin->value();
+    spec.modifierSource = static_cast<SaveModifierSource>(m_sourceCombo->currentData().toInt());
+    spec.fixedModifier = m_fixedSpin->value();
+    spec.damage = *damage;
+    spec.halfOnSave = m_halfCheck->isChecked();
+    spec.rollDamageOnce = m_onceCheck->isChecked();
+    m_result = resolveAreaEffect(m_manager, m_rows, spec, m_roller);
+    populateResults();
+    m_applyButton->setEnabled(m_result.size() > 0);
+}
+
+void AreaEffectDialog::populateResults() {
+    m_resultsTable->setRowCount(m_result.size());
+    for (int i = 0; i < m_result.size(); ++i) {
+        const auto combatant = m_manager.combatantById(m_result.ids.at(i));
+        const QString name = combatant ? combatant->name.toString() : QString();
+        m_resultsTable->setItem(i, 0, new QTableWidgetItem(name));
+        m_resultsTable->setItem(i, 1, new QTableWidgetItem(QString::number(m_result.saveTotals.at(i))));
+        m_resultsTable->setItem(i, 2, new QTableWidgetItem(m_result.saved.at(i) ? tr("Saved") : tr("Failed")));
+        m_resultsTable->setItem(i, 3, new QTableWidgetItem(QString::number(m_result.damage.at(i))));
+        m_resultsTable->setItem(i, 4, new QTableWidgetItem(QStringLiteral("%1 → %2").arg(m_result.hpBefore.at(i)).arg(m_result.hpAfter.at(i))));
+    }
+}
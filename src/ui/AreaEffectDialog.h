@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QDialog>
+
+#include "models/AreaEffect.h"
+
+class QCheckBox;
+class QComboBox;
+class QLineEdit;
+class QPushButton;
+class QSpinBox;
+class QTableWidget;
+
+// Collects the save/damage parameters, rolls the effect for the selected rows
+// and shows the outcome for review. Accepting the dialog means "apply".
+class AreaEffectDialog : public QDialog {
+    Q_OBJECT
+public:
+    AreaEffectDialog(const TurnManager &manager, QVector<int> rows, DiceRoller &roller, QWidget *parent = nullptr);
+
+    const AreaEffectResult &result() const noexcept { return m_result; }
+
+private slots:
+    void rollEffect();
+
+private:
+    void populateResults();
+
+    const TurnManager &m_manager;
+    QVector<int> m_rows;
+    DiceRoller &m_roller;
+    AreaEffectResult m_result;
+
+    QSpinBox *m_dcSpin = nullptr;
+    QComboBox *m_sourceCombo = nullptr;
+    QSpinBox *m_fixedSpin = nullptr;
+    QLineEdit *m_damageEdit = nullptr;
+    QCheckBox *m_halfCheck = nullptr;
+    QCheckBox *m_onceCheck = nullptr;
+    QTableWidget *m_resultsTable = nullptr;
+    QPushButton *m_applyButton = nullptr;
+};
@@ -1,37 +1,120 @@
 #include "MainWindow.h"
 
 #include <QAction>
+#include <QActionGroup>
 #include <QApplication>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QDir>
 #include <QDockWidget>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QFutureWatcher>
 #include <QFormLayout>
+#include <QInputDialog>
 #include <QLabel>
 #include <QLineEdit>
 #include <QItemSelectionModel>
 #include <QMenu>
 #include <QMenuBar>
+#include <QMessageBox>
 #include <QSpinBox>
+#include <QStandardPaths>
 #include <QStatusBar>
 #include <QTableView>
 #include <QTextEdit>
+#include <QTimer>
 #include <QToolBar>
+#include <QVBoxLayout>
+#include <QtConcurrent>
 
+#include <algorithm>
+#include <limits>
+
+#include "AnalyticsDialog.h"
+#include "AreaEffectDialog.h"
+#include "stores/BestiaryImport.h"
 #include "undo/UndoCommands.h"
+#include "utils/StartupTimer.h"
+#include "utils/Trace.h"
+
+namespace {
+
+// About 1.5 million events, 24 bytes each, before the oldest are dropped.
+constexpr int kCombatLogSegments = 96;
+
+QString describeEvent(const CombatLog &log, const CombatEvent &event) {
+    const auto round = QObject::tr("Round %1: ").arg(event.round);
+    switch (event.type) {
+    case CombatEventType::TurnStarted:
+        return round + QObject::tr("turn started");
+    case CombatEventType::Roll:
+        return round + QObject::tr("rolled %1 (%2), total %3").arg(event.before).arg(log.text(event.text)).arg(event.after);
+    case CombatEventType::InitiativeChanged:
+        return round + QObject::tr("initiative %1 -> %2").arg(event.before).arg(event.after);
+    case CombatEventType::HpChanged:
+        return round + QObject::tr("HP %1 -> %2").arg(event.before).arg(event.after);
+    case CombatEventType::ConsciousChanged:
+        return round + (event.after ? QObject::tr("regained consciousness") : QObject::tr("fell unconscious"));
+    case CombatEventType::DeathSavesChanged:
+        return round
+               + QObject::tr("death saves %1 successes, %2 failures%3")
+                     .arg(event.after & 0xff)
+                     .arg((event.after >> 8) & 0xff)
+                     .arg(event.after & (1 << 16) ? QObject::tr(", dead") : event.after & (1 << 17) ? QObject::tr(", stable") : QString());
+    case CombatEventType::ConditionAdded:
+        return round + QObject::tr("gained %1 for %2 rounds").arg(log.text(event.text)).arg(event.after);
+    case CombatEventType::ConditionEnded:
+        return round + QObject::tr("lost %1").arg(log.text(event.text));
+    case CombatEventType::Added:
+        return round + QObject::tr("joined the encounter");
+    case CombatEventType::Removed:
+        return round + QObject::tr("left the encounter");
+    case CombatEventType::EncounterStarted:
+        return round + QObject::tr("encounter started");
+    }
+    return round;
+}
+
+} // namespace
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
-    , m_model(&m_turnManager, this) {
+    , m_model(&m_turnManager, this)
+    , m_undoHistory(&m_turnManager)
+    , m_combatLog(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QStringLiteral("/combat-log")) {
+    m_undoHistory.setByteBudget(m_settings.undoHistoryBudgetBytes());
+    m_turnManager.setInitiativeRules(m_settings.initiativeRules());
+    m_turnManager.setRoundStartReroll(m_settings.rerollEachRound() ? &m_diceRoller : nullptr);
+    m_turnManager.setAdvanceMode(m_settings.groupTurns() ? AdvanceMode::PerCohort : AdvanceMode::PerMember);
+    m_model.setUndoHistory(&m_undoHistory);
     setupUi();
     setupMenus();
     connectSignals();
-    populateSampleData();
+    startBackgroundLoads();
     updateStatusBar();
+    StartupTimer::mark(QStringLiteral("main window constructed"));
+    // Neither the editor dock nor the player broadcast is needed for the first frame.
+    QTimer::singleShot(0, this, &MainWindow::setupEditorDock);
+    QTimer::singleShot(0, this, &MainWindow::setupBroadcast);
+    QTimer::singleShot(0, this, &MainWindow::setupCombatLog);
 }
 
 void MainWindow::setupUi() {
     m_tableView = new QTableView(this);
     m_tableView->setModel(&m_model);
+    m_tableView->setSelectionBehavior(QAbstractItemView::SelectRows);
     setCentralWidget(m_tableView);
 
+    auto *toolBar = addToolBar(tr("Turns"));
+    toolBar->addAction(tr("Prev"), this, &MainWindow::handlePreviousTurn);
+    toolBar->addAction(tr("Next"), this, &MainWindow::handleNextTurn);
+
+    statusBar()->showMessage(tr("Ready"));
+}
+
+void MainWindow::setupEditorDock() {
+    TRACE_SCOPE("MainWindow::setupEditorDock");
     auto *editorDock = new QDockWidget(tr("Editor"), this);
     auto *editorWidget = new QWidget(editorDock);
     auto *form = new QFormLayout(editorWidget);
@@ -46,34 +129,17 @@ void MainWindow::setupUi() {
     editorDock->setWidget(editorWidget);
     addDockWidget(Qt::RightDockWidgetArea, editorDock);
 
-    auto *toolBar = addToolBar(tr("Turns"));
-    toolBar->addAction(tr("Prev"), this, &MainWindow::handlePreviousTurn);
-    toolBar->addAction(tr("Next"), this, &MainWindow::handleNextTurn);
-
-    statusBar()->showMessage(tr("Ready"));
-}
-
-void MainWindow::setupMenus() {
-    auto *turnMenu = menuBar()->addMenu(tr("Encounter"));
-    turnMenu->addAction(tr("Previous Turn"), this, &MainWindow::handlePreviousTurn, QKeySequence(Qt::Key_PageUp));
-    turnMenu->addAction(tr("Next Turn"), this, &MainWindow::handleNextTurn, QKeySequence(Qt::Key_PageDown));
-
-    auto *rollMenu = menuBar()->addMenu(tr("Roll"));
-    rollMenu->addAction(tr("Normal"), this, &MainWindow::handleRollNormal, QKeySequence(tr("Ctrl+R")));
-    rollMenu->addAction(tr("Advantage"), this, &MainWindow::handleRollAdvantage);
-    rollMenu->addAction(tr("Disadvantage"), this, &MainWindow::handleRollDisadvantage);
-}
-
-void MainWindow::connectSignals() {
-    connect(m_tableView->selectionModel(), &QItemSelectionModel::currentRowChanged, this, [this](const QModelIndex &current) {
+    const auto showCombatant = [this](const QModelIndex &current) {
         if (!current.isValid()) {
             return;
         }
         const auto &combatant = m_turnManager.combatants().at(current.row());
-        m_nameEdit->setText(combatant.name);
+        m_nameEdit->setText(combatant.name.toString());
         m_initiativeSpin->setValue(combatant.initiative);
         m_notesEdit->setPlainText(combatant.notes);
-    });
+    };
+    connect(m_tableView->selectionModel(), &QItemSelectionModel::currentRowChanged, this, showCombatant);
+    showCombatant(m_tableView->currentIndex());
 
     connect(m_nameEdit, &QLineEdit::textEdited, this, [this](const QString &text) {
         const auto index = m_tableView->currentIndex();
@@ -95,10 +161,193 @@ void MainWindow::connectSignals() {
             m_model.setData(m_model.index(index.row(), InitiativeModel::ColumnNotes), m_notesEdit->toPlainText(), Qt::EditRole);
         }
     });
+    StartupTimer::mark(QStringLiteral("editor dock ready"));
+}
+
+void MainWindow::setupMenus() {
+    auto *editMenu = menuBar()->addMenu(tr("Edit"));
+    editMenu->addAction(tr("Undo"), this, &MainWindow::handleUndo, QKeySequence::Undo);
+    editMenu->addAction(tr("Redo"), this, &MainWindow::handleRedo, QKeySequence::Redo);
 
+    auto *turnMenu = menuBar()->addMenu(tr("Encounter"));
+    turnMenu->addAction(tr("Previous Turn"), this, &MainWindow::handlePreviousTurn, QKeySequence(Qt::Key_PageUp));
+    turnMenu->addAction(tr("Next Turn"), this, &MainWindow::handleNextTurn, QKeySequence(Qt::Key_PageDown));
+    turnMenu->addSeparator();
+    turnMenu->addAction(tr("Add Group..."), this, &MainWindow::handleAddGroup);
+    turnMenu->addAction(tr("Apply Effect..."), this, &MainWindow::handleApplyEffect);
+    turnMenu->addAction(tr("Add Mob..."), this, &MainWindow::handleAddMob);
+    turnMenu->addAction(tr("Damage Mob..."), this, &MainWindow::handleDamageMob);
+    turnMenu->addAction(tr("Split Mob"), this, &MainWindow::handleSplitMob);
+    turnMenu->addAction(tr("Combatant History..."), this, &MainWindow::handleCombatantHistory);
+    turnMenu->addAction(tr("Campaign Statistics..."), this, &MainWindow::handleCampaignStatistics);
+    turnMenu->addAction(tr("Import Roster..."), this, &MainWindow::handleImportRoster);
+    turnMenu->addAction(tr("Export Roster..."), this, &MainWindow::handleExportRoster);
+    turnMenu->addAction(tr("Import Bestiary..."), this, &MainWindow::handleImportBestiary);
+    auto *groupTurnsAction = turnMenu->addAction(tr("Groups Act Together"));
+    groupTurnsAction->setCheckable(true);
+    groupTurnsAction->setChecked(m_settings.groupTurns());
+    connect(groupTurnsAction, &QAction::toggled, this, [this](bool enabled) {
+        m_settings.setGroupTurns(enabled);
+        m_turnManager.setAdvanceMode(enabled ? AdvanceMode::PerCohort : AdvanceMode::PerMember);
+    });
+
+    auto *rulesMenu = turnMenu->addMenu(tr("Initiative Ties"));
+    auto *rulesGroup = new QActionGroup(rulesMenu);
+    const struct {
+        const char *label;
+        InitiativeRules rules;
+    } ruleChoices[] = {
+        {QT_TR_NOOP("Dex Mod, PCs First"), InitiativeRules::Standard},
+        {QT_TR_NOOP("Dex Mod, NPCs First"), InitiativeRules::NpcsWinTies},
+        {QT_TR_NOOP("Dex Score"), InitiativeRules::DexScore},
+        {QT_TR_NOOP("Random Roll-Off"), InitiativeRules::RandomTiebreak},
+        {QT_TR_NOOP("Side Initiative"), InitiativeRules::SideInitiative},
+    };
+    for (const auto &choice : ruleChoices) {
+        auto *action = rulesMenu->addAction(tr(choice.label));
+        action->setCheckable(true);
+        action->setChecked(m_turnManager.initiativeRules() == choice.rules);
+        rulesGroup->addAction(action);
+        const auto rules = choice.rules;
+        connect(action, &QAction::triggered, this, [this, rules]() {
+            m_settings.setInitiativeRules(rules);
+            m_turnManager.setInitiativeRules(rules);
+            m_model.refresh();
+            updateStatusBar();
+        });
+    }
+
+    auto *rollMenu = menuBar()->addMenu(tr("Roll"));
+    rollMenu->addAction(tr("Normal"), this, &MainWindow::handleRollNormal, QKeySequence(tr("Ctrl+R")));
+    rollMenu->addAction(tr("Advantage"), this, &MainWindow::handleRollAdvantage);
+    rollMenu->addAction(tr("Disadvantage"), this, &MainWindow::handleRollDisadvantage);
+    rollMenu->addSeparator();
+    rollMenu->addAction(tr("Re-roll Everyone"), this, [this]() {
+        m_turnManager.rerollInitiative(m_diceRoller, RollMode::Normal);
+        m_model.refresh();
+        updateStatusBar();
+    });
+    auto *rerollAction = rollMenu->addAction(tr("Re-roll Each Round"));
+    rerollAction->setCheckable(true);
+    rerollAction->setChecked(m_turnManager.roundStartReroll());
+    connect(rerollAction, &QAction::toggled, this, [this](bool enabled) {
+        m_settings.setRerollEachRound(enabled);
+        m_turnManager.setRoundStartReroll(enabled ? &m_diceRoller : nullptr);
+    });
+}
+
+void MainWindow::connectSignals() {
     connect(m_tableView->selectionModel(), &QItemSelectionModel::currentRowChanged, this, [this](const QModelIndex &) {
         updateStatusBar();
     });
+    connect(&m_model, &QAbstractItemModel::dataChanged, this, &MainWindow::schedulePublish);
+    connect(&m_model, &QAbstractItemModel::layoutChanged, this, &MainWindow::schedulePublish);
+    connect(&m_model, &QAbstractItemModel::modelReset, this, &MainWindow::schedulePublish);
+    connect(&m_model, &QAbstractItemModel::rowsInserted, this, &MainWindow::schedulePublish);
+    connect(&m_model, &QAbstractItemModel::rowsRemoved, this, &MainWindow::schedulePublish);
+}
+
+void MainWindow::setupBroadcast() {
+    const auto port = m_settings.broadcastPort();
+    if (port == 0) {
+        return;
+    }
+    m_broadcast.setStreamerMode(m_settings.streamerMode());
+    if (!m_broadcast.listen(port)) {
+        statusBar()->showMessage(tr("Player broadcast unavailable: %1").arg(m_broadcast.errorString()));
+        return;
+    }
+    schedulePublish();
+}
+
+// Opening rebuilds the log's index from disk, so it waits for the first frame.
+void MainWindow::setupCombatLog() {
+    TRACE_SCOPE("MainWindow::setupCombatLog");
+    m_combatLog.setMaxSegments(kCombatLogSegments);
+    if (!m_combatLog.open()) {
+        statusBar()->showMessage(tr("Combat log unavailable in %1").arg(m_combatLog.directory()));
+        return;
+    }
+    m_turnManager.setEventLog(&m_combatLog);
+    connect(&m_diceRoller, &DiceRoller::rollPerformed, this, [this](int raw, RollMode mode, int, int total) {
+        static const QString modes[] = {QStringLiteral("normal"), QStringLiteral("advantage"), QStringLiteral("disadvantage")};
+        const auto &version = m_turnManager.currentVersion();
+        m_combatLog.append(CombatEventType::Roll, version.round, version.turnIndex, 0, raw, total, modes[int(mode)]);
+    });
+}
+
+// Coalesces every change made in one event-loop pass into a single publish.
+void MainWindow::schedulePublish() {
+    if (!m_broadcast.isListening() || m_publishPending) {
+        return;
+    }
+    m_publishPending = true;
+    QTimer::singleShot(0, this, [this]() {
+        m_publishPending = false;
+        m_broadcast.publish(m_turnManager);
+    });
+}
+
+void MainWindow::startBackgroundLoads() {
+    // Parsing runs on the pool; results are moved out of the futures and
+    // applied here on the GUI thread.
+    auto *rosterWatcher = new QFutureWatcher<RosterData>(this);
+    connect(rosterWatcher, &QFutureWatcher<RosterData>::finished, this, [this, rosterWatcher]() {
+        auto future = rosterWatcher->future();
+        rosterWatcher->deleteLater();
+        if (future.resultCount() > 0) {
+            m_rosterStore.apply(future.takeResult());
+        }
+        m_rosterLoaded = true;
+        StartupTimer::mark(QStringLiteral("roster loaded"));
+        // The roster folder is often synced from a shared drive.
+        connect(&m_rosterStore, &RosterStore::rosterChanged, this, [this](const RosterChanges &changes) {
+            if (changes.reset) {
+                return;
+            }
+            const int characters = changes.insertedCharacters.size() + changes.updatedCharacters.size() + changes.removedCharacters.size();
+            const int groups = changes.insertedGroups.size() + changes.updatedGroups.size() + changes.removedGroups.size();
+            statusBar()->showMessage(tr("Roster reloaded: %1 character(s) and %2 group(s) changed").arg(characters).arg(groups), 5000);
+        });
+        m_rosterStore.setWatching(true);
+    });
+    rosterWatcher->setFuture(m_rosterStore.loadAsync());
+
+    const auto encounterPath = m_settings.lastEncounterPath();
+    if (encounterPath.isEmpty()) {
+        populateSampleData();
+        return;
+    }
+    m_encounterStore.setFilePath(encounterPath);
+    auto *encounterWatcher = new QFutureWatcher<EncounterData>(this);
+    // The table is usable while the file loads; edits made meanwhile must not
+    // be overwritten silently.
+    const auto generation = m_turnManager.generation();
+    connect(encounterWatcher, &QFutureWatcher<EncounterData>::finished, this, [this, encounterWatcher, generation]() {
+        auto future = encounterWatcher->future();
+        encounterWatcher->deleteLater();
+        StartupTimer::mark(QStringLiteral("encounter loaded"));
+        const bool edited = m_turnManager.generation() != generation || m_undoHistory.count() > 0;
+        if (future.resultCount() == 0) {
+            if (!edited) {
+                populateSampleData();
+            }
+            return;
+        }
+        if (edited
+            && QMessageBox::question(this, tr("Restore Encounter"), tr("The last encounter finished loading after the table was changed. Replace the table with it?"))
+                   != QMessageBox::Yes) {
+            return;
+        }
+        auto encounter = future.takeResult();
+        m_turnManager.setCombatants(std::move(encounter.combatants), std::move(encounter.cohorts));
+        m_turnManager.setTurnState(encounter.round, encounter.turnIndex);
+        // Commands pushed before the restore describe a table that is gone.
+        m_undoHistory.clear();
+        m_model.refresh();
+        updateStatusBar();
+    });
+    encounterWatcher->setFuture(m_encounterStore.loadAsync());
 }
 
 void MainWindow::populateSampleData() {
@@ -131,49 +380,377 @@ void MainWindow::populateSampleData() {
 }
 
 void MainWindow::handleNextTurn() {
+    TRACE_SCOPE("MainWindow::handleNextTurn");
     m_turnManager.advanceTurn();
     updateStatusBar();
 }
 
 void MainWindow::handlePreviousTurn() {
+    TRACE_SCOPE("MainWindow::handlePreviousTurn");
     m_turnManager.rewindTurn();
     updateStatusBar();
 }
 
 void MainWindow::handleRollNormal() {
+    rollInitiativeForCurrent(RollMode::Normal);
+}
+
+void MainWindow::handleRollAdvantage() {
+    rollInitiativeForCurrent(RollMode::Advantage);
+}
+
+void MainWindow::handleRollDisadvantage() {
+    rollInitiativeForCurrent(RollMode::Disadvantage);
+}
+
+void MainWindow::rollInitiativeForCurrent(RollMode mode) {
+    TRACE_SCOPE("MainWindow::rollInitiativeForCurrent");
     const auto index = m_tableView->currentIndex();
     if (!index.isValid()) {
         return;
     }
-    auto &combatant = m_turnManager.combatants()[index.row()];
-    combatant.initiative = m_diceRoller.rollD20(RollMode::Normal, combatant.dexMod);
-    m_turnManager.sortCombatants();
+    const int id = m_turnManager.combatants().at(index.row()).id;
+    m_turnManager.updateCombatant(id, [this, mode](Combatant &combatant) {
+        combatant.initiative = m_diceRoller.rollD20(mode, combatant.dexMod);
+        combatant.tiebreak = m_diceRoller.rollTiebreak();
+    });
     m_model.refresh();
 }
 
-void MainWindow::handleRollAdvantage() {
+void MainWindow::handleAddGroup() {
+    TRACE_SCOPE("MainWindow::handleAddGroup");
+    QStringList names;
+    for (const auto &group : m_rosterStore.groups()) {
+        names << group.name;
+    }
+    if (names.isEmpty()) {
+        statusBar()->showMessage(m_rosterLoaded ? tr("No roster groups defined") : tr("Roster is still loading"));
+        return;
+    }
+    bool ok = false;
+    const auto name = QInputDialog::getItem(this, tr("Add Group"), tr("Group"), names, 0, false, &ok);
+    if (!ok) {
+        return;
+    }
+    auto combatants = m_rosterStore.massAddGroup(name, m_rosterStore.defaultNaming());
+    if (combatants.isEmpty()) {
+        return;
+    }
+    std::optional<Cohort> cohort;
+    if (m_settings.groupTurns()) {
+        cohort.emplace();
+        cohort->id = m_turnManager.nextCohortId();
+        cohort->name = name;
+        cohort->dexMod = combatants.first().dexMod;
+        cohort->initiative = m_diceRoller.rollD20(RollMode::Normal, cohort->dexMod);
+    }
+    int id = nextCombatantId();
+    for (auto &combatant : combatants) {
+        combatant.id = id++;
+        if (cohort) {
+            combatant.cohort = cohort->id;
+            combatant.initiative = cohort->initiative;
+        }
+    }
+    // The cohort is created and undone together with its members.
+    m_undoHistory.push(new AddCombatantsCommand(&m_turnManager, combatants, cohort));
+    m_model.refresh();
+    updateStatusBar();
+}
+
+void MainWindow::handleAddMob() {
+    TRACE_SCOPE("MainWindow::handleAddMob");
+    QStringList names;
+    for (const auto &character : m_rosterStore.characters()) {
+        names << character.name;
+    }
+    if (names.isEmpty()) {
+        statusBar()->showMessage(m_rosterLoaded ? tr("No roster characters defined") : tr("Roster is still loading"));
+        return;
+    }
+    bool ok = false;
+    const auto name = QInputDialog::getItem(this, tr("Add Mob"), tr("Character"), names, 0, false, &ok);
+    if (!ok) {
+        return;
+    }
+    const int count = QInputDialog::getInt(this, tr("Add Mob"), tr("Members"), 20, 2, 10000, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    // Members need HP to stand; the roster default is only a suggestion.
+    const auto character = m_rosterStore.character(name);
+    const int suggested = character && character->defaultHP > 0 ? std::min<int>(character->defaultHP, std::numeric_limits<qint16>::max()) : 10;
+    // MobMembers stores member HP as qint16.
+    const int memberHP = QInputDialog::getInt(this, tr("Add Mob"), tr("HP per member"), suggested, 1, std::numeric_limits<qint16>::max(), 1, &ok);
+    if (!ok) {
+        return;
+    }
+    auto mob = m_rosterStore.massAddMob(name, count, memberHP);
+    if (!mob) {
+        return;
+    }
+    mob->id = nextCombatantId();
+    mob->initiative = m_diceRoller.rollD20(RollMode::Normal, mob->dexMod);
+    mob->tiebreak = m_diceRoller.rollTiebreak();
+    m_undoHistory.push(new AddCombatantCommand(&m_turnManager, *mob));
+    m_model.refresh();
+    updateStatusBar();
+}
+
+std::optional<Combatant> MainWindow::selectedMob() {
     const auto index = m_tableView->currentIndex();
-    if (!index.isValid()) {
+    if (!index.isValid() || !m_turnManager.combatants().at(index.row()).isMob()) {
+        statusBar()->showMessage(tr("Select a mob first"));
+        return std::nullopt;
+    }
+    return m_turnManager.combatants().at(index.row());
+}
+
+void MainWindow::handleDamageMob() {
+    TRACE_SCOPE("MainWindow::handleDamageMob");
+    const auto mob = selectedMob();
+    if (!mob) {
         return;
     }
-    auto &combatant = m_turnManager.combatants()[index.row()];
-    combatant.initiative = m_diceRoller.rollD20(RollMode::Advantage, combatant.dexMod);
-    m_turnManager.sortCombatants();
+    bool ok = false;
+    const int amount = QInputDialog::getInt(this, tr("Damage Mob"), tr("Damage"), 1, 1, 100000, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    const struct {
+        const char *label;
+        MobDamage spread;
+    } spreads[] = {
+        {QT_TR_NOOP("One member, excess carries over"), MobDamage::Overflow},
+        {QT_TR_NOOP("One member only"), MobDamage::Focus},
+        {QT_TR_NOOP("Every standing member"), MobDamage::Each},
+    };
+    QStringList labels;
+    for (const auto &choice : spreads) {
+        labels << tr(choice.label);
+    }
+    const auto label = QInputDialog::getItem(this, tr("Damage Mob"), tr("Spread"), labels, 0, false, &ok);
+    if (!ok) {
+        return;
+    }
+    Combatant after = *mob;
+    const int dropped = after.mob.applyDamage(amount, spreads[labels.indexOf(label)].spread);
+    after.syncMobSummary();
+    m_undoHistory.push(new EditCombatantCommand(&m_turnManager, mob->id, *mob, after));
     m_model.refresh();
+    statusBar()->showMessage(tr("%n member(s) dropped", nullptr, dropped));
 }
 
-void MainWindow::handleRollDisadvantage() {
+void MainWindow::handleSplitMob() {
+    TRACE_SCOPE("MainWindow::handleSplitMob");
+    const auto mob = selectedMob();
+    if (!mob) {
+        return;
+    }
+    m_undoHistory.push(new SplitMobCommand(&m_turnManager, *mob, nextCombatantId()));
+    m_model.refresh();
+    updateStatusBar();
+}
+
+void MainWindow::handleApplyEffect() {
+    TRACE_SCOPE("MainWindow::handleApplyEffect");
+    QVector<int> rows;
+    for (const auto &index : m_tableView->selectionModel()->selectedRows()) {
+        rows.append(index.row());
+    }
+    if (rows.isEmpty()) {
+        statusBar()->showMessage(tr("Select the targets first"));
+        return;
+    }
+    std::sort(rows.begin(), rows.end());
+    AreaEffectDialog dialog(m_turnManager, rows, m_diceRoller, this);
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+    QVector<Combatant> before;
+    QVector<Combatant> after;
+    dialog.result().collectEdits(m_turnManager, before, after);
+    auto *command = new ApplyToManyCommand(&m_turnManager, before, after);
+    if (command->isEmpty()) {
+        delete command;
+        return;
+    }
+    m_undoHistory.push(command);
+    m_model.refresh();
+    updateStatusBar();
+}
+
+int MainWindow::nextCombatantId() const {
+    int maxId = 0;
+    for (const auto &combatant : m_turnManager.combatants()) {
+        maxId = std::max(maxId, combatant.id);
+    }
+    return maxId + 1;
+}
+
+void MainWindow::handleCombatantHistory() {
+    TRACE_SCOPE("MainWindow::handleCombatantHistory");
+    if (!m_combatLog.isOpen()) {
+        statusBar()->showMessage(tr("Combat log unavailable in %1").arg(m_combatLog.directory()));
+        return;
+    }
     const auto index = m_tableView->currentIndex();
     if (!index.isValid()) {
+        statusBar()->showMessage(tr("Select a combatant first"));
+        return;
+    }
+    const auto combatant = m_turnManager.combatants().at(index.row());
+    const int round = m_turnManager.currentVersion().round;
+    bool ok = false;
+    const int firstRound = QInputDialog::getInt(this, tr("Combatant History"), tr("From round"), 1, 0, round, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    const int lastRound = QInputDialog::getInt(this, tr("Combatant History"), tr("To round"), round, firstRound, round, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    QStringList lines;
+    // Ids restart with every fight, so only this one's events belong to the row.
+    for (const auto &event : m_combatLog.eventsFor(combatant.id, firstRound, lastRound, m_combatLog.encounterStart())) {
+        lines.append(describeEvent(m_combatLog, event));
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("History of %1").arg(combatant.name.toString()));
+    auto *layout = new QVBoxLayout(&dialog);
+    auto *text = new QTextEdit(&dialog);
+    text->setReadOnly(true);
+    text->setPlainText(lines.isEmpty() ? tr("Nothing recorded in these rounds.") : lines.join(QStringLiteral("\n")));
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout->addWidget(text);
+    layout->addWidget(buttons);
+    dialog.resize(480, 360);
+    dialog.exec();
+}
+
+// The statistics live in one snapshot next to the combat log; each visit
+// adds the fights the log finished since the last one.
+void MainWindow::handleCampaignStatistics() {
+    TRACE_SCOPE("MainWindow::handleCampaignStatistics");
+    const QDir base(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+    const auto path = base.filePath(QStringLiteral("campaign.analytics"));
+    CampaignAnalytics analytics;
+    if (base.exists(QStringLiteral("campaign.analytics")) && !analytics.load(path)) {
+        statusBar()->showMessage(tr("Campaign statistics were unreadable and have been rebuilt"));
+    }
+    if (m_combatLog.isOpen()) {
+        analytics.addCombatLog(m_combatLog);
+    }
+    AnalyticsDialog dialog(analytics, this);
+    dialog.exec();
+    if (!base.mkpath(QStringLiteral(".")) || !analytics.save(path)) {
+        statusBar()->showMessage(tr("Could not save campaign statistics to %1").arg(path));
+    }
+}
+
+void MainWindow::handleImportRoster() {
+    if (!m_rosterLoaded) {
+        statusBar()->showMessage(tr("Roster is still loading"));
+        return;
+    }
+    const auto directory = QFileDialog::getExistingDirectory(this, tr("Import Roster"), QDir::homePath());
+    if (directory.isEmpty()) {
+        return;
+    }
+    if (!m_rosterStore.importFiles(directory)) {
+        statusBar()->showMessage(tr("No characters.json or groups.json in %1").arg(directory));
+        return;
+    }
+    // The import is applied as a patch, so only the shards it touched are written.
+    if (!m_rosterStore.save()) {
+        statusBar()->showMessage(tr("Could not save the roster to %1").arg(m_rosterStore.basePath()));
+        return;
+    }
+    statusBar()->showMessage(tr("Roster imported from %1").arg(directory), 5000);
+}
+
+void MainWindow::handleExportRoster() {
+    const auto directory = QFileDialog::getExistingDirectory(this, tr("Export Roster"), QDir::homePath());
+    if (directory.isEmpty()) {
         return;
     }
-    auto &combatant = m_turnManager.combatants()[index.row()];
-    combatant.initiative = m_diceRoller.rollD20(RollMode::Disadvantage, combatant.dexMod);
-    m_turnManager.sortCombatants();
+    statusBar()->showMessage(m_rosterStore.exportFiles(directory) ? tr("Roster exported to %1").arg(directory)
+                                                                   : tr("Could not export the roster to %1").arg(directory),
+                             5000);
+}
+
+void MainWindow::handleImportBestiary() {
+    if (!m_rosterLoaded) {
+        statusBar()->showMessage(tr("Roster is still loading"));
+        return;
+    }
+    const auto path = QFileDialog::getOpenFileName(this, tr("Import Bestiary"), QDir::homePath(), tr("Spreadsheets (*.csv *.tsv *.txt)"));
+    if (path.isEmpty()) {
+        return;
+    }
+    auto *watcher = new QFutureWatcher<BestiaryResult>(this);
+    connect(watcher, &QFutureWatcher<BestiaryResult>::finished, this, [this, watcher, path]() {
+        auto future = watcher->future();
+        watcher->deleteLater();
+        if (future.resultCount() == 0) {
+            return;
+        }
+        auto result = future.takeResult();
+        if (!result.error.isEmpty()) {
+            statusBar()->showMessage(tr("Could not import %1: %2").arg(path, result.error));
+            return;
+        }
+        const int imported = result.data.characters.size();
+        m_rosterStore.merge(std::move(result.data));
+        if (!m_rosterStore.save()) {
+            statusBar()->showMessage(tr("Could not save the roster to %1").arg(m_rosterStore.basePath()));
+            return;
+        }
+        if (result.errors.isEmpty()) {
+            statusBar()->showMessage(tr("Imported %n monster(s)", nullptr, imported), 5000);
+            return;
+        }
+        statusBar()->showMessage(tr("Imported %1 monster(s); %2 row(s) skipped").arg(imported).arg(result.errors.size()));
+        QStringList lines;
+        lines.reserve(result.errors.size());
+        for (const auto &error : std::as_const(result.errors)) {
+            lines.append(tr("Row %1: %2").arg(error.row).arg(error.message));
+        }
+        QDialog dialog(this);
+        dialog.setWindowTitle(tr("Skipped Rows in %1").arg(QFileInfo(path).fileName()));
+        auto *layout = new QVBoxLayout(&dialog);
+        auto *text = new QTextEdit(&dialog);
+        text->setReadOnly(true);
+        text->setPlainText(lines.join(QStringLiteral("\n")));
+        auto *buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+        connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+        layout->addWidget(text);
+        layout->addWidget(buttons);
+        dialog.resize(480, 360);
+        dialog.exec();
+    });
+    watcher->setFuture(QtConcurrent::run([path]() { return BestiaryImport::readFile(path); }));
+}
+
+void MainWindow::handleUndo() {
+    TRACE_SCOPE("MainWindow::handleUndo");
+    m_undoHistory.undo();
+    m_model.refresh();
+    updateStatusBar();
+}
+
+void MainWindow::handleRedo() {
+    TRACE_SCOPE("MainWindow::handleRedo");
+    m_undoHistory.redo();
     m_model.refresh();
+    updateStatusBar();
 }
 
 void MainWindow::updateStatusBar() {
+    TRACE_SCOPE("MainWindow::updateStatusBar");
+    schedulePublish();
     if (m_turnManager.combatants().isEmpty()) {
         statusBar()->showMessage(tr("Round 0 • Turn 0/0"));
         return;
@@ -183,6 +760,6 @@ void MainWindow::updateStatusBar() {
                                  .arg(m_turnManager.round())
                                  .arg(m_turnManager.turnIndex() + 1)
                                  .arg(m_turnManager.combatants().size())
-                                 .arg(current.name));
+                                 .arg(current.name.toString()));
 }
 
@@ -1,13 +1,14 @@
 #pragma once
 
 #include <QMainWindow>
-#include <QUndoStack>
 
+#include "broadcast/BroadcastServer.h"
 #include "models/InitiativeModel.h"
 #include "models/TurnManager.h"
+#include "stores/CombatLog.h"
 #include "stores/EncounterStore.h"
 #include "stores/RosterStore.h"
-#include "undo/UndoCommands.h"
+#include "undo/UndoHistory.h"
 #include "utils/DiceRoller.h"
 #include "utils/Settings.h"
 
@@ -28,21 +29,47 @@ private slots:
     void handleRollNormal();
     void handleRollAdvantage();
     void handleRollDisadvantage();
+    void handleAddGroup();
+    void handleAddMob();
+    void handleDamageMob();
+    void handleSplitMob();
+    void handleApplyEffect();
+    void handleCombatantHistory();
+    void handleCampaignStatistics();
+    void handleImportRoster();
+    void handleExportRoster();
+    void handleImportBestiary();
+    void handleUndo();
+    void handleRedo();
     void updateStatusBar();
 
 private:
     void setupUi();
+    void setupEditorDock();
     void setupMenus();
     void connectSignals();
+    void startBackgroundLoads();
+    void setupBroadcast();
+    void setupCombatLog();
+    void schedulePublish();
     void populateSampleData();
+    void rollInitiativeForCurrent(RollMode mode);
+    int nextCombatantId() const;
+    // The selected row if it is a mob, otherwise reports why on the status bar.
+    std::optional<Combatant> selectedMob();
 
     TurnManager m_turnManager;
     InitiativeModel m_model;
-    QUndoStack m_undoStack;
+    UndoHistory m_undoHistory;
     DiceRoller m_diceRoller;
     Settings m_settings;
+    CombatLog m_combatLog;
     EncounterStore m_encounterStore;
     RosterStore m_rosterStore;
+    BroadcastServer m_broadcast;
+
+    bool m_rosterLoaded = false;
+    bool m_publishPending = false;
 
     QTableView *m_tableView = nullptr;
     QLineEdit *m_nameEdit = nullptr;
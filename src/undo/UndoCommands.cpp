@@ -2,11 +2,334 @@
 
 #include <algorithm>
 
+#include "utils/Arena.h"
+
+static qsizetype stringBytes(const QString &text) {
+    return text.size() * static_cast<qsizetype>(sizeof(QChar));
+}
+
+static qsizetype payloadBytes(const FieldValue &value) {
+    if (const auto *text = std::get_if<QString>(&value)) {
+        return stringBytes(*text);
+    }
+    if (const auto *name = std::get_if<CombatantName>(&value)) {
+        return name->ownedBytes();
+    }
+    if (const auto *conditions = std::get_if<ConditionList>(&value)) {
+        return conditions->heapBytes();
+    }
+    if (const auto *mob = std::get_if<MobMembers>(&value)) {
+        return mob->heapBytes();
+    }
+    return 0;
+}
+
+QVector<FieldDelta> diffCombatants(const Combatant &before, const Combatant &after) {
+    QVector<FieldDelta> deltas;
+    const int id = before.id;
+    if (before.name != after.name) {
+        deltas.push_back({id, CombatantField::Name, before.name, after.name});
+    }
+    if (before.initiative != after.initiative) {
+        deltas.push_back({id, CombatantField::Initiative, before.initiative, after.initiative});
+    }
+    if (before.dexMod != after.dexMod) {
+        deltas.push_back({id, CombatantField::DexMod, before.dexMod, after.dexMod});
+    }
+    if (before.isPC != after.isPC) {
+        deltas.push_back({id, CombatantField::IsPC, before.isPC, after.isPC});
+    }
+    if (before.conscious != after.conscious) {
+        deltas.push_back({id, CombatantField::Conscious, before.conscious, after.conscious});
+    }
+    if (before.hp != after.hp) {
+        deltas.push_back({id, CombatantField::HP, before.hp, after.hp});
+    }
+    if (before.ac != after.ac) {
+        deltas.push_back({id, CombatantField::AC, before.ac, after.ac});
+    }
+    if (!(before.deathSaves == after.deathSaves)) {
+        deltas.push_back({id, CombatantField::DeathSaves, before.deathSaves, after.deathSaves});
+    }
+    if (before.conditions != after.conditions) {
+        deltas.push_back({id, CombatantField::Conditions, before.conditions, after.conditions});
+    }
+    if (before.notes != after.notes) {
+        deltas.push_back({id, CombatantField::Notes, before.notes, after.notes});
+    }
+    if (before.dexScore != after.dexScore) {
+        deltas.push_back({id, CombatantField::DexScore, before.dexScore, after.dexScore});
+    }
+    if (before.tiebreak != after.tiebreak) {
+        deltas.push_back({id, CombatantField::Tiebreak, before.tiebreak, after.tiebreak});
+    }
+    if (before.side != after.side) {
+        deltas.push_back({id, CombatantField::Side, before.side, after.side});
+    }
+    if (before.cohort != after.cohort) {
+        deltas.push_back({id, CombatantField::Cohort, before.cohort, after.cohort});
+    }
+    if (before.mob != after.mob) {
+        deltas.push_back({id, CombatantField::Mob, before.mob, after.mob});
+    }
+    return deltas;
+}
+
+void applyFieldValue(Combatant &combatant, CombatantField field, const FieldValue &value) {
+    switch (field) {
+    case CombatantField::Name:
+        combatant.name = std::get<CombatantName>(value);
+        break;
+    case CombatantField::Initiative:
+        combatant.initiative = std::get<int>(value);
+        break;
+    case CombatantField::DexMod:
+        combatant.dexMod = std::get<int>(value);
+        break;
+    case CombatantField::IsPC:
+        combatant.isPC = std::get<bool>(value);
+        break;
+    case CombatantField::Conscious:
+        combatant.conscious = std::get<bool>(value);
+        break;
+    case CombatantField::HP:
+        combatant.hp = std::get<int>(value);
+        break;
+    case CombatantField::AC:
+        combatant.ac = std::get<int>(value);
+        break;
+    case CombatantField::DeathSaves:
+        combatant.deathSaves = std::get<DeathSaves>(value);
+        break;
+    case CombatantField::Conditions:
+        combatant.conditions = std::get<ConditionList>(value);
+        break;
+    case CombatantField::Notes:
+        combatant.notes = std::get<QString>(value);
+        break;
+    case CombatantField::DexScore:
+        combatant.dexScore = std::get<int>(value);
+        break;
+    case CombatantField::Tiebreak:
+        combatant.tiebreak = std::get<int>(value);
+        break;
+    case CombatantField::Side:
+        combatant.side = std::get<int>(value);
+        break;
+    case CombatantField::Cohort:
+        combatant.cohort = std::get<int>(value);
+        break;
+    case CombatantField::Mob:
+        combatant.mob = std::get<MobMembers>(value);
+        break;
+    }
+}
+
+qsizetype fieldDeltaBytes(const FieldDelta &delta) {
+    return static_cast<qsizetype>(sizeof(FieldDelta)) + payloadBytes(delta.before) + payloadBytes(delta.after);
+}
+
+qsizetype combatantBytes(const Combatant &combatant) {
+    return static_cast<qsizetype>(sizeof(Combatant)) + combatant.name.ownedBytes() + stringBytes(combatant.notes) + combatant.conditions.heapBytes() + combatant.mob.heapBytes();
+}
+
+// Applies deltas grouped per combatant through a single TurnManager batch, so
+// the whole set costs at most one sort and one recorded version.
+static void applyDeltas(TurnManager *manager, const QVector<FieldDelta> &deltas, bool useAfter) {
+    if (deltas.isEmpty()) {
+        return;
+    }
+    // Each combatant's deltas are chained through next in their original order.
+    ScratchArena scratch;
+    auto first = scratch.vector<int>();
+    auto last = scratch.vector<int>();
+    auto next = scratch.vector<int>(deltas.size(), -1);
+    QVector<int> ids;
+    QHash<int, int> positionById;
+    for (int i = 0; i < deltas.size(); ++i) {
+        const int combatantId = deltas.at(i).combatantId;
+        const auto it = positionById.constFind(combatantId);
+        if (it == positionById.constEnd()) {
+            positionById.insert(combatantId, ids.size());
+            ids.push_back(combatantId);
+            first.push_back(i);
+            last.push_back(i);
+        } else {
+            next[last[it.value()]] = i;
+            last[it.value()] = i;
+        }
+    }
+    manager->updateCombatants(ids, [&](int position, Combatant &combatant) {
+        for (int i = first[position]; i >= 0; i = next[i]) {
+            const auto &delta = deltas.at(i);
+            applyFieldValue(combatant, delta.field, useAfter ? delta.after : delta.before);
+        }
+    });
+}
+
+static QVector<int> idsOf(const QVector<Combatant> &combatants) {
+    QVector<int> ids;
+    ids.reserve(combatants.size());
+    for (const auto &combatant : combatants) {
+        ids.push_back(combatant.id);
+    }
+    return ids;
+}
+
+static quint64 deltaKey(int combatantId, CombatantField field) {
+    return (static_cast<quint64>(static_cast<quint32>(combatantId)) << 8) | static_cast<quint64>(field);
+}
+
+void ChangeSet::recordAdded(const Combatant &combatant) {
+    // An id removed earlier in the set stays in m_removed; redo removes before
+    // it adds, so the pair replays as a replacement.
+    m_addedIndex.insert(combatant.id, m_added.size());
+    m_added.push_back(combatant);
+}
+
+void ChangeSet::recordRemoved(const Combatant &combatant) {
+    const auto added = m_addedIndex.constFind(combatant.id);
+    if (added == m_addedIndex.constEnd()) {
+        m_removed.push_back(combatant);
+        return;
+    }
+    // Created and removed inside the set: no net effect.
+    m_added.removeAt(added.value());
+    m_addedIndex.clear();
+    for (int i = 0; i < m_added.size(); ++i) {
+        m_addedIndex.insert(m_added.at(i).id, i);
+    }
+}
+
+void ChangeSet::recordDelta(const FieldDelta &delta) {
+    // Combatants created inside the set simply absorb later edits.
+    const auto added = m_addedIndex.constFind(delta.combatantId);
+    if (added != m_addedIndex.constEnd()) {
+        applyFieldValue(m_added[added.value()], delta.field, delta.after);
+        return;
+    }
+    const auto key = deltaKey(delta.combatantId, delta.field);
+    const auto existing = m_deltaIndex.constFind(key);
+    if (existing != m_deltaIndex.constEnd()) {
+        m_deltas[existing.value()].after = delta.after;
+        return;
+    }
+    m_deltaIndex.insert(key, m_deltas.size());
+    m_deltas.push_back(delta);
+}
+
+void ChangeSet::recordCohort(const std::optional<Cohort> &before, const std::optional<Cohort> &after) {
+    if (!before && !after) {
+        return;
+    }
+    const int id = before ? before->id : after->id;
+    const auto existing = m_cohortIndex.constFind(id);
+    if (existing != m_cohortIndex.constEnd()) {
+        m_cohorts[existing.value()].after = after;
+        return;
+    }
+    m_cohortIndex.insert(id, m_cohorts.size());
+    m_cohorts.push_back({id, before, after});
+}
+
+void ChangeSet::recordTurn(int roundBefore, int turnBefore, int roundAfter, int turnAfter) {
+    if (m_turn) {
+        m_turn->roundAfter = roundAfter;
+        m_turn->turnAfter = turnAfter;
+        return;
+    }
+    m_turn = TurnChange{roundBefore, turnBefore, roundAfter, turnAfter};
+}
+
+void ChangeSet::merge(const ChangeSet &other) {
+    for (const auto &cohort : other.m_cohorts) {
+        recordCohort(cohort.before, cohort.after);
+    }
+    // Same order as redo(), so a replacement inside other is not mistaken for
+    // an add that it later removed.
+    for (const auto &delta : other.m_deltas) {
+        recordDelta(delta);
+    }
+    for (const auto &removed : other.m_removed) {
+        recordRemoved(removed);
+    }
+    for (const auto &added : other.m_added) {
+        recordAdded(added);
+    }
+    if (other.m_turn) {
+        recordTurn(other.m_turn->roundBefore, other.m_turn->turnBefore, other.m_turn->roundAfter, other.m_turn->turnAfter);
+    }
+}
+
+// Cohorts exist while their members do: they are restored before any member
+// comes back and dropped only after the members are gone.
+void ChangeSet::undo(TurnManager *manager) const {
+    for (const auto &cohort : m_cohorts) {
+        if (cohort.before) {
+            manager->setCohort(*cohort.before);
+        }
+    }
+    if (!m_added.isEmpty()) {
+        manager->removeCombatants(idsOf(m_added));
+    }
+    manager->addCombatants(m_removed);
+    applyDeltas(manager, m_deltas, false);
+    for (const auto &cohort : m_cohorts) {
+        if (!cohort.before) {
+            manager->removeCohort(cohort.id);
+        }
+    }
+    if (m_turn) {
+        manager->setTurnState(m_turn->roundBefore, m_turn->turnBefore);
+    }
+}
+
+void ChangeSet::redo(TurnManager *manager) const {
+    for (const auto &cohort : m_cohorts) {
+        if (cohort.after) {
+            manager->setCohort(*cohort.after);
+        }
+    }
+    applyDeltas(manager, m_deltas, true);
+    if (!m_removed.isEmpty()) {
+        manager->removeCombatants(idsOf(m_removed));
+    }
+    manager->addCombatants(m_added);
+    for (const auto &cohort : m_cohorts) {
+        if (!cohort.after) {
+            manager->removeCohort(cohort.id);
+        }
+    }
+    if (m_turn) {
+        manager->setTurnState(m_turn->roundAfter, m_turn->turnAfter);
+    }
+}
+
+qsizetype ChangeSet::byteSize() const {
+    qsizetype bytes = static_cast<qsizetype>(sizeof(ChangeSet));
+    bytes += (m_addedIndex.size() + m_deltaIndex.size()) * static_cast<qsizetype>(2 * sizeof(quint64));
+    for (const auto &added : m_added) {
+        bytes += combatantBytes(added);
+    }
+    for (const auto &removed : m_removed) {
+        bytes += combatantBytes(removed);
+    }
+    for (const auto &delta : m_deltas) {
+        bytes += fieldDeltaBytes(delta);
+    }
+    for (const auto &cohort : m_cohorts) {
+        bytes += static_cast<qsizetype>(sizeof(CohortChange) + 2 * sizeof(quint64));
+        bytes += cohort.before ? stringBytes(cohort.before->name) : 0;
+        bytes += cohort.after ? stringBytes(cohort.after->name) : 0;
+    }
+    return bytes;
+}
+
 AddCombatantCommand::AddCombatantCommand(TurnManager *manager, Combatant combatant, QUndoCommand *parent)
-    : QUndoCommand(parent)
+    : MeasuredUndoCommand(parent)
     , m_manager(manager)
     , m_combatant(std::move(combatant)) {
-    setText(QObject::tr("Add %1").arg(m_combatant.name));
+    setText(QObject::tr("Add %1").arg(m_combatant.name.toString()));
 }
 
 void AddCombatantCommand::undo() {
@@ -27,35 +350,350 @@ void AddCombatantCommand::redo() {
     }
 }
 
-EditCombatantCommand::EditCombatantCommand(TurnManager *manager, int combatantId, Combatant before, Combatant after, QUndoCommand *parent)
-    : QUndoCommand(parent)
+qsizetype AddCombatantCommand::byteSize() const {
+    return static_cast<qsizetype>(sizeof(*this)) + stringBytes(text()) + combatantBytes(m_combatant);
+}
+
+void AddCombatantCommand::collectChanges(ChangeSet &changes) const {
+    changes.recordAdded(m_combatant);
+}
+
+EditCombatantCommand::EditCombatantCommand(TurnManager *manager, int combatantId, const Combatant &before, const Combatant &after, QUndoCommand *parent)
+    : MeasuredUndoCommand(parent)
     , m_manager(manager)
     , m_combatantId(combatantId)
+    , m_deltas(diffCombatants(before, after)) {
+    for (auto &delta : m_deltas) {
+        delta.combatantId = combatantId;
+    }
+    setText(QObject::tr("Edit %1").arg(after.name.toString()));
+}
+
+void EditCombatantCommand::apply(bool useAfter) {
+    if (m_manager) {
+        applyDeltas(m_manager, m_deltas, useAfter);
+    }
+}
+
+void EditCombatantCommand::undo() {
+    apply(false);
+}
+
+void EditCombatantCommand::redo() {
+    apply(true);
+}
+
+bool EditCombatantCommand::mergeWith(const QUndoCommand *other) {
+    // Only text fields coalesce, so typing a note does not flood the history
+    // while every HP change stays its own undo step.
+    const auto *edit = static_cast<const EditCombatantCommand *>(other);
+    if (edit->m_combatantId != m_combatantId || edit->m_deltas.size() != 1 || m_deltas.size() != 1) {
+        return false;
+    }
+    auto &mine = m_deltas.first();
+    const auto &theirs = edit->m_deltas.first();
+    if (mine.field != theirs.field || (mine.field != CombatantField::Name && mine.field != CombatantField::Notes)) {
+        return false;
+    }
+    mine.after = theirs.after;
+    return true;
+}
+
+qsizetype EditCombatantCommand::byteSize() const {
+    qsizetype bytes = static_cast<qsizetype>(sizeof(*this)) + stringBytes(text());
+    for (const auto &delta : m_deltas) {
+        bytes += fieldDeltaBytes(delta);
+    }
+    return bytes;
+}
+
+void EditCombatantCommand::collectChanges(ChangeSet &changes) const {
+    for (const auto &delta : m_deltas) {
+        changes.recordDelta(delta);
+    }
+}
+
+CompactedHistoryCommand::CompactedHistoryCommand(TurnManager *manager, ChangeSet changes, QUndoCommand *parent)
+    : MeasuredUndoCommand(parent)
+    , m_manager(manager)
+    , m_changes(std::move(changes)) {
+    setText(QObject::tr("Earlier changes"));
+}
+
+void CompactedHistoryCommand::undo() {
+    if (m_manager) {
+        m_changes.undo(m_manager);
+    }
+}
+
+void CompactedHistoryCommand::redo() {
+    if (m_manager) {
+        m_changes.redo(m_manager);
+    }
+}
+
+qsizetype CompactedHistoryCommand::byteSize() const {
+    return static_cast<qsizetype>(sizeof(*this)) + stringBytes(text()) + m_changes.byteSize();
+}
+
+void CompactedHistoryCommand::collectChanges(ChangeSet &changes) const {
+    changes.merge(m_changes);
+}
+
+AddCombatantsCommand::AddCombatantsCommand(TurnManager *manager, QVector<Combatant> combatants, std::optional<Cohort> cohort, QUndoCommand *parent)
+    : MeasuredUndoCommand(parent)
+    , m_manager(manager)
+    , m_combatants(std::move(combatants))
+    , m_cohort(std::move(cohort)) {
+    setText(m_cohort ? QObject::tr("Add %1").arg(m_cohort->name)
+                     : QObject::tr("Add %n combatant(s)", nullptr, static_cast<int>(m_combatants.size())));
+}
+
+void AddCombatantsCommand::undo() {
+    if (!m_manager) {
+        return;
+    }
+    m_manager->removeCombatants(idsOf(m_combatants));
+    if (m_cohort) {
+        m_manager->removeCohort(m_cohort->id);
+    }
+    m_done = false;
+}
+
+void AddCombatantsCommand::redo() {
+    if (!m_manager) {
+        return;
+    }
+    if (!m_done) {
+        if (m_cohort) {
+            m_manager->setCohort(*m_cohort);
+        }
+        m_manager->addCombatants(m_combatants);
+        m_done = true;
+    }
+}
+
+qsizetype AddCombatantsCommand::byteSize() const {
+    qsizetype bytes = static_cast<qsizetype>(sizeof(*this)) + stringBytes(text());
+    for (const auto &combatant : m_combatants) {
+        bytes += combatantBytes(combatant);
+    }
+    if (m_cohort) {
+        bytes += stringBytes(m_cohort->name);
+    }
+    return bytes;
+}
+
+void AddCombatantsCommand::collectChanges(ChangeSet &changes) const {
+    if (m_cohort) {
+        changes.recordCohort(std::nullopt, m_cohort);
+    }
+    for (const auto &combatant : m_combatants) {
+        changes.recordAdded(combatant);
+    }
+}
+
+EditCohortCommand::EditCohortCommand(TurnManager *manager, std::optional<Cohort> before, std::optional<Cohort> after, QUndoCommand *parent)
+    : MeasuredUndoCommand(parent)
+    , m_manager(manager)
     , m_before(std::move(before))
     , m_after(std::move(after)) {
-    setText(QObject::tr("Edit %1").arg(m_after.name));
+    if (m_before && !m_after) {
+        for (const auto &combatant : manager->combatants()) {
+            if (combatant.cohort == m_before->id) {
+                m_members.push_back({combatant.id, CombatantField::Cohort, m_before->id, 0});
+            }
+        }
+    }
+    const auto &name = m_after ? m_after->name : m_before ? m_before->name : QString();
+    setText(!m_before ? QObject::tr("Group %1").arg(name) : !m_after ? QObject::tr("Ungroup %1").arg(name) : QObject::tr("Edit %1").arg(name));
 }
 
-static Combatant *findCombatant(TurnManager *manager, int id) {
-    auto &list = manager->combatants();
-    const auto it = std::find_if(list.begin(), list.end(), [id](const Combatant &c) { return c.id == id; });
-    if (it == list.end()) {
-        return nullptr;
+void EditCohortCommand::undo() {
+    if (!m_manager) {
+        return;
+    }
+    if (m_before) {
+        m_manager->setCohort(*m_before);
+        applyDeltas(m_manager, m_members, false);
+    } else if (m_after) {
+        m_manager->removeCohort(m_after->id);
     }
-    return &(*it);
 }
 
-void EditCombatantCommand::undo() {
-    if (auto *combatant = findCombatant(m_manager, m_combatantId)) {
-        *combatant = m_before;
-        m_manager->sortCombatants();
+void EditCohortCommand::redo() {
+    if (!m_manager) {
+        return;
+    }
+    if (m_after) {
+        m_manager->setCohort(*m_after);
+    } else if (m_before) {
+        m_manager->removeCohort(m_before->id);
     }
 }
 
-void EditCombatantCommand::redo() {
-    if (auto *combatant = findCombatant(m_manager, m_combatantId)) {
-        *combatant = m_after;
-        m_manager->sortCombatants();
+qsizetype EditCohortCommand::byteSize() const {
+    qsizetype bytes = static_cast<qsizetype>(sizeof(*this)) + stringBytes(text());
+    bytes += m_before ? stringBytes(m_before->name) : 0;
+    bytes += m_after ? stringBytes(m_after->name) : 0;
+    for (const auto &delta : m_members) {
+        bytes += fieldDeltaBytes(delta);
+    }
+    return bytes;
+}
+
+void EditCohortCommand::collectChanges(ChangeSet &changes) const {
+    changes.recordCohort(m_before, m_after);
+    for (const auto &delta : m_members) {
+        changes.recordDelta(delta);
+    }
+}
+
+SplitMobCommand::SplitMobCommand(TurnManager *manager, Combatant mob, int firstId, QUndoCommand *parent)
+    : MeasuredUndoCommand(parent)
+    , m_manager(manager)
+    , m_mob(std::move(mob))
+    , m_members(splitMob(m_mob, firstId)) {
+    setText(QObject::tr("Split %1").arg(m_mob.name.toString()));
+}
+
+void SplitMobCommand::undo() {
+    if (!m_manager) {
+        return;
+    }
+    m_manager->removeCombatants(idsOf(m_members));
+    m_manager->addCombatant(m_mob);
+}
+
+void SplitMobCommand::redo() {
+    if (!m_manager) {
+        return;
+    }
+    m_manager->removeCombatant(m_mob.id);
+    m_manager->addCombatants(m_members);
+}
+
+qsizetype SplitMobCommand::byteSize() const {
+    qsizetype bytes = static_cast<qsizetype>(sizeof(*this)) + stringBytes(text()) + combatantBytes(m_mob);
+    for (const auto &member : m_members) {
+        bytes += combatantBytes(member);
+    }
+    return bytes;
+}
+
+void SplitMobCommand::collectChanges(ChangeSet &changes) const {
+    changes.recordRemoved(m_mob);
+    for (const auto &member : m_members) {
+        changes.recordAdded(member);
     }
 }
 
+ApplyToManyCommand::ApplyToManyCommand(TurnManager *manager, const QVector<Combatant> &before, const QVector<Combatant> &after, QUndoCommand *parent)
+    : MeasuredUndoCommand(parent)
+    , m_manager(manager) {
+    const auto count = std::min(before.size(), after.size());
+    for (qsizetype i = 0; i < count; ++i) {
+        for (auto &delta : diffCombatants(before.at(i), after.at(i))) {
+            m_deltas.push_back(std::move(delta));
+        }
+    }
+    setText(QObject::tr("Edit %n combatant(s)", nullptr, static_cast<int>(count)));
+}
+
+void ApplyToManyCommand::undo() {
+    if (m_manager) {
+        applyDeltas(m_manager, m_deltas, false);
+    }
+}
+
+void ApplyToManyCommand::redo() {
+    if (m_manager) {
+        applyDeltas(m_manager, m_deltas, true);
+    }
+}
+
+qsizetype ApplyToManyCommand::byteSize() const {
+    qsizetype bytes = static_cast<qsizetype>(sizeof(*this)) + stringBytes(text());
+    for (const auto &delta : m_deltas) {
+        bytes += fieldDeltaBytes(delta);
+    }
+    return bytes;
+}
+
+void ApplyToManyCommand::collectChanges(ChangeSet &changes) const {
+    for (const auto &delta : m_deltas) {
+        changes.recordDelta(delta);
+    }
+}
+
+RestoreVersionCommand::RestoreVersionCommand(TurnManager *manager, EncounterVersion target, QUndoCommand *parent)
+    : MeasuredUndoCommand(parent)
+    , m_manager(manager)
+    , m_before(manager->currentVersion())
+    , m_target(std::move(target)) {
+    setText(QObject::tr("Jump to round %1").arg(m_target.round));
+}
+
+void RestoreVersionCommand::undo() {
+    if (m_manager) {
+        m_manager->restoreVersion(m_before);
+    }
+}
+
+void RestoreVersionCommand::redo() {
+    if (m_manager) {
+        m_manager->restoreVersion(m_target);
+    }
+}
+
+qsizetype RestoreVersionCommand::byteSize() const {
+    // Both versions share their nodes with the timeline, so only the handles count.
+    return static_cast<qsizetype>(sizeof(*this)) + stringBytes(text());
+}
+
+void RestoreVersionCommand::collectChanges(ChangeSet &changes) const {
+    const int slotCount = std::max(m_before.storage.size(), m_target.storage.size());
+    QVector<Combatant> added;
+    for (int slot = 0; slot < slotCount; ++slot) {
+        const auto before = slot < m_before.storage.size() ? m_before.storage.at(slot) : nullptr;
+        const auto after = slot < m_target.storage.size() ? m_target.storage.at(slot) : nullptr;
+        if (before == after) {
+            continue;
+        }
+        if (before && after && before->id == after->id) {
+            for (const auto &delta : diffCombatants(*before, *after)) {
+                changes.recordDelta(delta);
+            }
+            continue;
+        }
+        if (before) {
+            changes.recordRemoved(*before);
+        }
+        if (after) {
+            added.push_back(*after);
+        }
+    }
+    // The swap is simultaneous: an id that moved slots is a replacement, not
+    // an add cancelled by a later remove.
+    for (const auto &combatant : added) {
+        changes.recordAdded(combatant);
+    }
+    const auto findCohort = [](const QVector<Cohort> &cohorts, int id) -> std::optional<Cohort> {
+        const auto it = std::find_if(cohorts.cbegin(), cohorts.cend(), [id](const Cohort &cohort) { return cohort.id == id; });
+        return it == cohorts.cend() ? std::nullopt : std::optional<Cohort>(*it);
+    };
+    for (const auto &cohort : m_before.cohorts) {
+        const auto target = findCohort(m_target.cohorts, cohort.id);
+        if (!target || !(*target == cohort)) {
+            changes.recordCohort(cohort, target);
+        }
+    }
+    for (const auto &cohort : m_target.cohorts) {
+        if (!findCohort(m_before.cohorts, cohort.id)) {
+            changes.recordCohort(std::nullopt, cohort);
+        }
+    }
+    if (m_before.round != m_target.round || m_before.turnIndex != m_target.turnIndex) {
+        changes.recordTurn(m_before.round, m_before.turnIndex, m_target.round, m_target.turnIndex);
+    }
+}
@@ -1,14 +1,103 @@
 #pragma once
 
+#include <QHash>
 #include <QUndoCommand>
+#include <QVector>
+
+#include <optional>
+#include <variant>
 
 #include "models/TurnManager.h"
 
-class AddCombatantCommand : public QUndoCommand {
+enum class CombatantField {
+    Name,
+    Initiative,
+    DexMod,
+    IsPC,
+    Conscious,
+    HP,
+    AC,
+    DeathSaves,
+    Conditions,
+    Notes,
+    DexScore,
+    Tiebreak,
+    Side,
+    Cohort,
+    Mob
+};
+
+using FieldValue = std::variant<int, bool, QString, CombatantName, DeathSaves, ConditionList, MobMembers>;
+
+struct FieldDelta {
+    int combatantId = 0;
+    CombatantField field = CombatantField::HP;
+    FieldValue before;
+    FieldValue after;
+};
+
+QVector<FieldDelta> diffCombatants(const Combatant &before, const Combatant &after);
+void applyFieldValue(Combatant &combatant, CombatantField field, const FieldValue &value);
+qsizetype fieldDeltaBytes(const FieldDelta &delta);
+qsizetype combatantBytes(const Combatant &combatant);
+
+// Net effect of a run of commands. Used as the snapshot that replaces the
+// oldest commands once the history exceeds its byte budget.
+class ChangeSet {
+public:
+    void recordAdded(const Combatant &combatant);
+    void recordRemoved(const Combatant &combatant);
+    void recordDelta(const FieldDelta &delta);
+    // A missing before is a created cohort, a missing after a deleted one.
+    void recordCohort(const std::optional<Cohort> &before, const std::optional<Cohort> &after);
+    // Turn marker positions as (round, turnIndex); applied after the roster.
+    void recordTurn(int roundBefore, int turnBefore, int roundAfter, int turnAfter);
+    void merge(const ChangeSet &other);
+
+    void undo(TurnManager *manager) const;
+    void redo(TurnManager *manager) const;
+
+    bool isEmpty() const noexcept { return m_added.isEmpty() && m_removed.isEmpty() && m_deltas.isEmpty() && m_cohorts.isEmpty() && !m_turn; }
+    qsizetype byteSize() const;
+
+private:
+    struct CohortChange {
+        int id = 0;
+        std::optional<Cohort> before;
+        std::optional<Cohort> after;
+    };
+    struct TurnChange {
+        int roundBefore = 1;
+        int turnBefore = 0;
+        int roundAfter = 1;
+        int turnAfter = 0;
+    };
+
+    QVector<Combatant> m_added;
+    QVector<Combatant> m_removed;
+    QVector<FieldDelta> m_deltas;
+    QVector<CohortChange> m_cohorts;
+    std::optional<TurnChange> m_turn;
+    QHash<int, int> m_addedIndex;
+    QHash<quint64, int> m_deltaIndex;
+    QHash<int, int> m_cohortIndex;
+};
+
+class MeasuredUndoCommand : public QUndoCommand {
+public:
+    using QUndoCommand::QUndoCommand;
+
+    virtual qsizetype byteSize() const = 0;
+    virtual void collectChanges(ChangeSet &changes) const = 0;
+};
+
+class AddCombatantCommand : public MeasuredUndoCommand {
 public:
     AddCombatantCommand(TurnManager *manager, Combatant combatant, QUndoCommand *parent = nullptr);
     void undo() override;
     void redo() override;
+    qsizetype byteSize() const override;
+    void collectChanges(ChangeSet &changes) const override;
 
 private:
     TurnManager *m_manager;
@@ -16,16 +105,125 @@ private:
     bool m_done = false;
 };
 
-class EditCombatantCommand : public QUndoCommand {
+// Stores only the fields that differ between the before/after states.
+class EditCombatantCommand : public MeasuredUndoCommand {
 public:
-    EditCombatantCommand(TurnManager *manager, int combatantId, Combatant before, Combatant after, QUndoCommand *parent = nullptr);
+    enum { Id = 1 };
+
+    EditCombatantCommand(TurnManager *manager, int combatantId, const Combatant &before, const Combatant &after, QUndoCommand *parent = nullptr);
     void undo() override;
     void redo() override;
+    int id() const override { return Id; }
+    bool mergeWith(const QUndoCommand *other) override;
+    qsizetype byteSize() const override;
+    void collectChanges(ChangeSet &changes) const override;
+
+    bool isEmpty() const noexcept { return m_deltas.isEmpty(); }
 
 private:
+    void apply(bool useAfter);
+
     TurnManager *m_manager;
     int m_combatantId;
-    Combatant m_before;
-    Combatant m_after;
+    QVector<FieldDelta> m_deltas;
+};
+
+class CompactedHistoryCommand : public MeasuredUndoCommand {
+public:
+    CompactedHistoryCommand(TurnManager *manager, ChangeSet changes, QUndoCommand *parent = nullptr);
+    void undo() override;
+    void redo() override;
+    qsizetype byteSize() const override;
+    void collectChanges(ChangeSet &changes) const override;
+
+    const ChangeSet &changes() const noexcept { return m_changes; }
+
+private:
+    TurnManager *m_manager;
+    ChangeSet m_changes;
+};
+
+// Spawns a whole list of combatants as one undo step.
+// Adds several combatants in one step. When cohort is set it is created with
+// them and removed again on undo, so the group never outlives its members.
+class AddCombatantsCommand : public MeasuredUndoCommand {
+public:
+    AddCombatantsCommand(TurnManager *manager, QVector<Combatant> combatants, std::optional<Cohort> cohort = std::nullopt,
+                         QUndoCommand *parent = nullptr);
+    void undo() override;
+    void redo() override;
+    qsizetype byteSize() const override;
+    void collectChanges(ChangeSet &changes) const override;
+
+private:
+    TurnManager *m_manager;
+    QVector<Combatant> m_combatants;
+    std::optional<Cohort> m_cohort;
+    bool m_done = false;
+};
+
+// Creates (no before), edits, or deletes (no after) one cohort. Deleting
+// leaves the members in place as individuals; undo puts them back.
+class EditCohortCommand : public MeasuredUndoCommand {
+public:
+    EditCohortCommand(TurnManager *manager, std::optional<Cohort> before, std::optional<Cohort> after, QUndoCommand *parent = nullptr);
+    void undo() override;
+    void redo() override;
+    qsizetype byteSize() const override;
+    void collectChanges(ChangeSet &changes) const override;
+
+private:
+    TurnManager *m_manager;
+    std::optional<Cohort> m_before;
+    std::optional<Cohort> m_after;
+    // Cohort field deltas of the members a delete detaches.
+    QVector<FieldDelta> m_members;
+};
+
+// Replaces a mob row with one combatant per member.
+class SplitMobCommand : public MeasuredUndoCommand {
+public:
+    SplitMobCommand(TurnManager *manager, Combatant mob, int firstId, QUndoCommand *parent = nullptr);
+    void undo() override;
+    void redo() override;
+    qsizetype byteSize() const override;
+    void collectChanges(ChangeSet &changes) const override;
+
+private:
+    TurnManager *m_manager;
+    Combatant m_mob;
+    QVector<Combatant> m_members;
+};
+
+// Field deltas for many combatants at once, e.g. an area effect. before and
+// after are matched by position.
+class ApplyToManyCommand : public MeasuredUndoCommand {
+public:
+    ApplyToManyCommand(TurnManager *manager, const QVector<Combatant> &before, const QVector<Combatant> &after, QUndoCommand *parent = nullptr);
+    void undo() override;
+    void redo() override;
+    qsizetype byteSize() const override;
+    void collectChanges(ChangeSet &changes) const override;
+
+    bool isEmpty() const noexcept { return m_deltas.isEmpty(); }
+
+private:
+    TurnManager *m_manager;
+    QVector<FieldDelta> m_deltas;
 };
 
+// Moves the live encounter to a recorded EncounterVersion, which makes the
+// TurnManager timeline usable as the backing store for history jumps.
+class RestoreVersionCommand : public MeasuredUndoCommand {
+public:
+    RestoreVersionCommand(TurnManager *manager, EncounterVersion target, QUndoCommand *parent = nullptr);
+    void undo() override;
+    void redo() override;
+    qsizetype byteSize() const override;
+    void collectChanges(ChangeSet &changes) const override;
+
+private:
+    TurnManager *m_manager;
+    EncounterVersion m_before;
+    EncounterVersion m_target;
+};
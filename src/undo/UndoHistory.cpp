@@ -0,0 +1,111 @@
+#include "UndoHistory.h"
+
+#include <algorithm>
+
+UndoHistory::UndoHistory(TurnManager *manager, QObject *parent)
+    : QObject(parent)
+    , m_manager(manager) {}
+
+UndoHistory::~UndoHistory() = default;
+
+void UndoHistory::push(MeasuredUndoCommand *command) {
+    std::unique_ptr<MeasuredUndoCommand> owned(command);
+    owned->redo();
+
+    while (count() > m_index) {
+        m_byteSize -= m_commands.back()->byteSize();
+        m_commands.pop_back();
+    }
+
+    if (m_index > 0 && owned->id() != -1) {
+        auto &top = m_commands.back();
+        if (top->id() == owned->id()) {
+            const auto previousSize = top->byteSize();
+            if (top->mergeWith(owned.get())) {
+                m_byteSize += top->byteSize() - previousSize;
+                emit indexChanged(m_index);
+                return;
+            }
+        }
+    }
+
+    m_byteSize += owned->byteSize();
+    m_commands.push_back(std::move(owned));
+    ++m_index;
+    compact();
+    emit indexChanged(m_index);
+}
+
+void UndoHistory::clear() {
+    m_commands.clear();
+    m_index = 0;
+    m_byteSize = 0;
+    emit indexChanged(m_index);
+}
+
+const MeasuredUndoCommand *UndoHistory::command(int index) const {
+    if (index < 0 || index >= count()) {
+        return nullptr;
+    }
+    return m_commands[index].get();
+}
+
+void UndoHistory::setByteBudget(qsizetype bytes) {
+    m_byteBudget = std::max<qsizetype>(0, bytes);
+    compact();
+}
+
+void UndoHistory::undo() {
+    if (!canUndo()) {
+        return;
+    }
+    --m_index;
+    m_commands[m_index]->undo();
+    emit indexChanged(m_index);
+}
+
+void UndoHistory::redo() {
+    if (!canRedo()) {
+        return;
+    }
+    m_commands[m_index]->redo();
+    ++m_index;
+    emit indexChanged(m_index);
+}
+
+void UndoHistory::compact() {
+    if (m_byteSize <= m_byteBudget) {
+        return;
+    }
+    // Only applied commands can be folded, and the newest one stays intact so
+    // text edits can keep merging into it. Folding down to half the budget
+    // keeps compaction from running on every push.
+    const int limit = m_index - 1;
+    qsizetype remaining = m_byteSize;
+    int folded = 0;
+    while (folded < limit && remaining > m_byteBudget / 2) {
+        remaining -= m_commands[folded]->byteSize();
+        ++folded;
+    }
+    const bool alreadyCompacted = folded == 1 && dynamic_cast<CompactedHistoryCommand *>(m_commands.front().get());
+    if (folded == 0 || alreadyCompacted) {
+        return;
+    }
+
+    ChangeSet changes;
+    for (int i = 0; i < folded; ++i) {
+        m_commands[i]->collectChanges(changes);
+    }
+    m_commands.erase(m_commands.begin(), m_commands.begin() + folded);
+    m_index -= folded;
+    m_byteSize = remaining;
+
+    auto snapshot = std::make_unique<CompactedHistoryCommand>(m_manager, std::move(changes));
+    if (m_byteSize + snapshot->byteSize() > m_byteBudget) {
+        // The net change alone no longer fits; those edits fall off the history.
+        return;
+    }
+    m_byteSize += snapshot->byteSize();
+    m_commands.insert(m_commands.begin(), std::move(snapshot));
+    ++m_index;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QObject>
+
+#include <memory>
+#include <vector>
+
+#include "UndoCommands.h"
+
+// Undo stack with a byte budget. Once the retained commands exceed the budget
+// the oldest ones are folded into a single CompactedHistoryCommand, so memory
+// grows with what actually changed rather than with the number of edits.
+class UndoHistory : public QObject {
+    Q_OBJECT
+public:
+    static constexpr qsizetype kDefaultByteBudget = 4 * 1024 * 1024;
+
+    explicit UndoHistory(TurnManager *manager, QObject *parent = nullptr);
+    ~UndoHistory() override;
+
+    void push(MeasuredUndoCommand *command);
+    void clear();
+
+    bool canUndo() const noexcept { return m_index > 0; }
+    bool canRedo() const noexcept { return m_index < count(); }
+    int count() const noexcept { return static_cast<int>(m_commands.size()); }
+    int index() const noexcept { return m_index; }
+    const MeasuredUndoCommand *command(int index) const;
+
+    void setByteBudget(qsizetype bytes);
+    qsizetype byteBudget() const noexcept { return m_byteBudget; }
+    qsizetype byteSize() const noexcept { return m_byteSize; }
+
+public slots:
+    void undo();
+    void redo();
+
+signals:
+    void indexChanged(int index);
+
+private:
+    void compact();
+
+    TurnManager *m_manager;
+    std::vector<std::unique_ptr<MeasuredUndoCommand>> m_commands;
+    int m_index = 0;
+    qsizetype m_byteSize = 0;
+    qsizetype m_byteBudget = kDefaultByteBudget;
+};
@@ -0,0 +1,31 @@
+#include "Arena.h"
+
+#include <atomic>
+
+namespace {
+
+std::atomic<bool> g_enabled{true};
+
+} // namespace
+
+namespace arena {
+
+void setEnabled(bool enabled) noexcept {
+    g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool isEnabled() noexcept {
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+std::pmr::memory_resource *sharedPool() noexcept {
+    // Leaked on purpose; see the header.
+    static auto *pool = new std::pmr::synchronized_pool_resource();
+    return pool;
+}
+
+} // namespace arena
+
+ScratchArena::ScratchArena()
+    : m_resource(m_buffer, sizeof(m_buffer))
+    , m_enabled(arena::isEnabled()) {}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace arena {
+
+// Off sends ScratchArena and pooled allocations straight to the heap. Only
+// the benchmarks turn it off, to compare allocation counts.
+void setEnabled(bool enabled) noexcept;
+bool isEnabled() noexcept;
+
+// Process-wide, thread-safe pool for long-lived nodes such as the combatants
+// and trie nodes behind an EncounterVersion. It is never destroyed, so a
+// snapshot still held by a worker at exit stays valid.
+std::pmr::memory_resource *sharedPool() noexcept;
+
+// make_shared whose object and control block come from sharedPool().
+template <typename T, typename... Args>
+std::shared_ptr<T> makePooled(Args &&...args) {
+    using Object = std::remove_const_t<T>;
+    if (!isEnabled()) {
+        return std::make_shared<Object>(std::forward<Args>(args)...);
+    }
+    return std::allocate_shared<Object>(std::pmr::polymorphic_allocator<Object>(sharedPool()), std::forward<Args>(args)...);
+}
+
+} // namespace arena
+
+// Memory for the temporaries of one operation: a load, a sort, a roll or a
+// batch edit. Allocations come from an inline buffer and then from growing
+// heap blocks, and are all released together when the arena goes out of
+// scope. Individual frees are no-ops, so only short-lived data belongs here.
+class ScratchArena {
+public:
+    static constexpr std::size_t kInlineBytes = 8 * 1024;
+
+    ScratchArena();
+    ScratchArena(const ScratchArena &) = delete;
+    ScratchArena &operator=(const ScratchArena &) = delete;
+
+    std::pmr::memory_resource *resource() noexcept { return m_enabled ? &m_resource : std::pmr::new_delete_resource(); }
+
+    template <typename T>
+    std::pmr::vector<T> vector(std::size_t size = 0) {
+        return std::pmr::vector<T>(size, resource());
+    }
+    template <typename T>
+    std::pmr::vector<T> vector(std::size_t size, const T &value) {
+        return std::pmr::vector<T>(size, value, resource());
+    }
+
+private:
+    alignas(std::max_align_t) std::byte m_buffer[kInlineBytes];
+    std::pmr::monotonic_buffer_resource m_resource;
+    bool m_enabled;
+};
+
+template <typename T>
+using ScratchVector = std::pmr::vector<T>;
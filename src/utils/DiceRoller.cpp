@@ -1,15 +1,71 @@
 #include "DiceRoller.h"
 
+#include <QRegularExpression>
+
+#include <algorithm>
+
+std::optional<DiceExpression> DiceExpression::parse(const QString &text) {
+    static const QRegularExpression pattern(QStringLiteral("^\\s*(?:(\\d*)[dD](\\d+))?\\s*(?:([+-]?)\\s*(\\d+))?\\s*$"));
+    const auto match = pattern.match(text);
+    if (!match.hasMatch() || text.trimmed().isEmpty()) {
+        return std::nullopt;
+    }
+    DiceExpression expression;
+    if (!match.captured(2).isEmpty()) {
+        bool countOk = true;
+        bool sidesOk = false;
+        expression.count = match.captured(1).isEmpty() ? 1 : match.captured(1).toInt(&countOk);
+        expression.sides = match.captured(2).toInt(&sidesOk);
+        if (!countOk || !sidesOk || expression.count > kMaxCount || expression.sides <= 0 || expression.sides > kMaxSides) {
+            return std::nullopt;
+        }
+    }
+    if (!match.captured(4).isEmpty()) {
+        if (expression.sides > 0 && match.captured(3).isEmpty()) {
+            return std::nullopt;
+        }
+        bool bonusOk = false;
+        expression.bonus = match.captured(4).toInt(&bonusOk);
+        if (!bonusOk || expression.bonus > kMaxBonus) {
+            return std::nullopt;
+        }
+        if (match.captured(3) == QLatin1String("-")) {
+            expression.bonus = -expression.bonus;
+        }
+    }
+    return expression;
+}
+
+QString DiceExpression::toString() const {
+    if (count <= 0 || sides <= 0) {
+        return QString::number(bonus);
+    }
+    QString text = QStringLiteral("%1d%2").arg(count).arg(sides);
+    if (bonus > 0) {
+        text += QStringLiteral("+%1").arg(bonus);
+    } else if (bonus < 0) {
+        text += QString::number(bonus);
+    }
+    return text;
+}
+
 DiceRoller::DiceRoller(QObject *parent)
-    : QObject(parent)
-    , m_rng(QRandomGenerator::securelySeeded()) {}
+    : QObject(parent) {}
+
+// Secure seeding reads from the system entropy source, so it is deferred to
+// the first roll instead of slowing down startup.
+void DiceRoller::seedSecurely() {
+    m_rng = QRandomGenerator::securelySeeded();
+    m_seeded = true;
+}
 
 void DiceRoller::setSeed(quint32 seed) {
     m_rng = QRandomGenerator(seed);
+    m_seeded = true;
 }
 
 int DiceRoller::rollD20(RollMode mode, int modifier) {
-    auto rollOnce = [this]() { return static_cast<int>(m_rng.bounded(1, 21)); };
+    auto rollOnce = [this]() { return rollDie(20); };
     int first = rollOnce();
     int result = first;
     if (mode == RollMode::Advantage || mode == RollMode::Disadvantage) {
@@ -25,3 +81,37 @@ int DiceRoller::rollD20(RollMode mode, int modifier) {
     return total;
 }
 
+int DiceRoller::roll(const DiceExpression &expression) {
+    int total = expression.bonus;
+    for (int i = 0; i < expression.count; ++i) {
+        total += rollDie(expression.sides);
+    }
+    return total;
+}
+
+void DiceRoller::rollTiebreakMany(int *values, int count) {
+    for (int i = 0; i < count; ++i) {
+        values[i] = rollTiebreak();
+    }
+}
+
+void DiceRoller::rollD20Many(RollMode mode, const int *modifiers, int *totals, int count) {
+    for (int i = 0; i < count; ++i) {
+        totals[i] = rollDie(20);
+    }
+    if (mode != RollMode::Normal) {
+        for (int i = 0; i < count; ++i) {
+            const int second = rollDie(20);
+            totals[i] = mode == RollMode::Advantage ? std::max(totals[i], second) : std::min(totals[i], second);
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        totals[i] += modifiers[i];
+    }
+}
+
+void DiceRoller::rollMany(const DiceExpression &expression, int *totals, int count) {
+    for (int i = 0; i < count; ++i) {
+        totals[i] = roll(expression);
+    }
+}
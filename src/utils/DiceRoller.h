@@ -2,6 +2,9 @@
 
 #include <QObject>
 #include <QRandomGenerator>
+#include <QString>
+
+#include <optional>
 
 enum class RollMode {
     Normal,
@@ -9,6 +12,22 @@ enum class RollMode {
     Disadvantage
 };
 
+// Parsed "NdS+B" expression, e.g. "8d6", "2d8+3" or a flat "7". Larger
+// counts, sides or bonuses than the limits below fail to parse, which keeps
+// every total and average well inside int.
+struct DiceExpression {
+    static constexpr int kMaxCount = 1000;
+    static constexpr int kMaxSides = 1000;
+    static constexpr int kMaxBonus = 1000000;
+
+    int count = 0;
+    int sides = 0;
+    int bonus = 0;
+
+    static std::optional<DiceExpression> parse(const QString &text);
+    QString toString() const;
+};
+
 class DiceRoller : public QObject {
     Q_OBJECT
 public:
@@ -16,11 +35,28 @@ public:
 
     void setSeed(quint32 seed);
     int rollD20(RollMode mode, int modifier = 0);
+    int roll(const DiceExpression &expression);
+    // Roll-off value for InitiativeRules::RandomTiebreak; does not emit rollPerformed.
+    int rollTiebreak() { return rollDie(1 << 20); }
+    void rollTiebreakMany(int *values, int count);
+
+    // Batch variants for area effects. They fill totals[0..count) and do not
+    // emit rollPerformed per roll.
+    void rollD20Many(RollMode mode, const int *modifiers, int *totals, int count);
+    void rollMany(const DiceExpression &expression, int *totals, int count);
 
 signals:
     void rollPerformed(int raw, RollMode mode, int modifier, int total);
 
 private:
+    int rollDie(int sides) {
+        if (!m_seeded) {
+            seedSecurely();
+        }
+        return static_cast<int>(m_rng.bounded(1, sides + 1));
+    }
+    void seedSecurely();
+
     QRandomGenerator m_rng;
+    bool m_seeded = false;
 };
-
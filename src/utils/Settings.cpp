@@ -32,6 +32,42 @@ void Settings::setStreamerMode(bool enabled) {
     m_settings.setValue("streamerMode", enabled);
 }
 
+quint16 Settings::broadcastPort() const {
+    return static_cast<quint16>(m_settings.value("broadcastPort", 0).toUInt());
+}
+
+void Settings::setBroadcastPort(quint16 port) {
+    m_settings.setValue("broadcastPort", port);
+}
+
+InitiativeRules Settings::initiativeRules() const {
+    const int value = m_settings.value("initiativeRules", 0).toInt();
+    if (value < 0 || value > static_cast<int>(InitiativeRules::SideInitiative)) {
+        return InitiativeRules::Standard;
+    }
+    return static_cast<InitiativeRules>(value);
+}
+
+void Settings::setInitiativeRules(InitiativeRules rules) {
+    m_settings.setValue("initiativeRules", static_cast<int>(rules));
+}
+
+bool Settings::rerollEachRound() const {
+    return m_settings.value("rerollEachRound", false).toBool();
+}
+
+void Settings::setRerollEachRound(bool enabled) {
+    m_settings.setValue("rerollEachRound", enabled);
+}
+
+bool Settings::groupTurns() const {
+    return m_settings.value("groupTurns", false).toBool();
+}
+
+void Settings::setGroupTurns(bool enabled) {
+    m_settings.setValue("groupTurns", enabled);
+}
+
 QString Settings::lastEncounterPath() const {
     return m_settings.value("lastEncounterPath").toString();
 }
@@ -40,3 +76,23 @@ void Settings::setLastEncounterPath(const QString &path) {
     m_settings.setValue("lastEncounterPath", path);
 }
 
+qsizetype Settings::undoHistoryBudgetBytes() const {
+    return m_settings.value("undoHistoryBudget", 4 * 1024 * 1024).toLongLong();
+}
+
+void Settings::setUndoHistoryBudgetBytes(qsizetype bytes) {
+    m_settings.setValue("undoHistoryBudget", static_cast<qlonglong>(bytes));
+}
+
+
+QString Settings::tracePath() const {
+    const auto fromEnvironment = qEnvironmentVariable("DND_TRACE");
+    if (!fromEnvironment.isEmpty()) {
+        return fromEnvironment;
+    }
+    return m_settings.value("tracePath").toString();
+}
+
+void Settings::setTracePath(const QString &path) {
+    m_settings.setValue("tracePath", path);
+}
@@ -3,6 +3,8 @@
 #include <QObject>
 #include <QSettings>
 
+#include "models/InitiativeRules.h"
+
 class Settings : public QObject {
     Q_OBJECT
 public:
@@ -17,9 +19,32 @@ public:
     bool streamerMode() const;
     void setStreamerMode(bool enabled);
 
+    // Loopback port for player displays; 0 turns the broadcast off.
+    quint16 broadcastPort() const;
+    void setBroadcastPort(quint16 port);
+
     QString lastEncounterPath() const;
     void setLastEncounterPath(const QString &path);
 
+    InitiativeRules initiativeRules() const;
+    void setInitiativeRules(InitiativeRules rules);
+
+    // Re-roll everyone's initiative at the start of each round.
+    bool rerollEachRound() const;
+    void setRerollEachRound(bool enabled);
+
+    // Roster groups join as one cohort with a shared roll and turn.
+    bool groupTurns() const;
+    void setGroupTurns(bool enabled);
+
+    qsizetype undoHistoryBudgetBytes() const;
+    void setUndoHistoryBudgetBytes(qsizetype bytes);
+
+    // Where to write a Chrome trace on exit; empty disables tracing. The
+    // DND_TRACE environment variable takes precedence.
+    QString tracePath() const;
+    void setTracePath(const QString &path);
+
 private:
     QSettings m_settings;
 };
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// RCU-style publication of immutable values from one writer thread to any
+// number of readers. acquire() is wait-free: it never loops or locks, it just
+// bumps a reader counter while copying the shared_ptr. publish() never waits
+// for readers either; superseded values are handed back to shared_ptr
+// ownership once a grace period shows no reader can still be copying them,
+// and are then freed when their last reader drops them.
+//
+// Grace periods use two reader counters selected by an epoch bit. Readers
+// that started before a flip drain from the old counter while new readers
+// use the other one; a retired value is released after a flip once the old
+// counter has been seen at zero, and a flip only happens once the counter it
+// hands to new readers has drained of stragglers.
+template <typename T>
+class SnapshotPublisher {
+public:
+    using Pointer = std::shared_ptr<const T>;
+
+    explicit SnapshotPublisher(Pointer initial = std::make_shared<const T>())
+        : m_current(new Node{std::move(initial)}) {
+    }
+
+    ~SnapshotPublisher() {
+        delete m_current.load();
+        for (Node *node : m_pending) {
+            delete node;
+        }
+        for (Node *node : m_waiting) {
+            delete node;
+        }
+    }
+
+    SnapshotPublisher(const SnapshotPublisher &) = delete;
+    SnapshotPublisher &operator=(const SnapshotPublisher &) = delete;
+
+    // Any thread.
+    Pointer acquire() const {
+        const unsigned epoch = m_epoch.load() & 1u;
+        m_readers[epoch].fetch_add(1);
+        Pointer result = m_current.load()->value;
+        m_readers[epoch].fetch_sub(1);
+        return result;
+    }
+
+    // Writer thread only.
+    void publish(Pointer value) {
+        m_pending.push_back(m_current.exchange(new Node{std::move(value)}));
+        reclaim();
+    }
+
+    // Writer thread only. Retired values not yet released; 0 once readers
+    // have been quiet across two publishes or reclaim() calls.
+    int retiredCount() const noexcept { return static_cast<int>(m_pending.size() + m_waiting.size()); }
+
+    // Writer thread only. Advances the grace period without blocking.
+    void reclaim() {
+        if (!m_waiting.empty() && m_readers[m_waitingEpoch].load() == 0) {
+            releaseWaiting();
+        }
+        if (!m_waiting.empty() || m_pending.empty()) {
+            return;
+        }
+        const unsigned epoch = m_epoch.load() & 1u;
+        if (m_readers[epoch ^ 1u].load() != 0) {
+            return;
+        }
+        m_epoch.store(epoch ^ 1u);
+        m_waiting.swap(m_pending);
+        m_waitingEpoch = epoch;
+        if (m_readers[epoch].load() == 0) {
+            releaseWaiting();
+        }
+    }
+
+private:
+    struct Node {
+        Pointer value;
+    };
+
+    void releaseWaiting() {
+        for (Node *node : m_waiting) {
+            delete node;
+        }
+        m_waiting.clear();
+    }
+
+    std::atomic<Node *> m_current;
+    std::atomic<unsigned> m_epoch{0};
+    mutable std::array<std::atomic<int>, 2> m_readers{};
+
+    // Writer-side bookkeeping.
+    std::vector<Node *> m_pending;
+    std::vector<Node *> m_waiting;
+    unsigned m_waitingEpoch = 0;
+};
@@ -0,0 +1,86 @@
+#include "StartupTimer.h"
+
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QPair>
+#include <QTimer>
+#include <QVector>
+
+#include <cstdio>
+
+namespace {
+
+struct State {
+    bool enabled = false;
+    bool reported = false;
+    QElapsedTimer clock;
+    QVector<QPair<QString, qint64>> marks;
+};
+
+State &state() {
+    static State instance;
+    return instance;
+}
+
+void printLine(const QString &label, qint64 elapsedUs, qint64 deltaUs) {
+    std::fprintf(stderr, "[startup] %8.2f ms  (+%7.2f ms)  %s\n", elapsedUs / 1000.0, deltaUs / 1000.0, qPrintable(label));
+}
+
+void printReport() {
+    auto &s = state();
+    qint64 previous = 0;
+    for (const auto &mark : std::as_const(s.marks)) {
+        printLine(mark.first, mark.second, mark.second - previous);
+        previous = mark.second;
+    }
+    s.reported = true;
+}
+
+class FirstPaintFilter : public QObject {
+public:
+    using QObject::QObject;
+
+    bool eventFilter(QObject *watched, QEvent *event) override {
+        if (event->type() == QEvent::Paint) {
+            watched->removeEventFilter(this);
+            // Report after the paint has been handled, not before it.
+            QTimer::singleShot(0, [] {
+                StartupTimer::mark(QStringLiteral("first paint"));
+                printReport();
+            });
+            deleteLater();
+        }
+        return false;
+    }
+};
+
+} // namespace
+
+void StartupTimer::start() {
+    auto &s = state();
+    s.enabled = true;
+    s.clock.start();
+}
+
+bool StartupTimer::isEnabled() noexcept {
+    return state().enabled;
+}
+
+void StartupTimer::mark(const QString &label) {
+    auto &s = state();
+    if (!s.enabled) {
+        return;
+    }
+    const qint64 elapsed = s.clock.nsecsElapsed() / 1000;
+    if (s.reported) {
+        printLine(label, elapsed, elapsed - s.marks.last().second);
+    }
+    s.marks.append({label, elapsed});
+}
+
+void StartupTimer::reportOnFirstPaint(QObject *window) {
+    if (!state().enabled || !window) {
+        return;
+    }
+    window->installEventFilter(new FirstPaintFilter(window));
+}
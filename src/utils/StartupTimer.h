@@ -0,0 +1,19 @@
+#pragma once
+
+#include <QString>
+
+class QObject;
+
+// Milestones from process start to first paint, printed to stderr when the
+// app runs with --startup-trace. Everything is a no-op until start().
+class StartupTimer {
+public:
+    static void start();
+    static bool isEnabled() noexcept;
+
+    static void mark(const QString &label);
+
+    // Reports the breakdown once window has painted for the first time. Marks
+    // recorded after that (background loads) are printed as they arrive.
+    static void reportOnFirstPaint(QObject *window);
+};
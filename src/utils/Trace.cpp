@@ -0,0 +1,140 @@
+#include "Trace.h"
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Trace::s_enabled{false};
+
+namespace {
+
+// One ring slot, guarded by a per-slot seqlock. sequence is 2 * index + 1
+// while event index is being written and 2 * index + 2 once it is complete,
+// so a reader can tell a finished event from a torn or recycled slot.
+struct TraceSlot {
+    std::atomic<quint64> sequence{0};
+    std::atomic<const char *> name{nullptr};
+    std::atomic<qint64> startNs{0};
+    std::atomic<qint64> endNs{0};
+};
+
+// Single-producer ring: only the owning thread writes, and it publishes each
+// event by bumping written with release ordering.
+struct ThreadBuffer {
+    explicit ThreadBuffer(int threadId)
+        : id(threadId)
+        , events(Trace::kEventsPerThread) {}
+
+    int id;
+    std::vector<TraceSlot> events;
+    std::atomic<quint64> written{0};
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+};
+
+Registry &registry() {
+    static Registry instance;
+    return instance;
+}
+
+ThreadBuffer &localBuffer() {
+    // Buffers are owned by the registry so events survive thread exit.
+    thread_local ThreadBuffer *buffer = [] {
+        auto &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.buffers.push_back(std::make_shared<ThreadBuffer>(static_cast<int>(reg.buffers.size()) + 1));
+        return reg.buffers.back().get();
+    }();
+    return *buffer;
+}
+
+const qint64 kEpochNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+} // namespace
+
+qint64 Trace::nowNs() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() - kEpochNs;
+}
+
+void Trace::record(const char *name, qint64 startNs, qint64 endNs) noexcept {
+    auto &buffer = localBuffer();
+    const quint64 index = buffer.written.load(std::memory_order_relaxed);
+    auto &slot = buffer.events[index % kEventsPerThread];
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.endNs.store(endNs, std::memory_order_relaxed);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+QByteArray Trace::toJson() {
+    QJsonArray events;
+    const qint64 pid = QCoreApplication::applicationPid();
+    auto &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const auto &buffer : reg.buffers) {
+        const quint64 written = buffer->written.load(std::memory_order_acquire);
+        const quint64 first = written > static_cast<quint64>(kEventsPerThread) ? written - kEventsPerThread : 0;
+        events.append(QJsonObject{
+            {"name", "thread_name"},
+            {"ph", "M"},
+            {"pid", pid},
+            {"tid", buffer->id},
+            {"args", QJsonObject{{"name", buffer->id == 1 ? QStringLiteral("main") : QStringLiteral("thread %1").arg(buffer->id)}}},
+        });
+        for (quint64 i = first; i < written; ++i) {
+            const auto &slot = buffer->events[i % kEventsPerThread];
+            const quint64 expected = 2 * i + 2;
+            if (slot.sequence.load(std::memory_order_acquire) != expected) {
+                continue;
+            }
+            const char *name = slot.name.load(std::memory_order_relaxed);
+            const qint64 startNs = slot.startNs.load(std::memory_order_relaxed);
+            const qint64 endNs = slot.endNs.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // The owning thread lapped the ring while the slot was copied.
+            if (slot.sequence.load(std::memory_order_relaxed) != expected) {
+                continue;
+            }
+            events.append(QJsonObject{
+                {"name", QString::fromLatin1(name)},
+                {"ph", "X"},
+                {"pid", pid},
+                {"tid", buffer->id},
+                {"ts", static_cast<double>(startNs) / 1000.0},
+                {"dur", static_cast<double>(endNs - startNs) / 1000.0},
+            });
+        }
+    }
+    return QJsonDocument(QJsonObject{{"traceEvents", events}, {"displayTimeUnit", "ms"}}).toJson(QJsonDocument::Compact);
+}
+
+bool Trace::writeJson(const QString &path) {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(toJson());
+    return file.commit();
+}
+
+void Trace::clear() {
+    auto &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const auto &buffer : reg.buffers) {
+        buffer->written.store(0, std::memory_order_release);
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+
+// Scoped tracing that writes Chrome/Perfetto trace-event JSON. Each thread
+// records complete ("X") events into its own fixed-size ring buffer without
+// locking; when tracing is off a span costs one relaxed load and a branch.
+class Trace {
+public:
+    static constexpr int kEventsPerThread = 1 << 16;
+
+    static bool isEnabled() noexcept { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled) noexcept { s_enabled.store(enabled, std::memory_order_relaxed); }
+
+    static qint64 nowNs() noexcept;
+    static void record(const char *name, qint64 startNs, qint64 endNs) noexcept;
+
+    // Collects every thread's buffer into one trace file. Safe while other
+    // threads record: an event overwritten during the copy is skipped.
+    static bool writeJson(const QString &path);
+    static QByteArray toJson();
+    // Only safe while no other thread is recording.
+    static void clear();
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+class TraceScope {
+public:
+    explicit TraceScope(const char *name) noexcept
+        : m_name(Trace::isEnabled() ? name : nullptr) {
+        if (m_name) {
+            m_start = Trace::nowNs();
+        }
+    }
+    ~TraceScope() {
+        if (m_name) {
+            Trace::record(m_name, m_start, Trace::nowNs());
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *m_name;
+    qint64 m_start = 0;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// name must be a string literal (or otherwise outlive the trace).
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
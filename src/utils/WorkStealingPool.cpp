@@ -0,0 +1,105 @@
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+
+namespace {
+
+// Identifies the pool and deque of the calling thread, if it is a worker.
+thread_local const WorkStealingPool *t_pool = nullptr;
+thread_local int t_workerIndex = -1;
+
+} // namespace
+
+WorkStealingPool::WorkStealingPool(int threadCount)
+    : m_threadCount(threadCount > 0 ? threadCount : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))) {
+    m_workers.reserve(static_cast<std::size_t>(m_threadCount));
+    for (int i = 0; i < m_threadCount; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    m_threads.reserve(static_cast<std::size_t>(m_threadCount));
+    for (int i = 0; i < m_threadCount; ++i) {
+        m_threads.emplace_back([this, i]() { run(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto &thread : m_threads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::submit(Task task) {
+    const int index = t_pool == this ? t_workerIndex : static_cast<int>(m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_threadCount);
+    m_outstanding.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+        m_workers[index]->tasks.push_back(std::move(task));
+    }
+    {
+        // Counted under the sleep mutex so a worker about to wait cannot miss it.
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_queued.fetch_add(1, std::memory_order_release);
+    }
+    m_wake.notify_one();
+}
+
+void WorkStealingPool::waitForIdle() {
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_idle.wait(lock, [this]() { return m_outstanding.load(std::memory_order_acquire) == 0; });
+}
+
+void WorkStealingPool::run(int index) {
+    t_pool = this;
+    t_workerIndex = index;
+    Task task;
+    for (;;) {
+        if (popLocal(index, task) || steal(index, task)) {
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            task = nullptr;
+            finishTask();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this]() { return m_stopping || m_queued.load(std::memory_order_acquire) > 0; });
+        if (m_stopping && m_queued.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+bool WorkStealingPool::popLocal(int index, Task &task) {
+    auto &worker = *m_workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+        return false;
+    }
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(int thief, Task &task) {
+    for (int offset = 1; offset < m_threadCount; ++offset) {
+        auto &victim = *m_workers[(thief + offset) % m_threadCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::finishTask() {
+    if (m_outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_idle.notify_all();
+    }
+}
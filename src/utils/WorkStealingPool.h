@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task deque. A worker pops
+// its newest task first and, when it runs dry, steals the oldest task from
+// another worker. Tasks submitted from a worker go to that worker's deque, so
+// a task that reschedules itself stays warm on the same core until stolen.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    // threadCount <= 0 uses one thread per hardware core.
+    explicit WorkStealingPool(int threadCount = 0);
+    // Runs every task still queued, then joins the workers.
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    void submit(Task task);
+    // Blocks until no task is queued or running.
+    void waitForIdle();
+
+    int threadCount() const noexcept { return m_threadCount; }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(int index);
+    bool popLocal(int index, Task &task);
+    bool steal(int thief, Task &task);
+    void finishTask();
+
+    int m_threadCount = 0;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::atomic<int> m_queued{0};
+    std::atomic<int> m_outstanding{0};
+    std::atomic<unsigned> m_nextWorker{0};
+    bool m_stopping = false;
+};
@@ -1,10 +1,129 @@
 #include <QtTest/QtTest>
 
 #include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QRandomGenerator>
+#include <QTcpSocket>
+#include <QTemporaryDir>
 
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+#include "broadcast/BroadcastServer.h"
+#include "daemon/CommandProcessor.h"
+#include "daemon/DaemonServer.h"
+#include "host/EncounterHost.h"
+#include "analytics/CampaignAnalytics.h"
+#include "models/AreaEffect.h"
 #include "models/TurnManager.h"
+#include "stores/BestiaryImport.h"
+#include "stores/CombatLog.h"
 #include "stores/EncounterStore.h"
 #include "stores/RosterStore.h"
+#include "undo/UndoHistory.h"
+#include "utils/Arena.h"
+#include "utils/Trace.h"
+
+namespace {
+
+// Any JSON type, so the fuzzed documents also exercise wrong-typed fields.
+QJsonValue fuzzValue(QRandomGenerator &rng, int depth = 0) {
+    switch (rng.bounded(depth > 1 ? 6 : 8)) {
+    case 0:
+        return rng.bounded(-1000, 1000);
+    case 1:
+        return rng.bounded(2) ? 2.5 : 4.0;
+    case 2:
+        return rng.bounded(2) == 1;
+    case 3:
+        return QStringLiteral("s%1\u00e9").arg(rng.bounded(100));
+    case 4:
+        return QJsonValue(QJsonValue::Undefined);
+    case 5:
+        return QJsonValue(QJsonValue::Null);
+    case 6: {
+        QJsonObject obj;
+        for (const char *key : {"name", "remainingRounds", "successes", "failures", "dead", "stable"}) {
+            if (rng.bounded(3) != 0) {
+                obj.insert(QLatin1String(key), fuzzValue(rng, depth + 1));
+            }
+        }
+        return obj;
+    }
+    default: {
+        QJsonArray array;
+        for (int i = rng.bounded(4); i > 0; --i) {
+            array.append(fuzzValue(rng, depth + 1));
+        }
+        return array;
+    }
+    }
+}
+
+QJsonObject fuzzObject(QRandomGenerator &rng, const QStringList &keys) {
+    QJsonObject obj;
+    for (const auto &key : keys) {
+        if (rng.bounded(5) != 0) {
+            const auto value = fuzzValue(rng);
+            if (!value.isUndefined()) {
+                obj.insert(key, value);
+            }
+        }
+    }
+    if (rng.bounded(10) == 0) {
+        obj.insert(QStringLiteral("extra"), 1);
+    }
+    return obj;
+}
+
+// The original value()-based loaders, kept as the reference behaviour.
+Combatant referenceCombatant(const QJsonObject &obj) {
+    Combatant combatant;
+    combatant.id = obj.value("id").toInt();
+    combatant.name = obj.value("name").toString();
+    combatant.initiative = obj.value("initiative").toInt();
+    combatant.dexMod = obj.value("dexMod").toInt();
+    combatant.isPC = obj.value("isPC").toBool();
+    combatant.conscious = obj.value("conscious").toBool(true);
+    combatant.hp = obj.value("hp").toInt();
+    combatant.ac = obj.value("ac").toInt();
+    const auto ds = obj.value("deathSaves").toObject();
+    combatant.deathSaves.successes = ds.value("successes").toInt();
+    combatant.deathSaves.failures = ds.value("failures").toInt();
+    combatant.deathSaves.dead = ds.value("dead").toBool();
+    combatant.deathSaves.stable = ds.value("stable").toBool();
+    for (const auto &conditionValue : obj.value("conditions").toArray()) {
+        const auto conditionObj = conditionValue.toObject();
+        Condition condition;
+        condition.name = conditionObj.value("name").toString();
+        condition.remainingRounds = conditionObj.value("remainingRounds").toInt();
+        combatant.conditions.push_back(condition);
+    }
+    combatant.notes = obj.value("notes").toString();
+    return combatant;
+}
+
+RosterCharacter referenceCharacter(const QJsonObject &obj) {
+    RosterCharacter character;
+    character.name = obj.value("name").toString();
+    character.dexMod = obj.value("dexMod").toInt();
+    character.isPC = obj.value("isPC").toBool();
+    for (const auto &tag : obj.value("tags").toArray()) {
+        character.tags.insert(tag.toString());
+    }
+    character.defaultHP = obj.value("defaultHP").toInt();
+    character.defaultAC = obj.value("defaultAC").toInt();
+    character.defaultNotes = obj.value("defaultNotes").toString();
+    return character;
+}
+
+} // namespace
 
 class TestTurnManager : public QObject {
     Q_OBJECT
@@ -14,6 +133,32 @@ private slots:
     void deathSavesLogic();
     void massAddNaming();
     void encounterRoundTrip();
+    void fieldDeltaUndo();
+    void undoHistoryCompaction();
+    void versionTimeline();
+    void batchCommands();
+    void areaEffectResolution();
+    void changeTracking();
+    void traceEvents();
+    void rosterReadAndApply();
+    void asyncStoreIo();
+    void parallelDecodeMatchesReference();
+    void daemonCommands();
+    void daemonTransports();
+    void encounterHostActors();
+    void playerBroadcast();
+    void snapshotReadersStress();
+    void internedNamesAndConditions();
+    void initiativeRulePolicies();
+    void radixSortMatchesComparison();
+    void cohortOrdering();
+    void mobRows();
+    void arenaAllocation();
+    void combatLogQueries();
+    void campaignAnalytics();
+    void rosterIncrementalReload();
+    void rosterShardedSave();
+    void bestiaryImport();
 };
 
 void TestTurnManager::sortingRule() {
@@ -25,9 +170,9 @@ void TestTurnManager::sortingRule() {
     manager.addCombatant(b);
     manager.addCombatant(c);
     const auto &list = manager.combatants();
-    QCOMPARE(list[0].name, QStringLiteral("Charlie"));
-    QCOMPARE(list[1].name, QStringLiteral("Alice"));
-    QCOMPARE(list[2].name, QStringLiteral("Bob"));
+    QCOMPARE(list[0].name.toString(), QStringLiteral("Charlie"));
+    QCOMPARE(list[1].name.toString(), QStringLiteral("Alice"));
+    QCOMPARE(list[2].name.toString(), QStringLiteral("Bob"));
 }
 
 void TestTurnManager::conditionDecrement() {
@@ -76,8 +221,8 @@ void TestTurnManager::massAddNaming() {
 
     const auto added = store.massAdd("Bandit", 3, naming);
     QCOMPARE(added.size(), 3);
-    QCOMPARE(added[0].name, QStringLiteral("Bandit 01"));
-    QCOMPARE(added[1].name, QStringLiteral("Bandit 02"));
+    QCOMPARE(added[0].name.toString(), QStringLiteral("Bandit 01"));
+    QCOMPARE(added[1].name.toString(), QStringLiteral("Bandit 02"));
     QCOMPARE(added[2].hp, 11);
     QCOMPARE(added[2].notes, QStringLiteral("Sneaky"));
 }
@@ -106,6 +251,1563 @@ void TestTurnManager::encounterRoundTrip() {
     QCOMPARE(restored.combatants().size(), manager.combatants().size());
     QCOMPARE(restored.combatants()[0].conditions.size(), 1);
     QCOMPARE(restored.combatants()[1].deathSaves.failures, 1);
+
+    const auto generation = restored.generation();
+    restored.setTurnState(restoredRound, restoredTurnIndex);
+    QCOMPARE(restored.round(), round);
+    QCOMPARE(restored.turnIndex(), turnIndex);
+    QCOMPARE(restored.currentVersion().turnIndex, turnIndex);
+    QVERIFY(restored.generation() > generation);
+    restored.setTurnState(0, 7);
+    QCOMPARE(restored.round(), 1);
+    QCOMPARE(restored.turnIndex(), 1);
+}
+
+void TestTurnManager::fieldDeltaUndo() {
+    TurnManager manager;
+    Combatant a{1, "Alice", 15, 2, true};
+    a.hp = 25;
+    a.notes = "A long note that should not be copied into every edit.";
+    manager.addCombatant(a);
+    Combatant b{2, "Bob", 12, 1, false};
+    manager.addCombatant(b);
+
+    Combatant after = a;
+    after.hp = 18;
+    after.initiative = 10;
+    const auto deltas = diffCombatants(a, after);
+    QCOMPARE(deltas.size(), 2);
+    QCOMPARE(deltas[0].field, CombatantField::Initiative);
+    QCOMPARE(deltas[1].field, CombatantField::HP);
+
+    UndoHistory history(&manager);
+    history.push(new EditCombatantCommand(&manager, a.id, a, after));
+    QCOMPARE(manager.combatants()[1].name.toString(), QStringLiteral("Alice"));
+    QCOMPARE(manager.combatants()[1].hp, 18);
+
+    history.undo();
+    QCOMPARE(manager.combatants()[0].name.toString(), QStringLiteral("Alice"));
+    QCOMPARE(manager.combatants()[0].hp, 25);
+    QCOMPARE(manager.combatants()[0].notes, a.notes);
+    history.redo();
+    QCOMPARE(manager.combatants()[1].hp, 18);
+}
+
+void TestTurnManager::undoHistoryCompaction() {
+    TurnManager manager;
+    Combatant a{1, "Alice", 15, 2, true};
+    a.hp = 100;
+    manager.addCombatant(a);
+
+    UndoHistory history(&manager);
+    history.setByteBudget(2048);
+    Combatant current = a;
+    for (int i = 0; i < 200; ++i) {
+        Combatant next = current;
+        next.hp = current.hp - 1;
+        history.push(new EditCombatantCommand(&manager, a.id, current, next));
+        current = next;
+    }
+    QVERIFY(history.byteSize() <= history.byteBudget());
+    QVERIFY(history.count() < 200);
+    QCOMPARE(manager.combatants()[0].hp, a.hp - 200);
+
+    while (history.canUndo()) {
+        history.undo();
+    }
+    QCOMPARE(manager.combatants()[0].hp, a.hp);
+
+    // Removing an id and adding it back replays as a replacement, both when
+    // recorded directly and when merged from an earlier snapshot.
+    Combatant replacement = a;
+    replacement.name = QStringLiteral("Alicia");
+    ChangeSet replaced;
+    replaced.recordRemoved(a);
+    replaced.recordAdded(replacement);
+    ChangeSet merged;
+    merged.merge(replaced);
+    QVERIFY(!merged.isEmpty());
+    for (const ChangeSet *changes : {&replaced, &merged}) {
+        changes->redo(&manager);
+        QCOMPARE(manager.combatants().size(), 1);
+        QCOMPARE(manager.combatants()[0].name.toString(), QStringLiteral("Alicia"));
+        changes->undo(&manager);
+        QCOMPARE(manager.combatants().size(), 1);
+        QCOMPARE(manager.combatants()[0].name.toString(), QStringLiteral("Alice"));
+    }
+}
+
+void TestTurnManager::versionTimeline() {
+    TurnManager manager;
+    TurnManager::CombatantList list;
+    for (int i = 0; i < 100; ++i) {
+        Combatant combatant{i + 1, QStringLiteral("Goblin %1").arg(i + 1), 10 + (i % 7), 1, false};
+        combatant.hp = 7;
+        list.push_back(combatant);
+    }
+    manager.setCombatants(list);
+    const EncounterVersion start = manager.currentVersion();
+    const int firstId = manager.combatants().first().id;
+
+    manager.updateCombatant(firstId, [](Combatant &combatant) { combatant.hp = 1; });
+    manager.advanceTurn();
+    manager.advanceTurn();
+    const EncounterVersion later = manager.currentVersion();
+    QVERIFY(later.serial > start.serial);
+    QCOMPARE(later.round, 1);
+    QCOMPARE(later.turnIndex, 2);
+    QCOMPARE(later.at(0).hp, 1);
+    QCOMPARE(start.at(0).hp, 7);
+    // Untouched combatants are shared between versions, not copied.
+    QCOMPARE(start.storage.at(start.order.at(5)).get(), later.storage.at(later.order.at(5)).get());
+
+    const auto *found = manager.timeline().find(1, 2);
+    QVERIFY(found);
+    QCOMPARE(found->serial, later.serial);
+
+    manager.restoreVersion(start);
+    QCOMPARE(manager.turnIndex(), 0);
+    QCOMPARE(manager.combatants().first().hp, 7);
+    QCOMPARE(manager.combatants().size(), 100);
+
+    UndoHistory history(&manager);
+    history.push(new RestoreVersionCommand(&manager, later));
+    QCOMPARE(manager.combatants().first().hp, 1);
+    history.undo();
+    QCOMPARE(manager.combatants().first().hp, 7);
+
+    // A jump that only moves the turn marker still survives compaction.
+    manager.advanceTurn();
+    const EncounterVersion moved = manager.currentVersion();
+    manager.restoreVersion(start);
+    RestoreVersionCommand jump(&manager, moved);
+    ChangeSet changes;
+    jump.collectChanges(changes);
+    QVERIFY(!changes.isEmpty());
+    CompactedHistoryCommand compacted(&manager, changes);
+    compacted.redo();
+    QCOMPARE(manager.turnIndex(), 1);
+    compacted.undo();
+    QCOMPARE(manager.turnIndex(), 0);
+}
+
+void TestTurnManager::batchCommands() {
+    TurnManager manager;
+    manager.addCombatant(Combatant{1, "Alice", 15, 2, true});
+
+    QVector<Combatant> spawned;
+    for (int i = 0; i < 40; ++i) {
+        Combatant goblin{100 + i, QStringLiteral("Goblin %1").arg(i + 1), 12, 2, false};
+        goblin.hp = 7;
+        spawned.push_back(goblin);
+    }
+    UndoHistory history(&manager);
+    const auto serialBefore = manager.currentVersion().serial;
+    history.push(new AddCombatantsCommand(&manager, spawned));
+    QCOMPARE(manager.combatants().size(), 41);
+    QCOMPARE(manager.currentVersion().serial, serialBefore + 1);
+
+    QVector<Combatant> before;
+    QVector<Combatant> after;
+    for (int i = 0; i < 25; ++i) {
+        const auto goblin = manager.combatantById(100 + i);
+        QVERIFY(goblin.has_value());
+        before.push_back(*goblin);
+        Combatant burned = *goblin;
+        burned.hp = 0;
+        burned.conscious = false;
+        after.push_back(burned);
+    }
+    history.push(new ApplyToManyCommand(&manager, before, after));
+    QCOMPARE(manager.currentVersion().serial, serialBefore + 2);
+    QCOMPARE(manager.combatantById(110)->hp, 0);
+    QVERIFY(!manager.combatantById(124)->conscious);
+    QCOMPARE(manager.combatantById(125)->hp, 7);
+
+    history.undo();
+    QCOMPARE(manager.combatantById(110)->hp, 7);
+    QCOMPARE(manager.currentVersion().serial, serialBefore + 3);
+    history.undo();
+    QCOMPARE(manager.combatants().size(), 1);
+    history.redo();
+    QCOMPARE(manager.combatants().size(), 41);
+}
+
+void TestTurnManager::areaEffectResolution() {
+    const auto expression = DiceExpression::parse(QStringLiteral("2d8+3"));
+    QVERIFY(expression.has_value());
+    QCOMPARE(expression->count, 2);
+    QCOMPARE(expression->sides, 8);
+    QCOMPARE(expression->bonus, 3);
+    QCOMPARE(DiceExpression::parse(QStringLiteral("10"))->bonus, 10);
+    QVERIFY(!DiceExpression::parse(QStringLiteral("d")).has_value());
+    QVERIFY(DiceExpression::parse(QStringLiteral("1000d1000")).has_value());
+    QVERIFY(!DiceExpression::parse(QStringLiteral("1001d6")).has_value());
+    QVERIFY(!DiceExpression::parse(QStringLiteral("2d1001")).has_value());
+    QVERIFY(!DiceExpression::parse(QStringLiteral("99999999999d6")).has_value());
+
+    TurnManager manager;
+    for (int i = 0; i < 4; ++i) {
+        Combatant goblin{i + 1, QStringLiteral("Goblin %1").arg(i + 1), 10 - i, 0, false};
+        goblin.hp = 12;
+        manager.addCombatant(goblin);
+    }
+    manager.updateCombatant(4, [](Combatant &combatant) {
+        combatant.hp = 0;
+        combatant.conscious = false;
+    });
+
+    DiceRoller roller;
+    roller.setSeed(42);
+    AreaEffectSpec spec;
+    spec.damage = *DiceExpression::parse(QStringLiteral("10"));
+    spec.modifierSource = SaveModifierSource::None;
+    spec.saveDC = 25;
+    auto result = resolveAreaEffect(manager, {0, 1, 2, 3}, spec, roller);
+    QCOMPARE(result.size(), 4);
+    QVERIFY(std::none_of(result.saved.begin(), result.saved.end(), [](quint8 saved) { return saved != 0; }));
+    QCOMPARE(result.hpAfter.at(0), 2);
+    QCOMPARE(result.deathSavesAfter.at(3).failures, 1);
+
+    spec.modifierSource = SaveModifierSource::Fixed;
+    spec.fixedModifier = 30;
+    result = resolveAreaEffect(manager, {0, 1}, spec, roller);
+    QCOMPARE(result.damage.at(0), 5);
+    QCOMPARE(result.hpAfter.at(1), 7);
+    spec.halfOnSave = false;
+    result = resolveAreaEffect(manager, {0}, spec, roller);
+    QCOMPARE(result.damage.at(0), 0);
+
+    spec.fixedModifier = 0;
+    spec.modifierSource = SaveModifierSource::None;
+    spec.damage = *DiceExpression::parse(QStringLiteral("20"));
+    result = resolveAreaEffect(manager, {0, 1, 2, 3}, spec, roller);
+    QVector<Combatant> before;
+    QVector<Combatant> after;
+    result.collectEdits(manager, before, after);
+    UndoHistory history(&manager);
+    history.push(new ApplyToManyCommand(&manager, before, after));
+    QCOMPARE(manager.combatantById(1)->hp, 0);
+    QVERIFY(!manager.combatantById(2)->conscious);
+    history.undo();
+    QCOMPARE(manager.combatantById(1)->hp, 12);
+
+    // No HP tracked (0 and conscious): nothing changes. A negated hit leaves
+    // a hand-set unconscious flag alone.
+    manager.updateCombatant(3, [](Combatant &combatant) { combatant.hp = 0; });
+    manager.updateCombatant(2, [](Combatant &combatant) { combatant.conscious = false; });
+    spec.modifierSource = SaveModifierSource::Fixed;
+    spec.fixedModifier = 30;
+    spec.halfOnSave = false;
+    result = resolveAreaEffect(manager, {1, 2}, spec, roller);
+    QCOMPARE(result.damage.at(0), 0);
+    QCOMPARE(result.consciousAfter.at(0), quint8(0));
+    spec.modifierSource = SaveModifierSource::None;
+    result = resolveAreaEffect(manager, {2}, spec, roller);
+    QCOMPARE(result.hpAfter.at(0), 0);
+    QCOMPARE(result.consciousAfter.at(0), quint8(1));
+    QCOMPARE(result.deathSavesAfter.at(0).failures, 0);
+}
+
+void TestTurnManager::changeTracking() {
+    TurnManager manager;
+    manager.setCombatants({Combatant{1, "Alice", 15, 2, true}, Combatant{2, "Bob", 12, 1, true}, Combatant{3, "Cara", 8, 0, false}});
+    const quint64 start = manager.generation();
+    QVERIFY(manager.changesSince(start).isEmpty());
+    QVERIFY(manager.changesSince(start - 1).reset);
+
+    manager.updateCombatant(2, [](Combatant &combatant) { combatant.hp = 3; });
+    auto changes = manager.changesSince(start);
+    QCOMPARE(changes.generation, start + 1);
+    QCOMPARE(changes.changedIds, QVector<int>{2});
+    QVERIFY(!changes.orderChanged);
+    QCOMPARE(manager.generationOf(2), start + 1);
+    QCOMPARE(manager.generationOf(1), quint64(0));
+
+    const quint64 afterEdit = manager.generation();
+    manager.updateCombatant(2, [](Combatant &) {});
+    QCOMPARE(manager.generation(), afterEdit);
+
+    manager.addCombatant(Combatant{4, "Dax", 20, 3, false});
+    manager.removeCombatant(3);
+    manager.advanceTurn();
+    changes = manager.changesSince(afterEdit);
+    QCOMPARE(changes.changedIds, QVector<int>{4});
+    QCOMPARE(changes.removedIds, QVector<int>{3});
+    QVERIFY(changes.orderChanged);
+    QVERIFY(changes.turnChanged);
+
+    manager.addCombatant(Combatant{5, "Eve", 1, 0, false});
+    manager.removeCombatant(5);
+    changes = manager.changesSince(manager.generation() - 2);
+    QCOMPARE(changes.removedIds, QVector<int>{5});
+    QVERIFY(changes.changedIds.isEmpty());
+
+    const quint64 beforeFlood = manager.generation();
+    for (int i = 0; i < 2000; ++i) {
+        manager.updateCombatant(1, [i](Combatant &combatant) { combatant.hp = i; });
+    }
+    QVERIFY(manager.changesSince(beforeFlood).reset);
+    changes = manager.changesSince(manager.generation() - 1);
+    QVERIFY(!changes.reset);
+    QCOMPARE(changes.changedIds, QVector<int>{1});
+}
+
+void TestTurnManager::traceEvents() {
+    Trace::clear();
+    TurnManager manager;
+    manager.addCombatant(Combatant{1, "Alice", 15, 2, true});
+    QVERIFY(!Trace::toJson().contains("TurnManager::addCombatants"));
+
+    Trace::setEnabled(true);
+    manager.addCombatant(Combatant{2, "Bob", 12, 1, true});
+    manager.advanceTurn();
+    Trace::setEnabled(false);
+    manager.rewindTurn();
+
+    const auto document = QJsonDocument::fromJson(Trace::toJson());
+    QStringList names;
+    for (const auto &value : document.object().value("traceEvents").toArray()) {
+        const auto event = value.toObject();
+        if (event.value("ph").toString() == QStringLiteral("X")) {
+            QVERIFY(event.value("dur").toDouble() >= 0.0);
+            names << event.value("name").toString();
+        }
+    }
+    QVERIFY(names.contains(QStringLiteral("TurnManager::addCombatants")));
+    QVERIFY(names.contains(QStringLiteral("TurnManager::advanceTurn")));
+    QVERIFY(!names.contains(QStringLiteral("TurnManager::rewindTurn")));
+
+    // Dumping while another thread laps its ring only yields whole events.
+    std::atomic<bool> stop{false};
+    std::thread writer([&stop] {
+        for (qint64 i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+            Trace::record("Trace::stress", i * 1000, i * 1000 + 1000);
+        }
+    });
+    int torn = 0;
+    for (int pass = 0; pass < 5; ++pass) {
+        const auto dump = QJsonDocument::fromJson(Trace::toJson());
+        for (const auto &value : dump.object().value("traceEvents").toArray()) {
+            const auto event = value.toObject();
+            if (event.value("name").toString() == QStringLiteral("Trace::stress") && event.value("dur").toDouble() != 1.0) {
+                ++torn;
+            }
+        }
+    }
+    stop.store(true);
+    writer.join();
+    QCOMPARE(torn, 0);
+    Trace::clear();
+}
+
+void TestTurnManager::rosterReadAndApply() {
+    QTemporaryDir temp;
+    QVERIFY(temp.isValid());
+    const auto basePath = temp.path();
+    RosterStore writer;
+    writer.setBasePath(basePath);
+    RosterCharacter character;
+    character.name = "Ogre";
+    character.tags = {"giant"};
+    writer.setCharacters({character});
+    writer.setGroups({RosterGroup{"Camp", {{"Ogre", 2}}}});
+    MassAddNaming naming;
+    naming.pattern = "%name-%index";
+    writer.setDefaultNaming(naming);
+    QVERIFY(writer.save());
+
+    auto data = RosterStore::readFiles(basePath);
+    QVERIFY(data.hasCharacters);
+    QVERIFY(data.hasGroups);
+    QCOMPARE(data.characters.size(), 1);
+
+    RosterStore reader;
+    reader.setBasePath(basePath);
+    QSignalSpy changed(&reader, &RosterStore::dataChanged);
+    reader.apply(std::move(data));
+    QCOMPARE(changed.count(), 1);
+    QCOMPARE(reader.characters().first().name, QStringLiteral("Ogre"));
+    QCOMPARE(reader.groups().first().entries.first().count, 2);
+    QCOMPARE(reader.defaultNaming().pattern, QStringLiteral("%name-%index"));
+
+    QVERIFY(!RosterStore::readFiles(basePath + "/missing").hasCharacters);
+    QVERIFY(!EncounterStore::readFile(basePath + "/missing.json").has_value());
+}
+
+void TestTurnManager::asyncStoreIo() {
+    QTemporaryDir temp;
+    QVERIFY(temp.isValid());
+    const auto path = temp.filePath(QStringLiteral("encounter.json"));
+    TurnManager::CombatantList rats;
+    for (int i = 0; i < 3000; ++i) {
+        rats.push_back(Combatant{i + 1, QStringLiteral("Rat %1").arg(i + 1), i % 20, 0, false});
+    }
+    TurnManager manager;
+    manager.setCombatants(rats);
+    EncounterStore store;
+    store.setFilePath(path);
+    auto saved = store.saveAsync(manager, 3, 1);
+    // Edits after the request must not leak into the snapshot being written.
+    manager.removeCombatant(1);
+    saved.waitForFinished();
+    QVERIFY(saved.result());
+
+    auto loaded = store.loadAsync();
+    loaded.waitForFinished();
+    QCOMPARE(loaded.resultCount(), 1);
+    QCOMPARE(loaded.progressValue(), loaded.progressMaximum());
+    const auto data = loaded.takeResult();
+    QCOMPARE(data.round, 3);
+    QCOMPARE(data.combatants.size(), 3000);
+
+    int calls = 0;
+    const auto canceled = EncounterStore::readFile(path, [&calls](int, int) { return ++calls < 2; });
+    QVERIFY(!canceled.has_value());
+    QCOMPARE(calls, 2);
+
+    // The newer ticket wins even when its write lands first.
+    const auto older = StoreWriteSequencer::reserve(path);
+    const auto newer = StoreWriteSequencer::reserve(path);
+    QVERIFY(StoreWriteSequencer::write(path, newer, "newer"));
+    QVERIFY(StoreWriteSequencer::write(path, older, "older"));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), QByteArray("newer"));
+}
+
+void TestTurnManager::parallelDecodeMatchesReference() {
+    QRandomGenerator rng(2024);
+    const QStringList combatantKeys{"id", "name", "initiative", "dexMod", "isPC", "conscious", "hp", "ac", "deathSaves", "conditions", "notes"};
+    QJsonArray combatants;
+    for (int i = 0; i < 20000; ++i) {
+        combatants.append(fuzzObject(rng, combatantKeys));
+    }
+    const auto text = QJsonDocument(QJsonObject{{"schema", 2}, {"round", 4}, {"turnIndex", 2}, {"combatants", combatants}}).toJson();
+    // The reference runs over the re-parsed text, exactly what the loader sees.
+    QVector<Combatant> expected;
+    for (const auto &value : QJsonDocument::fromJson(text).object().value("combatants").toArray()) {
+        expected.push_back(referenceCombatant(value.toObject()));
+    }
+    const auto decoded = EncounterStore::decode(text);
+    QVERIFY(decoded.has_value());
+    QCOMPARE(decoded->combatants.size(), expected.size());
+    for (int i = 0; i < expected.size(); ++i) {
+        QVERIFY2(decoded->combatants.at(i) == expected.at(i), qPrintable(QStringLiteral("combatant %1").arg(i)));
+    }
+
+    const QStringList characterKeys{"name", "dexMod", "isPC", "tags", "defaultHP", "defaultAC", "defaultNotes"};
+    QJsonArray characters;
+    for (int i = 0; i < 10000; ++i) {
+        characters.append(fuzzObject(rng, characterKeys));
+    }
+    const auto charactersText = QJsonDocument(QJsonObject{{"schema", 2}, {"characters", characters}}).toJson();
+    QVector<RosterCharacter> expectedCharacters;
+    for (const auto &value : QJsonDocument::fromJson(charactersText).object().value("characters").toArray()) {
+        expectedCharacters.push_back(referenceCharacter(value.toObject()));
+    }
+    QTemporaryDir temp;
+    QVERIFY(temp.isValid());
+    QFile file(temp.filePath(QStringLiteral("characters.json")));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(charactersText);
+    file.close();
+    const auto data = RosterStore::readFiles(temp.path());
+    QCOMPARE(data.characters.size(), expectedCharacters.size());
+    for (int i = 0; i < expectedCharacters.size(); ++i) {
+        const auto &actual = data.characters.at(i);
+        const auto &reference = expectedCharacters.at(i);
+        QVERIFY2(actual.name == reference.name && actual.dexMod == reference.dexMod && actual.isPC == reference.isPC
+                     && actual.tags == reference.tags && actual.defaultHP == reference.defaultHP
+                     && actual.defaultAC == reference.defaultAC && actual.defaultNotes == reference.defaultNotes,
+                 qPrintable(QStringLiteral("character %1").arg(i)));
+    }
+}
+
+void TestTurnManager::daemonCommands() {
+    TurnManager manager;
+    DiceRoller roller;
+    CommandProcessor processor(manager, roller);
+    QByteArray input = "{\"cmd\":\"add\",\"name\":\"Goblin\",\"initiative\":12,\"hp\":7,\"seq\":1}\n"
+                       "{\"cmd\":\"add\",\"name\":\"Hero\",\"initiative\":18,\"isPC\":true,\"hp\":30}\n"
+                       "\n"
+                       "{\"cmd\":\"set-hp\",\"id\":1,\"hp\":3}\n"
+                       "{\"cmd\":\"advance\"}\n"
+                       "{\"cmd\":\"remove\",\"id\":99}\n"
+                       "not json\n"
+                       "{\"cmd\":\"snap";
+    QByteArray out;
+    QCOMPARE(processor.processBuffer(input, out), 6);
+    QCOMPARE(input, QByteArray("{\"cmd\":\"snap"));
+
+    const auto lines = out.trimmed().split('\n');
+    QCOMPARE(lines.size(), 6);
+    const auto event = [&](int i) { return QJsonDocument::fromJson(lines.at(i)).object(); };
+    QCOMPARE(event(0).value("event").toString(), QString("added"));
+    QCOMPARE(event(0).value("id").toInt(), 1);
+    QCOMPARE(event(0).value("seq").toInt(), 1);
+    QCOMPARE(event(1).value("id").toInt(), 2);
+    QCOMPARE(event(1).value("index").toInt(), 0);
+    QCOMPARE(event(2).value("event").toString(), QString("hp"));
+    QCOMPARE(manager.combatantById(1)->hp, 3);
+    QCOMPARE(event(3).value("event").toString(), QString("turn"));
+    QCOMPARE(event(3).value("currentId").toInt(), 1);
+    QCOMPARE(event(4).value("event").toString(), QString("error"));
+    QCOMPARE(event(5).value("event").toString(), QString("error"));
+
+    input += "shot\",\"seq\":\"s\"}\n";
+    out.clear();
+    QCOMPARE(processor.processBuffer(input, out), 1);
+    QVERIFY(input.isEmpty());
+    const auto snapshot = QJsonDocument::fromJson(out).object();
+    QCOMPARE(snapshot.value("event").toString(), QString("snapshot"));
+    QCOMPARE(snapshot.value("seq").toString(), QString("s"));
+    QCOMPARE(snapshot.value("combatants").toArray().size(), 2);
+    QCOMPARE(snapshot.value("combatants").toArray().at(0).toObject().value("name").toString(), QString("Hero"));
+}
+
+void TestTurnManager::daemonTransports() {
+    const QByteArray commands = "{\"cmd\":\"add\",\"name\":\"Goblin\",\"initiative\":12,\"hp\":7,\"seq\":1}\n"
+                                "{\"cmd\":\"add\",\"name\":\"Hero\",\"initiative\":18,\"hp\":30,\"seq\":2}\n"
+                                "{\"cmd\":\"advance\",\"seq\":3}\n"
+                                "{\"cmd\":\"snapshot\",\"seq\":4}";
+    const auto parseEvents = [](const QByteArray &replies) {
+        QVector<QJsonObject> events;
+        for (const auto &line : replies.trimmed().split('\n')) {
+            events.push_back(QJsonDocument::fromJson(line).object());
+        }
+        return events;
+    };
+
+    // Stdio mode answers the final line even without a newline.
+    std::FILE *in = std::tmpfile();
+    std::FILE *out = std::tmpfile();
+    QVERIFY(in && out);
+    std::fwrite(commands.constData(), 1, static_cast<std::size_t>(commands.size()), in);
+    std::rewind(in);
+    {
+        TurnManager manager;
+        DiceRoller roller;
+        CommandProcessor processor(manager, roller);
+        QCOMPARE(processor.runStdio(in, out), 0);
+    }
+    std::rewind(out);
+    QByteArray stdioReplies;
+    char buffer[4096];
+    for (std::size_t read = 0; (read = std::fread(buffer, 1, sizeof(buffer), out)) > 0;) {
+        stdioReplies.append(buffer, static_cast<qsizetype>(read));
+    }
+    std::fclose(in);
+    std::fclose(out);
+    auto events = parseEvents(stdioReplies);
+    QCOMPARE(events.size(), 4);
+    for (int i = 0; i < events.size(); ++i) {
+        QCOMPARE(events.at(i).value("seq").toInt(), i + 1);
+    }
+    QCOMPARE(events.at(0).value("event").toString(), QString("added"));
+    QCOMPARE(events.at(2).value("event").toString(), QString("turn"));
+    QCOMPARE(events.at(3).value("event").toString(), QString("snapshot"));
+    QCOMPARE(events.at(3).value("combatants").toArray().size(), 2);
+
+    // Socket mode keeps replies in order across an attach to a new encounter.
+    EncounterHost host(2);
+    DaemonServer server(host);
+    const auto name = QStringLiteral("dnd-test-daemon-%1").arg(QCoreApplication::applicationPid());
+    QVERIFY2(server.listen(name), qPrintable(server.errorString()));
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    QVERIFY(socket.waitForConnected(5000));
+    socket.write(commands + "\n{\"cmd\":\"attach\",\"encounter\":\"side-table\",\"seq\":5}\n{\"cmd\":\"snapshot\",\"seq\":6}\n");
+    QByteArray socketReplies;
+    const auto received = [&]() {
+        socketReplies += socket.readAll();
+        return socketReplies.count('\n');
+    };
+    QTRY_COMPARE_WITH_TIMEOUT(received(), 6, 5000);
+    events = parseEvents(socketReplies);
+    for (int i = 0; i < events.size(); ++i) {
+        QCOMPARE(events.at(i).value("seq").toInt(), i + 1);
+    }
+    QCOMPARE(events.at(3).value("combatants").toArray().size(), 2);
+    QCOMPARE(events.at(4).value("event").toString(), QString("attached"));
+    QCOMPARE(events.at(5).value("combatants").toArray().size(), 0);
+}
+
+void TestTurnManager::encounterHostActors() {
+    QTemporaryDir temp;
+    QVERIFY(temp.isValid());
+    const auto autosaveDir = temp.path();
+    constexpr int kEncounters = 8;
+    constexpr int kBatches = 200;
+    std::mutex mutex;
+    QHash<QString, QVector<int>> seqs;
+    {
+        EncounterHost host(4);
+        host.setSeed(37);
+        host.setAutosaveDirectory(autosaveDir);
+        QVERIFY(!host.open(QStringLiteral("../escape")));
+        for (int batch = 0; batch < kBatches; ++batch) {
+            for (int e = 0; e < kEncounters; ++e) {
+                const auto id = QStringLiteral("table-%1").arg(e);
+                const auto actor = host.open(id);
+                const auto commands = QStringLiteral("{\"cmd\":\"add\",\"name\":\"C%1\",\"initiative\":%2,\"seq\":%1}\n{\"cmd\":\"advance\"}\n")
+                                          .arg(batch)
+                                          .arg(batch % 20)
+                                          .toUtf8();
+                actor->post(commands, [&mutex, &seqs, id](const QByteArray &events) {
+                    const auto event = QJsonDocument::fromJson(events.left(events.indexOf('\n'))).object();
+                    std::lock_guard<std::mutex> lock(mutex);
+                    seqs[id].push_back(event.value("seq").toInt(-1));
+                });
+            }
+        }
+        int seen = -1;
+        host.attach(QStringLiteral("table-3"))->post([&seen](TurnManager &manager, DiceRoller &) { seen = manager.combatants().size(); });
+        host.waitForIdle();
+        QCOMPARE(seen, kBatches);
+        QCOMPARE(host.encounterIds().size(), kEncounters);
+        QVERIFY(!host.attach(QStringLiteral("missing")));
+    }
+    QCOMPARE(seqs.size(), kEncounters);
+    for (auto it = seqs.cbegin(); it != seqs.cend(); ++it) {
+        QCOMPARE(it.value().size(), kBatches);
+        for (int i = 0; i < kBatches; ++i) {
+            QCOMPARE(it.value().at(i), i);
+        }
+    }
+    const auto saved = EncounterStore::readFile(QDir(autosaveDir).filePath(QStringLiteral("table-5.json")));
+    QVERIFY(saved.has_value());
+    QCOMPARE(saved->combatants.size(), kBatches);
+}
+
+void TestTurnManager::playerBroadcast() {
+    TurnManager manager;
+    manager.setCombatants({Combatant{1, "Alice", 15, 2, true}, Combatant{2, "Ogre", 12, 1, false}, Combatant{3, "Cara", 8, 0, true}});
+    manager.updateCombatant(2, [](Combatant &combatant) {
+        combatant.hp = 40;
+        combatant.notes = QStringLiteral("weak to fire");
+    });
+
+    PlayerViewEncoder encoder;
+    encoder.setStreamerMode(true);
+    PlayerViewState client;
+    QByteArray wire = encoder.update(manager);
+    QCOMPARE(client.apply(wire), 1);
+    QVERIFY(client.streamerMode);
+    QCOMPARE(client.entries.size(), 3);
+    QVERIFY(client.entries.at(1).notes.isEmpty());
+    QVERIFY(!client.entries.at(1).exactHp);
+    QCOMPARE(client.entries.at(1).hp, int(PlayerHpBucket::Healthy));
+    QVERIFY(encoder.update(manager).isEmpty());
+
+    manager.updateCombatant(2, [](Combatant &combatant) {
+        combatant.hp = 15;
+        combatant.conditions.push_back(Condition{QStringLiteral("Prone"), 2});
+    });
+    manager.updateCombatant(3, [](Combatant &combatant) { combatant.initiative = 20; });
+    manager.updateCombatant(2, [](Combatant &combatant) { combatant.notes = QStringLiteral("fleeing"); });
+    manager.addCombatant(Combatant{4, "Dax", 10, 0, false});
+    manager.removeCombatant(1);
+    manager.advanceTurn();
+    wire = encoder.update(manager);
+    QVERIFY(client.apply(wire) > 0);
+    QVERIFY(wire.isEmpty());
+
+    // The delta-fed client must match a client built from a fresh snapshot.
+    PlayerViewState fresh;
+    wire = encoder.snapshot();
+    QCOMPARE(fresh.apply(wire), 1);
+    QCOMPARE(client.entries, fresh.entries);
+    QCOMPARE(client.round, fresh.round);
+    QCOMPARE(client.turnIndex, fresh.turnIndex);
+    QCOMPARE(client.entries.at(0).id, 3);
+    QCOMPARE(client.entries.at(1).hp, int(PlayerHpBucket::Bloodied));
+    QCOMPARE(client.entries.at(1).conditions, QStringList{QStringLiteral("Prone")});
+
+    // A partial frame stays buffered until the rest arrives.
+    manager.updateCombatant(3, [](Combatant &combatant) { combatant.hp = 7; });
+    const auto hpFrame = encoder.update(manager);
+    QCOMPARE(hpFrame.size(), 14);
+    wire = hpFrame.left(5);
+    QCOMPARE(client.apply(wire), 0);
+    wire += hpFrame.mid(5);
+    QCOMPARE(client.apply(wire), 1);
+    QCOMPARE(client.entries.at(0).hp, 7);
+
+    // Stand-in display client on loopback.
+    BroadcastServer server;
+    server.setStreamerMode(true);
+    QVERIFY(server.listen(0));
+    server.publish(manager);
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(socket.waitForConnected(5000));
+    PlayerViewState remote;
+    QByteArray received;
+    const auto pump = [&]() {
+        received += socket.readAll();
+        return remote.apply(received);
+    };
+    QTRY_COMPARE(server.clientCount(), 1);
+    QTRY_VERIFY(pump() > 0);
+    QCOMPARE(remote.entries.size(), 3);
+    manager.advanceTurn();
+    manager.updateCombatant(2, [](Combatant &combatant) { combatant.hp = 0; });
+    server.publish(manager);
+    QTRY_VERIFY(pump() >= 0 && remote.round == manager.round() && remote.turnIndex == manager.turnIndex()
+                && remote.entries.at(manager.indexOf(2)).hp == int(PlayerHpBucket::Down));
+}
+
+// Readers on plain threads race the writer. Every batch sets all HP to the
+// same value, so a torn snapshot shows up as mixed HP. Build with
+// -DDND_TSAN=ON to have ThreadSanitizer check the publication itself.
+void TestTurnManager::snapshotReadersStress() {
+    constexpr int kCombatants = 200;
+    constexpr int kBatches = 5000;
+    TurnManager manager;
+    TurnManager::CombatantList list;
+    QVector<int> ids;
+    for (int i = 1; i <= kCombatants; ++i) {
+        list.push_back(Combatant{i, QStringLiteral("C%1").arg(i), i % 20, 0, false});
+        ids.push_back(i);
+    }
+    manager.setCombatants(list);
+
+    std::atomic<bool> stop{false};
+    std::atomic<int> torn{0};
+    std::atomic<qint64> reads{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.emplace_back([&]() {
+            quint64 lastSerial = 0;
+            while (!stop.load()) {
+                const auto version = manager.snapshot();
+                if (version->serial < lastSerial || version->size() != kCombatants) {
+                    ++torn;
+                }
+                lastSerial = version->serial;
+                const int hp = version->at(0).hp;
+                for (int position = 1; position < version->size(); ++position) {
+                    if (version->at(position).hp != hp) {
+                        ++torn;
+                        break;
+                    }
+                }
+                ++reads;
+            }
+        });
+    }
+    for (int batch = 1; batch <= kBatches; ++batch) {
+        manager.updateCombatants(ids, [batch](int, Combatant &combatant) { combatant.hp = batch; });
+    }
+    stop = true;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    QCOMPARE(torn.load(), 0);
+    QVERIFY(reads.load() > 0);
+    QCOMPARE(manager.snapshot()->at(kCombatants - 1).hp, kBatches);
+    QCOMPARE(manager.snapshot()->serial, manager.currentVersion().serial);
+}
+
+void TestTurnManager::internedNamesAndConditions() {
+    const ConditionName poisoned(QStringLiteral("Poisoned"));
+    QVERIFY(ConditionName("Poisoned") == poisoned);
+    QVERIFY(ConditionName("Prone") != poisoned);
+    QCOMPARE(poisoned.toString(), QStringLiteral("Poisoned"));
+    QVERIFY(ConditionName(QString()).isEmpty());
+
+    const SpawnStyle style{QStringLiteral("Goblin"), QStringLiteral("%name %index"), true, 2};
+    const auto third = CombatantName::spawned(style, 3);
+    QVERIFY(third.isSpawned());
+    QCOMPARE(third.toString(), QStringLiteral("Goblin 03"));
+    QCOMPARE(third.ownedBytes(), qsizetype(0));
+    QVERIFY(third == CombatantName(QStringLiteral("Goblin 03")));
+    QVERIFY(CombatantName::spawned(style, 9).lessCaseFolded(CombatantName::spawned(style, 10)));
+    // Past the pad width the text order wins over the numeric one.
+    QVERIFY(CombatantName::spawned(style, 100).lessCaseFolded(CombatantName::spawned(style, 99)));
+
+    ConditionList conditions;
+    conditions.push_back({poisoned, 2});
+    conditions.push_back({"Prone", 1});
+    QVERIFY(conditions.isInline());
+    QCOMPARE(conditions.heapBytes(), qsizetype(0));
+    conditions.push_back({"Blinded", 3});
+    QVERIFY(!conditions.isInline());
+    const ConditionList copy = conditions;
+    QVERIFY(copy == conditions);
+    conditions.erase(conditions.begin(), conditions.begin() + 1);
+    QCOMPARE(conditions.size(), 2);
+    QCOMPARE(conditions.at(0).name.toString(), QStringLiteral("Prone"));
+    QVERIFY(copy != conditions);
+
+    TurnManager manager;
+    Combatant goblin{1, third, 12, 1, false};
+    goblin.conditions = copy;
+    manager.addCombatant(goblin);
+    Combatant renamed{2, CombatantName::spawned(style, 4), 10, 0, false};
+    manager.addCombatant(renamed);
+    QVERIFY(manager.updateCombatant(2, [](Combatant &combatant) { combatant.name = QStringLiteral("Boss"); }));
+    const auto data = EncounterStore::serialize(manager, 1, 0);
+    TurnManager restored;
+    int round = 0;
+    int turnIndex = 0;
+    QVERIFY(EncounterStore::deserialize(data, restored, round, turnIndex));
+    QCOMPARE(restored.combatants().size(), 2);
+    QVERIFY(restored.combatants().at(0).name.isSpawned());
+    QCOMPARE(restored.combatants().at(0).name.toString(), QStringLiteral("Goblin 03"));
+    QVERIFY(restored.combatants().at(0).conditions == copy);
+    QVERIFY(!restored.combatants().at(1).name.isSpawned());
+    QCOMPARE(restored.combatants().at(1).name.toString(), QStringLiteral("Boss"));
+}
+
+void TestTurnManager::initiativeRulePolicies() {
+    TurnManager manager;
+    Combatant pc{1, "Pip", 14, 2, true};
+    pc.dexScore = 14;
+    pc.tiebreak = 5;
+    pc.side = 0;
+    Combatant npc{2, "Orc", 14, 2, false};
+    npc.dexScore = 15;
+    npc.tiebreak = 9;
+    npc.side = 1;
+    Combatant ally{3, "Ally", 14, 0, true};
+    ally.side = 0;
+    manager.addCombatants({pc, npc, ally});
+    auto order = [&manager]() {
+        QVector<int> ids;
+        for (const auto &combatant : manager.combatants()) {
+            ids.push_back(combatant.id);
+        }
+        return ids;
+    };
+    QCOMPARE(manager.initiativeRules(), InitiativeRules::Standard);
+    QCOMPARE(order(), (QVector<int>{1, 2, 3}));
+
+    const auto generation = manager.generation();
+    manager.setInitiativeRules(InitiativeRules::NpcsWinTies);
+    QCOMPARE(order(), (QVector<int>{2, 1, 3}));
+    QVERIFY(manager.generation() > generation);
+    QVERIFY(manager.changesSince(generation).orderChanged);
+
+    manager.setInitiativeRules(InitiativeRules::DexScore);
+    QCOMPARE(order(), (QVector<int>{2, 1, 3}));
+    manager.setInitiativeRules(InitiativeRules::RandomTiebreak);
+    QCOMPARE(order(), (QVector<int>{2, 1, 3}));
+    // Side 0 stays together even though the ally has the worse dex.
+    manager.setInitiativeRules(InitiativeRules::SideInitiative);
+    QCOMPARE(order(), (QVector<int>{1, 3, 2}));
+
+    // Editing a rule-only field re-sorts under the active rules.
+    QVERIFY(manager.updateCombatant(2, [](Combatant &combatant) { combatant.side = -1; }));
+    QCOMPARE(order(), (QVector<int>{2, 1, 3}));
+
+    const auto data = EncounterStore::serialize(manager, 1, 0);
+    TurnManager restored;
+    int round = 0;
+    int turnIndex = 0;
+    QVERIFY(EncounterStore::deserialize(data, restored, round, turnIndex));
+    const auto orc = restored.combatantById(2);
+    QVERIFY(orc.has_value());
+    QCOMPARE(orc->dexScore, 15);
+    QCOMPARE(orc->tiebreak, 9);
+    QCOMPARE(orc->side, -1);
+}
+
+void TestTurnManager::radixSortMatchesComparison() {
+    QRandomGenerator rng(42);
+    const QStringList names{"Goblin", "goblin", "Orc", "Zed", "aaron", "Ogre"};
+    const SpawnStyle style{QStringLiteral("Kobold"), QStringLiteral("%name #%index"), false, 2};
+    TurnManager::CombatantList list;
+    for (int i = 0; i < 3000; ++i) {
+        Combatant combatant{i + 1, names.at(rng.bounded(int(names.size()))), rng.bounded(1, 31), rng.bounded(-1, 6), rng.bounded(4) == 0};
+        if (i % 3 == 0) {
+            combatant.name = CombatantName::spawned(style, rng.bounded(1, 200));
+        }
+        combatant.tiebreak = rng.bounded(1, 8);
+        combatant.side = rng.bounded(3);
+        combatant.dexScore = rng.bounded(2) == 0 ? 0 : rng.bounded(8, 20);
+        list.push_back(combatant);
+    }
+    TurnManager manager;
+    manager.addCombatants(list);
+    QVERIFY(manager.combatants().size() >= TurnManager::kRadixSortThreshold);
+
+    auto ids = [](const TurnManager::CombatantList &combatants) {
+        QVector<int> result;
+        for (const auto &combatant : combatants) {
+            result.push_back(combatant.id);
+        }
+        return result;
+    };
+    auto expectedOrder = [&manager, &ids](InitiativeRules rules) {
+        auto expected = manager.combatants();
+        visitInitiativeOrder(rules, [&expected](auto order) {
+            using Order = decltype(order);
+            std::stable_sort(expected.begin(), expected.end(), [](const Combatant &lhs, const Combatant &rhs) { return Order::less(lhs, rhs); });
+        });
+        return ids(expected);
+    };
+    for (const auto rules : {InitiativeRules::NpcsWinTies, InitiativeRules::DexScore, InitiativeRules::RandomTiebreak,
+                             InitiativeRules::SideInitiative, InitiativeRules::Standard}) {
+        const auto expected = expectedOrder(rules);
+        manager.setInitiativeRules(rules);
+        QCOMPARE(ids(manager.combatants()), expected);
+    }
+
+    // Out-of-range values fall back to the comparison sort.
+    manager.setInitiativeRules(InitiativeRules::SideInitiative);
+    const int lastId = manager.combatants().last().id;
+    QVERIFY(manager.updateCombatant(lastId, [](Combatant &combatant) { combatant.initiative = 5000; }));
+    QCOMPARE(manager.combatants().first().id, lastId);
+    const auto fallbackExpected = expectedOrder(InitiativeRules::Standard);
+    manager.setInitiativeRules(InitiativeRules::Standard);
+    QCOMPARE(ids(manager.combatants()), fallbackExpected);
+
+    // Round-start re-roll: one batch of rolls and one version for the advance.
+    DiceRoller roller;
+    roller.setSeed(7);
+    manager.setRoundStartReroll(&roller);
+    manager.setSkipUnconscious(false);
+    while (manager.turnIndex() != manager.combatants().size() - 1) {
+        QVERIFY(manager.advanceTurn());
+    }
+    const auto before = ids(manager.combatants());
+    const auto generation = manager.generation();
+    QVERIFY(manager.advanceTurn());
+    QCOMPARE(manager.generation(), generation + 1);
+    QCOMPARE(manager.turnIndex(), 0);
+    QVERIFY(ids(manager.combatants()) != before);
+    const auto &rolled = manager.combatants();
+    for (int row = 1; row < rolled.size(); ++row) {
+        QVERIFY(!initiative::StandardOrder::less(rolled.at(row), rolled.at(row - 1)));
+        QVERIFY(rolled.at(row).initiative <= 20 + 5);
+    }
+}
+
+void TestTurnManager::cohortOrdering() {
+    auto member = [](int id, const char *name, int initiative, int cohort) {
+        Combatant combatant{id, name, initiative, 1, false};
+        combatant.cohort = cohort;
+        return combatant;
+    };
+    TurnManager::CombatantList list{member(1, "Goblin 1", 1, 1), member(2, "Wolf 1", 2, 2), member(3, "Aria", 20, 0), member(4, "Goblin 2", 18, 1),
+                                    member(5, "Bandit", 5, 0), member(6, "Wolf 2", 9, 2), member(7, "Goblin 3", 3, 1)};
+    list[5].conditions.append({"Prone", 1});
+    const QVector<Cohort> cohorts{{1, QStringLiteral("Goblins"), 12, 2}, {2, QStringLiteral("Wolves"), 15, 2}};
+    TurnManager manager;
+    manager.setCombatants(list, cohorts);
+
+    auto ids = [&manager]() {
+        QVector<int> result;
+        for (const auto &combatant : manager.combatants()) {
+            result.push_back(combatant.id);
+        }
+        return result;
+    };
+    // Cohorts sort on their own roll, stay contiguous and keep member order.
+    QCOMPARE(ids(), (QVector<int>{3, 2, 6, 1, 4, 7, 5}));
+    QCOMPARE(manager.combatants().at(3).initiative, 12);
+    QCOMPARE(manager.combatants().at(5).initiative, 12);
+
+    // Per-cohort turns skip the rest of the cohort and expire its conditions.
+    manager.setAdvanceMode(AdvanceMode::PerCohort);
+    QVERIFY(manager.advanceTurn());
+    QCOMPARE(manager.turnIndex(), 1);
+    QVERIFY(manager.advanceTurn());
+    QCOMPARE(manager.turnIndex(), 3);
+    QVERIFY(manager.combatantById(6)->conditions.isEmpty());
+    QVERIFY(manager.advanceTurn());
+    QCOMPARE(manager.turnIndex(), 6);
+    QVERIFY(manager.advanceTurn());
+    QCOMPARE(manager.turnIndex(), 0);
+    QCOMPARE(manager.round(), 2);
+    QVERIFY(manager.rewindTurn());
+    QCOMPARE(manager.turnIndex(), 6);
+    QVERIFY(manager.rewindTurn());
+    QCOMPARE(manager.turnIndex(), 3);
+
+    // Re-rolling a cohort moves the whole block.
+    const auto generation = manager.generation();
+    QVERIFY(manager.setCohortInitiative(2, 3));
+    QVERIFY(manager.changesSince(generation).cohortsChanged);
+    QCOMPARE(ids(), (QVector<int>{3, 1, 4, 7, 5, 2, 6}));
+    QCOMPARE(manager.combatantById(6)->initiative, 3);
+    QVERIFY(!manager.setCohortInitiative(9, 1));
+
+    const auto data = EncounterStore::serialize(manager, manager.round(), manager.turnIndex());
+    TurnManager restored;
+    int round = 0;
+    int turnIndex = 0;
+    QVERIFY(EncounterStore::deserialize(data, restored, round, turnIndex));
+    QCOMPARE(restored.cohorts(), manager.cohorts());
+    QCOMPARE(restored.combatants(), manager.combatants());
+
+    // Dissolving a cohort leaves its members in place as individuals.
+    QVERIFY(manager.removeCohort(1));
+    QCOMPARE(manager.cohorts().size(), 1);
+    QCOMPARE(manager.combatantById(4)->cohort, 0);
+    QCOMPARE(manager.combatantById(4)->initiative, 12);
+
+    // Cohorts without members are dropped on load and never saved.
+    TurnManager loaded;
+    auto withOrphan = cohorts;
+    withOrphan.push_back({9, QStringLiteral("Ghosts"), 30, 0});
+    loaded.setCombatants(list, withOrphan);
+    QCOMPARE(loaded.cohorts(), cohorts);
+    loaded.setCohort({9, QStringLiteral("Ghosts"), 30, 0});
+    QVERIFY(!EncounterStore::serialize(loaded, 1, 0).contains("Ghosts"));
+
+    // Creating, editing and deleting cohorts all go through the undo history,
+    // and survive being folded into a ChangeSet.
+    UndoHistory history(&loaded);
+    const Cohort bats{10, QStringLiteral("Bats"), 14, 3};
+    history.push(new AddCombatantsCommand(&loaded, {member(20, "Bat 1", 14, 10), member(21, "Bat 2", 14, 10)}, bats));
+    QVERIFY(loaded.cohortById(10).has_value());
+    history.undo();
+    QVERIFY(!loaded.cohortById(10).has_value());
+    QVERIFY(!loaded.combatantById(20));
+    history.redo();
+    Cohort rerolled = bats;
+    rerolled.initiative = 2;
+    history.push(new EditCohortCommand(&loaded, bats, rerolled));
+    QCOMPARE(loaded.combatantById(21)->initiative, 2);
+    history.push(new EditCohortCommand(&loaded, rerolled, std::nullopt));
+    QVERIFY(!loaded.cohortById(10).has_value());
+    QCOMPARE(loaded.combatantById(21)->cohort, 0);
+    history.undo();
+    QCOMPARE(loaded.combatantById(21)->cohort, 10);
+    history.undo();
+    QCOMPARE(loaded.combatantById(21)->initiative, 14);
+
+    ChangeSet folded;
+    AddCombatantsCommand(&loaded, {member(30, "Rat 1", 4, 11)}, Cohort{11, QStringLiteral("Rats"), 4, 0}).collectChanges(folded);
+    folded.redo(&loaded);
+    QVERIFY(loaded.cohortById(11).has_value());
+    QCOMPARE(loaded.combatantById(30)->cohort, 11);
+    folded.undo(&loaded);
+    QVERIFY(!loaded.cohortById(11).has_value());
+    QVERIFY(!loaded.combatantById(30));
+}
+
+void TestTurnManager::mobRows() {
+    Combatant zombies{1, "Zombie", 8, -2, false};
+    zombies.mob = MobMembers::uniform(200, 22);
+    zombies.syncMobSummary();
+    QCOMPARE(zombies.mob.standing(), 200);
+    QCOMPARE(zombies.hp, 200 * 22);
+
+    QCOMPARE(zombies.mob.applyDamage(30, MobDamage::Focus), 1);
+    QCOMPARE(zombies.mob.hp(0), 0);
+    QCOMPARE(zombies.mob.hp(1), 22);
+    QCOMPARE(zombies.mob.applyDamage(50, MobDamage::Overflow), 2);
+    QCOMPARE(zombies.mob.hp(3), 16);
+    QCOMPARE(zombies.mob.applyDamage(16, MobDamage::Each), 1);
+    QCOMPARE(zombies.mob.standing(), 196);
+    QCOMPARE(zombies.mob.hp(4), 6);
+    zombies.mob.addCondition(5, {"Prone", 1});
+    zombies.mob.addCondition(5, {"Frightened", 2});
+    QCOMPARE(zombies.mob.membersWithConditions(), 1);
+    QVERIFY(!zombies.mob.conditions(6));
+    zombies.syncMobSummary();
+    QCOMPARE(zombies.hp, 196 * 6);
+
+    TurnManager manager;
+    Combatant knight{2, "Knight", 12, 0, true};
+    manager.setCombatants({zombies, knight});
+    QCOMPARE(manager.combatants().size(), 2);
+    QVERIFY(manager.advanceTurn());
+    QVERIFY(manager.advanceTurn());
+    const auto ticked = manager.combatantById(1);
+    QCOMPARE(ticked->mob.conditions(5)->size(), 1);
+    QCOMPARE(ticked->mob.conditions(5)->at(0).name.toString(), QStringLiteral("Frightened"));
+
+    const auto data = EncounterStore::serialize(manager, 1, 0);
+    TurnManager restored;
+    int round = 0;
+    int turnIndex = 0;
+    QVERIFY(EncounterStore::deserialize(data, restored, round, turnIndex));
+    QCOMPARE(restored.combatants(), manager.combatants());
+
+    // Splitting restores individual rows and undoes back to the one mob row.
+    SplitMobCommand split(&manager, *ticked, 10);
+    split.redo();
+    QCOMPARE(manager.combatants().size(), 201);
+    QVERIFY(!manager.combatantById(1));
+    const auto fifth = manager.combatantById(14);
+    QCOMPARE(fifth->name.toString(), QStringLiteral("Zombie 5"));
+    QCOMPARE(fifth->hp, 6);
+    QVERIFY(!manager.combatantById(10)->conscious);
+    QCOMPARE(manager.combatantById(15)->conditions.size(), 1);
+    split.undo();
+    QCOMPARE(manager.combatants().size(), 2);
+    QCOMPARE(*manager.combatantById(1), *ticked);
+
+    // A mob needs members that start standing.
+    RosterStore store;
+    store.setCharacters({RosterCharacter{"Skeleton", 2, false, {}, 0, 13, {}}});
+    QVERIFY(!store.massAddMob(QStringLiteral("Skeleton"), 10));
+    const auto skeletons = store.massAddMob(QStringLiteral("Skeleton"), 10, 13);
+    QVERIFY(skeletons);
+    QCOMPARE(skeletons->mob.standing(), 10);
+    QCOMPARE(skeletons->hp, 130);
+    QCOMPARE(store.character(QStringLiteral("skeleton"))->name, QStringLiteral("Skeleton"));
+    QVERIFY(!store.character(QStringLiteral("Zombie")));
+}
+
+void TestTurnManager::arenaAllocation() {
+    {
+        // Small scratch data stays in the arena's inline buffer.
+        ScratchArena scratch;
+        auto small = scratch.vector<int>(16, 7);
+        const auto *begin = reinterpret_cast<const char *>(&scratch);
+        const auto *data = reinterpret_cast<const char *>(small.data());
+        QVERIFY(data >= begin && data < begin + sizeof(ScratchArena));
+        auto large = scratch.vector<quint64>(ScratchArena::kInlineBytes, 1);
+        QCOMPARE(std::accumulate(large.begin(), large.end(), quint64(0)), quint64(ScratchArena::kInlineBytes));
+    }
+
+    // Arenas and pooling change where memory comes from, not the results.
+    QRandomGenerator rng(11);
+    TurnManager::CombatantList list;
+    for (int i = 0; i < 2000; ++i) {
+        list.push_back(Combatant{i + 1, QStringLiteral("Creature %1").arg(i), rng.bounded(1, 25), rng.bounded(-1, 5), i % 9 == 0});
+    }
+    auto run = [&list](bool enabled) {
+        arena::setEnabled(enabled);
+        TurnManager manager;
+        manager.setCombatants(list);
+        DiceRoller roller;
+        roller.setSeed(3);
+        manager.rerollInitiative(roller, RollMode::Advantage);
+        const auto snapshot = manager.snapshot();
+        arena::setEnabled(true);
+        return snapshot->toList();
+    };
+    const auto heap = run(false);
+    const auto pooled = run(true);
+    QCOMPARE(pooled, heap);
+}
+
+void TestTurnManager::combatLogQueries() {
+    QTemporaryDir temp;
+    QVERIFY(temp.isValid());
+    const auto directory = temp.filePath(QStringLiteral("log"));
+    {
+        CombatLog log(directory);
+        QVERIFY(log.open());
+        for (int round = 1; round <= 4; ++round) {
+            log.append(CombatEventType::TurnStarted, round, 0, 1, round - 1, round);
+            log.append(CombatEventType::HpChanged, round, 1, 2, 20 - round, 19 - round);
+            log.append(CombatEventType::ConditionAdded, round, 1, 1, 0, 2, QStringLiteral("Poisoned"));
+        }
+        QCOMPARE(log.endSequence(), quint64(12));
+        const auto goblin = log.eventsFor(1, 2, 3);
+        QCOMPARE(goblin.size(), 4);
+        QCOMPARE(goblin.at(0).round, 2u);
+        QVERIFY(goblin.at(1).type == CombatEventType::ConditionAdded);
+        QCOMPARE(log.text(goblin.at(1).text), QStringLiteral("Poisoned"));
+        QCOMPARE(log.eventsInRounds(4, 4).size(), 3);
+        QVERIFY(log.eventsFor(3, 0, 10).isEmpty());
+    }
+    {
+        // Reopening rebuilds the index from the mapped segments.
+        CombatLog log(directory);
+        QVERIFY(log.open());
+        QCOMPARE(log.endSequence(), quint64(12));
+        const auto orc = log.eventsFor(2, 0, 10);
+        QCOMPARE(orc.size(), 4);
+        QCOMPARE(orc.last().after, 15);
+        QCOMPARE(log.text(log.eventsFor(1, 4, 4).last().text), QStringLiteral("Poisoned"));
+        log.append(CombatEventType::Removed, 5, 0, 2);
+        QCOMPARE(log.eventsFor(2, 5, 5).size(), 1);
+    }
+    {
+        CombatLog log(directory);
+        QVERIFY(log.open());
+        log.setMaxSegments(2);
+        for (quint32 i = 0; i < 2 * CombatLog::kRecordsPerSegment; ++i) {
+            log.append(CombatEventType::Roll, 6, 0, 0, 10, 12, QStringLiteral("normal"));
+        }
+        QCOMPARE(log.firstSequence(), quint64(CombatLog::kRecordsPerSegment));
+        QVERIFY(log.eventsFor(1, 0, 10).isEmpty());
+        QVERIFY(log.eventsInRounds(0, 5).isEmpty());
+        QCOMPARE(log.eventsInRounds(6, 6).size(), int(log.endSequence() - log.firstSequence()));
+    }
+    QDir(directory).removeRecursively();
+
+    CombatLog log(directory);
+    QVERIFY(log.open());
+    TurnManager manager;
+    Combatant goblin{1, "Goblin", 15, 2, false};
+    goblin.hp = 7;
+    manager.setCombatants({goblin, Combatant{2, "Orc", 12, 1, false}});
+    manager.setEventLog(&log);
+    QVERIFY(manager.updateCombatant(1, [](Combatant &combatant) {
+        combatant.hp = 3;
+        combatant.conditions.push_back({"Prone", 1});
+    }));
+    QVERIFY(manager.advanceTurn());
+    const auto events = log.eventsFor(1, 1, 1);
+    // The hit and the condition, then its expiry at the end of the turn.
+    QCOMPARE(events.size(), 3);
+    QVERIFY(events.at(0).type == CombatEventType::HpChanged);
+    QCOMPARE(events.at(0).before, 7);
+    QCOMPARE(events.at(0).after, 3);
+    QCOMPARE(log.text(events.at(1).text), QStringLiteral("Prone"));
+    QVERIFY(events.at(2).type == CombatEventType::ConditionEnded);
+    QCOMPARE(events.at(2).before, 1);
+    const auto turns = log.eventsFor(2, 1, 1);
+    QCOMPARE(turns.size(), 1);
+    QVERIFY(turns.first().type == CombatEventType::TurnStarted);
+
+    // A new fight reuses id 1; its history starts at the new encounter.
+    Combatant bandit{1, "Bandit", 11, 1, false};
+    bandit.hp = 9;
+    manager.setCombatants({bandit});
+    const auto fightStart = log.encounterStart();
+    QVERIFY(log.at(fightStart).type == CombatEventType::EncounterStarted);
+    QVERIFY(log.eventsFor(1, 1, 1).size() > 1);
+    const auto current = log.eventsFor(1, 1, 1, fightStart);
+    QVERIFY(!current.isEmpty());
+    QVERIFY(current.first().type == CombatEventType::Added);
+    QCOMPARE(log.text(current.first().text), QStringLiteral("Bandit"));
+    QVERIFY(std::none_of(current.begin(), current.end(), [](const CombatEvent &event) { return event.type == CombatEventType::HpChanged; }));
+    manager.setEventLog(nullptr);
+    log.close();
+}
+
+void TestTurnManager::campaignAnalytics() {
+    CampaignAnalytics analytics;
+    EncounterData first;
+    first.round = 4;
+    first.combatants = {Combatant{1, "Vaelen", 18, 3, true}, Combatant{2, "Brom", 9, 0, true}, Combatant{3, "Goblin", 14, 2, false}};
+    EncounterData second;
+    second.round = 2;
+    second.combatants = {Combatant{1, "Vaelen", 12, 3, true}, Combatant{4, "Goblin", 3, 2, false}};
+    analytics.addEncounter(first);
+    analytics.addEncounter(second);
+    QCOMPARE(analytics.fightCount(), 2);
+    QCOMPARE(analytics.rowCount(), 5);
+    QCOMPARE(analytics.averageRoundsPerFight(), 3.0);
+
+    AnalyticsQuery initiative{{{AnalyticsField::IsPC, AnalyticsOp::Equal, 1}}, AnalyticsField::Name, AnalyticsAggregate::Average, AnalyticsField::Initiative};
+    const auto perPc = analytics.run(initiative);
+    QCOMPARE(perPc.size(), 2);
+    QCOMPARE(analytics.label(AnalyticsField::Name, perPc.at(0).key), QStringLiteral("Vaelen"));
+    QCOMPARE(perPc.at(0).count, qint64(2));
+    QCOMPARE(perPc.at(0).value, 15.0);
+    QCOMPARE(perPc.at(1).value, 9.0);
+    const auto total = analytics.run({{{AnalyticsField::Rounds, AnalyticsOp::Greater, 2}}, std::nullopt, AnalyticsAggregate::Count, AnalyticsField::Fight});
+    QCOMPARE(total.size(), 1);
+    QCOMPARE(total.first().count, qint64(3));
+    const auto buckets = analytics.histogram(AnalyticsField::Initiative, 5);
+    QCOMPARE(buckets.size(), 4);
+    QCOMPARE(buckets.first().key, 0);
+    QCOMPARE(buckets.last().key, 15);
+    QCOMPARE(buckets.at(1).count, qint64(1));
+
+    // A combat log adds damage and condition uptime, one finished fight at a time.
+    QTemporaryDir temp;
+    QVERIFY(temp.isValid());
+    CombatLog log(temp.path());
+    QVERIFY(log.open());
+    TurnManager manager;
+    manager.setEventLog(&log);
+    Combatant vaelen{1, "Vaelen", 18, 3, true};
+    vaelen.hp = 30;
+    manager.setCombatants({vaelen, Combatant{2, "Orc", 5, 0, false}});
+    manager.updateCombatant(1, [](Combatant &combatant) {
+        combatant.hp = 22;
+        combatant.conditions.push_back({"Poisoned", 2});
+    });
+    manager.updateCombatant(1, [](Combatant &combatant) { combatant.hp = 25; });
+    for (int i = 0; i < 3; ++i) {
+        manager.advanceTurn();
+    }
+    QCOMPARE(analytics.addCombatLog(log), 0);
+    manager.setCombatants({Combatant{5, "Brom", 11, 0, true}});
+    QCOMPARE(analytics.addCombatLog(log), 1);
+    QCOMPARE(analytics.addCombatLog(log), 0);
+    manager.setEventLog(nullptr);
+    QCOMPARE(analytics.fightCount(), 3);
+    QCOMPARE(analytics.rowCount(), 7);
+    const QVector<AnalyticsFilter> lastFight = {{AnalyticsField::Fight, AnalyticsOp::Equal, 2}, {AnalyticsField::IsPC, AnalyticsOp::Equal, 1}};
+    const auto damage = analytics.run({lastFight, AnalyticsField::Name, AnalyticsAggregate::Sum, AnalyticsField::DamageTaken});
+    QCOMPARE(damage.size(), 1);
+    QCOMPARE(analytics.name(damage.first().key), QStringLiteral("Vaelen"));
+    QCOMPARE(damage.first().value, 8.0);
+    QCOMPARE(analytics.run({lastFight, std::nullopt, AnalyticsAggregate::Sum, AnalyticsField::ConditionRounds}).first().value, 2.0);
+    QCOMPARE(analytics.run({lastFight, std::nullopt, AnalyticsAggregate::Max, AnalyticsField::Rounds}).first().value, 2.0);
+
+    const auto snapshot = temp.filePath(QStringLiteral("campaign.analytics"));
+    QVERIFY(analytics.save(snapshot));
+    CampaignAnalytics reloaded;
+    QVERIFY(reloaded.load(snapshot));
+    QCOMPARE(reloaded.rowCount(), analytics.rowCount());
+    QCOMPARE(reloaded.summary(), analytics.summary());
+    QCOMPARE(reloaded.addCombatLog(log), 0);
+    log.close();
+}
+
+void TestTurnManager::rosterIncrementalReload() {
+    QTemporaryDir temp;
+    QVERIFY(temp.isValid());
+    const auto basePath = temp.path();
+    RosterCharacter goblin{"Goblin", 2, false, {"goblinoid"}, 7, 15, {}};
+    RosterCharacter orc{"Orc", 1, false, {"orc"}, 15, 13, {}};
+    RosterCharacter ogre{"Ogre", -1, false, {"giant"}, 59, 11, {}};
+    RosterStore store;
+    store.setBasePath(basePath);
+    store.setCharacters({goblin, orc, ogre});
+    store.setGroups({RosterGroup{"Camp", {{"Goblin", 4}, {"Ogre", 1}}}});
+    QSignalSpy changed(&store, &RosterStore::rosterChanged);
+    RosterChanges lastChanges;
+    connect(&store, &RosterStore::rosterChanged, this, [&lastChanges](const RosterChanges &changes) { lastChanges = changes; });
+
+    RosterData next;
+    next.hasCharacters = true;
+    goblin.dexMod = 3;
+    RosterCharacter troll{"Troll", 1, false, {"giant"}, 84, 15, {}};
+    next.characters = {troll, ogre, goblin};
+    next.hasGroups = true;
+    next.groups = {RosterGroup{"Camp", {{"Goblin", 6}, {"Ogre", 1}}}};
+    const auto changes = store.applyChanges(next);
+    QVERIFY(!changes.reset);
+    QCOMPARE(changes.insertedCharacters, QStringList{"Troll"});
+    QCOMPARE(changes.updatedCharacters, QStringList{"Goblin"});
+    QCOMPARE(changes.removedCharacters, QStringList{"Orc"});
+    QCOMPARE(changes.updatedGroups, QStringList{"Camp"});
+    QCOMPARE(changed.count(), 1);
+    // Surviving entries keep their places and new names are appended.
+    QCOMPARE(store.characters().size(), 3);
+    QCOMPARE(store.characters().at(0).dexMod, 3);
+    QCOMPARE(store.characters().at(2).name, QStringLiteral("Troll"));
+    const auto giants = store.filterCharacters(QString(), {"giant"});
+    QCOMPARE(giants.size(), 2);
+    QCOMPARE(giants.at(0).name, QStringLiteral("Ogre"));
+    QVERIFY(store.filterCharacters(QString(), {"orc"}).isEmpty());
+    QCOMPARE(store.massAdd(QStringLiteral("troll"), 2, store.defaultNaming()).size(), 2);
+    QCOMPARE(store.massAddGroup(QStringLiteral("camp"), store.defaultNaming()).size(), 7);
+    QVERIFY(store.applyChanges(next).isEmpty());
+    QCOMPARE(changed.count(), 1);
+
+    // An external save is picked up, parsed off-thread and applied as a patch.
+    QVERIFY(store.save());
+    store.setReloadDelay(20);
+    store.setWatching(true);
+    RosterStore writer;
+    writer.setBasePath(basePath);
+    writer.load();
+    auto characters = writer.characters();
+    characters.removeAt(1);
+    characters.push_back(RosterCharacter{"Hobgoblin", 1, false, {"goblinoid"}, 11, 18, {}});
+    writer.setCharacters(characters);
+    QVERIFY(writer.save());
+    QTRY_COMPARE_WITH_TIMEOUT(changed.count(), 2, 5000);
+    QCOMPARE(lastChanges.insertedCharacters, QStringList{"Hobgoblin"});
+    QCOMPARE(lastChanges.removedCharacters, QStringList{"Ogre"});
+    QVERIFY(lastChanges.updatedCharacters.isEmpty());
+    QCOMPARE(store.filterCharacters(QStringLiteral("gob"), {"goblinoid"}).size(), 2);
+
+    // A full reload applies the other entries but keeps unsaved local edits.
+    goblin.dexMod = 5;
+    store.updateCharacter(goblin);
+    characters = writer.characters();
+    characters[1].defaultHP = 90;
+    characters.push_back(RosterCharacter{"Bugbear", 2, false, {"goblinoid"}, 27, 16, {}});
+    writer.setCharacters(characters);
+    QVERIFY(writer.save());
+    QTRY_COMPARE_WITH_TIMEOUT(changed.count(), 4, 5000);
+    QCOMPARE(store.characters().size(), 4);
+    QCOMPARE(store.characters().at(0).dexMod, 5);
+    QCOMPARE(store.characters().at(1).defaultHP, 90);
+    QCOMPARE(store.characters().last().name, QStringLiteral("Bugbear"));
+    QVERIFY(store.hasUnsavedChanges());
+    QVERIFY(store.save());
+    RosterStore reader;
+    reader.setBasePath(basePath);
+    reader.load();
+    QCOMPARE(reader.characters().at(0).dexMod, 5);
+    QCOMPARE(reader.characters().at(1).defaultHP, 90);
+    store.setWatching(false);
+}
+
+void TestTurnManager::rosterShardedSave() {
+    QTemporaryDir temp;
+    QVERIFY(temp.isValid());
+    const auto basePath = temp.filePath(QStringLiteral("data"));
+    const auto exportPath = temp.filePath(QStringLiteral("export"));
+    QVector<RosterCharacter> characters;
+    for (int i = 0; i < 600; ++i) {
+        characters.push_back(RosterCharacter{QStringLiteral("Monster %1").arg(i + 1), i % 5, false, {"beast"}, 10 + i % 7, 12, {}});
+    }
+    RosterStore store;
+    store.setBasePath(basePath);
+    store.setCharacters(characters);
+    store.setGroups({RosterGroup{"Pack", {{"Monster 1", 3}}}});
+    QVERIFY(store.hasUnsavedChanges());
+    QVERIFY(store.save());
+    QVERIFY(!store.hasUnsavedChanges());
+    QVERIFY(QFileInfo::exists(basePath + "/roster/manifest.json"));
+    QVERIFY(!QFileInfo::exists(basePath + "/characters.json"));
+
+    // Edits keep the saved order: updates in place, new names at the end.
+    auto edited = characters.at(4);
+    edited.dexMod = 9;
+    store.updateCharacter(edited);
+    QVERIFY(store.removeCharacter(QStringLiteral("monster 7")));
+    store.updateCharacter(RosterCharacter{"Zombie Lord", 0, false, {"undead"}, 66, 14, {}});
+    QVERIFY(!store.removeCharacter(QStringLiteral("Nobody")));
+    QVERIFY(store.save());
+    RosterStore reader;
+    reader.setBasePath(basePath);
+    reader.load();
+    QVERIFY(!reader.hasUnsavedChanges());
+    QCOMPARE(reader.characters().size(), 600);
+    QCOMPARE(reader.characters().at(4).dexMod, 9);
+    QCOMPARE(reader.characters().at(6).name, QStringLiteral("Monster 8"));
+    QCOMPARE(reader.characters().last().name, QStringLiteral("Zombie Lord"));
+    QCOMPARE(reader.groups().first().name, QStringLiteral("Pack"));
+
+    // The single-file layout still round-trips, and loading it migrates.
+    QVERIFY(reader.exportFiles(exportPath));
+    QVERIFY(QFileInfo::exists(exportPath + "/characters.json"));
+    RosterStore legacy;
+    legacy.setBasePath(exportPath);
+    legacy.load();
+    QCOMPARE(legacy.characters().size(), 600);
+    QVERIFY(legacy.hasUnsavedChanges());
+    QVERIFY(legacy.save());
+    const auto migrated = RosterStore::readFiles(exportPath);
+    QVERIFY(migrated.sharded);
+    QCOMPARE(migrated.characters.size(), 600);
+    QCOMPARE(migrated.characters.last().name, QStringLiteral("Zombie Lord"));
+    RosterStore imported;
+    imported.setBasePath(basePath);
+    imported.load();
+    QVERIFY(imported.importFiles(exportPath));
+    QVERIFY(!imported.hasUnsavedChanges());
+
+    // Growing the layout writes a second set of files; until the manifest
+    // names it, readers still get the previous one whole.
+    QDir shards(basePath + "/roster");
+    QHash<QString, QByteArray> previous;
+    for (const auto &name : shards.entryList({QStringLiteral("*.json")}, QDir::Files)) {
+        QFile file(shards.filePath(name));
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        previous.insert(name, file.readAll());
+    }
+    auto grown = store.characters();
+    for (int i = 0; i < 5000; ++i) {
+        grown.push_back(RosterCharacter{QStringLiteral("Swarm %1").arg(i + 1), 0, false, {"beast"}, 5, 10, {}});
+    }
+    store.setCharacters(grown);
+    QVERIFY(store.save());
+    QVERIFY(shards.entryList({QStringLiteral("characters-010-*.json")}, QDir::Files).isEmpty());
+    QVERIFY(!shards.entryList({QStringLiteral("characters-020-*.json")}, QDir::Files).isEmpty());
+    QCOMPARE(RosterStore::readFiles(basePath).characters.size(), 5600);
+    for (auto it = previous.cbegin(); it != previous.cend(); ++it) {
+        QFile file(shards.filePath(it.key()));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(it.value());
+    }
+    const auto interrupted = RosterStore::readFiles(basePath);
+    QCOMPARE(interrupted.characterShardCount, 16);
+    QCOMPARE(interrupted.characters.size(), 600);
+    QCOMPARE(interrupted.characters.at(4).dexMod, 9);
+
+    // Only the shard holding the edit is written.
+    for (const auto &name : shards.entryList({QStringLiteral("characters-*.json")}, QDir::Files)) {
+        QVERIFY(shards.remove(name));
+    }
+    edited.dexMod = 1;
+    store.updateCharacter(edited);
+    QVERIFY(store.save());
+    QCOMPARE(shards.entryList({QStringLiteral("characters-*.json")}, QDir::Files).size(), 1);
+}
+
+void TestTurnManager::bestiaryImport() {
+    const QByteArray csv = "\xEF\xBB\xBFName,DEX,HP,AC,Tags,Notes,Group,Count\r\n"
+                           "Goblin,+2,7,15 (leather armor),goblinoid;minion,,Ambush,4\r\n"
+                           "\"Ogre, Chieftain\",-1,52 (8d10+8),11,giant,\"Carries a \"\"lucky\"\" club,\nand a sack\",Ambush,1\r\n"
+                           "Wolf,2,2d8+2,13,beast,,,\r\n"
+                           "\r\n"
+                           "Broken,1,10,plate,,,,\r\n"
+                           ",1,10,12,,,,\r\n"
+                           "Imp,3,10,13,fiend,,Ambush,none\r\n"
+                           "Bandit,1,11,12,humanoid,Last row has no newline,,";
+    const auto result = BestiaryImport::parse(csv.constData(), csv.size());
+    QVERIFY(result.error.isEmpty());
+    QCOMPARE(result.rows, 7);
+    QCOMPARE(result.data.characters.size(), 4);
+    QCOMPARE(result.errors.size(), 3);
+    QCOMPARE(result.errors.at(0).row, 6);
+    QVERIFY(result.errors.at(0).message.contains(QStringLiteral("AC")));
+    QCOMPARE(result.errors.at(1).message, QStringLiteral("missing name"));
+    QCOMPARE(result.errors.at(2).row, 8);
+    const auto &ogre = result.data.characters.at(1);
+    QCOMPARE(ogre.name, QStringLiteral("Ogre, Chieftain"));
+    QCOMPARE(ogre.defaultHP, 52);
+    QCOMPARE(ogre.defaultNotes, QStringLiteral("Carries a \"lucky\" club,\nand a sack"));
+    QCOMPARE(result.data.characters.at(0).defaultAC, 15);
+    QCOMPARE(result.data.characters.at(0).tags, (QSet<QString>{"goblinoid", "minion"}));
+    QCOMPARE(result.data.characters.at(2).defaultHP, 11);
+    QCOMPARE(result.data.characters.at(3).defaultNotes, QStringLiteral("Last row has no newline"));
+    QCOMPARE(result.data.groups.size(), 1);
+    QCOMPARE(result.data.groups.first().entries.size(), 2);
+    // An existing group keeps its other entries and takes the file's counts.
+    RosterStore camp;
+    camp.setGroups({RosterGroup{"ambush", {{"goblin", 2}, {"Wolf", 3}}}});
+    const auto merged = camp.merge(result.data);
+    QCOMPARE(merged.updatedGroups, QStringList{"ambush"});
+    const auto &ambush = camp.groups().first().entries;
+    QCOMPARE(ambush.size(), 3);
+    QCOMPARE(ambush.at(0).count, 4);
+    QCOMPARE(ambush.at(1).characterName, QStringLiteral("Wolf"));
+    QCOMPARE(ambush.at(2).characterName, QStringLiteral("Ogre, Chieftain"));
+    QVERIFY(camp.merge(result.data).updatedGroups.isEmpty());
+
+    // Tab-separated, mapped by column number, with ability scores for dex.
+    const QByteArray tsv = "Mummy\t8\t58\nZombie\t6\t22\n";
+    BestiaryColumns columns;
+    columns.hasHeader = false;
+    columns.name = QStringLiteral("1");
+    columns.dex = QStringLiteral("2");
+    columns.hp = QStringLiteral("3");
+    columns.dexIsScore = true;
+    const auto undead = BestiaryImport::parse(tsv.constData(), tsv.size(), columns);
+    QCOMPARE(undead.data.characters.size(), 2);
+    QCOMPARE(undead.data.characters.at(0).dexMod, -1);
+    QCOMPARE(undead.data.characters.at(1).defaultHP, 22);
+    QVERIFY(!BestiaryImport::parse(tsv.constData(), tsv.size()).error.isEmpty());
+
+    // Enough rows to span several scan chunks and parse batches, with quoted
+    // newlines throughout; the result feeds the name and tag lookups.
+    QByteArray large = "name,hp,tags,notes\n";
+    for (int i = 0; i < 30000; ++i) {
+        large += QStringLiteral("Monster %1,%2,%3,\"line one\nline two\"\n").arg(i).arg(10 + i % 9).arg(QLatin1String(i % 3 == 0 ? "undead" : "beast")).toUtf8();
+    }
+    QTemporaryDir temp;
+    QVERIFY(temp.isValid());
+    const auto path = temp.filePath(QStringLiteral("bestiary.csv"));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(large);
+    file.close();
+    auto bulk = BestiaryImport::readFile(path);
+    QVERIFY(bulk.errors.isEmpty());
+    QCOMPARE(bulk.data.characters.size(), 30000);
+    QCOMPARE(bulk.data.characters.last().name, QStringLiteral("Monster 29999"));
+    RosterStore store;
+    store.setCharacters({RosterCharacter{"Monster 5", 0, false, {"old"}, 1, 10, {}}, RosterCharacter{"Lich", 4, false, {"undead"}, 135, 17, {}}});
+    const auto changes = store.merge(std::move(bulk.data));
+    QCOMPARE(changes.updatedCharacters, QStringList{"Monster 5"});
+    QCOMPARE(changes.insertedCharacters.size(), 29999);
+    QCOMPARE(store.characters().size(), 30001);
+    QCOMPARE(store.characters().at(1).name, QStringLiteral("Lich"));
+    QCOMPARE(store.filterCharacters(QString(), {"undead"}).size(), 10001);
+    QCOMPARE(store.massAdd(QStringLiteral("monster 29999"), 2, store.defaultNaming()).first().hp, 10 + 29999 % 9);
 }
 
 QTEST_MAIN(TestTurnManager)